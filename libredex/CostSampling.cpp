@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CostSampling.h"
+
+#include <algorithm>
+#include <array>
+#include <mutex>
+
+#include "JemallocUtil.h"
+#include "ShardedMetrics.h"
+#include "Thread.h"
+
+namespace cost_sampling {
+
+namespace {
+
+constexpr size_t NUM_SHARDS = 16;
+
+bool slower(const Sample& a, const Sample& b) { return a.wall_ns > b.wall_ns; }
+
+// Adds the sample to a min-heap (by wall time) of at most `top_k` samples, so
+// that the fastest of the retained samples is cheap to check and evict.
+void add_to_heap(const Sample& sample,
+                 size_t top_k,
+                 std::vector<Sample>* heap) {
+  if (heap->size() < top_k) {
+    heap->push_back(sample);
+    std::push_heap(heap->begin(), heap->end(), slower);
+  } else if (!heap->empty() && slower(sample, heap->front())) {
+    std::pop_heap(heap->begin(), heap->end(), slower);
+    heap->back() = sample;
+    std::push_heap(heap->begin(), heap->end(), slower);
+  }
+}
+
+// Each shard keeps a min-heap of at most K samples, see add_to_heap.
+struct alignas(CACHE_LINE_SIZE) Shard {
+  std::mutex lock;
+  std::vector<Sample> heap;
+};
+
+std::array<Shard, NUM_SHARDS> s_shards;
+
+sharded_metrics::Histogram s_wall_us;
+
+} // namespace
+
+namespace detail {
+
+std::atomic<size_t> s_top_k{0};
+
+void record(const Sample& sample) {
+  s_wall_us.record(sample.wall_ns / 1000);
+  auto top_k = s_top_k.load(std::memory_order_relaxed);
+  auto& shard = s_shards[sharded_metrics::current_shard() % NUM_SHARDS];
+  std::lock_guard<std::mutex> guard(shard.lock);
+  add_to_heap(sample, top_k, &shard.heap);
+}
+
+uint64_t thread_allocated_bytes() {
+  return jemalloc_util::thread_allocated_bytes();
+}
+
+} // namespace detail
+
+void enable(size_t top_k) {
+  detail::s_top_k.store(top_k, std::memory_order_relaxed);
+}
+
+void SlowestSamples::add(const Sample& sample) {
+  add_to_heap(sample, m_top_k, &m_heap);
+}
+
+std::vector<Sample> SlowestSamples::take() {
+  std::vector<Sample> samples;
+  samples.swap(m_heap);
+  std::sort(samples.begin(), samples.end(), slower);
+  return samples;
+}
+
+void take_wall_us(sharded_metrics::Histogram* histogram) {
+  histogram->add(s_wall_us);
+  s_wall_us.reset();
+}
+
+void reset() {
+  for (auto& shard : s_shards) {
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard.heap.clear();
+  }
+  s_wall_us.reset();
+}
+
+std::vector<Sample> take_slowest() {
+  std::vector<Sample> samples;
+  for (auto& shard : s_shards) {
+    std::lock_guard<std::mutex> guard(shard.lock);
+    samples.insert(samples.end(), shard.heap.begin(), shard.heap.end());
+    shard.heap.clear();
+  }
+  std::sort(samples.begin(), samples.end(), slower);
+  auto top_k = detail::s_top_k.load(std::memory_order_relaxed);
+  if (samples.size() > top_k) {
+    samples.resize(top_k);
+  }
+  return samples;
+}
+
+} // namespace cost_sampling
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class DexMethod;
+
+namespace sharded_metrics {
+class Histogram;
+} // namespace sharded_metrics
+
+/**
+ * Opt-in sampling of the cost of processing individual methods, to find the
+ * few pathological (typically huge, generated) methods that dominate the
+ * running time of a pass.
+ *
+ * When enabled, the walkers (see Walkers.h) and work queues over methods (see
+ * WorkQueue.h) measure the wall time, and with jemalloc also the allocated
+ * bytes, of every method they process. Only the top K slowest methods are
+ * retained, along with a histogram of the wall time of all the methods. The
+ * PassManager resets the samples right before each pass runs, so that e.g. the
+ * methods it reads back from disk first don't count, and reports the slowest
+ * methods and the percentiles of the time per method in the pass metrics
+ * afterwards.
+ *
+ * When disabled, the cost of a sample is a single relaxed atomic load.
+ */
+namespace cost_sampling {
+
+struct Sample {
+  const DexMethod* method;
+  uint64_t wall_ns;
+  uint64_t allocated_bytes;
+};
+
+namespace detail {
+extern std::atomic<size_t> s_top_k;
+void record(const Sample& sample);
+uint64_t thread_allocated_bytes();
+} // namespace detail
+
+inline bool is_enabled() {
+  return detail::s_top_k.load(std::memory_order_relaxed) > 0;
+}
+
+// Retain the `top_k` slowest methods. Zero disables the sampling.
+void enable(size_t top_k);
+
+inline size_t top_k() {
+  return detail::s_top_k.load(std::memory_order_relaxed);
+}
+
+// The slowest methods sampled since the last call, slowest first. This resets
+// the samples.
+std::vector<Sample> take_slowest();
+
+// Adds the wall time, in microseconds, of every method sampled since the last
+// call to `histogram`. This resets the wall times.
+void take_wall_us(sharded_metrics::Histogram* histogram);
+
+// Drop the samples taken so far.
+void reset();
+
+// The `top_k` slowest of the samples it is given, for samples that are kept
+// apart from the process-wide ones. This is not thread-safe.
+class SlowestSamples final {
+ public:
+  explicit SlowestSamples(size_t top_k) : m_top_k(top_k) {}
+
+  void add(const Sample& sample);
+
+  // The slowest samples, slowest first. This resets the samples.
+  std::vector<Sample> take();
+
+ private:
+  size_t m_top_k;
+  std::vector<Sample> m_heap;
+};
+
+// Samples the method while in scope. The sample goes to `samples` if given,
+// and to the process-wide samples otherwise.
+class ScopedSample final {
+ public:
+  explicit ScopedSample(const DexMethod* method,
+                        SlowestSamples* samples = nullptr)
+      : m_method(is_enabled() ? method : nullptr), m_samples(samples) {
+    if (m_method != nullptr) {
+      m_allocated_start = detail::thread_allocated_bytes();
+      m_start = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~ScopedSample() {
+    if (m_method == nullptr) {
+      return;
+    }
+    auto wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - m_start)
+                       .count();
+    Sample sample{m_method, static_cast<uint64_t>(wall_ns),
+                  detail::thread_allocated_bytes() - m_allocated_start};
+    if (m_samples != nullptr) {
+      m_samples->add(sample);
+    } else {
+      detail::record(sample);
+    }
+  }
+
+  ScopedSample(const ScopedSample&) = delete;
+  ScopedSample& operator=(const ScopedSample&) = delete;
+
+ private:
+  const DexMethod* m_method;
+  SlowestSamples* m_samples;
+  uint64_t m_allocated_start{0};
+  std::chrono::steady_clock::time_point m_start;
+};
+
+} // namespace cost_sampling
@@ -19,6 +19,7 @@
 #include "DexUtil.h"
 #include "DuplicateClasses.h"
 #include "IRCode.h"
+#include "IRCodeSpill.h"
 #include "IRInstruction.h"
 #include "Show.h"
 #include "StringBuilder.h"
@@ -29,6 +30,8 @@
 #include <algorithm>
 #include <boost/functional/hash.hpp>
 #include <boost/optional.hpp>
+#include <cstring>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -37,7 +40,7 @@ uint32_t DexString::length() const {
   if (is_simple()) {
     return size();
   }
-  return length_of_utf8_string(c_str());
+  return length_of_utf8_string(c_str(), size());
 }
 
 int32_t DexString::java_hashcode() const {
@@ -254,7 +257,7 @@ std::vector<std::unique_ptr<DexDebugInstruction>> generate_debug_instructions(
     for (; it != entries.end() && it->addr == addr; ++it) {
       switch (it->type) {
       case DexDebugEntryType::Position:
-        if (it->pos->file != nullptr) {
+        if (it->pos->file() != nullptr) {
           positions.push_back(it->pos.get());
         }
         break;
@@ -361,9 +364,16 @@ DexCode::DexCode(const DexCode& that)
     : m_registers_size(that.m_registers_size),
       m_ins_size(that.m_ins_size),
       m_outs_size(that.m_outs_size),
-      m_insns(std::make_unique<std::vector<DexInstruction*>>()) {
-  for (auto& insn : *that.m_insns) {
-    m_insns->emplace_back(insn->clone());
+      m_compact(that.m_compact),
+      m_code_units(that.m_code_units),
+      m_code_unit_refs(that.m_code_unit_refs),
+      m_num_instructions(that.m_num_instructions),
+      m_size(that.m_size) {
+  if (that.m_insns) {
+    m_insns = std::make_unique<std::vector<DexInstruction*>>();
+    for (auto& insn : *that.m_insns) {
+      m_insns->emplace_back(insn->clone());
+    }
   }
   for (auto& try_ : that.m_tries) {
     m_tries.emplace_back(new DexTryItem(*try_));
@@ -439,6 +449,86 @@ std::unique_ptr<DexCode> DexCode::get_dex_code(DexIdx* idx, uint32_t offset) {
   return dc;
 }
 
+void DexCode::compact() {
+  always_assert(!is_compact() && m_insns);
+  uint32_t num_code_units = 0;
+  for (auto const& opc : *m_insns) {
+    num_code_units += opc->size();
+  }
+  m_code_units.resize(num_code_units);
+  m_code_unit_refs.clear();
+  m_size = 0;
+  uint16_t* insns = m_code_units.data();
+  for (auto const& opc : *m_insns) {
+    uint32_t offset = insns - m_code_units.data();
+    opc->encode_unresolved(insns);
+    always_assert(uint32_t(insns - m_code_units.data()) ==
+                  offset + opc->size());
+    if (!dex_opcode::is_fopcode(opc->opcode())) {
+      m_size += opc->size();
+    }
+    DexCodeUnitRef ref;
+    // The index follows the opcode unit.
+    ref.offset = offset + 1;
+    if (opc->has_string()) {
+      auto str = static_cast<DexOpcodeString*>(opc);
+      ref.kind = str->jumbo() ? DexCodeUnitRef::STRING_JUMBO
+                              : DexCodeUnitRef::STRING;
+      ref.string = str->get_string();
+    } else if (opc->has_type()) {
+      ref.kind = DexCodeUnitRef::TYPE;
+      ref.type = static_cast<DexOpcodeType*>(opc)->get_type();
+    } else if (opc->has_field()) {
+      ref.kind = DexCodeUnitRef::FIELD;
+      ref.field = static_cast<DexOpcodeField*>(opc)->get_field();
+    } else if (opc->has_method()) {
+      ref.kind = DexCodeUnitRef::METHOD;
+      ref.method = static_cast<DexOpcodeMethod*>(opc)->get_method();
+    } else if (opc->has_callsite()) {
+      ref.kind = DexCodeUnitRef::CALLSITE;
+      ref.callsite = static_cast<DexOpcodeCallSite*>(opc)->get_callsite();
+    } else if (opc->has_methodhandle()) {
+      ref.kind = DexCodeUnitRef::METHODHANDLE;
+      ref.methodhandle =
+          static_cast<DexOpcodeMethodHandle*>(opc)->get_methodhandle();
+    } else {
+      continue;
+    }
+    m_code_unit_refs.push_back(ref);
+  }
+  m_num_instructions = m_insns->size();
+  for (auto const& opc : *m_insns) {
+    delete opc;
+  }
+  m_insns.reset();
+  m_compact = true;
+}
+
+void DexCode::expand() {
+  always_assert(is_compact());
+  auto insns = std::make_unique<std::vector<DexInstruction*>>();
+  insns->reserve(m_num_instructions);
+  const uint16_t* cdata = m_code_units.data();
+  const uint16_t* end = cdata + m_code_units.size();
+  const DexCodeUnitRef* refs = m_code_unit_refs.data();
+  while (cdata < end) {
+    insns->push_back(DexInstruction::make_instruction(&refs, &cdata));
+  }
+  always_assert(cdata == end);
+  always_assert(refs == m_code_unit_refs.data() + m_code_unit_refs.size());
+  always_assert(insns->size() == m_num_instructions);
+  clear_code_units();
+  m_insns = std::move(insns);
+}
+
+void DexCode::clear_code_units() {
+  m_compact = false;
+  m_code_units = std::vector<uint16_t>();
+  m_code_unit_refs = std::vector<DexCodeUnitRef>();
+  m_num_instructions = 0;
+  m_size = 0;
+}
+
 int DexCode::encode(DexOutputIdx* dodx, uint32_t* output) {
   dex_code_item* code = (dex_code_item*)output;
   code->registers_size = m_registers_size;
@@ -448,8 +538,51 @@ int DexCode::encode(DexOutputIdx* dodx, uint32_t* output) {
   /* Debug info is added later */
   code->debug_info_off = 0;
   uint16_t* insns = (uint16_t*)(code + 1);
-  for (auto const& opc : get_instructions()) {
-    opc->encode(dodx, insns);
+  if (is_compact()) {
+    memcpy(insns, m_code_units.data(), m_code_units.size() * sizeof(uint16_t));
+    for (const auto& ref : m_code_unit_refs) {
+      uint16_t* idx = insns + ref.offset;
+      switch (ref.kind) {
+      case DexCodeUnitRef::STRING: {
+        uint32_t sidx = dodx->stringidx(ref.string);
+        always_assert_log(
+            sidx <= std::numeric_limits<uint16_t>::max(),
+            "Attempt to encode jumbo string in non-jumbo opcode: %s",
+            ref.string->c_str());
+        *idx = sidx;
+        break;
+      }
+      case DexCodeUnitRef::STRING_JUMBO: {
+        uint32_t sidx = dodx->stringidx(ref.string);
+        if (sidx <= std::numeric_limits<uint16_t>::max()) {
+          opt_warn(NON_JUMBO_STRING, "%s\n", ref.string->c_str());
+        }
+        idx[0] = (uint16_t)sidx;
+        idx[1] = (uint16_t)(sidx >> 16);
+        break;
+      }
+      case DexCodeUnitRef::TYPE:
+        *idx = dodx->typeidx(ref.type);
+        break;
+      case DexCodeUnitRef::FIELD:
+        *idx = dodx->fieldidx(ref.field);
+        break;
+      case DexCodeUnitRef::METHOD:
+        *idx = dodx->methodidx(ref.method);
+        break;
+      case DexCodeUnitRef::CALLSITE:
+        *idx = dodx->callsiteidx(ref.callsite);
+        break;
+      case DexCodeUnitRef::METHODHANDLE:
+        *idx = dodx->methodhandleidx(ref.methodhandle);
+        break;
+      }
+    }
+    insns += m_code_units.size();
+  } else {
+    for (auto const& opc : get_instructions()) {
+      opc->encode(dodx, insns);
+    }
   }
   code->insns_size = (uint32_t)(insns - ((uint16_t*)(code + 1)));
   if (m_tries.empty())
@@ -558,9 +691,16 @@ std::string DexMethod::get_fully_deobfuscated_name() const {
 }
 
 void DexMethod::set_code(std::unique_ptr<IRCode> code) {
+  if (is_code_spilled()) {
+    ir_code_spill::Store::get()->drop(this);
+  }
   m_code = std::move(code);
 }
 
+void DexMethod::fault_in_code() {
+  ir_code_spill::Store::get()->fault_in(this);
+}
+
 void DexMethod::balloon() {
   redex_assert(m_code == nullptr);
   m_code = std::make_unique<IRCode>(this);
@@ -569,7 +709,7 @@ void DexMethod::balloon() {
 
 void DexMethod::sync() {
   redex_assert(m_dex_code == nullptr);
-  m_dex_code = m_code->sync(this);
+  m_dex_code = get_code()->sync(this);
   m_code.reset();
 }
 
@@ -724,7 +864,7 @@ DexMethod* DexMethodRef::make_concrete(DexAccessFlags access,
                                        bool is_virtual) {
   auto that = static_cast<DexMethod*>(this);
   that->m_access = access;
-  that->m_code = std::move(dc);
+  that->set_code(std::move(dc));
   that->m_concrete = true;
   that->m_virtual = is_virtual;
   return that;
@@ -737,7 +877,7 @@ DexMethod* DexMethodRef::make_concrete(DexAccessFlags access, bool is_virtual) {
 void DexMethod::make_non_concrete() {
   m_access = static_cast<DexAccessFlags>(0);
   m_concrete = false;
-  m_code.reset();
+  set_code(nullptr);
   m_virtual = false;
   m_param_anno.clear();
 }
@@ -814,7 +954,10 @@ void DexClass::load_class_data_item(DexIdx* idx,
   }
 }
 
-std::unique_ptr<IRCode> DexMethod::release_code() { return std::move(m_code); }
+std::unique_ptr<IRCode> DexMethod::release_code() {
+  get_code();
+  return std::move(m_code);
+}
 
 std::vector<DexMethod*> DexClass::get_all_methods() const {
   std::vector<DexMethod*> all_methods(m_vmethods.begin(), m_vmethods.end());
@@ -1361,7 +1504,7 @@ void DexField::gather_methods(std::vector<DexMethodRef*>& lmethod) const {
 
 void DexMethod::gather_types(std::vector<DexType*>& ltype) const {
   gather_types_shallow(ltype); // Handle DexMethodRef parts.
-  if (m_code) m_code->gather_types(ltype);
+  if (get_code()) get_code()->gather_types(ltype);
   if (m_anno) m_anno->gather_types(ltype);
   auto param_anno = get_param_anno();
   if (param_anno) {
@@ -1374,18 +1517,18 @@ void DexMethod::gather_types(std::vector<DexType*>& ltype) const {
 
 void DexMethod::gather_callsites(std::vector<DexCallSite*>& lcallsite) const {
   // We handle m_spec.cls and proto in the first-layer gather.
-  if (m_code) m_code->gather_callsites(lcallsite);
+  if (get_code()) get_code()->gather_callsites(lcallsite);
 }
 
 void DexMethod::gather_methodhandles(
     std::vector<DexMethodHandle*>& lmethodhandle) const {
   // We handle m_spec.cls and proto in the first-layer gather.
-  if (m_code) m_code->gather_methodhandles(lmethodhandle);
+  if (get_code()) get_code()->gather_methodhandles(lmethodhandle);
 }
 void DexMethod::gather_strings(std::vector<DexString*>& lstring,
                                bool exclude_loads) const {
   // We handle m_name and proto in the first-layer gather.
-  if (m_code && !exclude_loads) m_code->gather_strings(lstring);
+  if (!exclude_loads && get_code()) get_code()->gather_strings(lstring);
   if (m_anno) m_anno->gather_strings(lstring);
   auto param_anno = get_param_anno();
   if (param_anno) {
@@ -1397,7 +1540,7 @@ void DexMethod::gather_strings(std::vector<DexString*>& lstring,
 }
 
 void DexMethod::gather_fields(std::vector<DexFieldRef*>& lfield) const {
-  if (m_code) m_code->gather_fields(lfield);
+  if (get_code()) get_code()->gather_fields(lfield);
   if (m_anno) m_anno->gather_fields(lfield);
   auto param_anno = get_param_anno();
   if (param_anno) {
@@ -1409,7 +1552,7 @@ void DexMethod::gather_fields(std::vector<DexFieldRef*>& lfield) const {
 }
 
 void DexMethod::gather_methods(std::vector<DexMethodRef*>& lmethod) const {
-  if (m_code) m_code->gather_methods(lmethod);
+  if (get_code()) get_code()->gather_methods(lmethod);
   if (m_anno) m_anno->gather_methods(lmethod);
   auto param_anno = get_param_anno();
   if (param_anno) {
@@ -1448,6 +1591,9 @@ void DexMethodRef::gather_strings_shallow(
 }
 
 uint32_t DexCode::size() const {
+  if (is_compact()) {
+    return m_size;
+  }
   uint32_t size = 0;
   for (auto const& opc : get_instructions()) {
     if (!dex_opcode::is_fopcode(opc->opcode())) {
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
 #include <functional>
@@ -55,6 +56,10 @@ class DexString;
 class DexType;
 class PositionMapper;
 
+namespace ir_code_spill {
+class Store;
+} // namespace ir_code_spill
+
 using Scope = std::vector<DexClass*>;
 
 #if defined(__SSE4_2__) && defined(__linux__) && defined(__STRCMP_LESS__)
@@ -92,7 +97,8 @@ class DexString {
   }
 
   static DexString* make_string(const std::string& nstr) {
-    return make_string(nstr.c_str());
+    return make_string(nstr.c_str(),
+                       length_of_utf8_string(nstr.c_str(), nstr.size()));
   }
 
   // Return an existing DexString or nullptr if one does not exist.
@@ -693,6 +699,35 @@ struct DexTryItem {
 
 class IRCode;
 
+/*
+ * A reference from a compacted code unit stream (see DexCode::compact()) to
+ * the string, type, field, method, call site or method handle whose index is
+ * only known at output time.
+ */
+struct DexCodeUnitRef {
+  enum Kind : uint8_t {
+    STRING,
+    STRING_JUMBO,
+    TYPE,
+    FIELD,
+    METHOD,
+    CALLSITE,
+    METHODHANDLE,
+  };
+
+  // Where the index goes, in code units from the start of the stream.
+  uint32_t offset;
+  Kind kind;
+  union {
+    DexString* string;
+    DexType* type;
+    DexFieldRef* field;
+    DexMethodRef* method;
+    DexCallSite* callsite;
+    DexMethodHandle* methodhandle;
+  };
+};
+
 class DexCode {
   friend class DexMethod;
 
@@ -703,6 +738,18 @@ class DexCode {
   std::vector<std::unique_ptr<DexTryItem>> m_tries;
   std::unique_ptr<DexDebugItem> m_dbg;
 
+  // The compacted form of m_insns, see compact().
+  bool m_compact{false};
+  std::vector<uint16_t> m_code_units;
+  std::vector<DexCodeUnitRef> m_code_unit_refs;
+  uint32_t m_num_instructions{0};
+  uint32_t m_size{0};
+
+  // Decodes the code units back into instructions, see compact().
+  void expand();
+
+  void clear_code_units();
+
  public:
   static std::unique_ptr<DexCode> get_dex_code(DexIdx* idx, uint32_t offset);
 
@@ -728,21 +775,29 @@ class DexCode {
     return std::move(m_dbg);
   }
   std::unique_ptr<std::vector<DexInstruction*>> release_instructions() {
+    if (m_compact) {
+      expand();
+    }
     return std::move(m_insns);
   }
   std::vector<DexInstruction*>& reset_instructions() {
+    clear_code_units();
     m_insns.reset(new std::vector<DexInstruction*>());
     return *m_insns;
   }
   std::vector<DexInstruction*>& get_instructions() {
+    if (m_compact) {
+      expand();
+    }
     redex_assert(m_insns);
     return *m_insns;
   }
   const std::vector<DexInstruction*>& get_instructions() const {
-    redex_assert(m_insns);
-    return *m_insns;
+    // Decoding the code units changes the representation, not the code.
+    return const_cast<DexCode*>(this)->get_instructions();
   }
   void set_instructions(std::vector<DexInstruction*>* insns) {
+    clear_code_units();
     m_insns.reset(insns);
   }
   std::vector<std::unique_ptr<DexTryItem>>& get_tries() { return m_tries; }
@@ -757,6 +812,32 @@ class DexCode {
   void set_ins_size(uint16_t sz) { m_ins_size = sz; }
   void set_outs_size(uint16_t sz) { m_outs_size = sz; }
 
+  /*
+   * Encodes the instructions into their final stream of code units, leaving
+   * out only the indices of the referenced strings, types, etc., which are
+   * patched in by encode(). The instructions are freed.
+   *
+   * The DexOutput compacts all methods right after syncing them, in
+   * parallel, so that encoding the code items is a copy, and the
+   * instructions don't stay around until the end of the process. Readers
+   * that still need the instructions after the output, e.g. the
+   * PostLowering, get them decoded on demand by get_instructions(). This
+   * undoes the compaction, and is not thread-safe, not even for the const
+   * overload.
+   */
+  void compact();
+
+  bool is_compact() const { return m_compact; }
+
+  const std::vector<uint16_t>& get_code_units() const { return m_code_units; }
+
+  /*
+   * The number of instructions, including payloads and alignment nops.
+   */
+  uint32_t num_instructions() const {
+    return is_compact() ? m_num_instructions : get_instructions().size();
+  }
+
   /*
    * Returns number of bytes in encoded output, passed in
    * pointer must be aligned.  Does not encode debugitem,
@@ -766,7 +847,7 @@ class DexCode {
 
   /*
    * Returns the number of 2-byte code units needed to encode all the
-   * instructions.
+   * instructions, not counting payloads.
    */
   uint32_t size() const;
 
@@ -841,6 +922,7 @@ class DexMethodRef {
 class DexMethod : public DexMethodRef {
   friend struct RedexContext;
   friend class DexMethodRef;
+  friend class ir_code_spill::Store;
 
   /* Concrete method members */
   DexAnnotationSet* m_anno;
@@ -848,6 +930,8 @@ class DexMethod : public DexMethodRef {
   std::unique_ptr<IRCode> m_code;
   DexAccessFlags m_access;
   bool m_virtual;
+  // Whether m_code is in the ir_code_spill::Store instead, see IRCodeSpill.h.
+  std::atomic<bool> m_code_spilled{false};
   ParamAnnotations m_param_anno;
   std::string m_deobfuscated_name;
 
@@ -862,6 +946,8 @@ class DexMethod : public DexMethodRef {
 
   std::string self_show() const; // To avoid "Show.h" in the header.
 
+  void fault_in_code();
+
  public:
   // Tracks whether this method can be deleted or renamed
   ReferencedState rstate;
@@ -959,8 +1045,19 @@ class DexMethod : public DexMethodRef {
   DexAnnotationSet* get_anno_set() { return m_anno; }
   const DexCode* get_dex_code() const { return m_dex_code.get(); }
   DexCode* get_dex_code() { return m_dex_code.get(); }
-  IRCode* get_code() { return m_code.get(); }
-  const IRCode* get_code() const { return m_code.get(); }
+  IRCode* get_code() {
+    if (m_code_spilled.load(std::memory_order_acquire)) {
+      fault_in_code();
+    }
+    return m_code.get();
+  }
+  const IRCode* get_code() const {
+    return const_cast<DexMethod*>(this)->get_code();
+  }
+  // Whether the code was spilled to disk. get_code() brings it back.
+  bool is_code_spilled() const {
+    return m_code_spilled.load(std::memory_order_acquire);
+  }
   std::unique_ptr<IRCode> release_code();
   bool is_virtual() const { return m_virtual; }
   DexAccessFlags get_access() const {
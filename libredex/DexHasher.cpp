@@ -167,8 +167,8 @@ void DexClassHasher::hash(const IRCode* c) {
       hash(mie.dbgop->uvalue());
       break;
     case MFLOW_POSITION:
-      if (mie.pos->method) hash(mie.pos->method);
-      if (mie.pos->file) hash(mie.pos->file);
+      if (mie.pos->method()) hash(mie.pos->method());
+      if (mie.pos->file()) hash(mie.pos->file());
       hash(mie.pos->line);
       break;
     case MFLOW_FALLTHROUGH:
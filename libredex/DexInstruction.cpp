@@ -8,6 +8,7 @@
 #include "DexInstruction.h"
 
 #include "Debug.h"
+#include "DexClass.h"
 #include "DexCallSite.h"
 #include "DexIdx.h"
 #include "DexMethodHandle.h"
@@ -765,10 +766,85 @@ void DexInstruction::encode(DexOutputIdx* /* unused */,
   encode_args(insns);
 }
 
+void DexInstruction::encode_unresolved(uint16_t*& insns) const {
+  if (m_ref_type == REF_NONE) {
+    encode(nullptr, insns);
+    return;
+  }
+  // Mirrors the encode() overrides of the subclasses.
+  encode_opcode(insns);
+  *insns++ = 0;
+  if (m_ref_type == REF_STRING) {
+    if (opcode() == DOPCODE_CONST_STRING_JUMBO) {
+      *insns++ = 0;
+    }
+    return;
+  }
+  if (m_ref_type != REF_FIELD) {
+    encode_args(insns);
+  }
+}
+
 uint16_t DexInstruction::size() const { return m_count + 1; }
 
+namespace {
+
+/*
+ * Looks up the references of a compacted code unit stream in its side table.
+ * The stream holds no indices, but its instructions refer to the entries of
+ * the table in order, so every lookup just takes the next entry.
+ */
+class CodeUnitRefs {
+ public:
+  explicit CodeUnitRefs(const DexCodeUnitRef** refs) : m_refs(refs) {}
+
+  DexString* get_stringidx(uint32_t) {
+    auto& ref = next();
+    always_assert(ref.kind == DexCodeUnitRef::STRING ||
+                  ref.kind == DexCodeUnitRef::STRING_JUMBO);
+    return ref.string;
+  }
+  DexType* get_typeidx(uint32_t) { return next(DexCodeUnitRef::TYPE).type; }
+  DexFieldRef* get_fieldidx(uint32_t) {
+    return next(DexCodeUnitRef::FIELD).field;
+  }
+  DexMethodRef* get_methodidx(uint32_t) {
+    return next(DexCodeUnitRef::METHOD).method;
+  }
+  DexCallSite* get_callsiteidx(uint32_t) {
+    return next(DexCodeUnitRef::CALLSITE).callsite;
+  }
+  DexMethodHandle* get_methodhandleidx(uint32_t) {
+    return next(DexCodeUnitRef::METHODHANDLE).methodhandle;
+  }
+
+ private:
+  const DexCodeUnitRef& next() { return *(*m_refs)++; }
+
+  const DexCodeUnitRef& next(DexCodeUnitRef::Kind kind) {
+    auto& ref = next();
+    always_assert(ref.kind == kind);
+    return ref;
+  }
+
+  const DexCodeUnitRef** m_refs;
+};
+
+} // namespace
+
 DexInstruction* DexInstruction::make_instruction(DexIdx* idx,
                                                  const uint16_t** insns_ptr) {
+  return decode(idx, insns_ptr);
+}
+
+DexInstruction* DexInstruction::make_instruction(const DexCodeUnitRef** refs,
+                                                 const uint16_t** insns_ptr) {
+  CodeUnitRefs idx(refs);
+  return decode(&idx, insns_ptr);
+}
+
+template <typename Idx>
+DexInstruction* DexInstruction::decode(Idx* idx, const uint16_t** insns_ptr) {
   auto& insns = *insns_ptr;
   auto fopcode = static_cast<DexOpcode>(*insns++);
   DexOpcode opcode = static_cast<DexOpcode>(fopcode & 0xff);
@@ -23,6 +23,7 @@
 class DexIdx;
 class DexOutputIdx;
 class DexString;
+struct DexCodeUnitRef;
 
 class DexInstruction : public Gatherable {
  protected:
@@ -81,12 +82,29 @@ class DexInstruction : public Gatherable {
 
   void encode_opcode(uint16_t*& insns) const { *insns++ = m_opcode; }
 
+ private:
+  // Decodes an instruction, looking up its reference, if any, in `idx`.
+  template <typename Idx>
+  static DexInstruction* decode(Idx* idx, const uint16_t** insns_ptr);
+
  public:
   static DexInstruction* make_instruction(DexIdx* idx,
                                           const uint16_t** insns_ptr);
+  /*
+   * Decodes an instruction of a compacted code unit stream (see
+   * DexCode::compact()). Its reference, if it has one, is `**refs`, and
+   * `*refs` is advanced past it.
+   */
+  static DexInstruction* make_instruction(const DexCodeUnitRef** refs,
+                                          const uint16_t** insns_ptr);
   /* Creates the right subclass of DexInstruction for the given opcode */
   static DexInstruction* make_instruction(DexOpcode);
   virtual void encode(DexOutputIdx* dodx, uint16_t*& insns) const;
+  /*
+   * Like encode(), but writes zero in place of the index of the referenced
+   * string, type, etc., which directly follows the opcode unit.
+   */
+  void encode_unresolved(uint16_t*& insns) const;
   virtual uint16_t size() const;
   virtual DexInstruction* clone() const { return new DexInstruction(*this); }
   bool operator==(const DexInstruction&) const;
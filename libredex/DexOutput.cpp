@@ -923,13 +923,19 @@ void DexOutput::generate_class_data_items() {
 
 static void sync_all(const Scope& scope) {
   constexpr bool serial = false; // for debugging
-  auto wq = workqueue_foreach<DexMethod*>([](DexMethod* m) { m->sync(); });
+  // Compacting right away frees the DexInstructions of each method while the
+  // others are still being synced.
+  auto wq = workqueue_foreach<DexMethod*>([](DexMethod* m) {
+    m->sync();
+    m->get_dex_code()->compact();
+  });
   walk::code(scope,
              [](DexMethod*) { return true; },
              [&](DexMethod* m, IRCode&) {
                if (serial) {
                  TRACE(MTRANS, 2, "Syncing %s", SHOW(m));
                  m->sync();
+                 m->get_dex_code()->compact();
                } else {
                  wq.add_item(m);
                }
@@ -997,7 +1003,7 @@ void DexOutput::generate_code_items(const std::vector<SortMode>& mode) {
                                    (dex_code_item*)(m_output + m_offset));
     auto insns_size = ((const dex_code_item*)(m_output + m_offset))->insns_size;
     m_offset += size;
-    m_stats.num_instructions += code->get_instructions().size();
+    m_stats.num_instructions += code->num_instructions();
     m_stats.instruction_bytes += insns_size * 2;
   }
   /// insert_map_item returns early if m_code_item_emits is empty
@@ -2038,19 +2044,56 @@ void compute_method_to_id_map(
   }
 }
 
+/*
+ * Appends the `num_blocks` blocks of a symbol file to `filename`, in order.
+ * Formatting the names is what takes the time on large apps, so the blocks
+ * are formatted in parallel, a window at a time so that only one window's
+ * worth of output is ever held in memory.
+ */
+template <typename FormatBlockFn>
+void append_blocks_in_parallel(const std::string& filename,
+                               size_t num_blocks,
+                               const FormatBlockFn& format_block) {
+  std::ofstream ofs(filename.c_str(), std::ofstream::out | std::ofstream::app);
+  assert_log(ofs, "Can't open symbol file %s: %s\n", filename.c_str(),
+             strerror(errno));
+  const size_t window_size = 1024 * redex_parallel::default_num_threads();
+  std::vector<std::string> blocks;
+  for (size_t start = 0; start < num_blocks; start += window_size) {
+    size_t end = std::min(num_blocks, start + window_size);
+    blocks.assign(end - start, std::string());
+    auto wq = workqueue_foreach<size_t>([&](size_t i) {
+      std::ostringstream ss;
+      format_block(i, ss);
+      blocks[i - start] = ss.str();
+    });
+    for (size_t i = start; i < end; ++i) {
+      wq.add_item(i);
+    }
+    wq.run_all();
+    for (const auto& block : blocks) {
+      ofs << block;
+    }
+  }
+}
+
 void write_method_mapping(const std::string& filename,
                           const DexOutputIdx* dodx,
                           const DexClasses* classes,
                           uint8_t* dex_signature) {
   always_assert(!filename.empty());
-  FILE* fd = fopen(filename.c_str(), "a");
-  assert_log(fd, "Can't open method mapping file %s: %s\n", filename.c_str(),
-             strerror(errno));
   std::unordered_set<DexClass*> classes_in_dex(classes->begin(),
                                                classes->end());
-  for (auto& it : dodx->method_to_idx()) {
-    auto method = it.first;
-    auto idx = it.second;
+  std::vector<std::pair<DexMethodRef*, uint32_t>> methods(
+      dodx->method_to_idx().begin(), dodx->method_to_idx().end());
+  // Turns out, the checksum can change on-device. (damn you dexopt)
+  // The signature, however, is never recomputed. Let's log the top 4 bytes,
+  // in little-endian (since that's faster to compute on-device).
+  uint32_t signature = *reinterpret_cast<uint32_t*>(dex_signature);
+  append_blocks_in_parallel(filename, methods.size(), [&](size_t i,
+                                                          std::ostream& out) {
+    auto method = methods[i].first;
+    auto idx = methods[i].second;
 
     // Types (and methods) internal to our app have a cached deobfuscated name
     // that comes from the proguard map.  If we don't have one, it's a
@@ -2060,7 +2103,7 @@ void write_method_mapping(const std::string& filename,
     if (classes_in_dex.count(cls) == 0) {
       // We only want to emit IDs for the methods that are defined in this dex,
       // and not for references to methods in other dexes.
-      continue;
+      return;
     }
     auto deobf_class = [&] {
       if (cls) {
@@ -2099,15 +2142,9 @@ void write_method_mapping(const std::string& filename,
     auto end = deobf_method.rfind(':');
     auto deobf_method_name = deobf_method.substr(begin, end - begin);
 
-    // Turns out, the checksum can change on-device. (damn you dexopt)
-    // The signature, however, is never recomputed. Let's log the top 4 bytes,
-    // in little-endian (since that's faster to compute on-device).
-    uint32_t signature = *reinterpret_cast<uint32_t*>(dex_signature);
-
-    fprintf(fd, "%u %u %s %s\n", idx, signature, deobf_method_name.c_str(),
-            deobf_class.c_str());
-  }
-  fclose(fd);
+    out << idx << " " << signature << " " << deobf_method_name << " "
+        << deobf_class << "\n";
+  });
 }
 
 void write_class_mapping(const std::string& filename,
@@ -2269,56 +2306,56 @@ void write_pg_mapping(const std::string& filename, DexClasses* classes) {
     return show(field);
   };
 
-  std::ofstream ofs(filename.c_str(), std::ofstream::out | std::ofstream::app);
-
-  for (auto cls : *classes) {
+  append_blocks_in_parallel(filename, classes->size(), [&](size_t i,
+                                                           std::ostream& out) {
+    auto cls = classes->at(i);
     auto deobf_cls = deobf_class(cls);
-    ofs << java_names::internal_to_external(deobf_cls) << " -> "
-        << java_names::internal_to_external(cls->get_type()->c_str()) << ":"
-        << std::endl;
+    out << java_names::internal_to_external(deobf_cls) << " -> "
+        << java_names::internal_to_external(cls->get_type()->c_str()) << ":\n";
     for (auto field : cls->get_ifields()) {
       auto deobf = deobf_field(field);
-      ofs << "    " << deobf << " -> " << field->c_str() << std::endl;
+      out << "    " << deobf << " -> " << field->c_str() << "\n";
     }
     for (auto field : cls->get_sfields()) {
       auto deobf = deobf_field(field);
-      ofs << "    " << deobf << " -> " << field->c_str() << std::endl;
+      out << "    " << deobf << " -> " << field->c_str() << "\n";
     }
     for (auto meth : cls->get_dmethods()) {
       auto deobf = deobf_meth(meth);
-      ofs << "    " << deobf << " -> " << meth->c_str() << std::endl;
+      out << "    " << deobf << " -> " << meth->c_str() << "\n";
     }
     for (auto meth : cls->get_vmethods()) {
       auto deobf = deobf_meth(meth);
-      ofs << "    " << deobf << " -> " << meth->c_str() << std::endl;
+      out << "    " << deobf << " -> " << meth->c_str() << "\n";
     }
-  }
+  });
 }
 
 void write_full_mapping(const std::string& filename, DexClasses* classes) {
   if (filename.empty()) return;
 
-  std::ofstream ofs(filename.c_str(), std::ofstream::out | std::ofstream::app);
-  for (auto cls : *classes) {
-    ofs << "type " << cls->get_deobfuscated_name() << " -> " << show(cls)
-        << std::endl;
+  append_blocks_in_parallel(filename, classes->size(), [&](size_t i,
+                                                           std::ostream& out) {
+    auto cls = classes->at(i);
+    out << "type " << cls->get_deobfuscated_name() << " -> " << show(cls)
+        << "\n";
     for (auto field : cls->get_ifields()) {
-      ofs << "ifield " << field->get_deobfuscated_name() << " -> "
-          << show(field) << std::endl;
+      out << "ifield " << field->get_deobfuscated_name() << " -> "
+          << show(field) << "\n";
     }
     for (auto field : cls->get_sfields()) {
-      ofs << "sfield " << field->get_deobfuscated_name() << " -> "
-          << show(field) << std::endl;
+      out << "sfield " << field->get_deobfuscated_name() << " -> "
+          << show(field) << "\n";
     }
     for (auto method : cls->get_dmethods()) {
-      ofs << "dmethod " << method->get_deobfuscated_name() << " -> "
-          << show(method) << std::endl;
+      out << "dmethod " << method->get_deobfuscated_name() << " -> "
+          << show(method) << "\n";
     }
     for (auto method : cls->get_vmethods()) {
-      ofs << "vmethod " << method->get_deobfuscated_name() << " -> "
-          << show(method) << std::endl;
+      out << "vmethod " << method->get_deobfuscated_name() << " -> "
+          << show(method) << "\n";
     }
-  }
+  });
 }
 
 void write_bytecode_offset_mapping(
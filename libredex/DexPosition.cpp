@@ -11,20 +11,28 @@
 #include "DexClass.h"
 #include "DexPosition.h"
 #include "DexUtil.h"
+#include "RedexContext.h"
 #include "Show.h"
 
 DexPosition::DexPosition(uint32_t line) : line(line) {}
 
+const DexPositionFrame* DexPositionFrame::make(DexString* method,
+                                               DexString* file) {
+  if (method == nullptr && file == nullptr) {
+    return nullptr;
+  }
+  return g_redex->make_position_frame(method, file);
+}
+
 DexPosition::DexPosition(DexString* method, DexString* file, uint32_t line)
-    : method(method), file(file), line(line) {}
+    : m_frame(DexPositionFrame::make(method, file)), line(line) {}
 
 void DexPosition::bind(DexString* method_, DexString* file_) {
-  this->method = method_;
-  this->file = file_;
+  m_frame = DexPositionFrame::make(method_, file_);
 }
 
 bool DexPosition::operator==(const DexPosition& that) const {
-  return method == that.method && file == that.file && line == that.line &&
+  return m_frame == that.m_frame && line == that.line &&
          (parent == that.parent ||
           (parent != nullptr && that.parent != nullptr &&
            *parent == *that.parent));
@@ -105,6 +113,15 @@ void RealPositionMapper::write_map_v2() {
     return string_ids.at(s);
   };
 
+  // Positions share their frames, so each method name only gets taken apart
+  // once.
+  struct FrameIds {
+    uint32_t class_id;
+    uint32_t method_id;
+    uint32_t file_id;
+  };
+  std::unordered_map<const DexPositionFrame*, FrameIds> frame_ids;
+
   for (auto pos : m_positions) {
     uint32_t parent_line = 0;
     try {
@@ -113,21 +130,27 @@ void RealPositionMapper::write_map_v2() {
       std::cerr << "Parent position " << show(pos->parent) << " of "
                 << show(pos) << " was not registered" << std::endl;
     }
-    // of the form "class_name.method_name:(arg_types)return_type"
-    const auto& full_method_name = pos->method->str();
-    // strip out the args and return type
-    auto qualified_method_name =
-        full_method_name.substr(0, full_method_name.find(':'));
-    auto class_name = java_names::internal_to_external(
-        qualified_method_name.substr(0, qualified_method_name.rfind('.')));
-    auto method_name =
-        qualified_method_name.substr(qualified_method_name.rfind('.') + 1);
-    auto class_id = id_of_string(class_name);
-    auto method_id = id_of_string(method_name);
-    auto file_id = id_of_string(pos->file->c_str());
-    pos_out.write((const char*)&class_id, sizeof(class_id));
-    pos_out.write((const char*)&method_id, sizeof(method_id));
-    pos_out.write((const char*)&file_id, sizeof(file_id));
+    auto ids_it = frame_ids.find(pos->frame());
+    if (ids_it == frame_ids.end()) {
+      // of the form "class_name.method_name:(arg_types)return_type"
+      const auto& full_method_name = pos->method()->str();
+      // strip out the args and return type
+      auto qualified_method_name =
+          full_method_name.substr(0, full_method_name.find(':'));
+      auto class_name = java_names::internal_to_external(
+          qualified_method_name.substr(0, qualified_method_name.rfind('.')));
+      auto method_name =
+          qualified_method_name.substr(qualified_method_name.rfind('.') + 1);
+      FrameIds ids;
+      ids.class_id = id_of_string(class_name);
+      ids.method_id = id_of_string(method_name);
+      ids.file_id = id_of_string(pos->file()->c_str());
+      ids_it = frame_ids.emplace(pos->frame(), ids).first;
+    }
+    const auto& ids = ids_it->second;
+    pos_out.write((const char*)&ids.class_id, sizeof(ids.class_id));
+    pos_out.write((const char*)&ids.method_id, sizeof(ids.method_id));
+    pos_out.write((const char*)&ids.file_id, sizeof(ids.file_id));
     pos_out.write((const char*)&pos->line, sizeof(pos->line));
     pos_out.write((const char*)&parent_line, sizeof(parent_line));
   }
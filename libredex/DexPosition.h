@@ -19,9 +19,29 @@ class DexMethod;
 class DexString;
 class DexDebugItem;
 
+/*
+ * The (method, file) pair of a DexPosition. There are far fewer distinct
+ * pairs than positions, so they are interned in the RedexContext and the
+ * positions only point at them. This keeps a DexPosition at three words, which
+ * matters since every position in every method, and every copy of them made
+ * by the inliner, is a separate allocation.
+ */
+struct DexPositionFrame final {
+  DexString* method;
+  DexString* file;
+
+  DexPositionFrame(DexString* method, DexString* file)
+      : method(method), file(file) {}
+
+  // Returns the interned frame of the given pair, or nullptr if both are null.
+  static const DexPositionFrame* make(DexString* method, DexString* file);
+};
+
 struct DexPosition final {
-  DexString* method{nullptr};
-  DexString* file{nullptr};
+ private:
+  const DexPositionFrame* m_frame{nullptr};
+
+ public:
   uint32_t line;
   // when a function gets inlined for the first time, all its DexPositions will
   // have the DexPosition of the callsite as their parent.
@@ -29,6 +49,14 @@ struct DexPosition final {
   explicit DexPosition(uint32_t line);
   DexPosition(DexString* method, DexString* file, uint32_t line);
 
+  DexString* method() const {
+    return m_frame == nullptr ? nullptr : m_frame->method;
+  }
+  DexString* file() const {
+    return m_frame == nullptr ? nullptr : m_frame->file;
+  }
+  const DexPositionFrame* frame() const { return m_frame; }
+
   void bind(DexString* method_, DexString* file_);
   bool operator==(const DexPosition&) const;
 
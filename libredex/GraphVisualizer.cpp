@@ -296,14 +296,14 @@ class CodeVisualizer : public TaggedBase {
     if (mie.pos) {
       m_output << " \"";
       DexPosition& pos = *mie.pos;
-      if (pos.method != nullptr) {
-        m_output << pos.method->str();
+      if (pos.method() != nullptr) {
+        m_output << pos.method()->str();
       } else {
         m_output << "<unnamed-method>";
       }
       m_output << "(";
-      if (pos.file != nullptr) {
-        m_output << pos.file->str() << ":" << pos.line;
+      if (pos.file() != nullptr) {
+        m_output << pos.file()->str() << ":" << pos.line;
       } else {
         m_output << "<no-file>";
       }
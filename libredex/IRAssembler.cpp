@@ -125,8 +125,8 @@ s_expr _to_s_expr(const DexPosition* pos, uint32_t idx, uint32_t parent_idx) {
   auto parent_idx_str = get_dbg_label(parent_idx);
   return s_expr({
       s_expr(".pos:" + idx_str),
-      s_expr(show(pos->method)),
-      s_expr(pos->file->c_str()),
+      s_expr(show(pos->method())),
+      s_expr(pos->file()->c_str()),
       s_expr(std::to_string(pos->line)),
       s_expr(parent_idx_str),
   });
@@ -160,8 +160,8 @@ std::vector<s_expr> to_s_exprs(
     auto idx_str = get_dbg_label(positions_emitted->size() - 1);
     return {s_expr({
         s_expr(".pos:" + idx_str),
-        s_expr(show(pos->method)),
-        s_expr(pos->file->c_str()),
+        s_expr(show(pos->method())),
+        s_expr(pos->file()->c_str()),
         s_expr(std::to_string(pos->line)),
     })};
   }
@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "IRCodeSpill.h"
+
+#include <boost/filesystem.hpp>
+#include <cstring>
+
+#include "Debug.h"
+#include "DexDebugInstruction.h"
+#include "DexPosition.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "WorkQueue.h"
+
+namespace ir_code_spill {
+
+namespace {
+
+constexpr uint32_t NO_ENTRY = 0xffffffff;
+
+Store* s_store{nullptr};
+
+class Writer {
+ public:
+  template <typename T>
+  void put(T value) {
+    auto size = m_bytes.size();
+    m_bytes.resize(size + sizeof(T));
+    memcpy(&m_bytes[size], &value, sizeof(T));
+  }
+
+  template <typename T>
+  void put_ptr(T* ptr) {
+    put<uint64_t>(reinterpret_cast<uintptr_t>(ptr));
+  }
+
+  std::vector<uint8_t>& bytes() { return m_bytes; }
+
+ private:
+  std::vector<uint8_t> m_bytes;
+};
+
+class Reader {
+ public:
+  explicit Reader(const uint8_t* ptr) : m_ptr(ptr) {}
+
+  template <typename T>
+  T get() {
+    T value;
+    memcpy(&value, m_ptr, sizeof(T));
+    m_ptr += sizeof(T);
+    return value;
+  }
+
+  template <typename T>
+  T* get_ptr() {
+    return reinterpret_cast<T*>(static_cast<uintptr_t>(get<uint64_t>()));
+  }
+
+ private:
+  const uint8_t* m_ptr;
+};
+
+void serialize_insn(const IRInstruction* insn, Writer* out) {
+  out->put<uint16_t>(insn->opcode());
+  out->put<uint32_t>(insn->has_dest() ? insn->dest() : 0);
+  out->put<uint16_t>(insn->srcs_size());
+  for (size_t i = 0; i < insn->srcs_size(); ++i) {
+    out->put<uint32_t>(insn->src(i));
+  }
+  if (insn->has_literal()) {
+    out->put<int64_t>(insn->get_literal());
+  } else if (insn->has_string()) {
+    out->put_ptr(insn->get_string());
+  } else if (insn->has_type()) {
+    out->put_ptr(insn->get_type());
+  } else if (insn->has_field()) {
+    out->put_ptr(insn->get_field());
+  } else if (insn->has_method()) {
+    out->put_ptr(insn->get_method());
+  } else if (insn->has_callsite()) {
+    out->put_ptr(insn->get_callsite());
+  } else if (insn->has_methodhandle()) {
+    out->put_ptr(insn->get_methodhandle());
+  } else if (insn->has_data()) {
+    out->put_ptr(insn->get_data());
+  }
+}
+
+IRInstruction* deserialize_insn(Reader* in) {
+  auto insn = new IRInstruction(static_cast<IROpcode>(in->get<uint16_t>()));
+  auto dest = in->get<uint32_t>();
+  if (insn->has_dest()) {
+    insn->set_dest(dest);
+  }
+  insn->set_srcs_size(in->get<uint16_t>());
+  for (size_t i = 0; i < insn->srcs_size(); ++i) {
+    insn->set_src(i, in->get<uint32_t>());
+  }
+  if (insn->has_literal()) {
+    insn->set_literal(in->get<int64_t>());
+  } else if (insn->has_string()) {
+    insn->set_string(in->get_ptr<DexString>());
+  } else if (insn->has_type()) {
+    insn->set_type(in->get_ptr<DexType>());
+  } else if (insn->has_field()) {
+    insn->set_field(in->get_ptr<DexFieldRef>());
+  } else if (insn->has_method()) {
+    insn->set_method(in->get_ptr<DexMethodRef>());
+  } else if (insn->has_callsite()) {
+    insn->set_callsite(in->get_ptr<DexCallSite>());
+  } else if (insn->has_methodhandle()) {
+    insn->set_methodhandle(in->get_ptr<DexMethodHandle>());
+  } else if (insn->has_data()) {
+    insn->set_data(in->get_ptr<DexOpcodeData>());
+  }
+  return insn;
+}
+
+void serialize_debug(const DexDebugInstruction* dbgop, Writer* out) {
+  out->put<uint8_t>(dbgop->opcode());
+  out->put<uint32_t>(dbgop->uvalue());
+  switch (dbgop->opcode()) {
+  case DBG_SET_FILE:
+    out->put_ptr(static_cast<const DexDebugOpcodeSetFile*>(dbgop)->file());
+    break;
+  case DBG_START_LOCAL:
+  case DBG_START_LOCAL_EXTENDED: {
+    auto start_local = static_cast<const DexDebugOpcodeStartLocal*>(dbgop);
+    out->put_ptr(start_local->name());
+    out->put_ptr(start_local->type());
+    out->put_ptr(start_local->sig());
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+std::unique_ptr<DexDebugInstruction> deserialize_debug(Reader* in) {
+  auto op = in->get<uint8_t>();
+  auto value = in->get<uint32_t>();
+  switch (op) {
+  case DBG_SET_FILE:
+    return std::make_unique<DexDebugOpcodeSetFile>(in->get_ptr<DexString>());
+  case DBG_START_LOCAL:
+  case DBG_START_LOCAL_EXTENDED: {
+    auto name = in->get_ptr<DexString>();
+    auto type = in->get_ptr<DexType>();
+    auto sig = in->get_ptr<DexString>();
+    return std::make_unique<DexDebugOpcodeStartLocal>(value, name, type, sig);
+  }
+  case DBG_ADVANCE_LINE:
+    // The only signed operand, see DexDebugInstruction::make_instruction.
+    return std::make_unique<DexDebugInstruction>(op, int32_t(value));
+  default:
+    return std::make_unique<DexDebugInstruction>(op, value);
+  }
+}
+
+/*
+ * The entries refer to each other (branch targets to their branches, try
+ * markers to their catches, positions to their parents) by their index in
+ * the list. Returns false if the code can't be spilled.
+ */
+bool serialize(const IRCode& code, Writer* out) {
+  if (code.cfg_built()) {
+    return false;
+  }
+  std::unordered_map<const MethodItemEntry*, uint32_t> entry_ids;
+  std::unordered_map<const DexPosition*, uint32_t> position_ids;
+  for (const auto& mie : code) {
+    if (mie.type == MFLOW_DEX_OPCODE) {
+      return false;
+    }
+    auto id = entry_ids.size();
+    entry_ids.emplace(&mie, id);
+    if (mie.type == MFLOW_POSITION) {
+      position_ids.emplace(mie.pos.get(), id);
+    }
+  }
+  auto entry_id = [&](const MethodItemEntry* mie) {
+    return mie == nullptr ? NO_ENTRY : entry_ids.at(mie);
+  };
+
+  out->put<uint32_t>(code.get_registers_size());
+  out->put<uint32_t>(entry_ids.size());
+  for (const auto& mie : code) {
+    out->put<uint8_t>(mie.type);
+    switch (mie.type) {
+    case MFLOW_TRY:
+      out->put<uint8_t>(mie.tentry->type);
+      out->put<uint32_t>(entry_id(mie.tentry->catch_start));
+      break;
+    case MFLOW_CATCH:
+      out->put_ptr(mie.centry->catch_type);
+      out->put<uint32_t>(entry_id(mie.centry->next));
+      break;
+    case MFLOW_OPCODE:
+      serialize_insn(mie.insn, out);
+      break;
+    case MFLOW_TARGET:
+      out->put<uint8_t>(mie.target->type);
+      out->put<int32_t>(mie.target->case_key);
+      out->put<uint32_t>(entry_id(mie.target->src));
+      break;
+    case MFLOW_DEBUG:
+      serialize_debug(mie.dbgop.get(), out);
+      break;
+    case MFLOW_POSITION: {
+      const auto& pos = *mie.pos;
+      out->put_ptr(pos.method());
+      out->put_ptr(pos.file());
+      out->put<uint32_t>(pos.line);
+      uint32_t parent = NO_ENTRY;
+      if (pos.parent != nullptr) {
+        // A parent outside of this code would dangle once it's read back.
+        auto it = position_ids.find(pos.parent);
+        if (it == position_ids.end()) {
+          return false;
+        }
+        parent = it->second;
+      }
+      out->put<uint32_t>(parent);
+      break;
+    }
+    case MFLOW_FALLTHROUGH:
+      break;
+    case MFLOW_DEX_OPCODE:
+      not_reached();
+    }
+  }
+  return true;
+}
+
+std::unique_ptr<IRCode> deserialize(const uint8_t* data,
+                                    std::unique_ptr<DexDebugItem> dbg) {
+  Reader in(data);
+  auto code = std::make_unique<IRCode>();
+  code->set_registers_size(in.get<uint32_t>());
+  code->set_debug_item(std::move(dbg));
+  auto size = in.get<uint32_t>();
+
+  // The references to other entries are resolved once they all exist.
+  struct Fixup {
+    MethodItemEntry* mie;
+    MethodItemType type;
+    uint32_t ref;
+    uint8_t try_type;
+  };
+  std::vector<MethodItemEntry*> entries;
+  std::vector<Fixup> fixups;
+  entries.reserve(size);
+  for (uint32_t i = 0; i < size; ++i) {
+    auto type = static_cast<MethodItemType>(in.get<uint8_t>());
+    MethodItemEntry* mie;
+    switch (type) {
+    case MFLOW_TRY: {
+      mie = new MethodItemEntry();
+      auto try_type = in.get<uint8_t>();
+      fixups.push_back({mie, type, in.get<uint32_t>(), try_type});
+      break;
+    }
+    case MFLOW_CATCH:
+      mie = new MethodItemEntry(in.get_ptr<DexType>());
+      fixups.push_back({mie, type, in.get<uint32_t>(), 0});
+      break;
+    case MFLOW_OPCODE:
+      mie = new MethodItemEntry(deserialize_insn(&in));
+      break;
+    case MFLOW_TARGET: {
+      auto target = new BranchTarget();
+      target->type = static_cast<BranchTargetType>(in.get<uint8_t>());
+      target->case_key = in.get<int32_t>();
+      mie = new MethodItemEntry(target);
+      fixups.push_back({mie, type, in.get<uint32_t>(), 0});
+      break;
+    }
+    case MFLOW_DEBUG:
+      mie = new MethodItemEntry(deserialize_debug(&in));
+      break;
+    case MFLOW_POSITION: {
+      auto method = in.get_ptr<DexString>();
+      auto file = in.get_ptr<DexString>();
+      auto line = in.get<uint32_t>();
+      mie = new MethodItemEntry(
+          std::make_unique<DexPosition>(method, file, line));
+      fixups.push_back({mie, type, in.get<uint32_t>(), 0});
+      break;
+    }
+    case MFLOW_FALLTHROUGH:
+      mie = new MethodItemEntry();
+      break;
+    case MFLOW_DEX_OPCODE:
+      not_reached();
+    }
+    entries.push_back(mie);
+  }
+
+  for (const auto& fixup : fixups) {
+    auto ref = fixup.ref == NO_ENTRY ? nullptr : entries.at(fixup.ref);
+    switch (fixup.type) {
+    case MFLOW_TRY:
+      fixup.mie->type = MFLOW_TRY;
+      fixup.mie->tentry =
+          new TryEntry(static_cast<TryEntryType>(fixup.try_type), ref);
+      break;
+    case MFLOW_CATCH:
+      fixup.mie->centry->next = ref;
+      break;
+    case MFLOW_TARGET:
+      fixup.mie->target->src = ref;
+      break;
+    case MFLOW_POSITION:
+      fixup.mie->pos->parent = ref == nullptr ? nullptr : ref->pos.get();
+      break;
+    default:
+      not_reached();
+    }
+  }
+  for (auto mie : entries) {
+    code->push_back(*mie);
+  }
+  return code;
+}
+
+} // namespace
+
+Store::Store(const std::string& dir) {
+  always_assert_log(s_store == nullptr, "There already is an IRCode store");
+  m_path = (boost::filesystem::path(dir) /
+            boost::filesystem::unique_path("ir-code-spill-%%%%%%%%.bin"))
+               .string();
+  m_file = fopen(m_path.c_str(), "wb");
+  always_assert_log(m_file != nullptr, "Could not create %s", m_path.c_str());
+  s_store = this;
+}
+
+Store::~Store() {
+  fault_in_all();
+  s_store = nullptr;
+  m_mapping.close();
+  fclose(m_file);
+  boost::filesystem::remove(m_path);
+}
+
+Store* Store::get() { return s_store; }
+
+size_t Store::spill(const std::vector<DexMethod*>& methods,
+                    size_t min_opcodes) {
+  std::atomic<size_t> num_spilled{0};
+  auto wq = workqueue_foreach<DexMethod*>([&](DexMethod* method) {
+    auto& code = method->m_code;
+    if (method->is_code_spilled() || code == nullptr ||
+        code->count_opcodes() < min_opcodes) {
+      return;
+    }
+    Writer out;
+    if (!serialize(*code, &out)) {
+      return;
+    }
+    Record record;
+    {
+      std::lock_guard<std::mutex> lock(m_file_mutex);
+      record.offset = m_file_size;
+      always_assert(fwrite(out.bytes().data(), 1, out.bytes().size(),
+                           m_file) == out.bytes().size());
+      m_file_size += out.bytes().size();
+    }
+    record.dbg = code->release_debug_item();
+    // IRCode doesn't own its instructions, but nothing else refers to them
+    // between passes.
+    std::vector<IRInstruction*> insns;
+    for (const auto& mie : InstructionIterable(*code)) {
+      insns.push_back(mie.insn);
+    }
+    code.reset();
+    for (auto insn : insns) {
+      delete insn;
+    }
+    auto& shard = this->shard(method);
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.records.emplace(method, std::move(record));
+    }
+    method->m_code_spilled.store(true, std::memory_order_release);
+    ++num_spilled;
+  });
+  for (auto method : methods) {
+    wq.add_item(method);
+  }
+  wq.run_all();
+
+  always_assert(fflush(m_file) == 0);
+  if (m_file_size > 0) {
+    m_mapping.close();
+    m_mapping.open(m_path);
+    always_assert_log(m_mapping.is_open(), "Could not map %s",
+                      m_path.c_str());
+  }
+  return num_spilled;
+}
+
+void Store::fault_in(DexMethod* method) {
+  auto& shard = this->shard(method);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  // Another thread may have read it back while we were waiting.
+  if (!method->m_code_spilled.load(std::memory_order_relaxed)) {
+    return;
+  }
+  auto it = shard.records.find(method);
+  always_assert(it != shard.records.end());
+  method->m_code = deserialize(
+      reinterpret_cast<const uint8_t*>(m_mapping.data()) + it->second.offset,
+      std::move(it->second.dbg));
+  shard.records.erase(it);
+  method->m_code_spilled.store(false, std::memory_order_release);
+  ++m_num_faults;
+}
+
+void Store::drop(DexMethod* method) {
+  auto& shard = this->shard(method);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.records.erase(method);
+  method->m_code_spilled.store(false, std::memory_order_release);
+}
+
+void Store::fault_in_all() {
+  std::vector<DexMethod*> methods;
+  for (auto& shard : m_shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (const auto& pair : shard.records) {
+      methods.push_back(const_cast<DexMethod*>(pair.first));
+    }
+  }
+  auto wq = workqueue_foreach<DexMethod*>(
+      [](DexMethod* method) { method->get_code(); });
+  for (auto method : methods) {
+    wq.add_item(method);
+  }
+  wq.run_all();
+}
+
+size_t Store::num_spilled() const {
+  size_t num = 0;
+  for (auto& shard : m_shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    num += shard.records.size();
+  }
+  return num;
+}
+
+} // namespace ir_code_spill
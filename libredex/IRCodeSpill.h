@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DexClass.h"
+
+/*
+ * Out-of-core support for very large scopes: the IRCode of the methods that a
+ * pass doesn't access can be written to a file and freed, and is read back by
+ * DexMethod::get_code() the next time anyone asks for it.
+ *
+ * The spilled code refers to strings, types, fields, methods, call sites,
+ * method handles and fill-array-data payloads by pointer, since those live as
+ * long as the RedexContext; so a store is only ever read back by the process
+ * that wrote it.
+ *
+ * Spilling frees the instructions of the code, so it must only happen while
+ * nobody holds on to them, i.e. between passes. PassManager spills before the
+ * passes that report their code access scope, see
+ * Pass::get_code_access_scope().
+ *
+ * Code that has been read back leaves its old bytes in the file; the file is
+ * only removed when the store is destroyed.
+ */
+namespace ir_code_spill {
+
+class Store {
+ public:
+  // Creates the spill file in the given directory, and makes this the store
+  // that DexMethod::get_code() reads back from.
+  explicit Store(const std::string& dir);
+
+  // Reads back all spilled code, and removes the spill file.
+  ~Store();
+
+  // The current store, if any.
+  static Store* get();
+
+  /*
+   * Spills the code of the given methods, in parallel. Code with fewer than
+   * `min_opcodes` instructions isn't worth it, and code with a CFG or with
+   * DexInstructions can't be spilled. Returns the number of methods whose
+   * code was spilled.
+   */
+  size_t spill(const std::vector<DexMethod*>& methods, size_t min_opcodes);
+
+  // Reads back all spilled code, in parallel.
+  void fault_in_all();
+
+  // The number of methods whose code is spilled right now.
+  size_t num_spilled() const;
+
+  // The number of methods whose code was read back so far.
+  size_t num_faults() const { return m_num_faults; }
+
+  uint64_t file_size() const { return m_file_size; }
+
+ private:
+  friend class ::DexMethod;
+
+  void fault_in(DexMethod* method);
+
+  // Forgets the spilled code of a method whose code gets replaced.
+  void drop(DexMethod* method);
+
+  struct Record {
+    uint64_t offset;
+    // The debug item is tiny once the code is ballooned, so it stays in
+    // memory.
+    std::unique_ptr<DexDebugItem> dbg;
+  };
+
+  // Faults happen from many threads at once, so the records are sharded by
+  // method.
+  struct Shard {
+    mutable std::mutex mutex;
+    std::unordered_map<const DexMethod*, Record> records;
+  };
+  static constexpr size_t NUM_SHARDS = 64;
+
+  Shard& shard(const DexMethod* method) {
+    return m_shards[std::hash<const DexMethod*>()(method) % NUM_SHARDS];
+  }
+
+  std::string m_path;
+  FILE* m_file;
+  std::mutex m_file_mutex;
+  uint64_t m_file_size{0};
+  boost::iostreams::mapped_file_source m_mapping;
+  std::array<Shard, NUM_SHARDS> m_shards;
+  std::atomic<size_t> m_num_faults{0};
+};
+
+} // namespace ir_code_spill
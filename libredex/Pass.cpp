@@ -11,6 +11,7 @@
 #include "Debug.h"
 #include "DexUtil.h"
 #include "PassRegistry.h"
+#include "Walkers.h"
 
 Pass::Pass(const std::string& name, Kind kind) : m_name(name), m_kind(kind) {
   PassRegistry::get().register_pass(this);
@@ -24,6 +25,48 @@ void Pass::set_analysis_usage(AnalysisUsage& analysis_usage) const {
   }
 }
 
+void MethodLocalPass::run_pass(DexStoresVector& stores,
+                               ConfigFiles& conf,
+                               PassManager& mgr) {
+  begin_walk(stores, conf, mgr);
+  walk_code(build_class_scope(stores),
+            [&](DexMethod* method, IRCode& code, size_t worker_id) {
+              cost_sampling::ScopedSample sample(method);
+              run_on_method(method, code, worker_id);
+            });
+  end_walk(stores, conf, mgr);
+}
+
+size_t MethodLocalPass::num_workers() {
+  return redex_parallel::default_num_threads();
+}
+
+void MethodLocalPass::walk_code(
+    const Scope& scope,
+    const std::function<void(DexMethod*, IRCode&, size_t)>& walker) {
+  auto wq = workqueue_foreach<DexClass*>(
+      [&](sparta::SpartaWorkerState<DexClass*>* state, DexClass* cls) {
+        auto visit = [&](DexMethod* method) {
+          auto code = method->get_code();
+          if (code != nullptr) {
+            TraceContext context(method->get_deobfuscated_name());
+            walker(method, *code, state->worker_id());
+          }
+        };
+        for (auto method : cls->get_dmethods()) {
+          visit(method);
+        }
+        for (auto method : cls->get_vmethods()) {
+          visit(method);
+        }
+      },
+      num_workers());
+  for (auto cls : scope) {
+    wq.add_item(cls);
+  }
+  wq.run_all();
+}
+
 void PartialPass::run_pass(DexStoresVector& whole_program_stores,
                            ConfigFiles& conf,
                            PassManager& mgr) {
@@ -32,6 +75,14 @@ void PartialPass::run_pass(DexStoresVector& whole_program_stores,
   run_partial_pass(whole_program_stores, std::move(current_scope), conf, mgr);
 }
 
+boost::optional<Scope> PartialPass::get_code_access_scope(
+    const DexStoresVector& stores) {
+  if (m_select_packages.empty()) {
+    return boost::none;
+  }
+  return build_class_scope_for_packages(stores, m_select_packages);
+}
+
 Scope PartialPass::build_class_scope_with_packages_config(
     const DexStoresVector& stores) {
   if (m_select_packages.empty()) {
@@ -8,6 +8,8 @@
 #pragma once
 
 #include <algorithm>
+#include <boost/optional.hpp>
+#include <functional>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -18,6 +20,7 @@
 
 class AnalysisUsage;
 struct ConfigFiles;
+class IRCode;
 class PassManager;
 
 class Pass : public Configurable {
@@ -58,11 +61,62 @@ class Pass : public Configurable {
 
   virtual void set_analysis_usage(AnalysisUsage& analysis_usage) const;
 
+  /**
+   * The classes whose code the pass may access, or none if it may access any
+   * code. When IR code spilling is on (see IRCodeSpill.h), the code of all
+   * other methods is spilled to disk before the pass runs.
+   */
+  virtual boost::optional<Scope> get_code_access_scope(
+      const DexStoresVector& /* stores */) {
+    return boost::none;
+  }
+
  private:
   std::string m_name;
   Kind m_kind;
 };
 
+/**
+ * A pass that transforms the code of every method on its own, without looking
+ * at, or changing, anything outside of the method. When the
+ * "fuse_method_local_passes" option is on, PassManager runs adjacent
+ * method-local passes in a single parallel walk, in which every method goes
+ * through the whole chain of passes while its code is still hot in cache.
+ *
+ * begin_walk() and end_walk() are called around the walk, with the pass'
+ * own metrics being current; run_on_method() is called concurrently for
+ * different methods, and is where sharded metric handles can't be gotten.
+ * It gets the id of the worker it runs on, which is below num_workers(), so
+ * that the pass can gather its stats per worker without a lock, and report
+ * their sum in end_walk().
+ */
+class MethodLocalPass : public Pass {
+ public:
+  explicit MethodLocalPass(const std::string& name) : Pass(name) {}
+
+  void run_pass(DexStoresVector& stores,
+                ConfigFiles& conf,
+                PassManager& mgr) final;
+
+  virtual void begin_walk(DexStoresVector& /* stores */,
+                          ConfigFiles& /* conf */,
+                          PassManager& /* mgr */) {}
+  virtual void run_on_method(DexMethod* method,
+                             IRCode& code,
+                             size_t worker_id) = 0;
+  virtual void end_walk(DexStoresVector& /* stores */,
+                        ConfigFiles& /* conf */,
+                        PassManager& /* mgr */) {}
+
+  static size_t num_workers();
+
+  // Calls `walker(method, code, worker_id)` on all code in `scope` in
+  // parallel, on num_workers() workers.
+  static void walk_code(
+      const Scope& scope,
+      const std::function<void(DexMethod*, IRCode&, size_t)>& walker);
+};
+
 /**
  * In certain cases, a pass will need to operate on a fragment of code (e.g. a
  * package or a class prefix), either without requiring knowledge from the other
@@ -91,6 +145,9 @@ class PartialPass : public Pass {
                                 ConfigFiles& conf,
                                 PassManager& mgr) = 0;
 
+  boost::optional<Scope> get_code_access_scope(
+      const DexStoresVector& stores) override;
+
  protected:
   Scope build_class_scope_with_packages_config(const DexStoresVector& stores);
 
@@ -8,6 +8,7 @@
 #include "PassManager.h"
 
 #include <boost/filesystem.hpp>
+#include <chrono>
 #include <cinttypes>
 #include <cstdio>
 #include <typeinfo>
@@ -18,6 +19,7 @@
 #include "ApkManager.h"
 #include "CommandProfiling.h"
 #include "ConfigFiles.h"
+#include "CostSampling.h"
 #include "Debug.h"
 #include "DexClass.h"
 #include "DexLoader.h"
@@ -25,6 +27,7 @@
 #include "DexUtil.h"
 #include "GraphVisualizer.h"
 #include "IRCode.h"
+#include "IRCodeSpill.h"
 #include "IRTypeChecker.h"
 #include "InstructionLowering.h"
 #include "JemallocUtil.h"
@@ -39,6 +42,7 @@
 #include "Show.h"
 #include "Timer.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 namespace {
 
@@ -485,6 +489,12 @@ boost::optional<ScopedCommandProfiling> maybe_command_profile(
                                 profiler_info->post_cmd};
 }
 
+double seconds_since(std::chrono::steady_clock::time_point begin) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       begin)
+      .count();
+}
+
 bool is_run_hasher_after_each_pass(const ConfigFiles& conf,
                                    const RedexOptions& options) {
   if (options.disable_dex_hasher) {
@@ -619,6 +629,7 @@ void PassManager::eval_passes(DexStoresVector& stores, ConfigFiles& conf) {
     Timer t(pass->name() + " (eval)");
     m_current_pass_info = &m_pass_info[i];
     pass->eval_pass(stores, conf, *this);
+    flush_sharded_metrics();
     m_current_pass_info = nullptr;
   }
 }
@@ -677,6 +688,19 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
   const bool hwm_per_pass =
       conf.get_json_config().get("mem_stats_per_pass", true);
 
+  // Report the slowest methods of every pass, see CostSampling.h.
+  size_t method_cost_sampling_top_k;
+  conf.get_json_config().get("method_cost_sampling_top_k", 0,
+                             method_cost_sampling_top_k);
+  cost_sampling::enable(method_cost_sampling_top_k);
+
+  // Pin the work queue threads to CPUs, and keep the work on every item on
+  // the same NUMA node from one walk to the next, see SpartaWorkQueue.h.
+  bool pin_worker_threads;
+  conf.get_json_config().get("pin_worker_threads", false, pin_worker_threads);
+  auto& thread_pool = sparta::workqueue_impl::ThreadPool::get();
+  thread_pool.set_pinning(pin_worker_threads);
+
   size_t min_pass_idx_for_dex_ref_check =
       checker_conf.min_pass_idx_for_dex_ref_check(m_activated_passes);
 
@@ -686,12 +710,17 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
   // For core loop legibility, have a lambda here.
 
   auto post_pass_verifiers = [&](Pass* pass, size_t i) {
-    walk::parallel::code(build_class_scope(stores), [](DexMethod* m,
-                                                       IRCode& code) {
+    walk::parallel::methods(build_class_scope(stores), [](DexMethod* m) {
+      // Spilled code never has a CFG, and reading it back here would undo
+      // the spilling.
+      if (m->is_code_spilled() || m->get_code() == nullptr) {
+        return;
+      }
       // Ensure that pass authors deconstructed the editable CFG at the end of
       // their pass. Currently, passes assume the incoming code will be in
       // IRCode form
-      always_assert_log(!code.editable_cfg_built(), "%s has a cfg!", SHOW(m));
+      always_assert_log(!m->get_code()->editable_cfg_built(), "%s has a cfg!",
+                        SHOW(m));
     });
 
     bool run_hasher = run_hasher_after_each_pass;
@@ -718,30 +747,249 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
     }
   };
 
+  // Spill the code that a pass doesn't access to disk before it runs, see
+  // IRCodeSpill.h and Pass::get_code_access_scope.
+  std::unique_ptr<ir_code_spill::Store> code_spill_store;
+  size_t code_spill_min_opcodes = 0;
+  {
+    const Json::Value& spill_args = conf.get_json_config()["ir_code_spill"];
+    if (spill_args.get("enabled", false).asBool()) {
+      code_spill_store = std::make_unique<ir_code_spill::Store>(
+          spill_args.get("dir", conf.get_outdir()).asString());
+      code_spill_min_opcodes = spill_args.get("min_opcodes", 16).asUInt();
+    }
+  }
+
   std::unordered_map<const Pass*, size_t> runs;
 
+  // Run adjacent method-local passes in a single walk, see MethodLocalPass.
+  // The checks that run after a pass need to see its result on its own, so
+  // a pass they run after ends the run.
+  bool fuse_method_local_passes;
+  conf.get_json_config().get("fuse_method_local_passes", false,
+                             fuse_method_local_passes);
+  fuse_method_local_passes = fuse_method_local_passes &&
+                             !run_hasher_after_each_pass &&
+                             !check_unique_deobfuscated.m_after_each_pass &&
+                             !code_spill_store;
+  auto method_local_run_end = [&](size_t begin) {
+    std::unordered_set<const Pass*> seen;
+    size_t end = begin;
+    while (end < m_activated_passes.size()) {
+      Pass* pass = m_activated_passes[end];
+      if (dynamic_cast<MethodLocalPass*>(pass) == nullptr ||
+          pass == m_malloc_profile_pass || !seen.insert(pass).second) {
+        break;
+      }
+      ++end;
+      if (checker_conf.run_after_pass(pass)) {
+        break;
+      }
+    }
+    return end;
+  };
+
   /////////////////////
   // MAIN PASS LOOP. //
   /////////////////////
 
   for (size_t i = 0; i < m_activated_passes.size(); ++i) {
+    size_t fused_end = fuse_method_local_passes ? method_local_run_end(i) : i;
+    if (fused_end > i + 1) {
+      std::vector<MethodLocalPass*> fused;
+      std::vector<AnalysisUsageHelper> analysis_usage_helpers;
+      std::vector<size_t> pass_runs;
+      // The time each pass takes, and the methods it is slowest on.
+      std::vector<double> pass_seconds;
+      std::vector<cost_sampling::SlowestSamples> pass_slowest;
+      // The wall time of each method, in microseconds, per pass.
+      bool sample_costs = cost_sampling::is_enabled();
+      std::vector<std::unique_ptr<sharded_metrics::Histogram>> pass_method_us;
+      std::string names;
+      cost_sampling::reset();
+      for (size_t k = i; k < fused_end; ++k) {
+        auto pass = static_cast<MethodLocalPass*>(m_activated_passes[k]);
+        pass_runs.push_back(++runs[pass]);
+        fused.push_back(pass);
+        names += (k == i ? "" : "+") + pass->name();
+        analysis_usage_helpers.emplace_back(m_preserved_analysis_passes);
+        analysis_usage_helpers.back().pre_pass(pass);
+        pass_slowest.emplace_back(cost_sampling::top_k());
+        pass_method_us.push_back(
+            std::make_unique<sharded_metrics::Histogram>());
+        m_current_pass_info = &m_pass_info[k];
+        auto begin = std::chrono::steady_clock::now();
+        pass->begin_walk(stores, conf, *this);
+        pass_seconds.push_back(seconds_since(begin));
+        if (sample_costs) {
+          cost_sampling::take_wall_us(pass_method_us.back().get());
+        }
+        flush_sharded_metrics();
+        for (const auto& sample : cost_sampling::take_slowest()) {
+          pass_slowest.back().add(sample);
+        }
+      }
+      // No pass is current during the walk, so that metrics can't end up
+      // with the wrong one.
+      m_current_pass_info = nullptr;
+
+      // Each worker times the passes and samples their slowest methods on its
+      // own, so that the walk takes no lock.
+      struct WorkerCosts {
+        std::vector<std::chrono::steady_clock::duration> durations;
+        std::vector<cost_sampling::SlowestSamples> slowest;
+      };
+      std::vector<CacheAligned<WorkerCosts>> worker_costs(
+          MethodLocalPass::num_workers(),
+          WorkerCosts{std::vector<std::chrono::steady_clock::duration>(
+                          fused.size()),
+                      pass_slowest});
+      TRACE(PM, 1, "Running %s...", names.c_str());
+      ScopedVmHWM vm_hwm{hwm_pass_stats, hwm_per_pass};
+      auto placement_before = thread_pool.placement_stats();
+      {
+        Timer t(names + " (fused run)");
+        boost::optional<ScopedCommandProfiling> scoped_command_prof;
+        for (auto pass : fused) {
+          if (!scoped_command_prof) {
+            scoped_command_prof = maybe_command_profile(profiler_info, pass);
+          }
+        }
+        MethodLocalPass::walk_code(
+            build_class_scope(stores),
+            [&](DexMethod* method, IRCode& code, size_t worker_id) {
+              WorkerCosts& costs = worker_costs[worker_id];
+              for (size_t p = 0; p < fused.size(); ++p) {
+                auto begin = std::chrono::steady_clock::now();
+                {
+                  cost_sampling::ScopedSample sample(method,
+                                                     &costs.slowest[p]);
+                  fused[p]->run_on_method(method, code, worker_id);
+                }
+                auto duration = std::chrono::steady_clock::now() - begin;
+                costs.durations[p] += duration;
+                if (sample_costs) {
+                  pass_method_us[p]->record(
+                      std::chrono::duration_cast<std::chrono::microseconds>(
+                          duration)
+                          .count());
+                }
+              }
+            });
+      }
+      auto placement = thread_pool.placement_stats();
+      for (WorkerCosts& costs : worker_costs) {
+        for (size_t p = 0; p < fused.size(); ++p) {
+          pass_seconds[p] +=
+              std::chrono::duration<double>(costs.durations[p]).count();
+          for (const auto& sample : costs.slowest[p].take()) {
+            pass_slowest[p].add(sample);
+          }
+        }
+      }
+
+      for (size_t k = i; k < fused_end; ++k) {
+        auto pass = fused[k - i];
+        m_current_pass_info = &m_pass_info[k];
+        auto begin = std::chrono::steady_clock::now();
+        pass->end_walk(stores, conf, *this);
+        pass_seconds[k - i] += seconds_since(begin);
+        // The time of the pass itself, as if it had run on its own. The
+        // memory and placement stats are the ones of the whole walk.
+        Timer::add_timing(pass->name() + " " +
+                              std::to_string(pass_runs[k - i]) + " (run)",
+                          pass_seconds[k - i]);
+        if (sample_costs) {
+          auto& method_us = histogram("~method~us");
+          cost_sampling::take_wall_us(&method_us);
+          method_us.add(*pass_method_us[k - i]);
+        }
+        flush_sharded_metrics();
+        for (const auto& sample : cost_sampling::take_slowest()) {
+          pass_slowest[k - i].add(sample);
+        }
+        report_slowest_methods(pass_slowest[k - i].take());
+        if (pin_worker_threads) {
+          m_current_pass_info->metrics["~placement~local_tasks"] =
+              placement.local_tasks - placement_before.local_tasks;
+          m_current_pass_info->metrics["~placement~remote_tasks"] =
+              placement.remote_tasks - placement_before.remote_tasks;
+        }
+        vm_hwm.trace_log(this, pass);
+        m_current_pass_info->metrics["~fused~passes"] = fused.size();
+        sanitizers::lsan_do_recoverable_leak_check();
+        graph_visualizer.add_pass(pass, k);
+        if (k + 1 == fused_end) {
+          post_pass_verifiers(pass, k);
+        }
+        analysis_usage_helpers[k - i].post_pass(pass);
+        process_method_profiles(*this, conf);
+        m_current_pass_info = nullptr;
+      }
+      i = fused_end - 1;
+      continue;
+    }
+
     Pass* pass = m_activated_passes[i];
     const size_t pass_run = ++runs[pass];
     AnalysisUsageHelper analysis_usage_helper{m_preserved_analysis_passes};
     analysis_usage_helper.pre_pass(pass);
 
     TRACE(PM, 1, "Running %s...", pass->name().c_str());
+    size_t code_spilled = 0;
+    size_t code_faults_before = 0;
+    if (code_spill_store) {
+      auto access_scope = pass->get_code_access_scope(stores);
+      if (access_scope) {
+        Timer spill_timer("IR code spill");
+        std::unordered_set<const DexType*> accessed;
+        for (auto cls : *access_scope) {
+          accessed.insert(cls->get_type());
+        }
+        std::vector<DexMethod*> cold;
+        walk::methods(build_class_scope(stores), [&](DexMethod* m) {
+          if (!accessed.count(m->get_class())) {
+            cold.push_back(m);
+          }
+        });
+        code_spilled = code_spill_store->spill(cold, code_spill_min_opcodes);
+        // Read the accessed code back up front and in parallel, instead of
+        // one method at a time as the pass gets to it.
+        walk::parallel::methods(*access_scope,
+                                [](DexMethod* m) { m->get_code(); });
+      }
+      code_faults_before = code_spill_store->num_faults();
+    }
     ScopedVmHWM vm_hwm{hwm_pass_stats, hwm_per_pass};
     Timer t(pass->name() + " " + std::to_string(pass_run) + " (run)");
     m_current_pass_info = &m_pass_info[i];
 
+    auto placement_before = thread_pool.placement_stats();
     {
       auto scoped_command_prof = maybe_command_profile(profiler_info, pass);
       jemalloc_util::ScopedProfiling malloc_prof(m_malloc_profile_pass == pass);
+      cost_sampling::reset();
       pass->run_pass(stores, conf, *this);
     }
+    if (cost_sampling::is_enabled()) {
+      cost_sampling::take_wall_us(&histogram("~method~us"));
+    }
+    flush_sharded_metrics();
+    report_slowest_methods(cost_sampling::take_slowest());
+    if (pin_worker_threads) {
+      auto placement = thread_pool.placement_stats();
+      m_current_pass_info->metrics["~placement~local_tasks"] =
+          placement.local_tasks - placement_before.local_tasks;
+      m_current_pass_info->metrics["~placement~remote_tasks"] =
+          placement.remote_tasks - placement_before.remote_tasks;
+    }
 
     vm_hwm.trace_log(this, pass);
+    if (code_spill_store) {
+      m_current_pass_info->metrics["ir_code_spilled"] = code_spilled;
+      m_current_pass_info->metrics["ir_code_faulted"] =
+          code_spill_store->num_faults() - code_faults_before;
+    }
 
     sanitizers::lsan_do_recoverable_leak_check();
 
@@ -756,6 +1004,9 @@ void PassManager::run_passes(DexStoresVector& stores, ConfigFiles& conf) {
     m_current_pass_info = nullptr;
   }
 
+  // Reads back all spilled code.
+  code_spill_store.reset();
+
   // Always run the type checker before generating the optimized dex code.
   scope = build_class_scope(it);
   CheckerConfig::run_verifier(scope, checker_conf.verify_moves,
@@ -811,6 +1062,62 @@ int64_t PassManager::get_metric(const std::string& key) {
   return (m_current_pass_info->metrics)[key];
 }
 
+sharded_metrics::Counter& PassManager::counter(const std::string& key) {
+  always_assert_log(m_current_pass_info != nullptr, "No current pass!");
+  std::lock_guard<std::mutex> lock(m_sharded_metrics_lock);
+  auto& counter = m_counters[key];
+  if (!counter) {
+    counter = std::make_unique<sharded_metrics::Counter>();
+  }
+  return *counter;
+}
+
+sharded_metrics::Histogram& PassManager::histogram(const std::string& key) {
+  always_assert_log(m_current_pass_info != nullptr, "No current pass!");
+  std::lock_guard<std::mutex> lock(m_sharded_metrics_lock);
+  auto& histogram = m_histograms[key];
+  if (!histogram) {
+    histogram = std::make_unique<sharded_metrics::Histogram>();
+  }
+  return *histogram;
+}
+
+void PassManager::report_slowest_methods(
+    const std::vector<cost_sampling::Sample>& samples) {
+  for (const auto& sample : samples) {
+    auto name = show_deobfuscated(sample.method);
+    m_current_pass_info->metrics["~slowest~us~" + name] =
+        sample.wall_ns / 1000;
+    if (sample.allocated_bytes > 0) {
+      m_current_pass_info->metrics["~slowest~allocated~" + name] =
+          sample.allocated_bytes;
+    }
+  }
+}
+
+void PassManager::flush_sharded_metrics() {
+  std::lock_guard<std::mutex> lock(m_sharded_metrics_lock);
+  auto& metrics = m_current_pass_info->metrics;
+  for (const auto& pair : m_counters) {
+    metrics[pair.first] += pair.second->sum();
+  }
+  for (const auto& pair : m_histograms) {
+    auto summary = pair.second->summarize();
+    metrics[pair.first + ".count"] += summary.count;
+    if (summary.count == 0) {
+      continue;
+    }
+    metrics[pair.first + ".sum"] += summary.sum;
+    metrics[pair.first + ".min"] = summary.min;
+    metrics[pair.first + ".max"] = summary.max;
+    metrics[pair.first + ".p50"] = summary.p50;
+    metrics[pair.first + ".p90"] = summary.p90;
+    metrics[pair.first + ".p99"] = summary.p99;
+  }
+  m_counters.clear();
+  m_histograms.clear();
+}
+
 const std::vector<PassManager::PassInfo>& PassManager::get_pass_info() const {
   return m_pass_info;
 }
@@ -9,6 +9,7 @@
 
 #include <boost/optional.hpp>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <typeinfo>
 #include <unordered_map>
@@ -17,10 +18,12 @@
 
 #include "AnalysisUsage.h"
 #include "ApkManager.h"
+#include "CostSampling.h"
 #include "DexHasher.h"
 #include "JsonWrapper.h"
 #include "ProguardConfiguration.h"
 #include "RedexOptions.h"
+#include "ShardedMetrics.h"
 
 struct ConfigFiles;
 class DexStore;
@@ -64,6 +67,16 @@ class PassManager {
   void incr_metric(const std::string& key, int64_t value);
   void set_metric(const std::string& key, int64_t value);
   int64_t get_metric(const std::string& key);
+
+  // Metric handles for hot paths, e.g. inside of parallel walks. Getting a
+  // handle takes a lock, so get it once before the walk; updating it is a
+  // relaxed atomic operation on a per-thread shard. Handles are interned by
+  // key and stay valid until the end of the current pass, when counters are
+  // added to the pass metric of the same key, and histograms are exported as
+  // `<key>.count`, `<key>.sum`, `<key>.min`, `<key>.max`, `<key>.p50`,
+  // `<key>.p90` and `<key>.p99`.
+  sharded_metrics::Counter& counter(const std::string& key);
+  sharded_metrics::Histogram& histogram(const std::string& key);
   const std::vector<PassManager::PassInfo>& get_pass_info() const;
   boost::optional<hashing::DexHash> get_initial_hash() const {
     return m_initial_hash;
@@ -114,6 +127,13 @@ class PassManager {
 
   void eval_passes(DexStoresVector&, ConfigFiles&);
 
+  // Fold the sharded metrics of the current pass into its metrics.
+  void flush_sharded_metrics();
+
+  // Add the slowest methods sampled during the current pass to its metrics.
+  void report_slowest_methods(
+      const std::vector<cost_sampling::Sample>& samples);
+
   ApkManager m_apk_mgr;
   std::vector<Pass*> m_registered_passes;
   std::vector<Pass*> m_activated_passes;
@@ -123,6 +143,12 @@ class PassManager {
   std::vector<PassManager::PassInfo> m_pass_info;
   PassInfo* m_current_pass_info;
 
+  std::mutex m_sharded_metrics_lock;
+  std::unordered_map<std::string, std::unique_ptr<sharded_metrics::Counter>>
+      m_counters;
+  std::unordered_map<std::string, std::unique_ptr<sharded_metrics::Histogram>>
+      m_histograms;
+
   std::unique_ptr<keep_rules::ProguardConfiguration> m_pg_config;
   const RedexOptions m_redex_options;
   bool m_testing_mode{false};
@@ -7,6 +7,8 @@
 
 #include "ProguardMap.h"
 
+#include <iterator>
+
 #include "DexPosition.h"
 #include "DexUtil.h"
 #include "IRCode.h"
@@ -213,30 +215,153 @@ ProguardLineRangeVector& ProguardMap::method_lines(
   return m_obfMethodLinesMap.at(pg_impl::lines_key(obfuscated_method));
 }
 
+/*
+ * The lines of a class in the map: the class line and its member lines. The
+ * lines before the first class form a section without a class.
+ */
+struct ProguardMap::ClassSection {
+  size_t begin;
+  size_t end;
+  bool has_class_line;
+  std::string cls;
+  std::string new_cls;
+};
+
+/*
+ * The member maps of a run of consecutive sections. Runs are parsed in
+ * parallel and merged back in file order, so that later entries still win.
+ */
+struct ProguardMap::MemberTables {
+  std::unordered_map<std::string, std::string> field_map;
+  std::unordered_map<std::string, std::string> method_map;
+  std::unordered_map<std::string, std::string> obf_field_map;
+  std::unordered_map<std::string, std::string> obf_method_map;
+  std::unordered_map<std::string, std::string> obf_untyped_field_map;
+  std::unordered_map<std::string, std::string> obf_untyped_method_map;
+  std::unordered_map<std::string, ProguardLineRangeVector>
+      obf_method_lines_map;
+  std::unordered_set<std::string> coalesced_interfaces;
+};
+
 void ProguardMap::parse_proguard_map(std::istream& fp) {
-  std::string line;
-  while (std::getline(fp, line)) {
-    parse_class(line);
+  std::string contents{std::istreambuf_iterator<char>(fp),
+                       std::istreambuf_iterator<char>()};
+  std::vector<std::pair<size_t, size_t>> line_bounds;
+  for (size_t begin = 0; begin < contents.size();) {
+    auto end = contents.find('\n', begin);
+    if (end == std::string::npos) {
+      end = contents.size();
+    }
+    line_bounds.emplace_back(begin, end);
+    begin = end + 1;
   }
-  fp.clear();
-  fp.seekg(0);
-  assert_log(!fp.fail(), "Can't use ProguardMap with non-seekable stream");
-  while (std::getline(fp, line)) {
-    if (parse_class(line)) {
-      continue;
+  auto get_line = [&](size_t i) {
+    return contents.substr(line_bounds[i].first,
+                           line_bounds[i].second - line_bounds[i].first);
+  };
+
+  // Member lines refer to classes anywhere in the map, so all the classes
+  // have to be known before any members are parsed.
+  std::vector<ClassSection> sections;
+  sections.push_back(ClassSection{0, 0, false, "", ""});
+  for (size_t i = 0; i < line_bounds.size(); ++i) {
+    if (parse_class(get_line(i))) {
+      sections.back().end = i;
+      sections.push_back(ClassSection{i, i, true, m_currClass, m_currNewClass});
     }
-    if (parse_field(line)) {
-      continue;
+  }
+  sections.back().end = line_bounds.size();
+
+  // Split the sections into runs of about the same number of lines, a few
+  // per thread.
+  std::vector<std::pair<size_t, size_t>> chunks;
+  size_t num_threads = redex_parallel::default_num_threads();
+  size_t lines_per_chunk = line_bounds.size() / (num_threads * 4) + 1;
+  for (size_t i = 0; i < sections.size();) {
+    size_t j = i;
+    size_t num_lines = 0;
+    while (j < sections.size() && num_lines < lines_per_chunk) {
+      num_lines += sections[j].end - sections[j].begin;
+      ++j;
     }
-    if (parse_method(line)) {
-      continue;
+    chunks.emplace_back(i, j);
+    i = j;
+  }
+
+  std::vector<MemberTables> chunk_tables(chunks.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t c) {
+    auto* tables = &chunk_tables[c];
+    for (size_t s = chunks[c].first; s < chunks[c].second; ++s) {
+      const auto& section = sections[s];
+      auto begin = section.begin + (section.has_class_line ? 1 : 0);
+      for (size_t i = begin; i < section.end; ++i) {
+        auto line = get_line(i);
+        if (parse_field(line, section, tables)) {
+          continue;
+        }
+        if (parse_method(line, section, tables)) {
+          continue;
+        }
+        if (comment(line)) {
+          continue;
+        }
+        not_reached_log("Bogus line encountered in proguard map: %s\n",
+                        line.c_str());
+      }
     }
-    if (comment(line)) {
-      continue;
+  });
+  for (size_t c = 0; c < chunks.size(); ++c) {
+    wq.add_item(c);
+  }
+  wq.run_all();
+  merge(chunk_tables);
+}
+
+void ProguardMap::merge(std::vector<MemberTables>& chunk_tables) {
+  using StringMap = std::unordered_map<std::string, std::string>;
+  std::vector<std::pair<StringMap*, StringMap MemberTables::*>> string_maps = {
+      {&m_fieldMap, &MemberTables::field_map},
+      {&m_methodMap, &MemberTables::method_map},
+      {&m_obfFieldMap, &MemberTables::obf_field_map},
+      {&m_obfMethodMap, &MemberTables::obf_method_map},
+      {&m_obfUntypedFieldMap, &MemberTables::obf_untyped_field_map},
+      {&m_obfUntypedMethodMap, &MemberTables::obf_untyped_method_map},
+  };
+  // Each of the maps is merged by its own thread.
+  auto wq = workqueue_foreach<size_t>([&](size_t i) {
+    if (i < string_maps.size()) {
+      auto* map = string_maps[i].first;
+      auto chunk_map = string_maps[i].second;
+      for (auto& tables : chunk_tables) {
+        auto& from = tables.*chunk_map;
+        if (map->empty()) {
+          *map = std::move(from);
+          continue;
+        }
+        for (auto& p : from) {
+          (*map)[p.first] = std::move(p.second);
+        }
+      }
+    } else if (i == string_maps.size()) {
+      for (auto& tables : chunk_tables) {
+        for (auto& p : tables.obf_method_lines_map) {
+          auto& lines = m_obfMethodLinesMap[p.first];
+          for (auto& range : p.second) {
+            lines.push_back(std::move(range));
+          }
+        }
+      }
+    } else {
+      for (auto& tables : chunk_tables) {
+        m_pg_coalesced_interfaces.insert(tables.coalesced_interfaces.begin(),
+                                         tables.coalesced_interfaces.end());
+      }
     }
-    not_reached_log("Bogus line encountered in proguard map: %s\n",
-                    line.c_str());
+  });
+  for (size_t i = 0; i < string_maps.size() + 2; ++i) {
+    wq.add_item(i);
   }
+  wq.run_all();
 }
 
 bool ProguardMap::parse_class(const std::string& line) {
@@ -253,7 +378,9 @@ bool ProguardMap::parse_class(const std::string& line) {
   return true;
 }
 
-bool ProguardMap::parse_field(const std::string& line) {
+bool ProguardMap::parse_field(const std::string& line,
+                              const ClassSection& section,
+                              MemberTables* tables) const {
   std::string type;
   std::string fieldname;
   std::string newname;
@@ -268,27 +395,29 @@ bool ProguardMap::parse_field(const std::string& line) {
 
   auto ctype = convert_type(type);
   auto xtype = translate_type(ctype, *this);
-  auto pgnew = convert_field(m_currNewClass, xtype, newname);
-  auto pgnew_notype = convert_field(m_currNewClass, "", newname);
-  auto pgold = convert_field(m_currClass, ctype, fieldname);
+  auto pgnew = convert_field(section.new_cls, xtype, newname);
+  auto pgnew_notype = convert_field(section.new_cls, "", newname);
+  auto pgold = convert_field(section.cls, ctype, fieldname);
   // Record interfaces that are coalesced by Proguard.
   if (ctype[0] == 'L' && is_maybe_proguard_generated_member(fieldname)) {
     fprintf(stderr,
             "Type '%s' is touched by Proguard in '%s'\n",
             ctype.c_str(),
             pgold.c_str());
-    m_pg_coalesced_interfaces.insert(ctype);
+    tables->coalesced_interfaces.insert(ctype);
   }
-  m_fieldMap[pgold] = pgnew;
-  m_obfFieldMap[pgnew] = pgold;
-  m_obfUntypedFieldMap[pgnew_notype] = pgold;
+  tables->field_map[pgold] = pgnew;
+  tables->obf_field_map[pgnew] = pgold;
+  tables->obf_untyped_field_map[pgnew_notype] = pgold;
   return true;
 }
 
-bool ProguardMap::parse_method(const std::string& line) {
+bool ProguardMap::parse_method(const std::string& line,
+                               const ClassSection& section,
+                               MemberTables* tables) const {
   std::string type;
   std::string methodname;
-  std::string classname = m_currClass;
+  std::string classname = section.cls;
   std::string old_args;
   std::string new_args;
   std::string newname;
@@ -329,13 +458,14 @@ bool ProguardMap::parse_method(const std::string& line) {
   auto old_rtype = convert_type(type);
   auto new_rtype = translate_type(old_rtype, *this);
   auto pgold = convert_method(classname, old_rtype, methodname, old_args);
-  auto pgnew = convert_method(m_currNewClass, new_rtype, newname, new_args);
-  auto pgnew_no_rtype = convert_method(m_currNewClass, "", newname, new_args);
-  m_methodMap[pgold] = pgnew;
-  m_obfMethodMap[pgnew] = pgold;
-  m_obfUntypedMethodMap[pgnew_no_rtype] = pgold;
+  auto pgnew = convert_method(section.new_cls, new_rtype, newname, new_args);
+  auto pgnew_no_rtype = convert_method(section.new_cls, "", newname, new_args);
+  tables->method_map[pgold] = pgnew;
+  tables->obf_method_map[pgnew] = pgold;
+  tables->obf_untyped_method_map[pgnew_no_rtype] = pgold;
   lines->original_name = pgold;
-  m_obfMethodLinesMap[pg_impl::lines_key(pgnew)].push_back(std::move(lines));
+  tables->obf_method_lines_map[pg_impl::lines_key(pgnew)].push_back(
+      std::move(lines));
   return true;
 }
 
@@ -378,14 +508,14 @@ void apply_deobfuscated_positions(IRCode* code, const ProguardMap& pm) {
       continue;
     }
     auto* pos = mie.pos.get();
-    const auto& remapped_frames = pm.deobfuscate_frame(pos->method, pos->line);
+    const auto& remapped_frames =
+        pm.deobfuscate_frame(pos->method(), pos->line);
     auto it = remapped_frames.begin();
-    // Make sure we don't update pos->file if the method and line numbers are
+    // Make sure we don't update the file if the method and line numbers are
     // unchanged. file_name_from_method_string() is only a best guess at the
     // real file name.
-    if (pos->method != it->method || pos->line != it->line) {
-      pos->method = it->method;
-      pos->file = file_name_from_method_string(it->method);
+    if (pos->method() != it->method || pos->line != it->line) {
+      pos->bind(it->method, file_name_from_method_string(it->method));
       pos->line = it->line;
     }
     // There may be multiple remapped frames if the given instruction was
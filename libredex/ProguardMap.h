@@ -12,6 +12,7 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "DexClass.h"
 #include "ProguardLineRange.h"
@@ -111,11 +112,19 @@ struct ProguardMap {
   }
 
  private:
+  struct ClassSection;
+  struct MemberTables;
+
   void parse_proguard_map(std::istream& fp);
 
   bool parse_class(const std::string& line);
-  bool parse_field(const std::string& line);
-  bool parse_method(const std::string& line);
+  bool parse_field(const std::string& line,
+                   const ClassSection& section,
+                   MemberTables* tables) const;
+  bool parse_method(const std::string& line,
+                    const ClassSection& section,
+                    MemberTables* tables) const;
+  void merge(std::vector<MemberTables>& chunk_tables);
 
  private:
   // Unobfuscated to obfuscated maps
@@ -16,6 +16,7 @@
 #include "Debug.h"
 #include "DexCallSite.h"
 #include "DexClass.h"
+#include "DexPosition.h"
 #include "DuplicateClasses.h"
 #include "Show.h"
 #include "Trace.h"
@@ -54,6 +55,10 @@ RedexContext::~RedexContext() {
   for (auto const& p : s_proto_map) {
     delete p.second;
   }
+  // Delete DexPositionFrames.
+  for (auto const& p : s_position_frame_map) {
+    delete p.second;
+  }
   // Delete DexMethods.
   for (auto const& it : s_method_map) {
     delete static_cast<DexMethod*>(it.second);
@@ -251,6 +256,17 @@ DexProto* RedexContext::get_proto(const DexType* rtype,
   return s_proto_map.get(ProtoKey(rtype, args), nullptr);
 }
 
+const DexPositionFrame* RedexContext::make_position_frame(DexString* method,
+                                                          DexString* file) {
+  PositionFrameKey key(method, file);
+  auto rv = s_position_frame_map.get(key, nullptr);
+  if (rv != nullptr) {
+    return rv;
+  }
+  return try_insert(key, new DexPositionFrame(method, file),
+                    &s_position_frame_map);
+}
+
 DexMethodRef* RedexContext::make_method(const DexType* type_,
                                         const DexString* name_,
                                         const DexProto* proto_) {
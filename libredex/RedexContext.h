@@ -37,6 +37,7 @@ class DexClass;
 struct DexFieldSpec;
 struct DexDebugEntry;
 struct DexPosition;
+struct DexPositionFrame;
 struct RedexContext;
 
 extern RedexContext* g_redex;
@@ -103,6 +104,9 @@ struct RedexContext {
                      const DexMethodSpec& new_spec,
                      bool rename_on_collision);
 
+  const DexPositionFrame* make_position_frame(DexString* method,
+                                              DexString* file);
+
   DexDebugEntry* make_dbg_entry(DexDebugInstruction* opcode);
   DexDebugEntry* make_dbg_entry(DexPosition* pos);
 
@@ -261,6 +265,13 @@ struct RedexContext {
   ConcurrentMap<DexMethodSpec, DexMethodRef*> s_method_map;
   std::mutex s_method_lock;
 
+  // DexPositionFrame
+  using PositionFrameKey = std::pair<const DexString*, const DexString*>;
+  ConcurrentMap<PositionFrameKey,
+                DexPositionFrame*,
+                boost::hash<PositionFrameKey>>
+      s_position_frame_map;
+
   // Type-to-class map
   std::mutex m_type_system_mutex;
   std::unordered_map<const DexType*, DexClass*> m_type_to_class;
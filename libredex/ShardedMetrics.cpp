@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ShardedMetrics.h"
+
+#include <algorithm>
+
+namespace sharded_metrics {
+
+namespace {
+
+std::atomic<size_t> s_next_shard{0};
+
+size_t most_significant_bit(uint64_t value) {
+  return 63 - __builtin_clzll(value);
+}
+
+} // namespace
+
+size_t current_shard() {
+  // Threads are assigned shards round-robin in the order in which they first
+  // touch a metric.
+  static thread_local size_t shard =
+      s_next_shard.fetch_add(1, std::memory_order_relaxed);
+  return shard;
+}
+
+int64_t Counter::sum() const {
+  int64_t result = 0;
+  for (const auto& shard : m_shards) {
+    result += shard.value.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+void Counter::reset() {
+  for (auto& shard : m_shards) {
+    shard.value.store(0, std::memory_order_relaxed);
+  }
+}
+
+size_t Histogram::bucket_of(uint64_t value) {
+  if (value < 2 * SUB_BUCKETS) {
+    return value;
+  }
+  auto msb = most_significant_bit(value);
+  auto sub_bucket = (value >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+  return 2 * SUB_BUCKETS + (msb - SUB_BUCKET_BITS - 1) * SUB_BUCKETS +
+         sub_bucket;
+}
+
+uint64_t Histogram::bucket_lower_bound(size_t bucket) {
+  if (bucket < 2 * SUB_BUCKETS) {
+    return bucket;
+  }
+  auto k = bucket - 2 * SUB_BUCKETS;
+  auto msb = k / SUB_BUCKETS + SUB_BUCKET_BITS + 1;
+  uint64_t sub_bucket = k % SUB_BUCKETS;
+  return (uint64_t(1) << msb) | (sub_bucket << (msb - SUB_BUCKET_BITS));
+}
+
+Histogram::Summary Histogram::summarize() const {
+  Summary summary;
+  std::array<uint64_t, NUM_BUCKETS> buckets{};
+  summary.min = std::numeric_limits<uint64_t>::max();
+  for (const auto& shard : m_shards) {
+    summary.sum += shard.sum.load(std::memory_order_relaxed);
+    summary.min =
+        std::min(summary.min, shard.min.load(std::memory_order_relaxed));
+    summary.max =
+        std::max(summary.max, shard.max.load(std::memory_order_relaxed));
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+      auto count = shard.buckets[i].load(std::memory_order_relaxed);
+      buckets[i] += count;
+      summary.count += count;
+    }
+  }
+  if (summary.count == 0) {
+    summary.min = 0;
+    return summary;
+  }
+
+  // The value at the given percentile is approximated by the lower bound of
+  // its bucket, but never reported outside of the observed range.
+  auto percentile = [&](uint64_t percent) {
+    uint64_t rank = std::max<uint64_t>(1, (summary.count * percent + 99) / 100);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+      seen += buckets[i];
+      if (seen >= rank) {
+        return std::min(std::max(bucket_lower_bound(i), summary.min),
+                        summary.max);
+      }
+    }
+    return summary.max;
+  };
+  summary.p50 = percentile(50);
+  summary.p90 = percentile(90);
+  summary.p99 = percentile(99);
+  return summary;
+}
+
+void Histogram::reset() {
+  for (auto& shard : m_shards) {
+    shard.sum.store(0, std::memory_order_relaxed);
+    shard.min.store(std::numeric_limits<uint64_t>::max(),
+                    std::memory_order_relaxed);
+    shard.max.store(0, std::memory_order_relaxed);
+    for (auto& bucket : shard.buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+void Histogram::add(const Histogram& other) {
+  for (size_t i = 0; i < NUM_SHARDS; ++i) {
+    const auto& from = other.m_shards[i];
+    auto& to = m_shards[i];
+    for (size_t b = 0; b < NUM_BUCKETS; ++b) {
+      auto count = from.buckets[b].load(std::memory_order_relaxed);
+      if (count != 0) {
+        to.buckets[b].fetch_add(count, std::memory_order_relaxed);
+      }
+    }
+    to.sum.fetch_add(from.sum.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+    auto min = from.min.load(std::memory_order_relaxed);
+    auto to_min = to.min.load(std::memory_order_relaxed);
+    while (min < to_min && !to.min.compare_exchange_weak(
+                               to_min, min, std::memory_order_relaxed)) {
+    }
+    auto max = from.max.load(std::memory_order_relaxed);
+    auto to_max = to.max.load(std::memory_order_relaxed);
+    while (max > to_max && !to.max.compare_exchange_weak(
+                               to_max, max, std::memory_order_relaxed)) {
+    }
+  }
+}
+
+} // namespace sharded_metrics
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "Thread.h"
+
+/**
+ * Metrics that are cheap enough to update from inside parallel walks, even
+ * once per instruction.
+ *
+ * Every metric is split into shards, each on its own cache line. A thread
+ * always updates the same shard with a relaxed atomic operation, so there is
+ * no lock and, as long as there are fewer running threads than shards, no
+ * cache line bouncing either. Reading a metric sums up all the shards; this
+ * is meant to happen once, after the parallel work is done.
+ *
+ * The PassManager hands out handles to these metrics by key (see
+ * PassManager::counter and PassManager::histogram) and folds them into the
+ * pass metrics at the end of the pass.
+ */
+namespace sharded_metrics {
+
+// The shard of the calling thread, stable for the lifetime of the thread.
+size_t current_shard();
+
+class Counter {
+ public:
+  static constexpr size_t NUM_SHARDS = 64;
+
+  void incr(int64_t value = 1) {
+    m_shards[current_shard() % NUM_SHARDS].value.fetch_add(
+        value, std::memory_order_relaxed);
+  }
+
+  int64_t sum() const;
+
+  void reset();
+
+ private:
+  struct alignas(CACHE_LINE_SIZE) Shard {
+    std::atomic<int64_t> value{0};
+  };
+  std::array<Shard, NUM_SHARDS> m_shards;
+};
+
+/**
+ * A histogram of non-negative values with log-linear buckets: values below
+ * 2 * SUB_BUCKETS (16) each get their own bucket, larger values are split into
+ * SUB_BUCKETS buckets per power of two. Percentiles are therefore exact for
+ * values below 16, and within 1/SUB_BUCKETS (12.5%) otherwise.
+ */
+class Histogram {
+ public:
+  static constexpr size_t NUM_SHARDS = 16;
+  static constexpr size_t SUB_BUCKET_BITS = 3;
+  static constexpr size_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static constexpr size_t NUM_BUCKETS =
+      2 * SUB_BUCKETS + (64 - SUB_BUCKET_BITS - 1) * SUB_BUCKETS;
+
+  struct Summary {
+    uint64_t count{0};
+    uint64_t sum{0};
+    uint64_t min{0};
+    uint64_t max{0};
+    uint64_t p50{0};
+    uint64_t p90{0};
+    uint64_t p99{0};
+  };
+
+  void record(uint64_t value) {
+    auto& shard = m_shards[current_shard() % NUM_SHARDS];
+    shard.buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+    auto max = shard.max.load(std::memory_order_relaxed);
+    while (value > max && !shard.max.compare_exchange_weak(
+                              max, value, std::memory_order_relaxed)) {
+    }
+    auto min = shard.min.load(std::memory_order_relaxed);
+    while (value < min && !shard.min.compare_exchange_weak(
+                              min, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  Summary summarize() const;
+
+  void reset();
+
+  // Adds all the values recorded in `other` to this histogram.
+  void add(const Histogram& other);
+
+  static size_t bucket_of(uint64_t value);
+
+  // The smallest value that falls into the given bucket.
+  static uint64_t bucket_lower_bound(size_t bucket);
+
+ private:
+  struct alignas(CACHE_LINE_SIZE) Shard {
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> min{std::numeric_limits<uint64_t>::max()};
+    std::atomic<uint64_t> max{0};
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets{};
+  };
+  std::array<Shard, NUM_SHARDS> m_shards;
+};
+
+} // namespace sharded_metrics
@@ -1071,16 +1071,16 @@ std::string show(const DexDebugInstruction* insn) {
 }
 
 std::ostream& operator<<(std::ostream& o, const DexPosition& pos) {
-  if (pos.method != nullptr) {
-    o << *pos.method;
+  if (pos.method() != nullptr) {
+    o << *pos.method();
   } else {
     o << "Unknown method";
   }
   o << "(";
-  if (pos.file == nullptr) {
+  if (pos.file() == nullptr) {
     o << "Unknown source";
   } else {
-    o << *pos.file;
+    o << *pos.file();
   }
   o << ":" << pos.line << ")";
   if (pos.parent != nullptr) {
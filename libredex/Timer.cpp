@@ -22,11 +22,15 @@ Timer::~Timer() {
   --s_indent;
   auto end = std::chrono::high_resolution_clock::now();
   auto duration_s = std::chrono::duration<double>(end - m_start).count();
+  add_timing(std::move(m_msg), duration_s);
+}
+
+void Timer::add_timing(std::string msg, double duration_s) {
   TRACE(TIME, 1, "%*s%s completed in %.1lf seconds", 4 * s_indent, "",
-        m_msg.c_str(), duration_s);
+        msg.c_str(), duration_s);
 
   {
     std::lock_guard<std::mutex> guard(s_lock);
-    s_times.push_back({std::move(m_msg), duration_s});
+    s_times.push_back({std::move(msg), duration_s});
   }
 }
@@ -17,6 +17,10 @@ struct Timer {
   explicit Timer(const std::string& msg);
   ~Timer();
 
+  // Records a duration that was measured elsewhere, e.g. summed up over many
+  // short intervals, as if a Timer had measured it.
+  static void add_timing(std::string msg, double duration_s);
+
   using times_t = std::vector<std::pair<std::string, double>>;
   // there should be no currently running Timers when this function is called
   static const times_t& get_times() { return s_times; }
@@ -53,6 +53,7 @@
   TM(FINALINLINE)    \
   TM(GETTER)         \
   TM(HASHER)         \
+  TM(HOTCOLD)        \
   TM(ICONSTP)        \
   TM(IDEX)           \
   TM(IFCS_ANALYSIS)  \
@@ -13,6 +13,7 @@
 #include <vector>
 
 #include "ControlFlow.h"
+#include "CostSampling.h"
 #include "DexAnnotation.h"
 #include "DexClass.h"
 #include "EditableCfgAdapter.h"
@@ -244,10 +245,12 @@ class walk {
   static void iterate_methods(const DexClass* cls, const WalkerFn& walker) {
     for (auto dmethod : cls->get_dmethods()) {
       TraceContext context(dmethod->get_deobfuscated_name());
+      cost_sampling::ScopedSample sample(dmethod);
       walker(dmethod);
     }
     for (auto vmethod : cls->get_vmethods()) {
       TraceContext context(vmethod->get_deobfuscated_name());
+      cost_sampling::ScopedSample sample(vmethod);
       walker(vmethod);
     }
   }
@@ -467,10 +470,12 @@ class walk {
             Accumulator& acc = acc_vec[state->worker_id()];
             for (auto dmethod : cls->get_dmethods()) {
               TraceContext context(dmethod->get_deobfuscated_name());
+              cost_sampling::ScopedSample sample(dmethod);
               walker(dmethod, &acc);
             }
             for (auto vmethod : cls->get_vmethods()) {
               TraceContext context(vmethod->get_deobfuscated_name());
+              cost_sampling::ScopedSample sample(vmethod);
               walker(vmethod, &acc);
             }
           },
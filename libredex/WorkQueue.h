@@ -8,19 +8,34 @@
 #pragma once
 
 #include <exception>
+#include <type_traits>
 
+#include "CostSampling.h"
 #include "SpartaWorkQueue.h"
 
 namespace redex_workqueue_impl {
 
 void redex_queue_exception_handler(std::exception& e);
 
+// Work items that are methods get their cost sampled, see CostSampling.h.
+struct NoSample {
+  template <typename Input>
+  explicit NoSample(const Input&) {}
+};
+
+template <typename Input>
+using ItemSample = typename std::conditional<
+    std::is_convertible<Input, const DexMethod*>::value,
+    cost_sampling::ScopedSample,
+    NoSample>::type;
+
 // Helper classes so the type of Executor can be inferred
 template <typename Input, typename Fn>
 struct NoStateWorkQueueHelper {
   Fn fn;
   void operator()(sparta::SpartaWorkerState<Input>*, Input a) {
     try {
+      ItemSample<Input> sample(a);
       fn(a);
     } catch (std::exception& e) {
       redex_queue_exception_handler(e);
@@ -34,6 +49,7 @@ struct WithStateWorkQueueHelper {
   Fn fn;
   void operator()(sparta::SpartaWorkerState<Input>* state, Input a) {
     try {
+      ItemSample<Input> sample(a);
       fn(state, a);
     } catch (std::exception& e) {
       redex_queue_exception_handler(e);
@@ -8,6 +8,8 @@
 #include "CheckBreadcrumbs.h"
 
 #include <algorithm>
+#include <array>
+#include <memory>
 #include <sstream>
 #include <unordered_set>
 
@@ -21,6 +23,7 @@
 #include "Show.h"
 #include "Trace.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 /**
  * Performs 2 kind of verifications:
@@ -115,6 +118,9 @@ size_t illegal_elements(const XStoreRefs& xstores,
   return num_illegal_cross_store_refs;
 }
 
+// Lets the sequential walkers visit a single class of the scope.
+std::array<DexClass*, 1> single_class(DexClass* cls) { return {{cls}}; }
+
 } // namespace
 
 Breadcrumbs::Breadcrumbs(const Scope& scope,
@@ -124,13 +130,88 @@ Breadcrumbs::Breadcrumbs(const Scope& scope,
       m_xstores(stores),
       m_reject_illegal_refs_root_store(reject_illegal_refs_root_store) {
   m_classes.insert(scope.begin(), scope.end());
+  m_store_idx.reserve(scope.size());
+  for (const auto* cls : scope) {
+    auto type = cls->get_type();
+    m_store_idx.emplace(type, m_xstores.get_store_idx(type));
+  }
   m_multiple_root_store_dexes = stores[0].get_dexen().size() > 1;
 }
 
+template <typename Container>
+static void append_all(Container& to, Container&& from) {
+  for (auto& pair : from) {
+    auto& elems = to[pair.first];
+    elems.insert(elems.end(), pair.second.begin(), pair.second.end());
+  }
+}
+
+bool Breadcrumbs::Findings::empty() const {
+  return bad_fields.empty() && bad_methods.empty() && bad_type_insns.empty() &&
+         bad_field_insns.empty() && bad_meth_insns.empty() &&
+         illegal_field.empty() && bad_fields_refs.empty() &&
+         illegal_type.empty() && illegal_field_type.empty() &&
+         illegal_field_cls.empty() && illegal_method_call.empty();
+}
+
+void Breadcrumbs::Findings::append(Findings&& other) {
+  append_all(bad_fields, std::move(other.bad_fields));
+  append_all(bad_methods, std::move(other.bad_methods));
+  for (auto& pair : other.bad_type_insns) {
+    append_all(bad_type_insns[pair.first], std::move(pair.second));
+  }
+  for (auto& pair : other.bad_field_insns) {
+    append_all(bad_field_insns[pair.first], std::move(pair.second));
+  }
+  for (auto& pair : other.bad_meth_insns) {
+    append_all(bad_meth_insns[pair.first], std::move(pair.second));
+  }
+  append_all(illegal_field, std::move(other.illegal_field));
+  append_all(bad_fields_refs, std::move(other.bad_fields_refs));
+  append_all(illegal_type, std::move(other.illegal_type));
+  append_all(illegal_field_type, std::move(other.illegal_field_type));
+  append_all(illegal_field_cls, std::move(other.illegal_field_cls));
+  append_all(illegal_method_call, std::move(other.illegal_method_call));
+}
+
+/**
+ * Run `check` on every class of the scope in parallel. Each class gets its own
+ * (lazily allocated) Findings, merged into m_findings in scope order afterwards
+ * to keep the reports deterministic.
+ */
+template <typename CheckFn>
+void Breadcrumbs::check_classes(const CheckFn& check) {
+  std::vector<std::unique_ptr<Findings>> per_class(m_scope.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t idx) {
+    Findings findings;
+    check(m_scope[idx], findings);
+    if (!findings.empty()) {
+      per_class[idx] = std::make_unique<Findings>(std::move(findings));
+    }
+  });
+  for (size_t idx = 0; idx < m_scope.size(); ++idx) {
+    wq.add_item(idx);
+  }
+  wq.run_all();
+  for (auto& findings : per_class) {
+    if (findings) {
+      m_findings.append(std::move(*findings));
+    }
+  }
+}
+
 void Breadcrumbs::check_breadcrumbs() {
-  check_fields();
-  check_methods();
-  check_opcodes();
+  // The phases stay separate so that each kind of finding is collected in the
+  // same order as by a sequential fields/methods/opcodes walk.
+  check_classes([this](DexClass* cls, Findings& findings) {
+    check_fields(cls, findings);
+  });
+  check_classes([this](DexClass* cls, Findings& findings) {
+    check_methods(cls, findings);
+  });
+  check_classes([this](DexClass* cls, Findings& findings) {
+    check_opcodes(cls, findings);
+  });
 }
 
 void Breadcrumbs::report_deleted_types(bool report_only, PassManager& mgr) {
@@ -139,25 +220,26 @@ void Breadcrumbs::report_deleted_types(bool report_only, PassManager& mgr) {
   size_t bad_type_insns_count = 0;
   size_t bad_field_insns_count = 0;
   size_t bad_meths_insns_count = 0;
-  if (!m_bad_fields.empty() || !m_bad_methods.empty() ||
-      !m_bad_type_insns.empty() || !m_bad_field_insns.empty() ||
-      !m_bad_meth_insns.empty()) {
+  if (!m_findings.bad_fields.empty() || !m_findings.bad_methods.empty() ||
+      !m_findings.bad_type_insns.empty() ||
+      !m_findings.bad_field_insns.empty() ||
+      !m_findings.bad_meth_insns.empty()) {
     std::ostringstream ss;
-    for (const auto& bad_field : m_bad_fields) {
+    for (const auto& bad_field : m_findings.bad_fields) {
       for (const auto& field : bad_field.second) {
         bad_fields_count++;
         ss << "Reference to deleted type " << SHOW(bad_field.first)
            << " in field " << SHOW(field) << std::endl;
       }
     }
-    for (const auto& bad_meth : m_bad_methods) {
+    for (const auto& bad_meth : m_findings.bad_methods) {
       for (const auto& meth : bad_meth.second) {
         bad_methods_count++;
         ss << "Reference to deleted type " << SHOW(bad_meth.first)
            << " in method " << SHOW(meth) << std::endl;
       }
     }
-    for (const auto& bad_insns : m_bad_type_insns) {
+    for (const auto& bad_insns : m_findings.bad_type_insns) {
       for (const auto& insns : bad_insns.second) {
         for (const auto& insn : insns.second) {
           bad_type_insns_count++;
@@ -167,7 +249,7 @@ void Breadcrumbs::report_deleted_types(bool report_only, PassManager& mgr) {
         }
       }
     }
-    for (const auto& bad_insns : m_bad_field_insns) {
+    for (const auto& bad_insns : m_findings.bad_field_insns) {
       for (const auto& insns : bad_insns.second) {
         for (const auto& insn : insns.second) {
           bad_field_insns_count++;
@@ -177,7 +259,7 @@ void Breadcrumbs::report_deleted_types(bool report_only, PassManager& mgr) {
         }
       }
     }
-    for (const auto& bad_insns : m_bad_meth_insns) {
+    for (const auto& bad_insns : m_findings.bad_meth_insns) {
       for (const auto& insns : bad_insns.second) {
         for (const auto& insn : insns.second) {
           bad_meths_insns_count++;
@@ -212,7 +294,7 @@ void Breadcrumbs::report_deleted_types(bool report_only, PassManager& mgr) {
 
 std::string Breadcrumbs::get_methods_with_bad_refs() {
   std::ostringstream ss;
-  for (const auto& class_meth : m_bad_methods) {
+  for (const auto& class_meth : m_findings.bad_methods) {
     const auto type = class_meth.first;
     const auto& methods = class_meth.second;
     ss << "Bad methods in class " << type->get_name()->c_str() << std::endl;
@@ -221,7 +303,7 @@ std::string Breadcrumbs::get_methods_with_bad_refs() {
     }
     ss << std::endl;
   }
-  for (const auto& meth_field : m_bad_fields_refs) {
+  for (const auto& meth_field : m_findings.bad_fields_refs) {
     const auto type = meth_field.first->get_class();
     const auto method = meth_field.first;
     const auto& fields = meth_field.second;
@@ -239,7 +321,7 @@ void Breadcrumbs::report_illegal_refs(bool fail_if_illegal_refs,
                                       PassManager& mgr) {
   size_t num_illegal_fields = 0;
   std::ostringstream ss;
-  for (const auto& pair : m_illegal_field) {
+  for (const auto& pair : m_findings.illegal_field) {
     const auto type = pair.first;
     const auto& fields = pair.second;
     num_illegal_fields += fields.size();
@@ -254,13 +336,16 @@ void Breadcrumbs::report_illegal_refs(bool fail_if_illegal_refs,
   }
 
   size_t num_illegal_type_refs =
-      illegal_elements(m_xstores, m_illegal_type, "type refs", ss);
+      illegal_elements(m_xstores, m_findings.illegal_type, "type refs", ss);
   size_t num_illegal_field_type_refs =
-      illegal_elements(m_xstores, m_illegal_field_type, "field type refs", ss);
+      illegal_elements(m_xstores, m_findings.illegal_field_type,
+                       "field type refs", ss);
   size_t num_illegal_field_cls =
-      illegal_elements(m_xstores, m_illegal_field_cls, "field class refs", ss);
+      illegal_elements(m_xstores, m_findings.illegal_field_cls,
+                       "field class refs", ss);
   size_t num_illegal_method_calls =
-      illegal_elements(m_xstores, m_illegal_method_call, "method call", ss);
+      illegal_elements(m_xstores, m_findings.illegal_method_call,
+                       "method call", ss);
 
   size_t num_illegal_cross_store_refs =
       num_illegal_fields + num_illegal_type_refs + num_illegal_field_cls +
@@ -288,6 +373,11 @@ void Breadcrumbs::report_illegal_refs(bool fail_if_illegal_refs,
 }
 
 bool Breadcrumbs::has_illegal_access(const DexMethod* input_method) {
+  return has_illegal_access(input_method, m_findings);
+}
+
+bool Breadcrumbs::has_illegal_access(const DexMethod* input_method,
+                                     Findings& findings) {
   bool result = false;
   if (input_method->get_code() == nullptr) {
     return false;
@@ -297,7 +387,7 @@ bool Breadcrumbs::has_illegal_access(const DexMethod* input_method) {
     if (insn->has_field()) {
       auto res_field = resolve_field(insn->get_field());
       if (res_field != nullptr) {
-        if (!check_field_accessibility(input_method, res_field)) {
+        if (!check_field_accessibility(input_method, res_field, findings)) {
           result = true;
         }
       } else if (referenced_field_is_deleted(insn->get_field())) {
@@ -308,7 +398,7 @@ bool Breadcrumbs::has_illegal_access(const DexMethod* input_method) {
       auto res_method = resolve_method(insn->get_method(),
                                        opcode_to_search(insn), input_method);
       if (res_method != nullptr) {
-        if (!check_method_accessibility(input_method, res_method)) {
+        if (!check_method_accessibility(input_method, res_method, findings)) {
           result = true;
         }
       } else if (referenced_method_is_deleted(insn->get_method())) {
@@ -327,8 +417,8 @@ bool Breadcrumbs::is_illegal_cross_store(const DexType* caller,
     return false;
   }
 
-  size_t caller_store_idx = m_xstores.get_store_idx(caller);
-  size_t callee_store_idx = m_xstores.get_store_idx(callee);
+  size_t caller_store_idx = m_store_idx.at(caller);
+  size_t callee_store_idx = m_store_idx.at(callee);
 
   if (m_multiple_root_store_dexes && caller_store_idx == 0 &&
       callee_store_idx == 1 && !m_reject_illegal_refs_root_store) {
@@ -385,20 +475,21 @@ const DexType* Breadcrumbs::check_anno(const DexAnnotationSet* anno) {
 
 void Breadcrumbs::bad_type(const DexType* type,
                            const DexMethod* method,
-                           const IRInstruction* insn) {
-  m_bad_type_insns[type][method].emplace_back(insn);
+                           const IRInstruction* insn,
+                           Findings& findings) {
+  findings.bad_type_insns[type][method].emplace_back(insn);
 }
 
 // Verify that all field definitions reference types that are not deleted.
-void Breadcrumbs::check_fields() {
-  walk::fields(m_scope, [&](DexField* field) {
+void Breadcrumbs::check_fields(DexClass* cls, Findings& findings) {
+  walk::fields(single_class(cls), [&](DexField* field) {
     bool check_cross_store_ref = true;
     std::vector<DexType*> type_refs;
     field->gather_types(type_refs);
     for (auto type : type_refs) {
       auto bad_ref = check_type(type);
       if (bad_ref) {
-        m_bad_fields[bad_ref].emplace_back(field);
+        findings.bad_fields[bad_ref].emplace_back(field);
         check_cross_store_ref = false;
       }
     }
@@ -406,7 +497,7 @@ void Breadcrumbs::check_fields() {
       const auto cls = field->get_class();
       const auto field_type = field->get_type();
       if (is_illegal_cross_store(cls, field_type)) {
-        m_illegal_field[cls].emplace_back(field);
+        findings.illegal_field[cls].emplace_back(field);
       }
       return;
     }
@@ -415,35 +506,36 @@ void Breadcrumbs::check_fields() {
 
 // Verify that all method definitions use not deleted types in their signatures
 // and annotations.
-void Breadcrumbs::check_methods() {
-  walk::methods(m_scope, [&](DexMethod* method) {
+void Breadcrumbs::check_methods(DexClass* cls, Findings& findings) {
+  walk::methods(single_class(cls), [&](DexMethod* method) {
     bool check_cross_store_ref = true;
     // Check type references on the method signature.
     const auto* bad_ref = check_method(method);
     if (bad_ref) {
-      m_bad_methods[bad_ref].emplace_back(method);
+      findings.bad_methods[bad_ref].emplace_back(method);
       check_cross_store_ref = false;
     }
     // Check type references on the annotations on the method.
     bad_ref = check_anno(method->get_anno_set());
     if (bad_ref) {
-      m_bad_methods[bad_ref].emplace_back(method);
+      findings.bad_methods[bad_ref].emplace_back(method);
       check_cross_store_ref = false;
     }
 
     if (check_cross_store_ref) {
-      has_illegal_access(method);
+      has_illegal_access(method, findings);
     }
   });
 }
 
 /* verify that all method instructions that access fields are valid */
 bool Breadcrumbs::check_field_accessibility(const DexMethod* method,
-                                            const DexField* res_field) {
+                                            const DexField* res_field,
+                                            Findings& findings) {
   const auto field_class = res_field->get_class();
   const auto method_class = method->get_class();
   if (field_class != method_class && is_private(res_field)) {
-    m_bad_fields_refs[method].emplace_back(res_field);
+    findings.bad_fields_refs[method].emplace_back(res_field);
     return false;
   }
   return true;
@@ -461,11 +553,13 @@ bool Breadcrumbs::referenced_method_is_deleted(DexMethodRef* method_ref) {
 
 /* verify that all method instructions that access methods are valid */
 bool Breadcrumbs::check_method_accessibility(
-    const DexMethod* method, const DexMethod* res_called_method) {
+    const DexMethod* method,
+    const DexMethod* res_called_method,
+    Findings& findings) {
   const auto called_method_class = res_called_method->get_class();
   const auto method_class = method->get_class();
   if (called_method_class != method_class && is_private(res_called_method)) {
-    m_bad_methods[method_class].emplace_back(res_called_method);
+    findings.bad_methods[method_class].emplace_back(res_called_method);
     return false;
   }
   return true;
@@ -473,21 +567,23 @@ bool Breadcrumbs::check_method_accessibility(
 
 // verify that all opcodes are to non deleted references
 void Breadcrumbs::check_type_opcode(const DexMethod* method,
-                                    IRInstruction* insn) {
+                                    IRInstruction* insn,
+                                    Findings& findings) {
   const DexType* type = insn->get_type();
   type = check_type(type);
   if (type != nullptr) {
-    bad_type(type, method, insn);
+    bad_type(type, method, insn, findings);
   } else {
     const auto cls = method->get_class();
     if (is_illegal_cross_store(cls, insn->get_type())) {
-      m_illegal_type[method].emplace_back(insn);
+      findings.illegal_type[method].emplace_back(insn);
     }
   }
 }
 
 void Breadcrumbs::check_field_opcode(const DexMethod* method,
-                                     IRInstruction* insn) {
+                                     IRInstruction* insn,
+                                     Findings& findings) {
   bool check_cross_store_ref = true;
 
   auto field = insn->get_field();
@@ -496,7 +592,7 @@ void Breadcrumbs::check_field_opcode(const DexMethod* method,
   for (auto type : type_refs) {
     auto bad_ref = check_type(type);
     if (bad_ref) {
-      bad_type(bad_ref, method, insn);
+      bad_type(bad_ref, method, insn, findings);
       check_cross_store_ref = false;
     }
   }
@@ -504,11 +600,11 @@ void Breadcrumbs::check_field_opcode(const DexMethod* method,
   if (check_cross_store_ref) {
     auto cls = method->get_class();
     if (is_illegal_cross_store(cls, field->get_class())) {
-      m_illegal_field_type[method].emplace_back(insn);
+      findings.illegal_field_type[method].emplace_back(insn);
     }
 
     if (is_illegal_cross_store(cls, field->get_type())) {
-      m_illegal_field_cls[method].emplace_back(insn);
+      findings.illegal_field_cls[method].emplace_back(insn);
     }
   }
 
@@ -518,7 +614,7 @@ void Breadcrumbs::check_field_opcode(const DexMethod* method,
     if (field != res_field) {
       auto bad_ref = check_type(field->get_class());
       if (bad_ref != nullptr) {
-        bad_type(bad_ref, method, insn);
+        bad_type(bad_ref, method, insn, findings);
         return;
       }
     }
@@ -526,23 +622,24 @@ void Breadcrumbs::check_field_opcode(const DexMethod* method,
     // the class of the field is around but the field may have
     // been deleted so let's verify the field exists on the class
     if (referenced_field_is_deleted(field)) {
-      m_bad_field_insns[static_cast<DexField*>(field)][method].emplace_back(
-          insn);
+      findings.bad_field_insns[static_cast<DexField*>(field)][method]
+          .emplace_back(insn);
       return;
     }
   }
 }
 
 void Breadcrumbs::check_method_opcode(const DexMethod* method,
-                                      IRInstruction* insn) {
+                                      IRInstruction* insn,
+                                      Findings& findings) {
   const auto& meth = insn->get_method();
   const DexType* type = check_method(meth);
   if (type != nullptr) {
-    bad_type(type, method, insn);
+    bad_type(type, method, insn, findings);
     return;
   }
   if (is_illegal_cross_store(method->get_class(), meth->get_class())) {
-    m_illegal_method_call[method].emplace_back(insn);
+    findings.illegal_method_call[method].emplace_back(insn);
   }
 
   DexMethod* res_meth = resolve_method(meth, opcode_to_search(insn), method);
@@ -551,7 +648,7 @@ void Breadcrumbs::check_method_opcode(const DexMethod* method,
     if (res_meth != meth) {
       type = check_type(res_meth->get_class());
       if (type != nullptr) {
-        bad_type(type, method, insn);
+        bad_type(type, method, insn, findings);
         return;
       }
     }
@@ -559,29 +656,29 @@ void Breadcrumbs::check_method_opcode(const DexMethod* method,
     // the class of the method is around but the method may have
     // been deleted so let's verify the method exists on the class
     if (referenced_method_is_deleted(meth)) {
-      m_bad_meth_insns[static_cast<DexMethod*>(meth)][method].emplace_back(
-          insn);
+      findings.bad_meth_insns[static_cast<DexMethod*>(meth)][method]
+          .emplace_back(insn);
       return;
     }
   }
 }
 
-void Breadcrumbs::check_opcodes() {
-  walk::opcodes(m_scope,
-                [](DexMethod*) { return true; },
-                [&](DexMethod* method, IRInstruction* insn) {
-                  if (insn->has_type()) {
-                    check_type_opcode(method, insn);
-                    return;
-                  }
-                  if (insn->has_field()) {
-                    check_field_opcode(method, insn);
-                    return;
-                  }
-                  if (insn->has_method()) {
-                    check_method_opcode(method, insn);
-                  }
-                });
+void Breadcrumbs::check_opcodes(DexClass* cls, Findings& findings) {
+  walk::opcodes(
+      single_class(cls), [](DexMethod*) { return true; },
+      [&](DexMethod* method, IRInstruction* insn) {
+        if (insn->has_type()) {
+          check_type_opcode(method, insn, findings);
+          return;
+        }
+        if (insn->has_field()) {
+          check_field_opcode(method, insn, findings);
+          return;
+        }
+        if (insn->has_method()) {
+          check_method_opcode(method, insn, findings);
+        }
+      });
 }
 
 void CheckBreadcrumbsPass::run_pass(DexStoresVector& stores,
@@ -8,6 +8,8 @@
 #pragma once
 
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "DexClass.h" // All the comparators.
@@ -65,21 +67,36 @@ class Breadcrumbs {
   bool has_illegal_access(const DexMethod* input_method);
 
  private:
+  /**
+   * Everything the checks find. Each class of the scope is checked in
+   * parallel into its own Findings, which are then appended in scope order,
+   * so the reports are identical to the ones of a sequential walk.
+   */
+  struct Findings {
+    std::map<const DexType*, Fields, dextypes_comparator> bad_fields;
+    std::map<const DexType*, Methods, dextypes_comparator> bad_methods;
+    std::map<const DexType*, MethodInsns, dextypes_comparator> bad_type_insns;
+    std::map<const DexField*, MethodInsns, dexfields_comparator>
+        bad_field_insns;
+    std::map<const DexMethod*, MethodInsns, dexmethods_comparator>
+        bad_meth_insns;
+    std::map<const DexType*, Fields, dextypes_comparator> illegal_field;
+    std::map<const DexMethod*, Fields, dexmethods_comparator> bad_fields_refs;
+    MethodInsns illegal_type;
+    MethodInsns illegal_field_type;
+    MethodInsns illegal_field_cls;
+    MethodInsns illegal_method_call;
+
+    bool empty() const;
+    void append(Findings&& other);
+  };
+
   const Scope& m_scope;
   std::unordered_set<const DexClass*> m_classes;
-  std::map<const DexType*, Fields, dextypes_comparator> m_bad_fields;
-  std::map<const DexType*, Methods, dextypes_comparator> m_bad_methods;
-  std::map<const DexType*, MethodInsns, dextypes_comparator> m_bad_type_insns;
-  std::map<const DexField*, MethodInsns, dexfields_comparator>
-      m_bad_field_insns;
-  std::map<const DexMethod*, MethodInsns, dexmethods_comparator>
-      m_bad_meth_insns;
-  std::map<const DexType*, Fields, dextypes_comparator> m_illegal_field;
-  std::map<const DexMethod*, Fields, dexmethods_comparator> m_bad_fields_refs;
-  MethodInsns m_illegal_type;
-  MethodInsns m_illegal_field_type;
-  MethodInsns m_illegal_field_cls;
-  MethodInsns m_illegal_method_call;
+  // Store index of every class in scope, precomputed so that the parallel
+  // checks don't have to search the per-store type sets of XStoreRefs.
+  std::unordered_map<const DexType*, size_t> m_store_idx;
+  Findings m_findings;
   XStoreRefs m_xstores;
   bool m_multiple_root_store_dexes;
   bool m_reject_illegal_refs_root_store;
@@ -91,17 +108,29 @@ class Breadcrumbs {
 
   void bad_type(const DexType* type,
                 const DexMethod* method,
-                const IRInstruction* insn);
-  void check_fields();
-  void check_methods();
+                const IRInstruction* insn,
+                Findings& findings);
+  template <typename CheckFn>
+  void check_classes(const CheckFn& check);
+  bool has_illegal_access(const DexMethod* input_method, Findings& findings);
+  void check_fields(DexClass* cls, Findings& findings);
+  void check_methods(DexClass* cls, Findings& findings);
   bool referenced_field_is_deleted(DexFieldRef* field);
   bool referenced_method_is_deleted(DexMethodRef* method);
   bool check_field_accessibility(const DexMethod* method,
-                                 const DexField* res_field);
+                                 const DexField* res_field,
+                                 Findings& findings);
   bool check_method_accessibility(const DexMethod* method,
-                                  const DexMethod* res_called_method);
-  void check_type_opcode(const DexMethod* method, IRInstruction* insn);
-  void check_field_opcode(const DexMethod* method, IRInstruction* insn);
-  void check_method_opcode(const DexMethod* method, IRInstruction* insn);
-  void check_opcodes();
+                                  const DexMethod* res_called_method,
+                                  Findings& findings);
+  void check_type_opcode(const DexMethod* method,
+                         IRInstruction* insn,
+                         Findings& findings);
+  void check_field_opcode(const DexMethod* method,
+                          IRInstruction* insn,
+                          Findings& findings);
+  void check_method_opcode(const DexMethod* method,
+                           IRInstruction* insn,
+                           Findings& findings);
+  void check_opcodes(DexClass* cls, Findings& findings);
 };
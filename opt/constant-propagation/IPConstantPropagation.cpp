@@ -114,7 +114,12 @@ std::unique_ptr<FixpointIterator> PassImpl::analyze(
   // represented by Top.
   fp_iter->run({{CURRENT_PARTITION_LABEL, ArgumentDomain()}});
   auto non_true_virtuals = mog::get_non_true_virtuals(scope);
+  // The method summaries carry over from one iteration to the next, so only
+  // the methods whose arguments changed, or that read a field or a return
+  // value that changed, are analyzed again.
   for (size_t i = 0; i < m_config.max_heap_analysis_iterations; ++i) {
+    Timer t("Heap analysis iteration " + std::to_string(i));
+    auto stats_before = fp_iter->get_summary_stats();
     // Build an approximation of all the field values and method return values.
     auto wps = std::make_unique<WholeProgramState>(
         scope, *fp_iter, non_true_virtuals, m_config.field_blocklist);
@@ -126,7 +131,22 @@ std::unique_ptr<FixpointIterator> PassImpl::analyze(
     // the stack and registers.
     fp_iter->set_whole_program_state(std::move(wps));
     fp_iter->run({{CURRENT_PARTITION_LABEL, ArgumentDomain()}});
+    auto stats_after = fp_iter->get_summary_stats();
+    auto analyzed =
+        stats_after.analyzed_methods - stats_before.analyzed_methods;
+    auto reused = stats_after.reused_summaries - stats_before.reused_summaries;
+    TRACE(ICONSTP, 1,
+          "Heap analysis iteration %zu: analyzed %zu methods, reused %zu "
+          "summaries (%.1f%% analyzed), invalidated %zu summaries",
+          i, analyzed, reused,
+          analyzed + reused == 0 ? 0.0 : 100.0 * analyzed / (analyzed + reused),
+          stats_after.invalidated_summaries -
+              stats_before.invalidated_summaries);
+    ++m_stats.heap_analysis_iterations;
   }
+  auto summary_stats = fp_iter->get_summary_stats();
+  m_stats.analyzed_methods = summary_stats.analyzed_methods;
+  m_stats.reused_method_summaries = summary_stats.reused_summaries;
   compute_analysis_stats(fp_iter->get_whole_program_state());
 
   return fp_iter;
@@ -239,6 +259,9 @@ void PassImpl::run_pass(DexStoresVector& stores,
   mgr.incr_metric("callgraph_edges", m_stats.callgraph_edges);
   mgr.incr_metric("callgraph_nodes", m_stats.callgraph_nodes);
   mgr.incr_metric("callgraph_callsites", m_stats.callgraph_callsites);
+  mgr.incr_metric("heap_analysis_iterations", m_stats.heap_analysis_iterations);
+  mgr.incr_metric("analyzed_methods", m_stats.analyzed_methods);
+  mgr.incr_metric("reused_method_summaries", m_stats.reused_method_summaries);
 }
 
 static PassImpl s_pass;
@@ -93,6 +93,9 @@ class PassImpl : public Pass {
     size_t callgraph_nodes{0};
     size_t callgraph_edges{0};
     size_t callgraph_callsites{0};
+    size_t heap_analysis_iterations{0};
+    size_t analyzed_methods{0};
+    size_t reused_method_summaries{0};
   } m_stats;
   Transform::Stats m_transform_stats;
   Config m_config;
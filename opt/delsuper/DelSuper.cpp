@@ -17,6 +17,7 @@
 #include "IRInstruction.h"
 #include "PassManager.h"
 #include "ReachableClasses.h"
+#include "ReferenceIndex.h"
 #include "Show.h"
 #include "Trace.h"
 #include "Walkers.h"
@@ -290,20 +291,16 @@ class DelSuper {
       // remove the method declarations and the runtime semantics would be
       // unchanged -- but this ensures that we have no more references to
       // that method_id and can avoid emitting it in the dex output.
-      walk::opcodes(m_scope,
-                    [](DexMethod* meth) { return true; },
-                    [&](DexMethod* meth, IRInstruction* insn) {
-                      if (opcode::is_an_invoke(insn->opcode())) {
-                        auto method = insn->get_method()->as_def();
-                        if (!method) {
-                          return;
-                        }
-                        while (m_delmeths.count(method)) {
-                          method = m_delmeths.at(method);
-                        }
-                        insn->set_method(method);
-                      }
-                    });
+      reference_index::ReferenceIndex index(m_scope, reference_index::INVOKES);
+      for (const auto& pair : m_delmeths) {
+        auto method = pair.second;
+        while (m_delmeths.count(method)) {
+          method = m_delmeths.at(method);
+        }
+        for (const auto& site : index.invokes(pair.first)) {
+          site.insn->set_method(method);
+        }
+      }
       for (const auto& pair : m_delmeths) {
         auto meth = pair.first;
         auto clazz = type_class(meth->get_class());
@@ -0,0 +1,701 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "HotColdSplittingPass.h"
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "ConfigFiles.h"
+#include "ControlFlow.h"
+#include "DexClass.h"
+#include "DexStore.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "InterDexPass.h"
+#include "Liveness.h"
+#include "MethodUtil.h"
+#include "OutlinerTypeAnalysis.h"
+#include "PartialCandidates.h"
+#include "PassManager.h"
+#include "PluginRegistry.h"
+#include "ScopedCFG.h"
+#include "Show.h"
+#include "Trace.h"
+#include "TypeUtil.h"
+#include "Walkers.h"
+#include "WorkQueue.h"
+
+using Stats = HotColdSplittingPass::Stats;
+
+namespace {
+
+// Regions that need more arguments than this are too entangled with the hot
+// code to be worth a call.
+constexpr size_t MAX_ARGS = 16;
+
+// InstrumentPass doesn't trace blocks that only move values around, so we
+// know nothing about them; this mirrors its choice.
+bool was_instrumented(cfg::Block* block) {
+  if (block->num_opcodes() < 1) {
+    return false;
+  }
+  return std::any_of(
+      block->begin(), block->end(), [](const MethodItemEntry& mie) {
+        if (mie.type == MFLOW_TRY) {
+          return false;
+        }
+        if (mie.type != MFLOW_OPCODE) {
+          return true;
+        }
+        switch (mie.insn->opcode()) {
+        case OPCODE_MOVE:
+        case OPCODE_MOVE_WIDE:
+        case OPCODE_MOVE_OBJECT:
+        case OPCODE_MOVE_EXCEPTION:
+        case OPCODE_MOVE_RESULT:
+        case OPCODE_MOVE_RESULT_WIDE:
+        case OPCODE_MOVE_RESULT_OBJECT:
+          return false;
+        default:
+          return !opcode::is_an_internal(mie.insn->opcode());
+        }
+      });
+}
+
+bool can_move_opcode(IROpcode op) {
+  switch (op) {
+  case IOPCODE_LOAD_PARAM:
+  case IOPCODE_LOAD_PARAM_OBJECT:
+  case IOPCODE_LOAD_PARAM_WIDE:
+  case OPCODE_INVOKE_SUPER:
+  case OPCODE_MONITOR_ENTER:
+  case OPCODE_MONITOR_EXIT:
+  case OPCODE_MOVE_EXCEPTION:
+    return false;
+  default:
+    return true;
+  }
+}
+
+struct Region {
+  // The entry block comes first; the blocks form a tree below it.
+  std::vector<cfg::BlockId> blocks;
+  std::vector<reg_t> args;
+  std::vector<const DexType*> arg_types;
+  size_t size{0};
+};
+
+struct AnalysisData {
+  boost::optional<cfg::ScopedCFG> scoped_cfg = boost::none;
+  DexMethod* m{nullptr};
+  std::vector<Region> regions;
+
+  AnalysisData() = default;
+  AnalysisData(const AnalysisData&) = delete;
+  AnalysisData(AnalysisData&&) = default;
+  AnalysisData& operator=(const AnalysisData&) = delete;
+  AnalysisData& operator=(AnalysisData&&) = default;
+
+  size_t cold_size() const {
+    size_t size = 0;
+    for (const auto& region : regions) {
+      size += region.size;
+    }
+    return size;
+  }
+};
+
+// The instructions of the blocks of the non-editable CFG that never ran, or
+// none if the method changed since it was instrumented.
+boost::optional<std::unordered_set<const IRInstruction*>> get_cold_insns(
+    IRCode* code, const HotColdSplittingPass::BlockCoverage& coverage) {
+  code->build_cfg(/* editable */ false);
+  std::unordered_set<const IRInstruction*> cold_insns;
+  const auto& blocks = code->cfg().blocks();
+  bool matches = blocks.size() == coverage.num_blocks;
+  if (matches) {
+    for (auto* block : blocks) {
+      if (coverage.executed_blocks.count(block->id()) ||
+          !was_instrumented(block)) {
+        continue;
+      }
+      for (auto& mie : InstructionIterable(block)) {
+        cold_insns.insert(mie.insn);
+      }
+    }
+  }
+  code->clear_cfg();
+  if (!matches) {
+    return boost::none;
+  }
+  return cold_insns;
+}
+
+// Collects the tree of cold blocks below `entry`, or nothing if the code
+// there can't be moved, or flows back into hot code.
+std::vector<cfg::Block*> find_region(
+    cfg::Block* entry, const std::unordered_set<cfg::Block*>& cold_blocks) {
+  if (entry->starts_with_move_result()) {
+    return {};
+  }
+  std::vector<cfg::Block*> blocks{entry};
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    auto* block = blocks[i];
+    for (auto& mie : InstructionIterable(block)) {
+      if (!can_move_opcode(mie.insn->opcode())) {
+        return {};
+      }
+    }
+    for (auto* e : block->succs()) {
+      if (e->type() == cfg::EDGE_GHOST) {
+        continue;
+      }
+      auto* target = e->target();
+      if (e->type() == cfg::EDGE_THROW || target == entry ||
+          !cold_blocks.count(target) || target->preds().size() != 1) {
+        return {};
+      }
+      blocks.push_back(target);
+    }
+  }
+  return blocks;
+}
+
+// Whether the region calls a constructor on an object that it didn't create
+// itself; such objects can't be passed to another method.
+bool initializes_live_in_object(cfg::Block* block,
+                                std::unordered_set<reg_t> created) {
+  IRInstruction* last = nullptr;
+  for (auto& mie : InstructionIterable(block)) {
+    auto* insn = mie.insn;
+    if (insn->opcode() == OPCODE_INVOKE_DIRECT &&
+        method::is_init(insn->get_method()) && !created.count(insn->src(0))) {
+      return true;
+    }
+    if (insn->has_dest()) {
+      if (last != nullptr && last->opcode() == OPCODE_NEW_INSTANCE &&
+          opcode::is_a_move_result_pseudo(insn->opcode())) {
+        created.insert(insn->dest());
+      } else {
+        created.erase(insn->dest());
+      }
+    }
+    last = insn;
+  }
+  for (auto* e : block->succs()) {
+    if (e->type() != cfg::EDGE_GHOST &&
+        initializes_live_in_object(e->target(), created)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void build_partial_candidate_node(cfg::Block* block,
+                                  outliner_impl::PartialCandidateNode* node) {
+  for (auto& mie : InstructionIterable(block)) {
+    node->insns.push_back(mie.insn);
+  }
+  for (auto* e : block->succs()) {
+    if (e->type() == cfg::EDGE_GHOST) {
+      continue;
+    }
+    auto succ = std::make_shared<outliner_impl::PartialCandidateNode>();
+    build_partial_candidate_node(e->target(), succ.get());
+    node->succs.emplace_back(e, std::move(succ));
+  }
+}
+
+AnalysisData analyze(DexMethod* m,
+                     const HotColdSplittingPass::BlockCoverage& coverage,
+                     size_t min_region_size,
+                     Stats* stats) {
+  AnalysisData data;
+  data.m = m;
+  auto* code = m->get_code();
+  if (code == nullptr || coverage.executed_blocks.empty()) {
+    return data;
+  }
+  ++stats->hot_methods;
+  if (method::is_any_init(m)) {
+    ++stats->constructor;
+    return data;
+  }
+  auto* cls = type_class(m->get_class());
+  if (cls == nullptr || is_interface(cls)) {
+    return data;
+  }
+
+  auto cold_insns = get_cold_insns(code, coverage);
+  if (!cold_insns) {
+    ++stats->block_count_mismatch;
+    return data;
+  }
+  if (cold_insns->empty()) {
+    return data;
+  }
+
+  data.scoped_cfg = cfg::ScopedCFG(code);
+  auto& cfg = **data.scoped_cfg;
+
+  std::unordered_set<cfg::Block*> cold_blocks;
+  for (auto* block : cfg.blocks()) {
+    auto ii = InstructionIterable(block);
+    if (block->num_opcodes() > 0 &&
+        std::all_of(ii.begin(), ii.end(), [&](const MethodItemEntry& mie) {
+          return cold_insns->count(mie.insn) != 0;
+        })) {
+      cold_blocks.insert(block);
+    }
+  }
+
+  cfg.calculate_exit_block();
+  LivenessFixpointIterator liveness_iter(cfg);
+  liveness_iter.run(LivenessDomain());
+  outliner_impl::OutlinerTypeAnalysis type_analysis(m);
+
+  for (auto* entry : cfg.blocks()) {
+    if (entry == cfg.entry_block() || !cold_blocks.count(entry)) {
+      continue;
+    }
+    const auto& preds = entry->preds();
+    if (std::none_of(preds.begin(), preds.end(), [&](const cfg::Edge* e) {
+          return cold_blocks.count(e->src()) == 0;
+        })) {
+      continue;
+    }
+    auto blocks = find_region(entry, cold_blocks);
+    if (blocks.empty() || initializes_live_in_object(entry, {})) {
+      continue;
+    }
+
+    Region region;
+    for (auto* block : blocks) {
+      region.blocks.push_back(block->id());
+      region.size += block->sum_opcode_sizes();
+    }
+    if (region.size < min_region_size) {
+      continue;
+    }
+
+    const auto& live_in = liveness_iter.get_live_in_vars_at(entry);
+    region.args.assign(live_in.elements().begin(), live_in.elements().end());
+    if (region.args.size() > MAX_ARGS) {
+      continue;
+    }
+    std::sort(region.args.begin(), region.args.end());
+
+    outliner_impl::PartialCandidate pc;
+    build_partial_candidate_node(entry, &pc.root);
+    for (auto reg : region.args) {
+      auto* type = type_analysis.get_type_demand(pc, reg, boost::none, nullptr);
+      if (type == nullptr) {
+        break;
+      }
+      region.arg_types.push_back(type);
+    }
+    if (region.arg_types.size() != region.args.size()) {
+      ++stats->untyped_regions;
+      continue;
+    }
+
+    data.regions.push_back(std::move(region));
+  }
+
+  auto* exit_block = cfg.exit_block();
+  if (exit_block != nullptr &&
+      cfg.get_pred_edge_of_type(exit_block, cfg::EDGE_GHOST) != nullptr) {
+    cfg.remove_block(exit_block);
+  }
+  cfg.set_exit_block(nullptr);
+
+  if (data.regions.empty()) {
+    data.scoped_cfg = boost::none;
+    return data;
+  }
+  // Biggest first, in case we run out of method refs.
+  std::stable_sort(data.regions.begin(), data.regions.end(),
+                   [](const Region& lhs, const Region& rhs) {
+                     return lhs.size > rhs.size;
+                   });
+  return data;
+}
+
+// A copy of the region as a static method of the same class, which loads the
+// live-in registers as its parameters.
+DexMethod* create_cold_method(DexMethod* m,
+                              IRCode* code,
+                              const Region& region) {
+  auto cold_code = std::make_unique<IRCode>(*code);
+  auto& cfg = cold_code->cfg();
+
+  std::unordered_set<cfg::BlockId> region_ids(region.blocks.begin(),
+                                              region.blocks.end());
+  cfg::Block* region_entry = nullptr;
+  std::vector<cfg::Block*> others;
+  for (auto* block : cfg.blocks()) {
+    if (block->id() == region.blocks.front()) {
+      region_entry = block;
+    } else if (!region_ids.count(block->id())) {
+      others.push_back(block);
+    }
+  }
+  always_assert(region_entry != nullptr);
+
+  auto* entry = cfg.create_block();
+  std::vector<IRInstruction*> load_params;
+  for (size_t i = 0; i < region.args.size(); ++i) {
+    auto* insn = new IRInstruction(opcode::load_opcode(region.arg_types[i]));
+    insn->set_dest(region.args[i]);
+    load_params.push_back(insn);
+  }
+  cfg.push_back(entry, load_params);
+  cfg.add_edge(entry, region_entry, cfg::EDGE_GOTO);
+  cfg.set_entry_block(entry);
+  for (auto* block : others) {
+    cfg.remove_block(block);
+  }
+  cfg.set_exit_block(nullptr);
+
+  // The locals of the hot method don't describe the new one.
+  for (auto* block : cfg.blocks()) {
+    for (auto it = block->begin(); it != block->end();) {
+      if (it->type == MFLOW_DEBUG) {
+        block->remove_mie(it++);
+      } else {
+        ++it;
+      }
+    }
+  }
+  if (cold_code->get_debug_item() != nullptr) {
+    cold_code->set_debug_item(std::make_unique<DexDebugItem>());
+  }
+  cold_code->clear_cfg();
+
+  std::deque<DexType*> arg_types;
+  for (auto* type : region.arg_types) {
+    arg_types.push_back(const_cast<DexType*>(type));
+  }
+  auto* proto =
+      DexProto::make_proto(m->get_proto()->get_rtype(),
+                           DexTypeList::make_type_list(std::move(arg_types)));
+  auto* name = DexMethod::get_unique_name(
+      m->get_class(), DexString::make_string(m->str() + "$cold"), proto);
+  auto* cold_method =
+      DexMethod::make_method(m->get_class(), name, proto)
+          ->make_concrete(ACC_PRIVATE | ACC_STATIC, std::move(cold_code),
+                          /* is_virtual */ false);
+  cold_method->set_deobfuscated_name(show_deobfuscated(cold_method));
+  cold_method->rstate.set_dont_inline(); // Don't undo our work.
+  return cold_method;
+}
+
+// Makes the entry block of the region call the cold method and return its
+// result, which leaves the rest of the region unreachable. The positions of
+// the entry block stay, so that the call keeps its line.
+void call_cold_method(cfg::ControlFlowGraph& cfg,
+                      cfg::Block* entry,
+                      DexMethod* cold_method,
+                      const std::vector<reg_t>& args) {
+  cfg.delete_succ_edges(entry);
+  for (auto it = entry->begin(); it != entry->end();) {
+    if (it->type == MFLOW_POSITION) {
+      ++it;
+    } else {
+      entry->remove_mie(it++);
+    }
+  }
+
+  auto* invoke = new IRInstruction(OPCODE_INVOKE_STATIC);
+  invoke->set_method(cold_method);
+  invoke->set_srcs_size(args.size());
+  for (size_t i = 0; i < args.size(); ++i) {
+    invoke->set_src(i, args[i]);
+  }
+  std::vector<IRInstruction*> insns{invoke};
+  auto* rtype = cold_method->get_proto()->get_rtype();
+  if (type::is_void(rtype)) {
+    insns.push_back(new IRInstruction(OPCODE_RETURN_VOID));
+  } else {
+    reg_t reg = type::is_wide_type(rtype) ? cfg.allocate_wide_temp()
+                                          : cfg.allocate_temp();
+    auto* move_result =
+        new IRInstruction(opcode::move_result_for_invoke(cold_method));
+    move_result->set_dest(reg);
+    auto* ret = new IRInstruction(opcode::return_opcode(rtype));
+    ret->set_src(0, reg);
+    insns.push_back(move_result);
+    insns.push_back(ret);
+  }
+  cfg.push_back(entry, insns);
+}
+
+// Returns the new methods; they still have to be added to their class.
+std::vector<DexMethod*> run_split(AnalysisData& data, Stats* stats) {
+  auto* m = data.m;
+  auto* code = m->get_code();
+  auto& cfg = **data.scoped_cfg;
+  size_t size_before = cfg.sum_opcode_sizes();
+
+  std::unordered_map<cfg::BlockId, cfg::Block*> blocks;
+  for (auto* block : cfg.blocks()) {
+    blocks.emplace(block->id(), block);
+  }
+  std::vector<DexMethod*> cold_methods;
+  for (const auto& region : data.regions) {
+    auto* cold_method = create_cold_method(m, code, region);
+    call_cold_method(cfg, blocks.at(region.blocks.front()), cold_method,
+                     region.args);
+    cold_methods.push_back(cold_method);
+  }
+  cfg.remove_unreachable_blocks();
+  size_t size_after = cfg.sum_opcode_sizes();
+  data.scoped_cfg = boost::none;
+
+  TRACE(HOTCOLD, 3, "Moved %zu cold regions out of %s, %zu -> %zu code units",
+        cold_methods.size(), SHOW(m), size_before, size_after);
+  ++stats->split_methods;
+  stats->cold_methods += cold_methods.size();
+  stats->hot_code_units_before += size_before;
+  stats->hot_code_units_after += size_after;
+  return cold_methods;
+}
+
+class HotColdSplittingInterDexPlugin : public interdex::InterDexPassPlugin {
+ public:
+  explicit HotColdSplittingInterDexPlugin(size_t max_cold_methods)
+      : m_max_cold_methods(max_cold_methods) {}
+
+  size_t reserve_mrefs() override { return m_max_cold_methods; }
+
+ private:
+  size_t m_max_cold_methods;
+};
+
+} // namespace
+
+Stats& Stats::operator+=(const Stats& rhs) {
+  hot_methods += rhs.hot_methods;
+  block_count_mismatch += rhs.block_count_mismatch;
+  constructor += rhs.constructor;
+  untyped_regions += rhs.untyped_regions;
+  no_slots += rhs.no_slots;
+  split_methods += rhs.split_methods;
+  cold_methods += rhs.cold_methods;
+  hot_code_units_before += rhs.hot_code_units_before;
+  hot_code_units_after += rhs.hot_code_units_after;
+  return *this;
+}
+
+HotColdSplittingPass::BlockCoverageMap
+HotColdSplittingPass::read_block_coverage(std::istream& in,
+                                          size_t* unknown_methods) {
+  BlockCoverageMap coverage;
+  std::string line;
+  size_t line_no = 0;
+  while (std::getline(in, line)) {
+    ++line_no;
+    if (line.empty()) {
+      continue;
+    }
+    auto name_end = line.find(',');
+    auto num_blocks_end = name_end == std::string::npos
+                              ? std::string::npos
+                              : line.find(',', name_end + 1);
+    always_assert_log(num_blocks_end != std::string::npos,
+                      "Malformed block coverage at line %zu: %s", line_no,
+                      line.c_str());
+    auto* ref = DexMethod::get_method(line.substr(0, name_end));
+    if (ref == nullptr || !ref->is_def()) {
+      ++*unknown_methods;
+      continue;
+    }
+    auto& method_coverage = coverage[ref->as_def()];
+    method_coverage.num_blocks = std::stoul(
+        line.substr(name_end + 1, num_blocks_end - name_end - 1));
+    std::istringstream ids(line.substr(num_blocks_end + 1));
+    cfg::BlockId id;
+    while (ids >> id) {
+      method_coverage.executed_blocks.insert(id);
+    }
+  }
+  return coverage;
+}
+
+Stats HotColdSplittingPass::run(DexMethod* m,
+                                const BlockCoverage& coverage,
+                                size_t min_region_size) {
+  Stats stats;
+  auto data = analyze(m, coverage, min_region_size, &stats);
+  if (data.regions.empty()) {
+    return stats;
+  }
+  for (auto* cold_method : run_split(data, &stats)) {
+    type_class(m->get_class())->add_method(cold_method);
+  }
+  return stats;
+}
+
+void HotColdSplittingPass::bind_config() {
+  bind("block_coverage_file", "", m_block_coverage_file,
+       "Basic block coverage of an instrumented build");
+  bind("min_region_size", 16u, m_min_region_size,
+       "Minimum code units of a cold region worth a call");
+  bind("max_cold_methods", 0u, m_max_cold_methods,
+       "Maximum number of cold methods per dex");
+
+  after_configuration([this] {
+    interdex::InterDexRegistry* registry =
+        static_cast<interdex::InterDexRegistry*>(
+            PluginRegistry::get().pass_registry(interdex::INTERDEX_PASS_NAME));
+    std::function<interdex::InterDexPassPlugin*()> fn =
+        [this]() -> interdex::InterDexPassPlugin* {
+      return new HotColdSplittingInterDexPlugin(m_max_cold_methods);
+    };
+    registry->register_plugin("HOT_COLD_SPLITTING_PLUGIN", std::move(fn));
+  });
+}
+
+void HotColdSplittingPass::run_pass(DexStoresVector& stores,
+                                    ConfigFiles& /* conf */,
+                                    PassManager& mgr) {
+  // The block ids only mean something in the uninstrumented build.
+  if (mgr.get_redex_options().instrument_pass_enabled) {
+    return;
+  }
+  if (m_max_cold_methods == 0) {
+    mgr.set_metric("max_cold_methods_zero", 1);
+    return;
+  }
+  if (m_block_coverage_file.empty()) {
+    mgr.set_metric("no_block_coverage_file", 1);
+    return;
+  }
+
+  std::ifstream in(m_block_coverage_file);
+  always_assert_log(in, "Cannot open block coverage file %s",
+                    m_block_coverage_file.c_str());
+  size_t unknown_methods = 0;
+  auto coverage = read_block_coverage(in, &unknown_methods);
+  mgr.set_metric("unknown_methods", unknown_methods);
+
+  // 1) Find the cold regions of all hot methods.
+
+  std::vector<AnalysisData> candidates;
+  std::mutex candidates_mutex;
+  const auto& scope = build_class_scope(stores);
+  auto stats = walk::parallel::methods<Stats>(scope, [&](DexMethod* m) {
+    auto it = coverage.find(m);
+    if (it == coverage.end()) {
+      return Stats{};
+    }
+    Stats ret;
+    auto data = analyze(m, it->second, m_min_region_size, &ret);
+    if (data.regions.empty()) {
+      return ret;
+    }
+    std::lock_guard<std::mutex> lock(candidates_mutex);
+    candidates.emplace_back(std::move(data));
+    return ret;
+  });
+
+  // 2) Pick the biggest ones that fit into the method refs reserved per dex,
+  // grouped by class, since splitting names new methods after their class.
+
+  std::unordered_map<const DexType*, std::vector<AnalysisData*>> by_type;
+  for (auto& data : candidates) {
+    by_type[data.m->get_class()].push_back(&data);
+  }
+  std::vector<std::vector<AnalysisData*>> work;
+  for (const auto& store : stores) {
+    for (const auto& dex : store.get_dexen()) {
+      std::vector<AnalysisData*> dex_candidates;
+      for (const auto* cls : dex) {
+        auto it = by_type.find(cls->get_type());
+        if (it != by_type.end()) {
+          std::sort(it->second.begin(), it->second.end(),
+                    [](const AnalysisData* lhs, const AnalysisData* rhs) {
+                      return compare_dexmethods(lhs->m, rhs->m);
+                    });
+          dex_candidates.insert(dex_candidates.end(), it->second.begin(),
+                                it->second.end());
+        }
+      }
+      std::stable_sort(dex_candidates.begin(), dex_candidates.end(),
+                       [](const AnalysisData* lhs, const AnalysisData* rhs) {
+                         return lhs->cold_size() > rhs->cold_size();
+                       });
+      size_t left = m_max_cold_methods;
+      for (auto* data : dex_candidates) {
+        if (left < data->regions.size()) {
+          stats.no_slots += data->regions.size() - left;
+          data->regions.erase(data->regions.begin() + left,
+                              data->regions.end());
+        }
+        left -= data->regions.size();
+      }
+      for (const auto* cls : dex) {
+        auto it = by_type.find(cls->get_type());
+        if (it == by_type.end()) {
+          continue;
+        }
+        std::vector<AnalysisData*> group;
+        for (auto* data : it->second) {
+          if (!data->regions.empty()) {
+            group.push_back(data);
+          }
+        }
+        if (!group.empty()) {
+          work.push_back(std::move(group));
+        }
+      }
+    }
+  }
+
+  // 3) Split, one class per thread.
+
+  std::vector<std::vector<DexMethod*>> new_methods(work.size());
+  std::vector<Stats> work_stats(work.size());
+  auto wq = workqueue_foreach<size_t>([&](size_t idx) {
+    for (auto* data : work[idx]) {
+      auto cold_methods = run_split(*data, &work_stats[idx]);
+      new_methods[idx].insert(new_methods[idx].end(), cold_methods.begin(),
+                              cold_methods.end());
+    }
+  });
+  for (size_t idx = 0; idx < work.size(); ++idx) {
+    wq.add_item(idx);
+  }
+  wq.run_all();
+  for (size_t idx = 0; idx < work.size(); ++idx) {
+    for (auto* cold_method : new_methods[idx]) {
+      type_class(cold_method->get_class())->add_method(cold_method);
+    }
+    stats += work_stats[idx];
+  }
+
+  mgr.set_metric("hot_methods", stats.hot_methods);
+  mgr.set_metric("block_count_mismatch", stats.block_count_mismatch);
+  mgr.set_metric("constructor", stats.constructor);
+  mgr.set_metric("untyped_regions", stats.untyped_regions);
+  mgr.set_metric("no_slots", stats.no_slots);
+  mgr.set_metric("split_methods", stats.split_methods);
+  mgr.set_metric("cold_methods", stats.cold_methods);
+  mgr.set_metric("hot_code_units_before", stats.hot_code_units_before);
+  mgr.set_metric("hot_code_units_after", stats.hot_code_units_after);
+}
+
+static HotColdSplittingPass s_pass;
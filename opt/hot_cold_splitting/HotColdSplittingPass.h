@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "ControlFlow.h"
+#include "Pass.h"
+
+class DexMethod;
+
+/*
+ * Moves the code that never ran out of hot methods, so that the hot methods
+ * get smaller and pack better into the pages that are touched at startup.
+ *
+ * The input is the basic block coverage of an instrumented build, see
+ * InstrumentPass' basic block tracing. Every line of the coverage file names
+ * a method, the number of blocks it had when it was instrumented, and the
+ * ids of the blocks that ran:
+ *
+ *   LFoo;.bar:(I)V,12,0 1 2 5 7
+ *
+ * Block ids are those of the non-editable CFG, so this pass has to run at the
+ * place in the pipeline where InstrumentPass ran in the instrumented build.
+ * Methods whose number of blocks changed since then are left alone.
+ *
+ * A cold region is a tree of blocks that never ran, with a single entry block
+ * that is reached from hot code, and that never flows back into hot code,
+ * i.e. it ends in returns and throws. It is moved into a new static method
+ * that takes the registers live into the region as arguments, typed with the
+ * outliner's type analysis; the hot method calls it and returns its result.
+ * Regions inside of try blocks, and regions that use monitors, invoke-super,
+ * or objects whose constructor hasn't been called yet, stay where they are.
+ */
+class HotColdSplittingPass : public Pass {
+ public:
+  struct BlockCoverage {
+    size_t num_blocks{0};
+    std::unordered_set<cfg::BlockId> executed_blocks;
+  };
+
+  using BlockCoverageMap = std::unordered_map<DexMethod*, BlockCoverage>;
+
+  struct Stats {
+    uint32_t hot_methods{0};
+    uint32_t block_count_mismatch{0};
+    uint32_t constructor{0};
+    uint32_t untyped_regions{0};
+    uint32_t no_slots{0};
+    uint32_t split_methods{0};
+    uint32_t cold_methods{0};
+    // Code units of the methods that got split, before and after.
+    size_t hot_code_units_before{0};
+    size_t hot_code_units_after{0};
+
+    Stats& operator+=(const Stats& rhs);
+  };
+
+  HotColdSplittingPass() : Pass("HotColdSplittingPass") {}
+
+  void bind_config() override;
+  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+
+  // Reads a coverage file in the format described above. Lines naming
+  // methods that don't exist are counted in `unknown_methods`.
+  static BlockCoverageMap read_block_coverage(std::istream& in,
+                                              size_t* unknown_methods);
+
+  // Moves all the cold regions of at least `min_region_size` code units out
+  // of `m`, and adds the new methods to its class.
+  static Stats run(DexMethod* m,
+                   const BlockCoverage& coverage,
+                   size_t min_region_size);
+
+ private:
+  std::string m_block_coverage_file;
+  uint32_t m_min_region_size = 0;
+  uint32_t m_max_cold_methods = 0;
+};
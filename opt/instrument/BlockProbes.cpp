@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "BlockProbes.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Dominators.h"
+#include "GraphUtil.h"
+#include "MonotonicFixpointIterator.h"
+
+namespace {
+
+using PostDomGraph =
+    sparta::BackwardsFixpointIterationAdaptor<cfg::GraphInterface>;
+
+// Numbers the post-dominator tree in depth-first order, so that whether a
+// block post-dominates another is a constant time check.
+class PostDominatorTree {
+ public:
+  explicit PostDominatorTree(const cfg::ControlFlowGraph& cfg) {
+    auto nodes = graph::postorder_sort<PostDomGraph>(cfg);
+    dominators::SimpleFastDominators<PostDomGraph> pdom(cfg);
+    std::unordered_map<cfg::Block*, std::vector<cfg::Block*>> children;
+    auto exit = cfg.exit_block();
+    for (auto block : nodes) {
+      if (block != exit) {
+        children[pdom.get_idom(block)].push_back(block);
+      }
+    }
+
+    size_t counter = 0;
+    std::vector<std::pair<cfg::Block*, bool>> stack{{exit, false}};
+    while (!stack.empty()) {
+      auto block = stack.back().first;
+      auto visited = stack.back().second;
+      if (visited) {
+        stack.pop_back();
+        m_post[block] = counter++;
+        continue;
+      }
+      stack.back().second = true;
+      m_pre[block] = counter++;
+      auto it = children.find(block);
+      if (it != children.end()) {
+        for (auto child : it->second) {
+          stack.emplace_back(child, false);
+        }
+      }
+    }
+  }
+
+  bool contains(cfg::Block* block) const { return m_pre.count(block); }
+
+  // Whether every path from `block` to the exit goes through `dominator`.
+  bool post_dominates(cfg::Block* dominator, cfg::Block* block) const {
+    return m_pre.at(dominator) <= m_pre.at(block) &&
+           m_post.at(block) <= m_post.at(dominator);
+  }
+
+ private:
+  std::unordered_map<cfg::Block*, size_t> m_pre;
+  std::unordered_map<cfg::Block*, size_t> m_post;
+};
+
+} // namespace
+
+namespace instrument {
+
+BlockProbes place_block_probes(
+    cfg::ControlFlowGraph& cfg,
+    const std::vector<cfg::Block*>& blocks,
+    const std::function<bool(cfg::Block*)>& can_probe) {
+  cfg.calculate_exit_block();
+  auto reachable = graph::postorder_sort<cfg::GraphInterface>(cfg);
+  std::unordered_set<cfg::Block*> reachable_set(reachable.begin(),
+                                                reachable.end());
+  dominators::SimpleFastDominators<cfg::GraphInterface> dom(cfg);
+  PostDominatorTree pdom(cfg);
+
+  // Walk up the dominator tree for as long as the block post-dominates its
+  // ancestors; the last of them is the head of its chain.
+  auto entry = cfg.entry_block();
+  std::unordered_map<cfg::Block*, cfg::Block*> heads;
+  for (auto block : blocks) {
+    auto head = block;
+    if (reachable_set.count(block) && pdom.contains(block)) {
+      while (head != entry) {
+        auto idom = dom.get_idom(head);
+        if (!pdom.contains(idom) || !pdom.post_dominates(block, idom)) {
+          break;
+        }
+        head = idom;
+      }
+    }
+    heads.emplace(block, head);
+  }
+
+  // A block shares the probe of the nearest block above it in its chain that
+  // holds one, so that the probe runs whenever the block does. Dominators come
+  // first in reverse postorder, so that block has been handled already.
+  std::unordered_set<cfg::Block*> block_set(blocks.begin(), blocks.end());
+  std::unordered_map<cfg::Block*, cfg::Block*> holder_of;
+  auto find_holder = [&](cfg::Block* block) -> cfg::Block* {
+    auto head = heads.at(block);
+    for (auto b = block;; b = dom.get_idom(b)) {
+      auto it = holder_of.find(b);
+      if (it != holder_of.end() && it->second == b) {
+        return b;
+      }
+      if (b == head) {
+        return nullptr;
+      }
+    }
+  };
+  for (auto it = reachable.rbegin(); it != reachable.rend(); ++it) {
+    auto block = *it;
+    if (!block_set.count(block)) {
+      continue;
+    }
+    auto holder = find_holder(block);
+    if (holder == nullptr && can_probe(block)) {
+      holder = block;
+    }
+    if (holder == nullptr && block != entry) {
+      // Nothing above the block in its chain can hold a probe, and neither can
+      // the block. Use the probe of its immediate dominator, which ran
+      // whenever the block did.
+      auto idom_it = holder_of.find(dom.get_idom(block));
+      if (idom_it != holder_of.end()) {
+        holder = idom_it->second;
+      }
+    }
+    holder_of.emplace(block, holder);
+  }
+  for (auto block : blocks) {
+    if (!reachable_set.count(block)) {
+      holder_of.emplace(block, can_probe(block) ? block : nullptr);
+    }
+  }
+
+  BlockProbes result;
+  std::unordered_map<cfg::Block*, int> probe_of_holder;
+  for (auto block : blocks) {
+    if (holder_of.at(block) == block) {
+      probe_of_holder.emplace(block, result.probe_blocks.size());
+      result.probe_blocks.push_back(block);
+    }
+  }
+
+  cfg::BlockId max_id = 0;
+  for (auto block : blocks) {
+    max_id = std::max(max_id, block->id());
+  }
+  result.probe_of_block.resize(blocks.empty() ? 0 : max_id + 1, -1);
+  for (auto block : blocks) {
+    auto holder = holder_of.at(block);
+    if (holder != nullptr) {
+      result.probe_of_block[block->id()] = probe_of_holder.at(holder);
+    }
+  }
+  return result;
+}
+
+} // namespace instrument
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "ControlFlow.h"
+
+namespace instrument {
+
+struct BlockProbes {
+  // The probe that tells whether a block ran, indexed by block id; -1 if no
+  // probe covers the block.
+  std::vector<int> probe_of_block;
+  // The block each probe goes into, indexed by probe.
+  std::vector<cfg::Block*> probe_blocks;
+};
+
+/*
+ * Places the fewest probes that still tell which of the given blocks ran.
+ *
+ * Two blocks X and Y run together when X dominates Y and Y post-dominates X:
+ * every execution of Y went through X, and every execution of X, that doesn't
+ * end in an uncaught exception, goes on to Y. Such blocks form chains in the
+ * dominator tree, and one probe at the head of the chain covers all of them.
+ * A block is only ever covered by a probe in one of its dominators, so a block
+ * that is left by an uncaught exception can be over-reported, but never
+ * missed. If the head can't hold a probe, e.g. because it only has
+ * move-results, it takes the probe of its immediate dominator, and the first
+ * block below it in the chain that can hold one gets a probe of its own.
+ *
+ * This calculates the exit block of the CFG.
+ */
+BlockProbes place_block_probes(
+    cfg::ControlFlowGraph& cfg,
+    const std::vector<cfg::Block*>& blocks,
+    const std::function<bool(cfg::Block*)>& can_probe);
+
+} // namespace instrument
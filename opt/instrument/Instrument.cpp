@@ -7,6 +7,7 @@
 
 #include "Instrument.h"
 
+#include "BlockProbes.h"
 #include "DexClass.h"
 #include "DexUtil.h"
 #include "InterDexPass.h"
@@ -21,6 +22,8 @@
 #include <cmath>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <numeric>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -40,8 +43,9 @@ constexpr bool instr_debug = false;
 
 class InstrumentInterDexPlugin : public interdex::InterDexPassPlugin {
  public:
-  explicit InstrumentInterDexPlugin(size_t max_analysis_methods)
-      : m_max_analysis_methods(max_analysis_methods) {}
+  InstrumentInterDexPlugin(size_t max_analysis_methods, size_t max_fields)
+      : m_max_analysis_methods(max_analysis_methods),
+        m_max_fields(max_fields) {}
 
   void configure(const Scope& scope, ConfigFiles& cfg) override{};
 
@@ -56,8 +60,8 @@ class InstrumentInterDexPlugin : public interdex::InterDexPassPlugin {
                    bool should_not_relocate_methods_of_class) override {}
 
   size_t reserve_frefs() override {
-    // We may introduce a new field
-    return 1;
+    // We may introduce new fields, e.g. the bitmap of every shard.
+    return m_max_fields;
   }
 
   size_t reserve_trefs() override {
@@ -80,6 +84,7 @@ class InstrumentInterDexPlugin : public interdex::InterDexPassPlugin {
 
  private:
   const size_t m_max_analysis_methods;
+  const size_t m_max_fields;
 };
 
 // For example, say that "Lcom/facebook/debug/" is in the set. We match either
@@ -1061,6 +1066,22 @@ void do_simple_method_tracing(DexClass* analysis_cls,
   pm.incr_metric("Excluded", excluded);
 }
 
+// The classes before the first dex end marker, as prefixes for is_included.
+std::unordered_set<std::string> get_cold_start_classes(ConfigFiles& cfg) {
+  auto interdex_list = cfg.get_coldstart_classes();
+  std::unordered_set<std::string> cold_start_classes;
+  std::string dex_end_marker0("LDexEndMarker0;");
+  for (auto class_string : interdex_list) {
+    if (class_string == dex_end_marker0) {
+      break;
+    }
+    class_string.back() = '/';
+    cold_start_classes.insert(class_string);
+  }
+  TRACE(INSTRUMENT, 7, "Number of classes: %d", cold_start_classes.size());
+  return cold_start_classes;
+}
+
 // A simple bit-vector basic block instrumentation algorithm
 //
 //  Example) Original CFG
@@ -1100,17 +1121,7 @@ void do_basic_block_tracing(DexClass* analysis_cls,
       method_id_name_map;
   auto scope = build_class_scope(stores);
 
-  auto interdex_list = cfg.get_coldstart_classes();
-  std::unordered_set<std::string> cold_start_classes;
-  std::string dex_end_marker0("LDexEndMarker0;");
-  for (auto class_string : interdex_list) {
-    if (class_string == dex_end_marker0) {
-      break;
-    }
-    class_string.back() = '/';
-    cold_start_classes.insert(class_string);
-  }
-  TRACE(INSTRUMENT, 7, "Number of classes: %d", cold_start_classes.size());
+  const auto& cold_start_classes = get_cold_start_classes(cfg);
 
   std::map<size_t /* num_vectors */, int /* count */> bb_vector_stat;
   walk::code(scope, [&](DexMethod* method, IRCode& code) {
@@ -1163,6 +1174,302 @@ void do_basic_block_tracing(DexClass* analysis_cls,
         (all_method_inst - 1), all_bb_inst, all_methods, all_bb_nums);
 }
 
+// Instead of collecting the bits of the blocks in registers and handing them
+// to the analysis class on every method exit, the "basic_block_bitmap"
+// strategy sets them right away in static int[] arrays of the analysis class,
+// sBlockBitmap1..N, which hold one bit per probe. Blocks that always run
+// together share a probe, see place_block_probes.
+//
+//   SGET_OBJECT Lcom/foo/Analysis;.sBlockBitmap1:[I   <== Method entry
+//   IOPCODE_MOVE_RESULT_PSEUDO_OBJECT v0
+//   ...
+//   CONST v1, word                                    <== Every probe
+//   AGET v0, v1
+//   IOPCODE_MOVE_RESULT_PSEUDO v2
+//   OR_INT_LIT16 v2, v2, 1 << bit                     (bits 15 to 31 need a
+//   APUT v2, v0, v1                                    CONST and an OR_INT)
+//
+// Methods are spread over the shards round robin, and the bits of every method
+// start at a word boundary.
+constexpr size_t kBitsPerWord = 32;
+
+struct BitmapMethod {
+  std::string name;
+  size_t num_blocks;
+  size_t shard;
+  size_t first_bit;
+  size_t num_probes;
+  std::vector<int> probe_of_block;
+};
+
+std::vector<IRInstruction*> make_probe(size_t bit,
+                                       reg_t bitmap_reg,
+                                       reg_t index_reg,
+                                       reg_t bits_reg,
+                                       reg_t mask_reg) {
+  const int32_t mask = static_cast<int32_t>(1U << (bit % kBitsPerWord));
+  std::vector<IRInstruction*> insns{
+      (new IRInstruction(OPCODE_CONST))
+          ->set_literal(bit / kBitsPerWord)
+          ->set_dest(index_reg),
+      (new IRInstruction(OPCODE_AGET))
+          ->set_srcs_size(2)
+          ->set_src(0, bitmap_reg)
+          ->set_src(1, index_reg),
+      (new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO))->set_dest(bits_reg)};
+  if (mask <= std::numeric_limits<int16_t>::max()) {
+    insns.push_back((new IRInstruction(OPCODE_OR_INT_LIT16))
+                        ->set_literal(mask)
+                        ->set_src(0, bits_reg)
+                        ->set_dest(bits_reg));
+  } else {
+    insns.push_back(
+        (new IRInstruction(OPCODE_CONST))->set_literal(mask)->set_dest(
+            mask_reg));
+    insns.push_back((new IRInstruction(OPCODE_OR_INT))
+                        ->set_srcs_size(2)
+                        ->set_src(0, bits_reg)
+                        ->set_src(1, mask_reg)
+                        ->set_dest(bits_reg));
+  }
+  insns.push_back((new IRInstruction(OPCODE_APUT))
+                      ->set_srcs_size(3)
+                      ->set_src(0, bits_reg)
+                      ->set_src(1, bitmap_reg)
+                      ->set_src(2, index_reg));
+  return insns;
+}
+
+// The first instruction of the block, after the labels, catch markers, try
+// boundaries and move-results it starts with. Unlike find_or_insn_insert_point,
+// this goes past the label of a branch target, so that a probe there runs on
+// every path into the block.
+IRList::iterator find_probe_insert_point(cfg::Block* block) {
+  return std::find_if(
+      block->begin(), block->end(), [](const MethodItemEntry& mie) {
+        if (mie.type != MFLOW_OPCODE) {
+          return false;
+        }
+        auto op = mie.insn->opcode();
+        return !opcode::is_a_load_param(op) &&
+               !opcode::is_move_result_any(op) &&
+               op != OPCODE_MOVE_EXCEPTION;
+      });
+}
+
+// Right after the parameters are loaded, where the bitmap is loaded too.
+IRList::iterator find_method_entry_insert_point(IRCode* code) {
+  return std::find_if_not(
+      code->begin(), code->end(), [&](const MethodItemEntry& mie) {
+        return mie.type == MFLOW_FALLTHROUGH ||
+               (mie.type == MFLOW_OPCODE &&
+                opcode::is_a_load_param(mie.insn->opcode()));
+      });
+}
+
+// Inserts the probes of the method, and returns the number of blocks the
+// "basic_block_tracing" strategy would have instrumented.
+size_t instrument_bitmap_probes(IRCode* code,
+                                DexFieldRef* bitmap,
+                                BitmapMethod& info) {
+  code->build_cfg(/* editable */ false);
+  auto& cfg = code->cfg();
+  const auto blocks = cfg.blocks();
+  info.num_blocks = blocks.size();
+
+  // The same blocks that basic_block_tracing instruments.
+  size_t num_instrumentable_blocks =
+      std::count_if(blocks.begin(), blocks.end(), [](cfg::Block* block) {
+        return block->get_first_insn() != block->end() &&
+               find_or_insn_insert_point(block) != block->end();
+      });
+
+  // The probe of the entry block goes at the method entry, so that every
+  // block has a dominator that can hold a probe.
+  auto entry = cfg.entry_block();
+  auto can_probe = [entry](cfg::Block* block) {
+    return block == entry || find_probe_insert_point(block) != block->end();
+  };
+  auto probes = instrument::place_block_probes(cfg, blocks, can_probe);
+  info.num_probes = probes.probe_blocks.size();
+  info.probe_of_block = std::move(probes.probe_of_block);
+  if (info.num_probes == 0) {
+    code->clear_cfg();
+    return num_instrumentable_blocks;
+  }
+
+  const reg_t bitmap_reg = code->allocate_temp();
+  const reg_t index_reg = code->allocate_temp();
+  const reg_t bits_reg = code->allocate_temp();
+  const reg_t mask_reg = code->allocate_temp();
+  for (size_t i = 0; i < info.num_probes; ++i) {
+    auto block = probes.probe_blocks[i];
+    if (block == entry) {
+      // This is never inside a try block.
+      auto insert_point = find_method_entry_insert_point(code);
+      for (auto insn : make_probe(info.first_bit + i, bitmap_reg, index_reg,
+                                  bits_reg, mask_reg)) {
+        code->insert_before(insert_point, insn);
+      }
+      continue;
+    }
+    // AGET and APUT may throw, so split try blocks around them like around
+    // the invokes of the other strategies.
+    auto insert_point = find_probe_insert_point(block);
+    auto catch_block = find_try_block(code, insert_point);
+    insert_try_end_instr(code, insert_point, catch_block);
+    for (auto insn : make_probe(info.first_bit + i, bitmap_reg, index_reg,
+                                bits_reg, mask_reg)) {
+      code->insert_before(insert_point, insn);
+    }
+    insert_try_start_instr(code, insert_point, catch_block);
+  }
+  code->clear_cfg();
+
+  // Load the bitmap last, so that it goes before the probe of the entry block.
+  auto insert_point_init = find_method_entry_insert_point(code);
+  code->insert_before(
+      code->insert_before(insert_point_init,
+                          (new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT))
+                              ->set_dest(bitmap_reg)),
+      (new IRInstruction(OPCODE_SGET_OBJECT))->set_field(bitmap));
+  return num_instrumentable_blocks;
+}
+
+std::vector<DexField*> make_bitmap_fields(DexClass* analysis_cls,
+                                          size_t num_shards) {
+  std::vector<DexField*> fields;
+  for (size_t i = 1; i <= num_shards; ++i) {
+    auto field = static_cast<DexField*>(DexField::make_field(
+        analysis_cls->get_type(),
+        DexString::make_string("sBlockBitmap" + std::to_string(i)),
+        type::make_array_type(type::_int())));
+    field->make_concrete(ACC_PUBLIC | ACC_STATIC);
+    analysis_cls->add_field(field);
+    fields.push_back(field);
+  }
+  return fields;
+}
+
+// Allocates the bitmaps at the beginning of the analysis class' clinit.
+void allocate_bitmaps(DexClass* analysis_cls,
+                      const std::vector<DexField*>& fields,
+                      const std::vector<size_t>& num_words) {
+  DexMethod* clinit = analysis_cls->get_clinit();
+  always_assert(clinit != nullptr);
+  auto* code = clinit->get_code();
+  const reg_t size_reg = code->allocate_temp();
+  const reg_t array_reg = code->allocate_temp();
+  std::vector<IRInstruction*> insns;
+  for (size_t i = 0; i < fields.size(); ++i) {
+    insns.push_back((new IRInstruction(OPCODE_CONST))
+                        ->set_literal(num_words[i])
+                        ->set_dest(size_reg));
+    insns.push_back((new IRInstruction(OPCODE_NEW_ARRAY))
+                        ->set_type(fields[i]->get_type())
+                        ->set_src(0, size_reg));
+    insns.push_back(
+        (new IRInstruction(IOPCODE_MOVE_RESULT_PSEUDO_OBJECT))
+            ->set_dest(array_reg));
+    insns.push_back((new IRInstruction(OPCODE_SPUT_OBJECT))
+                        ->set_src(0, array_reg)
+                        ->set_field(fields[i]));
+    TRACE(INSTRUMENT, 2, "%s was allocated: %zu words", SHOW(fields[i]),
+          num_words[i]);
+  }
+  code->insert_after(nullptr, insns);
+}
+
+// Every line describes a method: its index, name, number of blocks, shard,
+// first bit, number of probes, and the probe of each block (-1 if none).
+// Whether block b ran is bit (first bit + probe of b) of the shard.
+void write_bitmap_index_file(const std::string& file_name,
+                             const std::vector<BitmapMethod>& methods) {
+  std::ofstream ofs(file_name, std::ofstream::out | std::ofstream::trunc);
+  ofs << "#,basic-block-bitmap,1.0" << std::endl;
+  for (size_t i = 0; i < methods.size(); ++i) {
+    const auto& m = methods[i];
+    ofs << i << "," << m.name << "," << m.num_blocks << "," << m.shard << ","
+        << m.first_bit << "," << m.num_probes << ",";
+    for (size_t b = 0; b < m.probe_of_block.size(); ++b) {
+      ofs << (b == 0 ? "" : " ") << m.probe_of_block[b];
+    }
+    ofs << std::endl;
+  }
+  TRACE(INSTRUMENT, 2, "Index file was written to: %s", SHOW(file_name));
+}
+
+void do_basic_block_bitmap_tracing(DexClass* analysis_cls,
+                                   DexStoresVector& stores,
+                                   ConfigFiles& cfg,
+                                   PassManager& pm,
+                                   const InstrumentPass::Options& options) {
+  const size_t num_shards = options.num_shards;
+  always_assert(num_shards > 0);
+  const auto& fields = make_bitmap_fields(analysis_cls, num_shards);
+  const auto& cold_start_classes = get_cold_start_classes(cfg);
+  auto scope = build_class_scope(stores);
+
+  std::vector<BitmapMethod> methods;
+  std::vector<size_t> num_words(num_shards, 0);
+  size_t all_methods = 0;
+  size_t instrumentable_blocks = 0;
+  size_t probes = 0;
+  std::map<size_t /* blocks per probe, in percent */, int> saving_stat;
+  walk::code(scope, [&](DexMethod* method, IRCode& code) {
+    if (method->get_class() == analysis_cls->get_type()) {
+      return;
+    }
+    if ((!options.allowlist.empty() &&
+         !is_included(method, options.allowlist)) ||
+        (options.only_cold_start_class &&
+         !is_included(method, cold_start_classes))) {
+      return;
+    }
+    if (is_included(method, options.blocklist)) {
+      TRACE(INSTRUMENT, 9, "Block_list: excluded: %s", SHOW(method));
+      return;
+    }
+
+    all_methods++;
+    BitmapMethod info;
+    info.name = show(method);
+    info.shard = methods.size() % num_shards;
+    info.first_bit = num_words[info.shard] * kBitsPerWord;
+    size_t blocks = instrument_bitmap_probes(&code, fields[info.shard], info);
+    num_words[info.shard] +=
+        (info.num_probes + kBitsPerWord - 1) / kBitsPerWord;
+    instrumentable_blocks += blocks;
+    probes += info.num_probes;
+    if (info.num_probes > 0) {
+      ++saving_stat[blocks * 100 / info.num_probes / 50 * 50];
+    }
+    TRACE(INSTRUMENT, 7, "%s: %zu blocks, %zu probes, shard %zu, bit %zu",
+          SHOW(info.name), info.num_blocks, info.num_probes, info.shard,
+          info.first_bit);
+    methods.push_back(std::move(info));
+  });
+  allocate_bitmaps(analysis_cls, fields, num_words);
+
+  write_bitmap_index_file(cfg.metafile(options.metadata_file_name), methods);
+
+  TRACE(INSTRUMENT, 4, "Instrumentable blocks per probe:");
+  for (const auto& p : saving_stat) {
+    TRACE(INSTRUMENT, 4, " %3zu.%02zu+: %6d methods", p.first / 100,
+          p.first % 100, p.second);
+  }
+  const size_t all_words =
+      std::accumulate(num_words.begin(), num_words.end(), size_t(0));
+  TRACE(INSTRUMENT, 3,
+        "Placed %zu probes instead of %zu into %zu methods, in %zu words",
+        probes, instrumentable_blocks, all_methods, all_words);
+
+  pm.set_metric("bitmap_methods", all_methods);
+  pm.set_metric("bitmap_instrumentable_blocks", instrumentable_blocks);
+  pm.set_metric("bitmap_probes", probes);
+  pm.set_metric("bitmap_words", all_words);
+}
+
 std::unordered_set<std::string> load_blocklist_file(
     const std::string& file_name) {
   // Assume the file simply enumerates excluded names.
@@ -1182,6 +1489,15 @@ std::unordered_set<std::string> load_blocklist_file(
 
 } // namespace
 
+std::vector<int> InstrumentPass::insert_bitmap_probes(IRCode* code,
+                                                      DexFieldRef* bitmap,
+                                                      size_t first_bit) {
+  BitmapMethod info;
+  info.first_bit = first_bit;
+  instrument_bitmap_probes(code, bitmap, info);
+  return std::move(info.probe_of_block);
+}
+
 void InstrumentPass::bind_config() {
   bind("instrumentation_strategy", "", m_options.instrumentation_strategy);
   bind("analysis_class_name", "", m_options.analysis_class_name);
@@ -1204,10 +1520,14 @@ void InstrumentPass::bind_config() {
     interdex::InterDexRegistry* registry =
         static_cast<interdex::InterDexRegistry*>(
             PluginRegistry::get().pass_registry(interdex::INTERDEX_PASS_NAME));
-    registry->register_plugin("INSTRUMENT_PASS_PLUGIN",
-                              [num_shards = m_options.num_shards]() {
-                                return new InstrumentInterDexPlugin(num_shards);
-                              });
+    const bool bitmap =
+        m_options.instrumentation_strategy == "basic_block_bitmap";
+    registry->register_plugin(
+        "INSTRUMENT_PASS_PLUGIN",
+        [num_shards = m_options.num_shards, bitmap]() {
+          return new InstrumentInterDexPlugin(num_shards,
+                                              bitmap ? num_shards : 1);
+        });
     // Currently we only support instance call to static call.
     for (auto& pair : m_options.methods_replacement) {
       always_assert(!is_static(pair.first));
@@ -1290,6 +1610,8 @@ void InstrumentPass::run_pass(DexStoresVector& stores,
     do_simple_method_tracing(analysis_cls, stores, cfg, pm, m_options);
   } else if (m_options.instrumentation_strategy == "basic_block_tracing") {
     do_basic_block_tracing(analysis_cls, stores, cfg, pm, m_options);
+  } else if (m_options.instrumentation_strategy == "basic_block_bitmap") {
+    do_basic_block_bitmap_tracing(analysis_cls, stores, cfg, pm, m_options);
   } else {
     std::cerr << "[InstrumentPass] Unknown instrumentation strategy.\n";
   }
@@ -9,10 +9,13 @@
 
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "Pass.h"
 
+class DexFieldRef;
 class DexMethod;
+class IRCode;
 
 class InstrumentPass : public Pass {
  public:
@@ -35,6 +38,13 @@ class InstrumentPass : public Pass {
     std::unordered_map<DexMethod*, DexMethod*> methods_replacement;
   };
 
+  // Inserts the probes of the "basic_block_bitmap" strategy into `code`, so
+  // that probe i sets bit `first_bit + i` of the int[] in `bitmap`. Returns the
+  // probe of each block, see instrument::place_block_probes.
+  static std::vector<int> insert_bitmap_probes(IRCode* code,
+                                               DexFieldRef* bitmap,
+                                               size_t first_bit);
+
  private:
   Options m_options;
 };
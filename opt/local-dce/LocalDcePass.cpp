@@ -36,6 +36,8 @@ constexpr const char* METRIC_NPE_INSTRUCTIONS = "num_npe_instructions";
 constexpr const char* METRIC_DEAD_INSTRUCTIONS = "num_dead_instructions";
 constexpr const char* METRIC_UNREACHABLE_INSTRUCTIONS =
     "num_unreachable_instructions";
+constexpr const char* METRIC_REMOVED_INSTRUCTIONS_PER_METHOD =
+    "removed_instructions_per_method";
 constexpr const char* METRIC_NORMALIZED_NEW_INSTANCES =
     "num_normalized_new_instances";
 constexpr const char* METRIC_ALIASED_NEW_INSTANCES =
@@ -81,6 +83,8 @@ void LocalDcePass::run_pass(DexStoresVector& stores,
     }
   }
 
+  auto& removed_per_method =
+      mgr.histogram(METRIC_REMOVED_INSTRUCTIONS_PER_METHOD);
   auto stats =
       walk::parallel::methods<LocalDce::Stats>(scope, [&](DexMethod* m) {
         auto* code = m->get_code();
@@ -91,7 +95,11 @@ void LocalDcePass::run_pass(DexStoresVector& stores,
         LocalDce ldce(pure_methods, override_graph.get(),
                       may_allocate_registers);
         ldce.dce(code);
-        return ldce.get_stats();
+        const auto& method_stats = ldce.get_stats();
+        removed_per_method.record(method_stats.npe_instruction_count +
+                                  method_stats.dead_instruction_count +
+                                  method_stats.unreachable_instruction_count);
+        return method_stats;
       });
   mgr.incr_metric(METRIC_NPE_INSTRUCTIONS, stats.npe_instruction_count);
   mgr.incr_metric(METRIC_DEAD_INSTRUCTIONS, stats.dead_instruction_count);
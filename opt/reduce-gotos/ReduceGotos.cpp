@@ -492,30 +492,35 @@ ReduceGotosPass::Stats ReduceGotosPass::process_code(IRCode* code) {
   return stats;
 }
 
-void ReduceGotosPass::run_pass(DexStoresVector& stores,
-                               ConfigFiles& /* unused */,
-                               PassManager& mgr) {
-  auto scope = build_class_scope(stores);
-
-  Stats stats = walk::parallel::methods<Stats>(scope, [](DexMethod* method) {
-    const auto code = method->get_code();
-    if (!code) {
-      return Stats{};
-    }
+void ReduceGotosPass::begin_walk(DexStoresVector& /* unused */,
+                                 ConfigFiles& /* unused */,
+                                 PassManager& /* unused */) {
+  m_stats.assign(num_workers(), Stats{});
+}
 
-    Stats stats = ReduceGotosPass::process_code(code);
-    if (stats.replaced_gotos_with_returns ||
-        stats.inverted_conditional_branches) {
-      TRACE(RG, 3,
-            "[reduce gotos] Replaced %u gotos with returns, "
-            "removed %u trailing moves, "
-            "inverted %u conditional branches in {%s}",
-            stats.replaced_gotos_with_returns, stats.removed_trailing_moves,
-            stats.inverted_conditional_branches, SHOW(method));
-    }
-    return stats;
-  });
+void ReduceGotosPass::run_on_method(DexMethod* method,
+                                    IRCode& code,
+                                    size_t worker_id) {
+  Stats stats = ReduceGotosPass::process_code(&code);
+  if (stats.replaced_gotos_with_returns ||
+      stats.inverted_conditional_branches) {
+    TRACE(RG, 3,
+          "[reduce gotos] Replaced %u gotos with returns, "
+          "removed %u trailing moves, "
+          "inverted %u conditional branches in {%s}",
+          stats.replaced_gotos_with_returns, stats.removed_trailing_moves,
+          stats.inverted_conditional_branches, SHOW(method));
+  }
+  static_cast<Stats&>(m_stats[worker_id]) += stats;
+}
 
+void ReduceGotosPass::end_walk(DexStoresVector& /* unused */,
+                               ConfigFiles& /* unused */,
+                               PassManager& mgr) {
+  Stats stats;
+  for (Stats& worker_stats : m_stats) {
+    stats += worker_stats;
+  }
   mgr.incr_metric(METRIC_REMOVED_SWITCHES, stats.removed_switches);
   mgr.incr_metric(METRIC_REDUCED_SWITCHES, stats.reduced_switches);
   mgr.incr_metric(METRIC_REMAINING_TRIVIAL_SWITCHES,
@@ -7,13 +7,16 @@
 
 #pragma once
 
+#include <vector>
+
 #include "Pass.h"
+#include "Walkers.h"
 
 namespace cfg {
 class ControlFlowGraph;
 } // namespace cfg
 
-class ReduceGotosPass : public Pass {
+class ReduceGotosPass : public MethodLocalPass {
  public:
   struct Stats {
     size_t removed_switches{0};
@@ -32,9 +35,11 @@ class ReduceGotosPass : public Pass {
     Stats& operator+=(const Stats&);
   };
 
-  ReduceGotosPass() : Pass("ReduceGotosPass") {}
+  ReduceGotosPass() : MethodLocalPass("ReduceGotosPass") {}
 
-  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+  void begin_walk(DexStoresVector&, ConfigFiles&, PassManager&) override;
+  void run_on_method(DexMethod*, IRCode&, size_t worker_id) override;
+  void end_walk(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
   static Stats process_code(IRCode*);
   static void process_code_switches(cfg::ControlFlowGraph&, Stats&);
@@ -42,4 +47,7 @@ class ReduceGotosPass : public Pass {
 
  private:
   static void shift_registers(cfg::ControlFlowGraph* cfg, uint32_t* reg);
+
+  // Indexed by worker id.
+  std::vector<CacheAligned<Stats>> m_stats;
 };
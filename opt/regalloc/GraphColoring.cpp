@@ -8,6 +8,7 @@
 #include "GraphColoring.h"
 
 #include <algorithm>
+#include <memory>
 #include <boost/pending/disjoint_sets.hpp>
 #include <boost/property_map/property_map.hpp>
 
@@ -21,6 +22,7 @@
 #include "Trace.h"
 #include "Transform.h"
 #include "VirtualRegistersFile.h"
+#include "WorkQueue.h"
 
 namespace regalloc {
 
@@ -256,6 +258,29 @@ void fit_params(
   reg_transform->size = std::max(reg_transform->size, vreg);
 }
 
+/*
+ * Methods with at least this many instructions get their liveness and their
+ * interference graph computed in parallel over ranges of blocks. Methods are
+ * already allocated in parallel, but a few huge ones can each take longer
+ * than all the others combined.
+ */
+constexpr size_t PARALLEL_BLOCKS_MIN_INSNS = 10000;
+
+void mark_touched(reg_t reg, std::vector<bool>* touched) {
+  if (reg >= touched->size()) {
+    touched->resize(reg + 1);
+  }
+  (*touched)[reg] = true;
+}
+
+void run_liveness(size_t num_threads, LivenessFixpointIterator* fixpoint_iter) {
+  if (num_threads > 1) {
+    fixpoint_iter->run_summarized(num_threads);
+  } else {
+    fixpoint_iter->run(LivenessDomain());
+  }
+}
+
 std::string show(const SpillPlan& spill_plan) {
   std::ostringstream ss;
   ss << "Global spills:\n";
@@ -308,6 +333,75 @@ std::string show(const RegisterTransform& reg_transform) {
 
 } // namespace
 
+CodeSnapshot::CodeSnapshot(IRCode* code) {
+  for (const auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
+    Entry entry{insn->opcode(), static_cast<uint32_t>(m_entries.size()),
+                static_cast<uint32_t>(m_regs.size()), 0};
+    append_registers(insn, &m_regs);
+    entry.regs_end = m_regs.size();
+    m_entries.emplace(insn, entry);
+  }
+}
+
+void CodeSnapshot::mark_touched_registers(IRCode* code,
+                                          std::vector<bool>* touched) const {
+  std::vector<bool> seen(m_entries.size());
+  uint32_t last_pos{0};
+  std::vector<reg_t> regs;
+  for (const auto& mie : InstructionIterable(code)) {
+    auto insn = mie.insn;
+    regs.clear();
+    append_registers(insn, &regs);
+    auto it = m_entries.find(insn);
+    if (it == m_entries.end()) {
+      for (auto reg : regs) {
+        mark_touched(reg, touched);
+      }
+      continue;
+    }
+    const auto& entry = it->second;
+    seen[entry.pos] = true;
+    auto old_regs_begin = m_regs.begin() + entry.regs_begin;
+    auto old_regs_end = m_regs.begin() + entry.regs_end;
+    if (entry.op != insn->opcode() || entry.pos < last_pos ||
+        regs.size() != entry.regs_end - entry.regs_begin) {
+      for (auto reg : regs) {
+        mark_touched(reg, touched);
+      }
+      for (auto reg_it = old_regs_begin; reg_it != old_regs_end; ++reg_it) {
+        mark_touched(*reg_it, touched);
+      }
+    } else {
+      for (size_t i = 0; i < regs.size(); ++i) {
+        if (regs[i] != old_regs_begin[i]) {
+          mark_touched(regs[i], touched);
+          mark_touched(old_regs_begin[i], touched);
+        }
+      }
+    }
+    last_pos = std::max(last_pos, entry.pos);
+  }
+  for (const auto& pair : m_entries) {
+    const auto& entry = pair.second;
+    if (!seen[entry.pos]) {
+      for (auto i = entry.regs_begin; i < entry.regs_end; ++i) {
+        mark_touched(m_regs[i], touched);
+      }
+    }
+  }
+}
+
+void CodeSnapshot::append_registers(const IRInstruction* insn,
+                                    std::vector<reg_t>* regs) {
+  for (size_t i = 0; i < insn->srcs_size(); ++i) {
+    regs->push_back(insn->src(i));
+  }
+  if (insn->has_dest()) {
+    regs->push_back(insn->dest());
+  }
+}
+
 Allocator::Stats& Allocator::Stats::operator+=(const Allocator::Stats& that) {
   reiteration_count += that.reiteration_count;
   param_spill_moves += that.param_spill_moves;
@@ -345,7 +439,9 @@ static bool has_2addr_form(IROpcode op) {
  *
  * This is fairly similar to the implementation in [Briggs92] section 8.6.
  */
-bool Allocator::coalesce(interference::Graph* ig, IRCode* code) {
+bool Allocator::coalesce(interference::Graph* ig,
+                         IRCode* code,
+                         std::vector<bool>* touched) {
   // XXX We could use something more compact than an unordered_map?
   using Rank = std::unordered_map<reg_t, size_t>;
   using Parent = std::unordered_map<reg_t, reg_t>;
@@ -379,12 +475,19 @@ bool Allocator::coalesce(interference::Graph* ig, IRCode* code) {
     } else {
       dest = insn->dest();
     }
+    auto remove_move = [&]() {
+      if (touched != nullptr) {
+        mark_touched(insn->dest(), touched);
+        mark_touched(insn->src(0), touched);
+      }
+      ++m_stats.moves_coalesced;
+      code->remove_opcode(it.unwrap());
+    };
     dest = aliases.find_set(dest);
     auto src = aliases.find_set(insn->src(0));
     if (dest == src) {
       if (opcode::is_a_move(op)) {
-        ++m_stats.moves_coalesced;
-        code->remove_opcode(it.unwrap());
+        remove_move();
       }
     } else if (ig->is_coalesceable(dest, src)) {
       // This unifies the two trees represented by dest and src
@@ -398,11 +501,14 @@ bool Allocator::coalesce(interference::Graph* ig, IRCode* code) {
       }
       // Merge the child's node into the parent's
       ig->combine(parent, child);
+      if (touched != nullptr) {
+        mark_touched(parent, touched);
+        mark_touched(child, touched);
+      }
       TRACE(REG, 7, "Coalescing v%u and v%u because of %s", parent, child,
             SHOW(insn));
       if (opcode::is_a_move(op)) {
-        ++m_stats.moves_coalesced;
-        code->remove_opcode(it.unwrap());
+        remove_move();
       }
     }
   }
@@ -1084,6 +1190,16 @@ void Allocator::allocate(DexMethod* method) {
   if (no_overwrite_this) {
     dedicate_this_register(method);
   }
+  size_t num_threads = code->count_opcodes() >= PARALLEL_BLOCKS_MIN_INSNS
+                           ? redex_parallel::default_num_threads()
+                           : 1;
+  // After the first round, we don't rebuild the interference graph from
+  // scratch. The registers that coalescing, spilling and splitting have
+  // touched since the last round are tracked, and only their live ranges are
+  // recomputed.
+  interference::Graph ig;
+  std::vector<bool> touched;
+  std::unique_ptr<CodeSnapshot> snapshot;
   bool first{true};
   while (true) {
     SplitCosts split_costs;
@@ -1094,11 +1210,24 @@ void Allocator::allocate(DexMethod* method) {
     auto& cfg = code->cfg();
     cfg.calculate_exit_block();
     LivenessFixpointIterator fixpoint_iter(cfg);
-    fixpoint_iter.run(LivenessDomain());
+    run_liveness(num_threads, &fixpoint_iter);
 
     TRACE(REG, 5, "Allocating:\n%s", ::SHOW(code->cfg()));
-    auto ig =
-        interference::build_graph(fixpoint_iter, code, initial_regs, range_set);
+    if (first) {
+      ig = interference::build_graph(fixpoint_iter, code, initial_regs,
+                                     range_set, num_threads);
+    } else {
+      // The registers past the end of `touched` count as touched.
+      touched.resize(
+          std::max<size_t>(touched.size(), code->get_registers_size()));
+      snapshot->mark_touched_registers(code, &touched);
+      TRACE(REG, 5, "Updating the live ranges of %zu registers",
+            static_cast<size_t>(
+                std::count(touched.begin(), touched.end(), true)));
+      interference::update_graph(fixpoint_iter, code, initial_regs, range_set,
+                                 touched, &ig, num_threads);
+      touched.clear();
+    }
 
     // Make the `this` symreg conflict with every other one so that it never
     // gets overwritten in the method. See check_no_overwrite_this in
@@ -1112,11 +1241,11 @@ void Allocator::allocate(DexMethod* method) {
 
     TRACE(REG, 7, "IG:\n%s", SHOW(ig));
     if (first) {
-      coalesce(&ig, code);
+      coalesce(&ig, code, &touched);
       first = false;
       // After coalesce the live_out and live_in of blocks may change, so run
       // LivenessFixpointIterator again.
-      fixpoint_iter.run(LivenessDomain());
+      run_liveness(num_threads, &fixpoint_iter);
       TRACE(REG, 5, "Post-coalesce:\n%s", ::SHOW(code->cfg()));
     } else {
       // TODO we should coalesce here too, but we'll need to avoid removing
@@ -1150,6 +1279,7 @@ void Allocator::allocate(DexMethod* method) {
 
     if (!spill_plan.empty()) {
       TRACE(REG, 5, "Spill plan:\n%s", SHOW(spill_plan));
+      snapshot = std::make_unique<CodeSnapshot>(code);
       if (m_config.use_splitting) {
         calc_split_costs(fixpoint_iter, code, &split_costs);
         find_split(ig, split_costs, &reg_transform, &spill_plan, &split_plan);
@@ -61,6 +61,40 @@ struct RegisterTransform {
   vreg_t size{0};
 };
 
+/*
+ * Records the opcode and the registers of every instruction, so that we can
+ * tell which live ranges the spill and split code has changed since, and only
+ * update the interference graph for those.
+ *
+ * Instructions are identified by address, so none of them must be freed
+ * between the snapshot and the comparison.
+ */
+class CodeSnapshot {
+ public:
+  explicit CodeSnapshot(IRCode* code);
+
+  /*
+   * Mark the registers of the instructions that were inserted, removed, moved
+   * or changed since the snapshot. For an instruction whose operands were
+   * replaced, only the old and the new operands are marked.
+   */
+  void mark_touched_registers(IRCode* code, std::vector<bool>* touched) const;
+
+ private:
+  struct Entry {
+    IROpcode op;
+    uint32_t pos;
+    uint32_t regs_begin;
+    uint32_t regs_end;
+  };
+
+  static void append_registers(const IRInstruction* insn,
+                               std::vector<reg_t>* regs);
+
+  std::unordered_map<const IRInstruction*, Entry> m_entries;
+  std::vector<reg_t> m_regs;
+};
+
 /*
  * This is a Chaitin-Briggs style allocator with some adaptations. See the
  * comment block of allocate() for details.
@@ -105,7 +139,13 @@ class Allocator {
 
   explicit Allocator(const Config& config) : m_config(config) {}
 
-  bool coalesce(interference::Graph*, IRCode*);
+  /*
+   * If `touched` is given, mark in it the registers whose live ranges
+   * coalescing may have changed.
+   */
+  bool coalesce(interference::Graph*,
+                IRCode*,
+                std::vector<bool>* touched = nullptr);
 
   void simplify(interference::Graph*,
                 std::stack<reg_t>* select_stack,
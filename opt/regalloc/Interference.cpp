@@ -7,12 +7,16 @@
 
 #include "Interference.h"
 
+#include <algorithm>
+#include <tuple>
+
 #include "ControlFlow.h"
 #include "DexOpcode.h"
 #include "DexUtil.h"
 #include "IRCode.h"
 #include "MonotonicFixpointIterator.h"
 #include "Show.h"
+#include "WorkQueue.h"
 
 namespace regalloc {
 
@@ -224,6 +228,197 @@ void GraphBuilder::update_node_constraints(const IRList::iterator& it,
   }
 }
 
+namespace impl {
+
+/*
+ * The edges that the instructions of a range of blocks induce. Each edge is
+ * recorded once, in the order in which it is first found, so that adding the
+ * edges of consecutive ranges to the graph in order is the same as adding
+ * the edges of every instruction in turn.
+ */
+struct BlockRangeEdges {
+  // The last element is whether any of the instructions makes the edge
+  // non-coalesceable.
+  std::vector<std::tuple<reg_t, reg_t, bool>> edges;
+  std::unordered_map<reg_pair_t, size_t> edge_indices;
+  std::unordered_set<reg_pair_t> containment_edges;
+  std::vector<std::pair<IRInstruction*, LivenessDomain>> range_liveness;
+
+  void add_edge(reg_t u, reg_t v, bool can_coalesce = false) {
+    if (u == v) {
+      return;
+    }
+    auto result = edge_indices.emplace(build_edge(u, v), edges.size());
+    if (result.second) {
+      edges.emplace_back(u, v, !can_coalesce);
+    } else if (!can_coalesce) {
+      std::get<2>(edges[result.first->second]) = true;
+    }
+  }
+
+  void add_coalesceable_edge(reg_t u, reg_t v) { add_edge(u, v, true); }
+
+  void add_containment_edge(reg_t u, reg_t v) {
+    if (u == v) {
+      return;
+    }
+    containment_edges.emplace(build_containment_edge(u, v));
+  }
+};
+
+} // namespace impl
+
+namespace {
+
+/*
+ * Collect the edges between the live ranges in one block, keeping only those
+ * for which `keep(u, v)` holds.
+ */
+template <typename Keep>
+void collect_block_edges(const LivenessFixpointIterator& fixpoint_iter,
+                         cfg::Block* block,
+                         const Keep& keep,
+                         BlockRangeEdges* range) {
+  LivenessDomain live_out = fixpoint_iter.get_live_out_vars_at(block);
+  for (auto it = block->rbegin(); it != block->rend(); ++it) {
+    if (it->type != MFLOW_OPCODE) {
+      continue;
+    }
+    auto insn = it->insn;
+    auto op = insn->opcode();
+    if (opcode::has_range_form(op)) {
+      range->range_liveness.emplace_back(insn, live_out);
+    }
+    if (insn->has_dest()) {
+      for (auto reg : live_out.elements()) {
+        if (opcode::is_a_move(op) && reg == insn->src(0)) {
+          continue;
+        }
+        if (keep(insn->dest(), reg)) {
+          range->add_edge(insn->dest(), reg);
+        }
+      }
+      // We add interference edges between the dest and wide src operands of
+      // an instruction even if the srcs are not live-out. This avoids
+      // allocations like `xor-long v1, v0, v9`, where v1 and v0 overlap --
+      // even though this is not a verification error, we have observed bugs
+      // in the ART interpreter when handling these sorts of instructions.
+      // However, we still want to be able to coalesce these symregs if they
+      // don't actually interfere based on liveness information, so that we
+      // can remove move-wide opcodes and/or use /2addr encodings.  As such,
+      // we insert a specially marked edge that coalescing ignores but
+      // coloring respects.
+      for (size_t i = 0; i < insn->srcs_size(); ++i) {
+        if (insn->src_is_wide(i) && keep(insn->dest(), insn->src(i))) {
+          range->add_coalesceable_edge(insn->dest(), insn->src(i));
+        }
+      }
+    }
+    if (op == OPCODE_CHECK_CAST) {
+      auto move_result_pseudo = std::prev(it)->insn;
+      for (auto reg : live_out.elements()) {
+        if (keep(move_result_pseudo->dest(), reg)) {
+          range->add_edge(move_result_pseudo->dest(), reg);
+        }
+      }
+    }
+    // adding containment edge between liverange defined in insn and elements
+    // in live-out set of insn
+    if (insn->has_dest()) {
+      for (auto reg : live_out.elements()) {
+        if (keep(insn->dest(), reg)) {
+          range->add_containment_edge(insn->dest(), reg);
+        }
+      }
+    }
+    fixpoint_iter.analyze_instruction(it->insn, &live_out);
+    // adding containment edge between liverange used in insn and elements
+    // in live-in set of insn
+    for (size_t i = 0; i < insn->srcs_size(); ++i) {
+      for (auto reg : live_out.elements()) {
+        if (keep(insn->src(i), reg)) {
+          range->add_containment_edge(insn->src(i), reg);
+        }
+      }
+    }
+  }
+}
+
+/*
+ * Collect the edges of all the blocks, split into consecutive ranges of
+ * blocks of about the same number of instructions, one range per work item.
+ */
+template <typename Keep>
+std::vector<BlockRangeEdges> collect_edges(
+    const LivenessFixpointIterator& fixpoint_iter,
+    const cfg::ControlFlowGraph& cfg,
+    const Keep& keep,
+    size_t num_threads) {
+  auto blocks = cfg.blocks();
+  if (num_threads <= 1) {
+    std::vector<BlockRangeEdges> ranges(1);
+    for (auto* block : blocks) {
+      collect_block_edges(fixpoint_iter, block, keep, &ranges[0]);
+    }
+    return ranges;
+  }
+
+  // A few ranges per thread, so that the threads stay busy even if some
+  // ranges turn out to be more expensive than others.
+  // Block::num_opcodes() requires an editable CFG.
+  std::vector<size_t> block_insns;
+  block_insns.reserve(blocks.size());
+  size_t total_insns{0};
+  for (auto* block : blocks) {
+    auto ii = InstructionIterable(block);
+    block_insns.push_back(std::distance(ii.begin(), ii.end()));
+    total_insns += block_insns.back();
+  }
+  size_t insns_per_range =
+      std::max<size_t>(total_insns / (num_threads * 4), 1);
+  std::vector<size_t> range_starts{0};
+  size_t range_insns{0};
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    range_insns += block_insns[i];
+    if (range_insns >= insns_per_range && i + 1 < blocks.size()) {
+      range_starts.push_back(i + 1);
+      range_insns = 0;
+    }
+  }
+  range_starts.push_back(blocks.size());
+
+  std::vector<BlockRangeEdges> ranges(range_starts.size() - 1);
+  auto wq = workqueue_foreach<size_t>(
+      [&](size_t idx) {
+        for (size_t i = range_starts[idx]; i < range_starts[idx + 1]; ++i) {
+          collect_block_edges(fixpoint_iter, blocks[i], keep, &ranges[idx]);
+        }
+      },
+      num_threads);
+  for (size_t idx = 0; idx < ranges.size(); ++idx) {
+    wq.add_item(idx);
+  }
+  wq.run_all();
+  return ranges;
+}
+
+} // namespace
+
+void GraphBuilder::add_edges(const std::vector<BlockRangeEdges>& ranges,
+                             Graph* graph) {
+  for (const auto& range : ranges) {
+    for (const auto& edge : range.edges) {
+      graph->add_edge(std::get<0>(edge), std::get<1>(edge),
+                      /* can_coalesce */ !std::get<2>(edge));
+    }
+    graph->m_containment_graph.insert(range.containment_edges.begin(),
+                                      range.containment_edges.end());
+    for (const auto& pair : range.range_liveness) {
+      graph->m_range_liveness.emplace(pair.first, pair.second);
+    }
+  }
+}
+
 /*
  * Build the interference graph by adding edges between nodes that are
  * simultaneously live.
@@ -270,72 +465,95 @@ void GraphBuilder::update_node_constraints(const IRList::iterator& it,
 Graph GraphBuilder::build(const LivenessFixpointIterator& fixpoint_iter,
                           IRCode* code,
                           reg_t initial_regs,
-                          const RangeSet& range_set) {
+                          const RangeSet& range_set,
+                          size_t num_threads) {
   Graph graph;
   auto ii = InstructionIterable(code);
   for (auto it = ii.begin(); it != ii.end(); ++it) {
     GraphBuilder::update_node_constraints(it.unwrap(), range_set, &graph);
   }
 
-  auto& cfg = code->cfg();
-  for (cfg::Block* block : cfg.blocks()) {
-    LivenessDomain live_out = fixpoint_iter.get_live_out_vars_at(block);
-    for (auto it = block->rbegin(); it != block->rend(); ++it) {
-      if (it->type != MFLOW_OPCODE) {
-        continue;
-      }
-      auto insn = it->insn;
-      auto op = insn->opcode();
-      if (opcode::has_range_form(op)) {
-        graph.m_range_liveness.emplace(insn, live_out);
-      }
-      if (insn->has_dest()) {
-        for (auto reg : live_out.elements()) {
-          if (opcode::is_a_move(op) && reg == insn->src(0)) {
-            continue;
-          }
-          graph.add_edge(insn->dest(), reg);
-        }
-        // We add interference edges between the dest and wide src operands of
-        // an instruction even if the srcs are not live-out. This avoids
-        // allocations like `xor-long v1, v0, v9`, where v1 and v0 overlap --
-        // even though this is not a verification error, we have observed bugs
-        // in the ART interpreter when handling these sorts of instructions.
-        // However, we still want to be able to coalesce these symregs if they
-        // don't actually interfere based on liveness information, so that we
-        // can remove move-wide opcodes and/or use /2addr encodings.  As such,
-        // we insert a specially marked edge that coalescing ignores but
-        // coloring respects.
-        for (size_t i = 0; i < insn->srcs_size(); ++i) {
-          if (insn->src_is_wide(i)) {
-            graph.add_coalesceable_edge(insn->dest(), insn->src(i));
-          }
-        }
-      }
-      if (op == OPCODE_CHECK_CAST) {
-        auto move_result_pseudo = std::prev(it)->insn;
-        for (auto reg : live_out.elements()) {
-          graph.add_edge(move_result_pseudo->dest(), reg);
-        }
-      }
-      // adding containment edge between liverange defined in insn and elements
-      // in live-out set of insn
-      if (insn->has_dest()) {
-        for (auto reg : live_out.elements()) {
-          graph.add_containment_edge(insn->dest(), reg);
-        }
-      }
-      fixpoint_iter.analyze_instruction(it->insn, &live_out);
-      // adding containment edge between liverange used in insn and elements
-      // in live-in set of insn
-      for (size_t i = 0; i < insn->srcs_size(); ++i) {
-        for (auto reg : live_out.elements()) {
-          graph.add_containment_edge(insn->src(i), reg);
-        }
-      }
+  auto ranges = collect_edges(
+      fixpoint_iter, code->cfg(), [](reg_t, reg_t) { return true; },
+      num_threads);
+  add_edges(ranges, &graph);
+  finalize(code, initial_regs, &graph);
+  return graph;
+}
+
+void GraphBuilder::update(const LivenessFixpointIterator& fixpoint_iter,
+                          IRCode* code,
+                          reg_t initial_regs,
+                          const RangeSet& range_set,
+                          const std::vector<bool>& touched,
+                          size_t num_threads,
+                          Graph* graph) {
+  auto is_touched = [&touched](reg_t reg) {
+    return reg >= touched.size() || touched[reg];
+  };
+  auto is_touched_edge = [&is_touched](reg_pair_t edge) {
+    return is_touched(static_cast<reg_t>(edge >> (sizeof(reg_t) * 8))) ||
+           is_touched(static_cast<reg_t>(edge));
+  };
+
+  // Drop the touched nodes along with all their edges, and reset the
+  // constraints of the others, since the instructions that determine them
+  // may have changed.
+  auto& nodes = graph->m_nodes;
+  for (auto it = nodes.begin(); it != nodes.end();) {
+    if (is_touched(it->first)) {
+      it = nodes.erase(it);
+      continue;
     }
+    auto& node = it->second;
+    node.m_adjacent.erase(std::remove_if(node.m_adjacent.begin(),
+                                         node.m_adjacent.end(),
+                                         is_touched),
+                          node.m_adjacent.end());
+    node.m_weight = 0;
+    node.m_spill_cost = 0;
+    node.m_max_vreg = max_unsigned_value(16);
+    node.m_width = 0;
+    node.m_props.reset();
+    node.m_props.set(Node::ACTIVE);
+    node.m_type_domain = RegisterTypeDomain(RegisterType::UNKNOWN);
+    ++it;
+  }
+  auto& adj_matrix = graph->m_adj_matrix;
+  for (auto it = adj_matrix.begin(); it != adj_matrix.end();) {
+    it = is_touched_edge(it->first) ? adj_matrix.erase(it) : std::next(it);
+  }
+  auto& containment_graph = graph->m_containment_graph;
+  for (auto it = containment_graph.begin(); it != containment_graph.end();) {
+    it = is_touched_edge(*it) ? containment_graph.erase(it) : std::next(it);
   }
-  for (auto& pair : graph.nodes()) {
+  graph->m_range_liveness.clear();
+
+  auto ii = InstructionIterable(code);
+  for (auto it = ii.begin(); it != ii.end(); ++it) {
+    GraphBuilder::update_node_constraints(it.unwrap(), range_set, graph);
+  }
+  // The weights of the edges that we kept depend on the constraints we just
+  // recomputed.
+  for (auto& pair : nodes) {
+    auto& node = pair.second;
+    for (auto adj : node.m_adjacent) {
+      node.m_weight += graph->edge_weight(node, nodes.at(adj));
+    }
+  }
+
+  auto ranges = collect_edges(
+      fixpoint_iter, code->cfg(),
+      [&is_touched](reg_t u, reg_t v) {
+        return is_touched(u) || is_touched(v);
+      },
+      num_threads);
+  add_edges(ranges, graph);
+  finalize(code, initial_regs, graph);
+}
+
+void GraphBuilder::finalize(IRCode* code, reg_t initial_regs, Graph* graph) {
+  for (auto& pair : graph->nodes()) {
     auto reg = pair.first;
     auto& node = pair.second;
     if (reg >= initial_regs) {
@@ -346,7 +564,6 @@ Graph GraphBuilder::build(const LivenessFixpointIterator& fixpoint_iter,
                reg,
                SHOW(code));
   }
-  return graph;
 }
 
 std::ostream& Graph::write_dot_format(std::ostream& o) const {
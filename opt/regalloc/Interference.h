@@ -72,6 +72,7 @@ namespace interference {
 namespace impl {
 
 class GraphBuilder;
+struct BlockRangeEdges;
 
 inline reg_pair_t build_containment_edge(reg_t u, reg_t v) {
   reg_pair_t hi = static_cast<reg_pair_t>(u);
@@ -276,11 +277,24 @@ class GraphBuilder {
                                       const RangeSet&,
                                       Graph*);
 
+  static void add_edges(const std::vector<BlockRangeEdges>&, Graph*);
+
+  static void finalize(IRCode*, reg_t initial_regs, Graph*);
+
  public:
   static Graph build(const LivenessFixpointIterator&,
                      IRCode*,
                      reg_t initial_regs,
-                     const RangeSet&);
+                     const RangeSet&,
+                     size_t num_threads);
+
+  static void update(const LivenessFixpointIterator&,
+                     IRCode*,
+                     reg_t initial_regs,
+                     const RangeSet&,
+                     const std::vector<bool>& touched,
+                     size_t num_threads,
+                     Graph*);
 
   // For unit tests
   static Graph create_empty() { return Graph(); }
@@ -292,12 +306,41 @@ uint32_t edge_weight_helper(uint8_t, uint8_t);
 
 } // namespace impl
 
+/*
+ * The edges are collected in parallel over ranges of blocks when
+ * `num_threads` > 1. The resulting graph is the same either way.
+ */
 inline Graph build_graph(const LivenessFixpointIterator& fixpoint_iter,
                          IRCode* code,
                          reg_t initial_regs,
-                         const RangeSet& range_set) {
+                         const RangeSet& range_set,
+                         size_t num_threads = 1) {
   return impl::GraphBuilder::build(
-      fixpoint_iter, code, initial_regs, range_set);
+      fixpoint_iter, code, initial_regs, range_set, num_threads);
+}
+
+/*
+ * Bring a graph that build_graph() returned for an earlier version of the
+ * code up to date, as if it were rebuilt from scratch. Between the two
+ * versions, instructions may only have been inserted, removed, or had their
+ * registers changed, without changing the control flow between the other
+ * instructions. `touched` holds the registers that appear in any of those
+ * instructions, before or after the change, and any register that it doesn't
+ * cover is considered touched too. Only the edges of the touched registers
+ * are recomputed; the others are kept, so this is much cheaper than a rebuild
+ * when a few live ranges were spilled in a large method.
+ *
+ * The graph may have been coalesced and simplified since it was built.
+ */
+inline void update_graph(const LivenessFixpointIterator& fixpoint_iter,
+                         IRCode* code,
+                         reg_t initial_regs,
+                         const RangeSet& range_set,
+                         const std::vector<bool>& touched,
+                         Graph* graph,
+                         size_t num_threads = 1) {
+  impl::GraphBuilder::update(fixpoint_iter, code, initial_regs, range_set,
+                             touched, num_threads, graph);
 }
 
 } // namespace interference
@@ -11,6 +11,7 @@
 #include "DexStoreUtil.h"
 #include "DexUtil.h"
 #include "PassManager.h"
+#include "ReferenceUpdateBatch.h"
 #include "Resolver.h"
 #include "Show.h"
 #include "SwitchDispatch.h"
@@ -211,11 +212,6 @@ const DexType* get_replacement_type(const TypeSystem& type_system,
  *
  * CONST_CLASS: also not very common. We don't quite understand
  * the implication of the subsequent reflections.
- *
- * TODO(zwei): update type reference in an arbitrarily nested array
- * type. NEW_ARRAY & FILLED_NEW_ARRAY: are not excluded anymore. But we need to
- * add the machinery to update type reference in an arbitrarily nested array
- * type.
  */
 bool is_opcode_excluded(const IROpcode op) {
   return op == OPCODE_NEW_INSTANCE || op == OPCODE_CONST_CLASS ||
@@ -227,47 +223,25 @@ void remove_interface_references(
     const TypeSystem& type_system,
     const DexType* root,
     const std::unordered_set<const DexType*>& interfaces) {
-
-  auto patcher = [&](DexMethod*, IRInstruction* insn) {
-    if (!insn->has_type()) {
-      return;
-    }
-    const auto ref_type = insn->get_type();
-    auto type = type::get_element_type_if_array(ref_type);
-    if (interfaces.count(type) == 0) {
-      return;
-    }
-    auto opcode = insn->opcode();
-    always_assert_log(!is_opcode_excluded(opcode),
-                      "Unexpected opcode %s on %s\n", SHOW(opcode), SHOW(type));
-    always_assert(type_class(type));
-    auto new_type = get_replacement_type(type_system, type, root);
-    if (type::is_array(ref_type)) {
-      const auto array_merger_type = type::make_array_type(new_type);
-      insn->set_type(array_merger_type);
-      TRACE(RM_INTF,
-            9,
-            " removing %s referencing array type of %s",
-            SHOW(insn),
-            SHOW(type));
-    } else {
-      insn->set_type(const_cast<DexType*>(new_type));
-      TRACE(RM_INTF, 9, " removing %s referencing %s", SHOW(insn), SHOW(type));
-    }
-  };
-
-  walk::parallel::opcodes(scope, patcher);
-
-  std::unordered_map<const DexType*, DexType*> old_to_new;
+  reference_update::Batch batch;
   for (const auto intf : interfaces) {
+    always_assert(type_class(intf));
     auto new_type = get_replacement_type(type_system, intf, root);
-    old_to_new[intf] = const_cast<DexType*>(new_type);
+    batch.add_type(intf, const_cast<DexType*>(new_type));
   }
   auto& parent_to_children =
       type_system.get_class_scopes().get_parent_to_children();
-  update_method_signature_type_references(scope, old_to_new,
-                                          parent_to_children);
-  update_field_type_references(scope, old_to_new);
+  auto stats =
+      batch.apply(scope, parent_to_children, [](const IRInstruction* insn) {
+        always_assert_log(!is_opcode_excluded(insn->opcode()),
+                          "Unexpected opcode %s on %s\n", SHOW(insn->opcode()),
+                          SHOW(insn->get_type()));
+      });
+  TRACE(RM_INTF,
+        5,
+        "updated %zu type and %zu method references to removed interfaces",
+        stats.updated_type_insns,
+        stats.updated_method_insns);
 }
 
 size_t exclude_unremovables(const Scope& scope,
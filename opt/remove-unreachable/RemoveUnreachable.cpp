@@ -7,7 +7,6 @@
 
 #include "RemoveUnreachable.h"
 
-#include <atomic>
 #include <set>
 
 #include "ConfigFiles.h"
@@ -25,40 +24,37 @@ const std::string UNREACHABLE_SYMBOLS_FILENAME =
 
 void root_metrics(DexStoresVector& stores, PassManager& pm) {
   auto scope = build_class_scope(stores);
-  std::atomic<size_t> root_classes{0};
-  std::atomic<size_t> root_methods{0};
-  std::atomic<size_t> root_fields{0};
+  auto& root_classes = pm.counter("root_classes");
+  auto& root_methods = pm.counter("root_methods");
+  auto& root_fields = pm.counter("root_fields");
 
   walk::parallel::classes(scope, [&](const DexClass* cls) {
     if (root(cls)) {
-      root_classes++;
+      root_classes.incr();
     }
 
     for (auto const& f : cls->get_ifields()) {
       if (root(f)) {
-        root_fields++;
+        root_fields.incr();
       }
     }
     for (auto const& f : cls->get_sfields()) {
       if (root(f)) {
-        root_fields++;
+        root_fields.incr();
       }
     }
 
     for (auto const& m : cls->get_dmethods()) {
       if (root(m)) {
-        root_methods++;
+        root_methods.incr();
       }
     }
     for (auto const& m : cls->get_dmethods()) {
       if (root(m)) {
-        root_methods++;
+        root_methods.incr();
       }
     }
   });
-  pm.set_metric("root_classes", root_classes.load());
-  pm.set_metric("root_methods", root_methods.load());
-  pm.set_metric("root_fields", root_fields.load());
 }
 
 } // namespace
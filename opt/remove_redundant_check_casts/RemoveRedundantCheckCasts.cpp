@@ -35,16 +35,26 @@ void RemoveRedundantCheckCastsPass::bind_config() {
   bind("weaken", m_config.weaken, m_config.weaken);
 }
 
-void RemoveRedundantCheckCastsPass::run_pass(DexStoresVector& stores,
-                                             ConfigFiles&,
-                                             PassManager& mgr) {
-  auto scope = build_class_scope(stores);
+void RemoveRedundantCheckCastsPass::begin_walk(DexStoresVector&,
+                                               ConfigFiles&,
+                                               PassManager&) {
+  m_stats.assign(num_workers(), impl::Stats{});
+}
 
-  auto stats =
-      walk::parallel::methods<impl::Stats>(scope, [&](DexMethod* method) {
-        return remove_redundant_check_casts(m_config, method);
-      });
+void RemoveRedundantCheckCastsPass::run_on_method(DexMethod* method,
+                                                  IRCode&,
+                                                  size_t worker_id) {
+  static_cast<impl::Stats&>(m_stats[worker_id]) +=
+      remove_redundant_check_casts(m_config, method);
+}
 
+void RemoveRedundantCheckCastsPass::end_walk(DexStoresVector&,
+                                             ConfigFiles&,
+                                             PassManager& mgr) {
+  impl::Stats stats;
+  for (impl::Stats& worker_stats : m_stats) {
+    stats += worker_stats;
+  }
   mgr.set_metric("num_removed_casts", stats.removed_casts);
   mgr.set_metric("num_replaced_casts", stats.replaced_casts);
   mgr.set_metric("num_weakened_casts", stats.weakened_casts);
@@ -7,20 +7,29 @@
 
 #pragma once
 
+#include <vector>
+
 #include "CheckCastConfig.h"
+#include "CheckCastTransform.h"
 #include "Pass.h"
+#include "Walkers.h"
 
 namespace check_casts {
 
-class RemoveRedundantCheckCastsPass : public Pass {
+class RemoveRedundantCheckCastsPass : public MethodLocalPass {
  public:
-  RemoveRedundantCheckCastsPass() : Pass("RemoveRedundantCheckCastsPass") {}
+  RemoveRedundantCheckCastsPass()
+      : MethodLocalPass("RemoveRedundantCheckCastsPass") {}
 
   void bind_config() override;
-  void run_pass(DexStoresVector&, ConfigFiles&, PassManager&) override;
+  void begin_walk(DexStoresVector&, ConfigFiles&, PassManager&) override;
+  void run_on_method(DexMethod*, IRCode&, size_t worker_id) override;
+  void end_walk(DexStoresVector&, ConfigFiles&, PassManager&) override;
 
  private:
   CheckCastConfig m_config;
+  // Indexed by worker id.
+  std::vector<CacheAligned<impl::Stats>> m_stats;
 };
 
 } // namespace check_casts
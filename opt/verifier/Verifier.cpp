@@ -17,6 +17,7 @@
 #include "ConfigFiles.h"
 #include "DexClass.h"
 #include "DexUtil.h"
+#include "EditableCfgAdapter.h"
 #include "IRInstruction.h"
 #include "ReachableClasses.h"
 #include "Trace.h"
@@ -26,58 +27,73 @@ namespace {
 
 const std::string CLASS_DEPENDENCY_FILENAME = "redex-class-dependencies.txt";
 
-using refs_t = std::unordered_map<const DexClass*,
-                                  std::set<DexClass*, dexclasses_comparator>>;
+using refs_t = std::map<const DexClass*,
+                        std::set<DexClass*, dexclasses_comparator>,
+                        dexclasses_comparator>;
 using class_to_store_map_t = std::unordered_map<const DexClass*, DexStore*>;
 using allowed_store_map_t =
     std::unordered_map<std::string, std::set<std::string>>;
 
+struct merge_refs {
+  void operator()(const refs_t& addend, refs_t* accumulator) const {
+    for (const auto& ref : addend) {
+      (*accumulator)[ref.first].insert(ref.second.begin(), ref.second.end());
+    }
+  }
+};
+
 /**
  * Helper function that scans all the opcodes in the application and produces a
  * map of references from the class containing the opcode to the class
  * referenced by the opcode.
  *
- * @param scope all classes we're processing
- * @param dmethod_refs [out] all refs to dmethods in the application
- * @param class_refs [out] all refs to classes in the application
+ * The scan runs in parallel; every worker fills its own map, and the maps are
+ * merged at the end. As both the map and the sets are ordered, the result does
+ * not depend on the scheduling.
  *
+ * @param scope all classes we're processing
+ * @return all refs to classes in the application
  */
-void build_refs(const Scope& scope, refs_t& class_refs) {
+refs_t build_refs(const Scope& scope) {
   // TODO: walk through annotations
-  walk::opcodes(
-      scope,
-      [](const DexMethod*) { return true; },
-      [&](const DexMethod* meth, IRInstruction* insn) {
-        if (insn->has_type()) {
-          const auto tref = type_class(insn->get_type());
-          if (tref) class_refs[tref].emplace(type_class(meth->get_class()));
-          return;
-        }
-        if (insn->has_field()) {
-          const auto tref = type_class(insn->get_field()->get_class());
-          if (tref) class_refs[tref].emplace(type_class(meth->get_class()));
-          return;
-        }
-        if (insn->has_method()) {
-          // log methods class type, for virtual methods, this may not actually
-          // exist and true verification would require that the binding refers
-          // to a class that is valid.
-          const auto mref = type_class(insn->get_method()->get_class());
-          if (mref) class_refs[mref].emplace(type_class(meth->get_class()));
-
-          // don't log return type or types of parameters for now, but this is
-          // how you might do it.
-          // const auto proto = insn->get_method()->get_proto();
-          // const auto rref = type_class(proto->get_rtype());
-          // if (rref) class_refs[rref].emplace(type_class(meth->get_class()));
-          // for (const auto arg : proto->get_args()->get_type_list()) {
-          //   const auto aref = type_class(arg);
-          //   if (aref)
-          //   class_refs[aref].emplace(type_class(meth->get_class()));
-          // }
-
+  return walk::parallel::methods<refs_t, merge_refs>(
+      scope, [](DexMethod* meth, refs_t* class_refs) {
+        auto code = meth->get_code();
+        if (code == nullptr) {
           return;
         }
+        auto source = type_class(meth->get_class());
+        editable_cfg_adapter::iterate(code, [&](MethodItemEntry& mie) {
+          auto insn = mie.insn;
+          if (insn->has_type()) {
+            const auto tref = type_class(insn->get_type());
+            if (tref) (*class_refs)[tref].emplace(source);
+            return editable_cfg_adapter::LOOP_CONTINUE;
+          }
+          if (insn->has_field()) {
+            const auto tref = type_class(insn->get_field()->get_class());
+            if (tref) (*class_refs)[tref].emplace(source);
+            return editable_cfg_adapter::LOOP_CONTINUE;
+          }
+          if (insn->has_method()) {
+            // log methods class type, for virtual methods, this may not
+            // actually exist and true verification would require that the
+            // binding refers to a class that is valid.
+            const auto mref = type_class(insn->get_method()->get_class());
+            if (mref) (*class_refs)[mref].emplace(source);
+
+            // don't log return type or types of parameters for now, but this
+            // is how you might do it.
+            // const auto proto = insn->get_method()->get_proto();
+            // const auto rref = type_class(proto->get_rtype());
+            // if (rref) (*class_refs)[rref].emplace(source);
+            // for (const auto arg : proto->get_args()->get_type_list()) {
+            //   const auto aref = type_class(arg);
+            //   if (aref) (*class_refs)[aref].emplace(source);
+            // }
+          }
+          return editable_cfg_adapter::LOOP_CONTINUE;
+        });
       });
 }
 
@@ -111,25 +127,26 @@ std::set<std::string> getAllowedStores(DexStoresVector& stores,
 
 void verifyStore(DexStoresVector& stores,
                  DexStore& store,
-                 class_to_store_map_t map,
+                 const class_to_store_map_t& map,
                  const allowed_store_map_t& store_map,
                  FILE* fd) {
-  refs_t class_refs;
   auto scope = build_class_scope(store.get_dexen());
-  build_refs(scope, class_refs);
+  refs_t class_refs = build_refs(scope);
+  std::set<std::string> allowed_stores =
+      getAllowedStores(stores, store, store_map);
   for (auto& ref : class_refs) {
     const auto target = ref.first;
+    std::string target_store_name;
+    auto find = map.find(target);
+    if (find != map.end()) {
+      target_store_name = find->second->get_name();
+    } else {
+      target_store_name = "external";
+    }
+    bool allowed =
+        allowed_stores.find(target_store_name) != allowed_stores.end();
     for (const auto& source : ref.second) {
-      std::string target_store_name;
-      auto find = map.find(target);
-      if (find != map.end()) {
-        target_store_name = find->second->get_name();
-      } else {
-        target_store_name = "external";
-      }
-      std::set<std::string> allowed_stores =
-          getAllowedStores(stores, store, store_map);
-      if (allowed_stores.find(target_store_name) == allowed_stores.end()) {
+      if (!allowed) {
         TRACE(VERIFY, 5, "BAD REFERENCE from %s %s to %s %s",
               store.get_name().c_str(), source->get_deobfuscated_name().c_str(),
               target_store_name.c_str(),
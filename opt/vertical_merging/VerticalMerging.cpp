@@ -8,9 +8,11 @@
 #include "VerticalMerging.h"
 
 #include "ClassHierarchy.h"
+#include "ConcurrentContainers.h"
 #include "DexAnnotation.h"
 #include "DexClass.h"
 #include "DexUtil.h"
+#include "EditableCfgAdapter.h"
 #include "IROpcode.h"
 #include "PassManager.h"
 #include "Resolver.h"
@@ -28,19 +30,20 @@ namespace {
  */
 enum DontMergeState { kConditional, kStrict };
 
-void record_dont_merge_state(
-    const DexType* type,
-    DontMergeState state,
-    std::unordered_map<const DexType*, DontMergeState>* dont_merge_status) {
+// Filled in by all the threads of the scan in record_referenced.
+using DontMergeStatus = ConcurrentMap<const DexType*, DontMergeState>;
+
+void record_dont_merge_state(const DexType* type,
+                             DontMergeState state,
+                             DontMergeStatus* dont_merge_status) {
   auto element_type = type::get_element_type_if_array(type);
-  if (state == kStrict) {
-    (*dont_merge_status)[element_type] = state;
-    return;
-  }
-  const auto& find = dont_merge_status->find(element_type);
-  if (find == dont_merge_status->end() || find->second != kStrict) {
-    (*dont_merge_status)[element_type] = state;
-  }
+  dont_merge_status->update(
+      element_type,
+      [state](const DexType*, DontMergeState& current, bool exists) {
+        if (!exists || current != kStrict) {
+          current = state;
+        }
+      });
 }
 
 /**
@@ -48,7 +51,7 @@ void record_dont_merge_state(
  * should be merged into which class, or not merge at all.
  */
 void check_dont_merge_list(
-    const std::unordered_map<const DexType*, DontMergeState>& dont_merge_status,
+    const DontMergeStatus& dont_merge_status,
     DexClass* child_cls,
     DexClass* parent_cls,
     std::unordered_map<DexClass*, DexClass*>* mergeable_to_merger) {
@@ -219,7 +222,7 @@ void handle_invoke_init(
 void collect_can_merge(
     const Scope& scope,
     const XStoreRefs& xstores,
-    const std::unordered_map<const DexType*, DontMergeState>& dont_merge_status,
+    const DontMergeStatus& dont_merge_status,
     std::unordered_map<DexClass*, DexClass*>* mergeable_to_merger) {
   ClassHierarchy ch = build_type_hierarchy(scope);
   auto throwables = get_all_children(ch, type::java_lang_Throwable());
@@ -255,111 +258,104 @@ void collect_can_merge(
   }
 }
 
-void record_annotation(
-    const Scope& scope,
-    std::unordered_map<const DexType*, DontMergeState>* dont_merge_status) {
+void record_annotation(const DexAnnotationSet* anno_set,
+                       DontMergeStatus* dont_merge_status) {
   // Remove class if it is the type of an annotation.
   // TODO(suree404): Merge the classes even though it appears in annotation?
-  walk::annotations(scope, [&](DexAnnotation* anno) {
-    std::vector<DexType*> types_in_anno;
-    anno->gather_types(types_in_anno);
-    for (const auto& type : types_in_anno) {
-      record_dont_merge_state(type, kStrict, dont_merge_status);
-    }
-  });
+  if (anno_set == nullptr) {
+    return;
+  }
+  std::vector<DexType*> types_in_anno;
+  anno_set->gather_types(types_in_anno);
+  for (const auto& type : types_in_anno) {
+    record_dont_merge_state(type, kStrict, dont_merge_status);
+  }
 }
 
-void record_code_reference(
-    const Scope& scope,
-    std::unordered_map<const DexType*, DontMergeState>* dont_merge_status,
-    std::unordered_set<DexMethod*>* referenced_methods) {
-  walk::opcodes(
-      scope,
-      [](DexMethod* method) { return true; },
-      [&](DexMethod* method, IRInstruction* insn) {
-        std::unordered_set<DexType*> types_to_check;
-        if (insn->has_type()) {
-          types_to_check.emplace(insn->get_type());
-          if (opcode::is_instance_of(insn->opcode())) {
-            // We don't want to merge class if either merger or
-            // mergeable was ever accessed in instance_of to prevent
-            // semantic error.
-            record_dont_merge_state(insn->get_type(), kStrict,
-                                    dont_merge_status);
-            return;
-          }
-        } else if (insn->has_field()) {
-          DexField* field = resolve_field(insn->get_field());
-          if (field != nullptr) {
-            if (field->get_class() != insn->get_field()->get_class() ||
-                !can_rename(field)) {
-              // If a field reference need to be resolved, don't merge as
-              // renaming it might cause problems.
-              // If a field that can't be renamed is being referenced. Don't
-              // merge it as we need the field and this field can't be renamed
-              // if having collision.
-              // TODO(suree404): can improve.
-              record_dont_merge_state(field->get_class(), kConditional,
-                                      dont_merge_status);
-            }
-          } else {
-            record_dont_merge_state(insn->get_field()->get_class(),
-                                    kConditional, dont_merge_status);
-          }
-        } else if (insn->has_method()) {
-          DexMethod* callee =
-              resolve_method(insn->get_method(), MethodSearch::Any);
-          if (callee != nullptr) {
-            if (type_class(method->get_class())->get_super_class() ==
-                    callee->get_class() &&
-                (insn->opcode() == OPCODE_INVOKE_SUPER ||
-                 insn->opcode() == OPCODE_INVOKE_DIRECT)) {
-              // If this method call is invoke-super or invoke-direct
-              // from child class method to parent class method, then this
-              // should be fine as we can relocate the methods.
-              return;
-            }
-            types_to_check.emplace(callee->get_class());
-            // Don't merge an abstract class if its method is invoked through
-            // invoke-virtual, it means we might need to keep both method
-            // in parent and child class, and need to face true-virtual
-            // renaming issue.
-            // TODO(suree404): oportunity to improve this.
-            if (insn->opcode() == OPCODE_INVOKE_VIRTUAL &&
-                callee->get_class() == insn->get_method()->get_class()) {
-              DexClass* callee_class = type_class(callee->get_class());
-              if (callee_class && is_abstract(callee_class)) {
-                record_dont_merge_state(callee->get_class(), kConditional,
-                                        dont_merge_status);
-              }
-            }
-            if ((insn->opcode() == OPCODE_INVOKE_STATIC ||
-                 insn->opcode() == OPCODE_INVOKE_DIRECT) &&
-                type_class(method->get_class())->get_super_class() !=
-                    callee->get_class()) {
-              // Record abstract class's static and direct methods that are
-              // referenced somewhere other than their child class. This means
-              // we need to keep those methods.
-              DexClass* callee_class = type_class(callee->get_class());
-              if (callee_class && is_abstract(callee_class)) {
-                referenced_methods->emplace(callee);
-              }
-            }
-          }
-          types_to_check.emplace(insn->get_method()->get_class());
+void record_code_reference(DexMethod* method,
+                           IRInstruction* insn,
+                           DontMergeStatus* dont_merge_status,
+                           ConcurrentSet<DexMethod*>* referenced_methods) {
+  std::unordered_set<DexType*> types_to_check;
+  if (insn->has_type()) {
+    types_to_check.emplace(insn->get_type());
+    if (opcode::is_instance_of(insn->opcode())) {
+      // We don't want to merge class if either merger or
+      // mergeable was ever accessed in instance_of to prevent
+      // semantic error.
+      record_dont_merge_state(insn->get_type(), kStrict, dont_merge_status);
+      return;
+    }
+  } else if (insn->has_field()) {
+    DexField* field = resolve_field(insn->get_field());
+    if (field != nullptr) {
+      if (field->get_class() != insn->get_field()->get_class() ||
+          !can_rename(field)) {
+        // If a field reference need to be resolved, don't merge as
+        // renaming it might cause problems.
+        // If a field that can't be renamed is being referenced. Don't
+        // merge it as we need the field and this field can't be renamed
+        // if having collision.
+        // TODO(suree404): can improve.
+        record_dont_merge_state(field->get_class(), kConditional,
+                                dont_merge_status);
+      }
+    } else {
+      record_dont_merge_state(insn->get_field()->get_class(),
+                              kConditional, dont_merge_status);
+    }
+  } else if (insn->has_method()) {
+    DexMethod* callee =
+        resolve_method(insn->get_method(), MethodSearch::Any);
+    if (callee != nullptr) {
+      if (type_class(method->get_class())->get_super_class() ==
+              callee->get_class() &&
+          (insn->opcode() == OPCODE_INVOKE_SUPER ||
+           insn->opcode() == OPCODE_INVOKE_DIRECT)) {
+        // If this method call is invoke-super or invoke-direct
+        // from child class method to parent class method, then this
+        // should be fine as we can relocate the methods.
+        return;
+      }
+      types_to_check.emplace(callee->get_class());
+      // Don't merge an abstract class if its method is invoked through
+      // invoke-virtual, it means we might need to keep both method
+      // in parent and child class, and need to face true-virtual
+      // renaming issue.
+      // TODO(suree404): oportunity to improve this.
+      if (insn->opcode() == OPCODE_INVOKE_VIRTUAL &&
+          callee->get_class() == insn->get_method()->get_class()) {
+        DexClass* callee_class = type_class(callee->get_class());
+        if (callee_class && is_abstract(callee_class)) {
+          record_dont_merge_state(callee->get_class(), kConditional,
+                                  dont_merge_status);
         }
-
-        for (auto type_to_check : types_to_check) {
-          const DexType* self_type =
-              type::get_element_type_if_array(type_to_check);
-          DexClass* cls = type_class(self_type);
-          if (cls && !is_abstract(cls)) {
-            // If a type is referenced and not a abstract type then
-            // add it to don't use this type as mergeable.
-            record_dont_merge_state(self_type, kConditional, dont_merge_status);
-          }
+      }
+      if ((insn->opcode() == OPCODE_INVOKE_STATIC ||
+           insn->opcode() == OPCODE_INVOKE_DIRECT) &&
+          type_class(method->get_class())->get_super_class() !=
+              callee->get_class()) {
+        // Record abstract class's static and direct methods that are
+        // referenced somewhere other than their child class. This means
+        // we need to keep those methods.
+        DexClass* callee_class = type_class(callee->get_class());
+        if (callee_class && is_abstract(callee_class)) {
+          referenced_methods->insert(callee);
         }
-      });
+      }
+    }
+    types_to_check.emplace(insn->get_method()->get_class());
+  }
+
+  for (auto type_to_check : types_to_check) {
+    const DexType* self_type = type::get_element_type_if_array(type_to_check);
+    DexClass* cls = type_class(self_type);
+    if (cls && !is_abstract(cls)) {
+      // If a type is referenced and not a abstract type then
+      // add it to don't use this type as mergeable.
+      record_dont_merge_state(self_type, kConditional, dont_merge_status);
+    }
+  }
 }
 
 // Record a type as don't merge as a mergeable if
@@ -369,9 +365,8 @@ void record_code_reference(
 //     have this case. I don't really understand why this case exist in
 //     in singleimpl, so exclude it for now and probably can optimize later.
 //  3. It's in method signature and it is not an abstract class.
-void record_method_signature(
-    const Scope& scope,
-    std::unordered_map<const DexType*, DontMergeState>* dont_merge_status) {
+void record_method_signature(DexMethod* method,
+                             DontMergeStatus* dont_merge_status) {
   auto check_method_sig = [&](const DexType* type, DexMethod* method) {
     bool method_is_native = is_native(method);
     DexType* self_type = method->get_class();
@@ -386,40 +381,32 @@ void record_method_signature(
       }
     }
   };
-  walk::methods(scope, [&](DexMethod* method) {
-    DexProto* proto = method->get_proto();
-    const DexType* rtype = type::get_element_type_if_array(proto->get_rtype());
-    check_method_sig(rtype, method);
-    DexTypeList* args = proto->get_args();
-    for (const DexType* it : args->get_type_list()) {
-      const DexType* extracted_type = type::get_element_type_if_array(it);
-      check_method_sig(extracted_type, method);
-    }
-  });
+  DexProto* proto = method->get_proto();
+  const DexType* rtype = type::get_element_type_if_array(proto->get_rtype());
+  check_method_sig(rtype, method);
+  DexTypeList* args = proto->get_args();
+  for (const DexType* it : args->get_type_list()) {
+    const DexType* extracted_type = type::get_element_type_if_array(it);
+    check_method_sig(extracted_type, method);
+  }
 }
 
-void record_blocklist(
-    const Scope& scope,
-    std::unordered_map<const DexType*, DontMergeState>* dont_merge_status,
-    const std::vector<std::string>& blocklist) {
-  if (blocklist.empty()) {
-    return;
-  }
-  walk::classes(scope, [&](DexClass* cls) {
-    // Mark class in blocklist as kStrict don't merge
-    for (const auto& name : blocklist) {
-      if (strstr(cls->get_name()->c_str(), name.c_str()) != nullptr) {
-        TRACE(VMERGE,
-              5,
-              "%s | %s | %u",
-              SHOW(cls),
-              cls->rstate.str().c_str(),
-              can_delete(cls));
-        record_dont_merge_state(cls->get_type(), kStrict, dont_merge_status);
-        return;
-      }
+void record_blocklist(DexClass* cls,
+                      DontMergeStatus* dont_merge_status,
+                      const std::vector<std::string>& blocklist) {
+  // Mark class in blocklist as kStrict don't merge
+  for (const auto& name : blocklist) {
+    if (strstr(cls->get_name()->c_str(), name.c_str()) != nullptr) {
+      TRACE(VMERGE,
+            5,
+            "%s | %s | %u",
+            SHOW(cls),
+            cls->rstate.str().c_str(),
+            can_delete(cls));
+      record_dont_merge_state(cls->get_type(), kStrict, dont_merge_status);
+      return;
     }
-  });
+  }
 }
 
 /**
@@ -443,27 +430,62 @@ void remove_both_have_clinit(
  * Don't merge a class if it is a field's type and this field can't be
  * renamed.
  */
-void record_field_reference(
-    const Scope& scope,
-    std::unordered_map<const DexType*, DontMergeState>* dont_merge_status) {
-  walk::fields(scope, [&](DexField* field) {
-    if (!can_rename(field)) {
-      record_dont_merge_state(field->get_type(), kConditional,
-                              dont_merge_status);
-    }
-  });
+void record_field_reference(DexField* field,
+                            DontMergeStatus* dont_merge_status) {
+  if (!can_rename(field)) {
+    record_dont_merge_state(field->get_type(), kConditional, dont_merge_status);
+  }
 }
 
-void record_referenced(
-    const Scope& scope,
-    std::unordered_map<const DexType*, DontMergeState>* dont_merge_status,
-    const std::vector<std::string>& blocklist,
-    std::unordered_set<DexMethod*>* referenced_methods) {
-  record_annotation(scope, dont_merge_status);
-  record_code_reference(scope, dont_merge_status, referenced_methods);
-  record_field_reference(scope, dont_merge_status);
-  record_method_signature(scope, dont_merge_status);
-  record_blocklist(scope, dont_merge_status, blocklist);
+/**
+ * Find all the reasons not to merge a type in a single parallel scan over the
+ * classes, which visits every class, field, method and instruction once.
+ */
+void record_referenced(const Scope& scope,
+                       DontMergeStatus* dont_merge_status,
+                       const std::vector<std::string>& blocklist,
+                       std::unordered_set<DexMethod*>* referenced_methods) {
+  ConcurrentSet<DexMethod*> concurrent_referenced_methods;
+  walk::parallel::classes(scope, [&](DexClass* cls) {
+    record_blocklist(cls, dont_merge_status, blocklist);
+    record_annotation(cls->get_anno_set(), dont_merge_status);
+    auto visit_field = [&](DexField* field) {
+      record_annotation(field->get_anno_set(), dont_merge_status);
+      record_field_reference(field, dont_merge_status);
+    };
+    for (auto field : cls->get_ifields()) {
+      visit_field(field);
+    }
+    for (auto field : cls->get_sfields()) {
+      visit_field(field);
+    }
+    auto visit_method = [&](DexMethod* method) {
+      record_annotation(method->get_anno_set(), dont_merge_status);
+      if (method->get_param_anno()) {
+        for (const auto& pair : *method->get_param_anno()) {
+          record_annotation(pair.second, dont_merge_status);
+        }
+      }
+      record_method_signature(method, dont_merge_status);
+      auto code = method->get_code();
+      if (code == nullptr) {
+        return;
+      }
+      editable_cfg_adapter::iterate(code, [&](MethodItemEntry& mie) {
+        record_code_reference(method, mie.insn, dont_merge_status,
+                              &concurrent_referenced_methods);
+        return editable_cfg_adapter::LOOP_CONTINUE;
+      });
+    };
+    for (auto method : cls->get_dmethods()) {
+      visit_method(method);
+    }
+    for (auto method : cls->get_vmethods()) {
+      visit_method(method);
+    }
+  });
+  referenced_methods->insert(concurrent_referenced_methods.begin(),
+                             concurrent_referenced_methods.end());
 }
 
 void move_fields(DexClass* from_cls, DexClass* to_cls) {
@@ -488,11 +510,16 @@ void move_fields(DexClass* from_cls, DexClass* to_cls) {
   }
 }
 
+/**
+ * Rewrite the references to all the merged classes in one parallel walk over
+ * the code, no matter how many pairs got merged.
+ */
 void update_references(const Scope& scope,
                        const std::unordered_map<DexType*, DexType*>& update_map,
                        const std::unordered_map<DexMethodRef*, DexMethodRef*>&
-                           methodref_update_map) {
-  walk::opcodes(
+                           methodref_update_map,
+                       type_reference::TypeRefUpdater* updater) {
+  walk::parallel::opcodes(
       scope,
       [](DexMethod* method) { return true; },
       [&](DexMethod* method, IRInstruction* insn) {
@@ -502,19 +529,7 @@ void update_references(const Scope& scope,
           return;
         }
         if (insn->has_type()) {
-          auto ref_type = insn->get_type();
-          DexType* type =
-              const_cast<DexType*>(type::get_element_type_if_array(ref_type));
-          if (update_map.count(type) == 0) {
-            return;
-          }
-          auto merger_type = update_map.at(type);
-          if (type::is_array(ref_type)) {
-            auto array_merger_type = type::make_array_type(merger_type);
-            insn->set_type(array_merger_type);
-          } else {
-            insn->set_type(const_cast<DexType*>(merger_type));
-          }
+          updater->update_type_reference(insn);
         } else if (insn->has_field()) {
           DexField* field = resolve_field(insn->get_field());
           if (field != nullptr) {
@@ -774,8 +789,8 @@ void VerticalMergingPass::merge_classes(
     merger->combine_annotations_with(mergeable);
     merger->rstate.join_with(mergeable->rstate);
   }
-  update_references(scope, update_map, methodref_update_map);
   type_reference::TypeRefUpdater updater(update_map);
+  update_references(scope, update_map, methodref_update_map, &updater);
   updater.update_methods_fields(scope);
 }
 
@@ -784,7 +799,7 @@ void VerticalMergingPass::run_pass(DexStoresVector& stores,
                                    PassManager& mgr) {
   auto scope = build_class_scope(stores);
 
-  std::unordered_map<const DexType*, DontMergeState> dont_merge_status;
+  DontMergeStatus dont_merge_status;
   std::unordered_set<DexMethod*> referenced_methods;
   record_referenced(scope, &dont_merge_status, m_blocklist,
                     &referenced_methods);
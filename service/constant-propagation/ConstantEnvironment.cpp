@@ -8,8 +8,9 @@
 #include "ConstantEnvironment.h"
 
 int64_t SignedConstantDomain::max_element() const {
-  if (constant_domain().is_value()) {
-    return *constant_domain().get_constant();
+  auto cst = get_constant();
+  if (cst) {
+    return *cst;
   }
   switch (interval()) {
   case sign_domain::Interval::EMPTY:
@@ -30,8 +31,9 @@ int64_t SignedConstantDomain::max_element() const {
 }
 
 int64_t SignedConstantDomain::min_element() const {
-  if (constant_domain().is_value()) {
-    return *constant_domain().get_constant();
+  auto cst = get_constant();
+  if (cst) {
+    return *cst;
   }
   switch (interval()) {
   case sign_domain::Interval::EMPTY:
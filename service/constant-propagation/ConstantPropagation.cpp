@@ -9,29 +9,28 @@
 
 #include "ConstantPropagationAnalysis.h"
 #include "ConstantPropagationTransform.h"
+#include "SparseConstantPropagation.h"
 
 #include "Trace.h"
 #include "Walkers.h"
 
 namespace constant_propagation {
 
-Transform::Stats ConstantPropagation::run(DexMethod* method,
-                                          XStoreRefs* xstores) {
-  if (method->get_code() == nullptr) {
-    return Transform::Stats();
-  }
-  TRACE(CONSTP, 2, "Method: %s", SHOW(method));
+namespace {
+
+template <class Iterator>
+Transform::Stats run_on_code(const Config& config,
+                             DexMethod* method,
+                             XStoreRefs* xstores) {
   auto code = method->get_code();
   code->build_cfg(/* editable */ false);
-  auto& cfg = code->cfg();
 
   TRACE(CONSTP, 5, "CFG: %s", SHOW(code->cfg()));
   Transform::Stats local_stats;
   {
-    intraprocedural::FixpointIterator fp_iter(code->cfg(),
-                                              ConstantPrimitiveAnalyzer());
+    Iterator fp_iter(code->cfg(), ConstantPrimitiveAnalyzer());
     fp_iter.run(ConstantEnvironment());
-    constant_propagation::Transform tf(m_config.transform);
+    constant_propagation::Transform tf(config.transform);
     local_stats = tf.apply_on_uneditable_cfg(
         fp_iter, WholeProgramState(), code, xstores, method->get_class());
   }
@@ -40,10 +39,9 @@ Transform::Stats ConstantPropagation::run(DexMethod* method,
     code->build_cfg(/* editable */ true);
     code->cfg().calculate_exit_block();
     {
-      intraprocedural::FixpointIterator fp_iter(code->cfg(),
-                                                ConstantPrimitiveAnalyzer());
+      Iterator fp_iter(code->cfg(), ConstantPrimitiveAnalyzer());
       fp_iter.run(ConstantEnvironment());
-      constant_propagation::Transform tf(m_config.transform);
+      constant_propagation::Transform tf(config.transform);
       local_stats += tf.apply(fp_iter, code->cfg(), method, xstores);
     }
     code->clear_cfg();
@@ -51,6 +49,22 @@ Transform::Stats ConstantPropagation::run(DexMethod* method,
   return local_stats;
 }
 
+} // namespace
+
+Transform::Stats ConstantPropagation::run(DexMethod* method,
+                                          XStoreRefs* xstores) {
+  if (method->get_code() == nullptr) {
+    return Transform::Stats();
+  }
+  TRACE(CONSTP, 2, "Method: %s", SHOW(method));
+  if (m_config.use_sparse_engine) {
+    return run_on_code<intraprocedural::SparseFixpointIterator>(
+        m_config, method, xstores);
+  }
+  return run_on_code<intraprocedural::FixpointIterator>(m_config, method,
+                                                        xstores);
+}
+
 Transform::Stats ConstantPropagation::run(const Scope& scope,
                                           XStoreRefs* xstores) {
   return walk::parallel::methods<Transform::Stats>(
@@ -14,6 +14,10 @@ namespace constant_propagation {
 
 struct Config {
   Transform::Config transform;
+  // Analyze the methods with SparseFixpointIterator instead of
+  // FixpointIterator. The results are the same, but it keeps one value per
+  // SSA definition instead of a whole environment per block.
+  bool use_sparse_engine{false};
 };
 
 class ConstantPropagation final {
@@ -1063,10 +1063,16 @@ void FixpointIterator::analyze_instruction(const IRInstruction* insn,
 
 void FixpointIterator::analyze_instruction_no_throw(
     const IRInstruction* insn, ConstantEnvironment* current_state) const {
+  refine_no_throw(insn, current_state, m_kotlin_null_check_assertions);
+}
+
+void refine_no_throw(
+    const IRInstruction* insn,
+    ConstantEnvironment* current_state,
+    const std::unordered_set<DexMethodRef*>& kotlin_null_check_assertions) {
   auto src_index = get_dereferenced_object_src_index(insn);
   if (!src_index) {
-    src_index =
-        get_null_check_object_index(insn, m_kotlin_null_check_assertions);
+    src_index = get_null_check_object_index(insn, kotlin_null_check_assertions);
   }
   if (!src_index) {
     return;
@@ -1201,6 +1207,14 @@ static void analyze_if(const IRInstruction* insn,
 
 ConstantEnvironment FixpointIterator::analyze_edge(
     const EdgeId& edge, const ConstantEnvironment& exit_state_at_source) const {
+  return refine_edge(
+      edge, exit_state_at_source, m_kotlin_null_check_assertions);
+}
+
+ConstantEnvironment refine_edge(
+    const cfg::Edge* edge,
+    const ConstantEnvironment& exit_state_at_source,
+    const std::unordered_set<DexMethodRef*>& kotlin_null_check_assertions) {
   auto env = exit_state_at_source;
   auto last_insn_it = edge->src()->get_last_insn();
   if (last_insn_it == edge->src()->end()) {
@@ -1231,7 +1245,7 @@ ConstantEnvironment FixpointIterator::analyze_edge(
       }
     }
   } else if (edge->type() != cfg::EDGE_THROW) {
-    analyze_instruction_no_throw(insn, &env);
+    refine_no_throw(insn, &env, kotlin_null_check_assertions);
   }
   return env;
 }
@@ -33,6 +33,27 @@ boost::optional<size_t> get_null_check_object_index(
 
 namespace intraprocedural {
 
+/*
+ * The parts of the analysis that don't depend on the instruction analyzer,
+ * shared by FixpointIterator and SparseFixpointIterator.
+ *
+ * After an instruction that didn't throw, the object it dereferenced can't be
+ * null.
+ */
+void refine_no_throw(
+    const IRInstruction* insn,
+    ConstantEnvironment* current_state,
+    const std::unordered_set<DexMethodRef*>& kotlin_null_check_assertions);
+
+/*
+ * Returns the environment on `edge`, given the one at the end of its source
+ * block. It is bottom if the edge can't be taken.
+ */
+ConstantEnvironment refine_edge(
+    const cfg::Edge* edge,
+    const ConstantEnvironment& exit_state_at_source,
+    const std::unordered_set<DexMethodRef*>& kotlin_null_check_assertions);
+
 class FixpointIterator final
     : public sparta::MonotonicFixpointIterator<cfg::GraphInterface,
                                                ConstantEnvironment> {
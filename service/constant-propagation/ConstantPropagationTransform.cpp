@@ -8,6 +8,7 @@
 #include "ConstantPropagationTransform.h"
 
 #include "ReachingDefinitions.h"
+#include "SparseConstantPropagation.h"
 #include "Trace.h"
 #include "Transform.h"
 #include "TypeInference.h"
@@ -325,8 +326,9 @@ void Transform::remove_dead_switch(const ConstantEnvironment& env,
  * whether it is dead (i.e. whether the branch always taken or never taken).
  * If it is, we can replace it with either a nop or a goto.
  */
+template <class Iterator>
 void Transform::eliminate_dead_branch(
-    const intraprocedural::FixpointIterator& intra_cp,
+    const Iterator& intra_cp,
     const ConstantEnvironment& env,
     cfg::ControlFlowGraph& cfg,
     cfg::Block* block) {
@@ -439,8 +441,9 @@ void Transform::apply_changes(IRCode* code) {
   }
 }
 
+template <class Iterator>
 Transform::Stats Transform::apply_on_uneditable_cfg(
-    const intraprocedural::FixpointIterator& intra_cp,
+    const Iterator& intra_cp,
     const WholeProgramState& wps,
     IRCode* code,
     const XStoreRefs* xstores,
@@ -473,8 +476,9 @@ Transform::Stats Transform::apply_on_uneditable_cfg(
   return m_stats;
 }
 
+template <class Iterator>
 void Transform::forward_targets(
-    const intraprocedural::FixpointIterator& intra_cp,
+    const Iterator& intra_cp,
     const ConstantEnvironment& env,
     cfg::ControlFlowGraph& cfg,
     cfg::Block* block,
@@ -731,8 +735,9 @@ bool Transform::has_problematic_return(cfg::ControlFlowGraph& cfg,
   return false;
 }
 
+template <class Iterator>
 Transform::Stats Transform::apply(
-    const intraprocedural::FixpointIterator& intra_cp,
+    const Iterator& intra_cp,
     cfg::ControlFlowGraph& cfg,
     DexMethod* method,
     const XStoreRefs* xstores) {
@@ -754,4 +759,28 @@ Transform::Stats Transform::apply(
   return m_stats;
 }
 
+template Transform::Stats Transform::apply_on_uneditable_cfg(
+    const intraprocedural::FixpointIterator&,
+    const WholeProgramState&,
+    IRCode*,
+    const XStoreRefs*,
+    const DexType*);
+template Transform::Stats Transform::apply_on_uneditable_cfg(
+    const intraprocedural::SparseFixpointIterator&,
+    const WholeProgramState&,
+    IRCode*,
+    const XStoreRefs*,
+    const DexType*);
+
+template Transform::Stats Transform::apply(
+    const intraprocedural::FixpointIterator&,
+    cfg::ControlFlowGraph&,
+    DexMethod*,
+    const XStoreRefs*);
+template Transform::Stats Transform::apply(
+    const intraprocedural::SparseFixpointIterator&,
+    cfg::ControlFlowGraph&,
+    DexMethod*,
+    const XStoreRefs*);
+
 } // namespace constant_propagation
@@ -56,16 +56,21 @@ class Transform final {
       : m_config(config),
         m_kotlin_null_check_assertions(get_kotlin_null_assertions()) {}
 
+  // The Iterator is either intraprocedural::FixpointIterator or
+  // intraprocedural::SparseFixpointIterator; both are instantiated in the .cpp.
+
   // Apply transformations on uneditable cfg
   // TODO: Migrate all to use editable cfg via `apply` method
-  Stats apply_on_uneditable_cfg(const intraprocedural::FixpointIterator&,
+  template <class Iterator>
+  Stats apply_on_uneditable_cfg(const Iterator&,
                                 const WholeProgramState&,
                                 IRCode*,
                                 const XStoreRefs*,
                                 const DexType*);
 
   // Apply (new) transformations on editable cfg
-  Stats apply(const intraprocedural::FixpointIterator&,
+  template <class Iterator>
+  Stats apply(const Iterator&,
               cfg::ControlFlowGraph&,
               DexMethod*,
               const XStoreRefs*);
@@ -108,13 +113,15 @@ class Transform final {
                           cfg::ControlFlowGraph&,
                           cfg::Block*);
 
-  void eliminate_dead_branch(const intraprocedural::FixpointIterator&,
+  template <class Iterator>
+  void eliminate_dead_branch(const Iterator&,
                              const ConstantEnvironment&,
                              cfg::ControlFlowGraph&,
                              cfg::Block*);
 
+  template <class Iterator>
   void forward_targets(
-      const intraprocedural::FixpointIterator&,
+      const Iterator&,
       const ConstantEnvironment&,
       cfg::ControlFlowGraph&,
       cfg::Block*,
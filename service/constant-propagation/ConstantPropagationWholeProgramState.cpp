@@ -65,11 +65,8 @@ void analyze_clinits(const Scope& scope,
                               FieldType::STATIC, field_partition);
       continue;
     }
-    IRCode* code = clinit->get_code();
-    auto& cfg = code->cfg();
-    auto intra_cp = fp_iter.get_intraprocedural_analysis(clinit);
-    auto env = intra_cp->get_exit_state_at(cfg.exit_block());
-    set_fields_in_partition(cls, env.get_field_environment(), FieldType::STATIC,
+    auto summary = fp_iter.get_method_summary(clinit);
+    set_fields_in_partition(cls, summary->clinit_field_env, FieldType::STATIC,
                             field_partition);
   }
 }
@@ -153,31 +150,33 @@ WholeProgramState::WholeProgramState(
 /*
  * Walk over the entire program, doing a join over the values written to each
  * field, as well as a join over the values returned by each method.
+ *
+ * If there are no reachable return opcodes in a method, then it never
+ * returns. Its return value will be represented by Bottom in our analysis.
  */
 void WholeProgramState::collect(
     const Scope& scope, const interprocedural::FixpointIterator& fp_iter) {
   initialize_ifields(scope, &m_field_partition);
   ConcurrentMap<const DexField*, std::vector<ConstantValue>> fields_value_tmp;
-  ConcurrentMap<const DexMethod*, std::vector<ConstantValue>> methods_value_tmp;
+  ConcurrentMap<const DexMethod*, ConstantValue> methods_value_tmp;
   walk::parallel::methods(scope, [&](DexMethod* method) {
-    IRCode* code = method->get_code();
-    if (code == nullptr) {
+    if (method->get_code() == nullptr) {
       return;
     }
-    auto& cfg = code->cfg();
-    auto intra_cp = fp_iter.get_intraprocedural_analysis(method);
-    for (cfg::Block* b : cfg.blocks()) {
-      auto env = intra_cp->get_entry_state_at(b);
-      auto last_insn = b->get_last_insn();
-      for (auto& mie : InstructionIterable(b)) {
-        auto* insn = mie.insn;
-        intra_cp->analyze_instruction(insn, &env, insn == last_insn->insn);
-        collect_field_values(insn, env,
-                             method::is_clinit(method) ? method->get_class()
-                                                       : nullptr,
-                             &fields_value_tmp);
-        collect_return_values(insn, env, method, &methods_value_tmp);
+    auto summary = fp_iter.get_method_summary(method);
+    for (const auto& pair : summary->field_values) {
+      if (!m_known_fields.count(pair.first)) {
+        continue;
       }
+      fields_value_tmp.update(pair.first,
+                              [&pair](const DexField*,
+                                      std::vector<ConstantValue>& s,
+                                      bool /* exists */) {
+                                s.emplace_back(pair.second);
+                              });
+    }
+    if (!summary->return_value.is_bottom()) {
+      methods_value_tmp.emplace(method, summary->return_value);
     }
   });
   for (const auto& pair : fields_value_tmp) {
@@ -188,82 +187,10 @@ void WholeProgramState::collect(
     }
   }
   for (const auto& pair : methods_value_tmp) {
-    for (auto& value : pair.second) {
-      m_method_partition.update(pair.first, [&value](auto* current_value) {
-        current_value->join_with(value);
-      });
-    }
-  }
-}
-
-/*
- * For each field, do a join over all the values that may have been
- * written to it at any point in the program.
- *
- * If we are encountering a static field write of some value to Foo.someField
- * in the body of Foo.<clinit>, don't do anything -- that value will only be
- * visible to other methods if it remains unchanged up until the end of the
- * <clinit>. In that case, analyze_clinits() will record it.
- */
-void WholeProgramState::collect_field_values(
-    const IRInstruction* insn,
-    const ConstantEnvironment& env,
-    const DexType* clinit_cls,
-    ConcurrentMap<const DexField*, std::vector<ConstantValue>>*
-        fields_value_tmp) {
-  if (!opcode::is_an_sput(insn->opcode()) &&
-      !opcode::is_an_iput(insn->opcode())) {
-    return;
-  }
-  auto field = resolve_field(insn->get_field());
-  if (field != nullptr && m_known_fields.count(field)) {
-    if (opcode::is_an_sput(insn->opcode()) &&
-        field->get_class() == clinit_cls) {
-      return;
-    }
-    auto value = env.get(insn->src(0));
-    fields_value_tmp->update(
-        field,
-        [value](const DexField*,
-                std::vector<ConstantValue>& s,
-                bool /* exists */) { s.emplace_back(value); });
-  }
-}
-
-/*
- * For each method, do a join over all the values that can be returned by it.
- *
- * If there are no reachable return opcodes in the method, then it never
- * returns. Its return value will be represented by Bottom in our analysis.
- */
-void WholeProgramState::collect_return_values(
-    const IRInstruction* insn,
-    const ConstantEnvironment& env,
-    const DexMethod* method,
-    ConcurrentMap<const DexMethod*, std::vector<ConstantValue>>*
-        methods_value_tmp) {
-  auto op = insn->opcode();
-  if (!opcode::is_a_return(op)) {
-    return;
-  }
-  if (op == OPCODE_RETURN_VOID) {
-    // We must set the binding to Top here to record the fact that this method
-    // does indeed return -- even though `void` is not actually a return value,
-    // this tells us that the code following any invoke of this method is
-    // reachable.
-    methods_value_tmp->update(
-        method,
-        [](const DexMethod*, std::vector<ConstantValue>& s, bool /* exists */) {
-          s.emplace_back(ConstantValue::top());
-        });
-    return;
+    m_method_partition.update(pair.first, [&pair](auto* current_value) {
+      current_value->join_with(pair.second);
+    });
   }
-  auto value = env.get(insn->src(0));
-  methods_value_tmp->update(
-      method,
-      [value](const DexMethod*,
-              std::vector<ConstantValue>& s,
-              bool /* exists */) { s.emplace_back(value); });
 }
 
 void WholeProgramState::collect_static_finals(const DexClass* cls,
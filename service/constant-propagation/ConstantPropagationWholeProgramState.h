@@ -109,18 +109,6 @@ class WholeProgramState {
   void collect(const Scope& scope,
                const interprocedural::FixpointIterator& fp_iter);
 
-  void collect_field_values(
-      const IRInstruction* insn,
-      const ConstantEnvironment& env,
-      const DexType* clinit_cls,
-      ConcurrentMap<const DexField*, std::vector<ConstantValue>>* field_tmp);
-
-  void collect_return_values(
-      const IRInstruction* insn,
-      const ConstantEnvironment& env,
-      const DexMethod* method,
-      ConcurrentMap<const DexMethod*, std::vector<ConstantValue>>* method_tmp);
-
   // Unknown fields and methods will be treated as containing / returning Top.
   std::unordered_set<const DexField*> m_known_fields;
   std::unordered_set<const DexMethod*> m_known_methods;
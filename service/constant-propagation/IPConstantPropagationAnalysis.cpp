@@ -7,6 +7,11 @@
 
 #include "IPConstantPropagationAnalysis.h"
 
+#include <algorithm>
+
+#include "Resolver.h"
+#include "Trace.h"
+
 namespace constant_propagation {
 
 namespace interprocedural {
@@ -42,38 +47,13 @@ void FixpointIterator::analyze_node(call_graph::NodeId const& node,
   if (method == nullptr) {
     return;
   }
-  auto code = method->get_code();
-  if (code == nullptr) {
+  if (method->get_code() == nullptr) {
     return;
   }
-  auto& cfg = code->cfg();
-  auto intra_cp = get_intraprocedural_analysis(method);
-  const auto outgoing_edges =
-      call_graph::GraphInterface::successors(m_call_graph, node);
-  std::unordered_set<IRInstruction*> outgoing_insns;
-  for (const auto& edge : outgoing_edges) {
-    if (edge->callee() == m_call_graph.exit()) {
-      continue; // ghost edge to the ghost exit node
-    }
-    outgoing_insns.emplace(edge->invoke_iterator()->insn);
-  }
-  for (auto* block : cfg.blocks()) {
-    auto state = intra_cp->get_entry_state_at(block);
-    auto last_insn = block->get_last_insn();
-    for (auto& mie : InstructionIterable(block)) {
-      auto* insn = mie.insn;
-      auto op = insn->opcode();
-      if (insn->has_method()) {
-        if (outgoing_insns.count(insn)) {
-          ArgumentDomain out_args;
-          for (size_t i = 0; i < insn->srcs_size(); ++i) {
-            out_args.set(i, state.get(insn->src(i)));
-          }
-          current_state->set(insn, out_args);
-        }
-      }
-      intra_cp->analyze_instruction(insn, &state, insn == last_insn->insn);
-    }
+  auto summary =
+      get_method_summary(method, current_state->get(CURRENT_PARTITION_LABEL));
+  for (const auto& pair : summary->callsite_args) {
+    current_state->set(pair.first, pair.second);
   }
 }
 
@@ -105,6 +85,145 @@ FixpointIterator::get_intraprocedural_analysis(const DexMethod* method) const {
                                  args.get(CURRENT_PARTITION_LABEL));
 }
 
+std::shared_ptr<const MethodSummary> FixpointIterator::get_method_summary(
+    const DexMethod* method) const {
+  auto args = Domain::bottom();
+  if (m_call_graph.has_node(method)) {
+    args = this->get_entry_state_at(m_call_graph.node(method));
+  }
+  return get_method_summary(method, args.get(CURRENT_PARTITION_LABEL));
+}
+
+std::shared_ptr<const MethodSummary> FixpointIterator::get_method_summary(
+    const DexMethod* method, const ArgumentDomain& args) const {
+  auto summary = m_summaries.get(method, nullptr);
+  if (summary != nullptr && summary->args.equals(args)) {
+    ++m_reused_summaries;
+    return summary;
+  }
+  ++m_analyzed_methods;
+  summary = summarize(method, args);
+  m_summaries.insert_or_assign(std::make_pair(method, summary));
+  return summary;
+}
+
+std::shared_ptr<const MethodSummary> FixpointIterator::summarize(
+    const DexMethod* method, const ArgumentDomain& args) const {
+  auto summary = std::make_shared<MethodSummary>();
+  summary->args = args;
+  auto& cfg = method->get_code()->cfg();
+  auto intra_cp = m_proc_analysis_factory(method, *m_wps, args);
+
+  std::unordered_set<IRInstruction*> outgoing_insns;
+  if (m_call_graph.has_node(method)) {
+    const auto outgoing_edges = call_graph::GraphInterface::successors(
+        m_call_graph, m_call_graph.node(method));
+    for (const auto& edge : outgoing_edges) {
+      if (edge->callee() == m_call_graph.exit()) {
+        continue; // ghost edge to the ghost exit node
+      }
+      outgoing_insns.emplace(edge->invoke_iterator()->insn);
+    }
+  }
+  auto clinit_cls =
+      method::is_clinit(method) ? method->get_class() : nullptr;
+  std::unordered_set<const DexField*> read_fields;
+  std::unordered_set<const DexMethod*> read_methods;
+  for (auto* block : cfg.blocks()) {
+    auto state = intra_cp->get_entry_state_at(block);
+    auto last_insn = block->get_last_insn();
+    for (auto& mie : InstructionIterable(block)) {
+      auto* insn = mie.insn;
+      auto op = insn->opcode();
+      if (insn->has_method() && outgoing_insns.count(insn)) {
+        ArgumentDomain out_args;
+        for (size_t i = 0; i < insn->srcs_size(); ++i) {
+          out_args.set(i, state.get(insn->src(i)));
+        }
+        summary->callsite_args.emplace(insn, out_args);
+      }
+      // The same resolution as WholeProgramAwareAnalyzer's.
+      if (opcode::is_an_sget(op) || opcode::is_an_iget(op)) {
+        auto field = resolve_field(insn->get_field());
+        if (field != nullptr) {
+          read_fields.insert(field);
+        }
+      } else if (op == OPCODE_INVOKE_DIRECT || op == OPCODE_INVOKE_STATIC ||
+                 op == OPCODE_INVOKE_VIRTUAL) {
+        auto callee =
+            resolve_method(insn->get_method(), opcode_to_search(insn));
+        if (callee != nullptr) {
+          read_methods.insert(callee);
+        }
+      }
+      intra_cp->analyze_instruction(insn, &state, insn == last_insn->insn);
+      if (op == OPCODE_RETURN_VOID) {
+        // Even though `void` is not actually a return value, Top tells us that
+        // the code following any invoke of this method is reachable.
+        summary->return_value = ConstantValue::top();
+        continue;
+      }
+      if (state.is_bottom()) {
+        continue;
+      }
+      // If we are encountering a static field write of some value to
+      // Foo.someField in the body of Foo.<clinit>, don't record it -- that
+      // value will only be visible to other methods if it remains unchanged up
+      // until the end of the <clinit>, which clinit_field_env records.
+      if (opcode::is_an_sput(op) || opcode::is_an_iput(op)) {
+        auto field = resolve_field(insn->get_field());
+        if (field != nullptr &&
+            !(opcode::is_an_sput(op) && field->get_class() == clinit_cls)) {
+          auto value = state.get(insn->src(0));
+          auto it = summary->field_values.find(field);
+          if (it == summary->field_values.end()) {
+            summary->field_values.emplace(field, value);
+          } else {
+            it->second.join_with(value);
+          }
+        }
+      } else if (opcode::is_a_return(op)) {
+        summary->return_value.join_with(state.get(insn->src(0)));
+      }
+    }
+  }
+  if (clinit_cls != nullptr) {
+    summary->clinit_field_env =
+        intra_cp->get_exit_state_at(cfg.exit_block()).get_field_environment();
+  }
+  summary->read_fields.assign(read_fields.begin(), read_fields.end());
+  summary->read_methods.assign(read_methods.begin(), read_methods.end());
+  return summary;
+}
+
+void FixpointIterator::set_whole_program_state(
+    std::unique_ptr<WholeProgramState> wps) {
+  auto field_changed = [&](const DexField* field) {
+    return !m_wps->get_field_value(field).equals(wps->get_field_value(field));
+  };
+  auto return_value_changed = [&](const DexMethod* method) {
+    return !m_wps->get_return_value(method).equals(
+        wps->get_return_value(method));
+  };
+  std::vector<const DexMethod*> stale;
+  for (const auto& pair : m_summaries) {
+    const auto& summary = *pair.second;
+    if (std::any_of(summary.read_fields.begin(), summary.read_fields.end(),
+                    field_changed) ||
+        std::any_of(summary.read_methods.begin(), summary.read_methods.end(),
+                    return_value_changed)) {
+      stale.push_back(pair.first);
+    }
+  }
+  for (auto method : stale) {
+    m_summaries.erase(method);
+  }
+  m_invalidated_summaries += stale.size();
+  TRACE(ICONSTP, 2, "Invalidated %zu of %zu method summaries", stale.size(),
+        m_summaries.size() + stale.size());
+  m_wps = std::move(wps);
+}
+
 } // namespace interprocedural
 
 void set_encoded_values(const DexClass* cls, ConstantEnvironment* env) {
@@ -7,7 +7,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 #include "CallGraph.h"
+#include "ConcurrentContainers.h"
 #include "ConstantEnvironment.h"
 #include "ConstantPropagationAnalysis.h"
 #include "ConstantPropagationWholeProgramState.h"
@@ -55,6 +61,29 @@ ConstantEnvironment env_with_params(bool is_static,
                                     const IRCode* code,
                                     const ArgumentDomain& args);
 
+/*
+ * What the rest of the interprocedural analysis needs from the analysis of a
+ * method. It is a function of the arguments of the method and of the values
+ * that the WholeProgramState gives to the fields the method reads and to the
+ * methods it calls, so it stays valid from one refinement of the
+ * WholeProgramState to the next as long as none of those values change.
+ */
+struct MethodSummary {
+  // The arguments that the method was analyzed with.
+  ArgumentDomain args;
+  // The arguments passed at each of the callsites in the call graph.
+  std::unordered_map<const IRInstruction*, ArgumentDomain> callsite_args;
+  // The join of the values written to each field.
+  std::unordered_map<const DexField*, ConstantValue> field_values;
+  // The join of the returned values, Bottom if the method never returns.
+  ConstantValue return_value{ConstantValue::bottom()};
+  // The values of the fields at the exit of a <clinit>.
+  FieldEnvironment clinit_field_env;
+  // The fields and methods whose values in the WholeProgramState were used.
+  std::vector<const DexField*> read_fields;
+  std::vector<const DexMethod*> read_methods;
+};
+
 using ProcedureAnalysisFactory =
     std::function<std::unique_ptr<intraprocedural::FixpointIterator>(
         const DexMethod*, const WholeProgramState&, ArgumentDomain)>;
@@ -88,18 +117,49 @@ class FixpointIterator : public sparta::ParallelMonotonicFixpointIterator<
   std::unique_ptr<intraprocedural::FixpointIterator>
   get_intraprocedural_analysis(const DexMethod*) const;
 
+  /*
+   * The summary of the method with its current entry state. The summaries are
+   * kept across runs: the method is only analyzed again if its arguments
+   * changed, or if set_whole_program_state() changed a value it reads.
+   */
+  std::shared_ptr<const MethodSummary> get_method_summary(
+      const DexMethod*) const;
+
   const WholeProgramState& get_whole_program_state() const { return *m_wps; }
 
-  void set_whole_program_state(std::unique_ptr<WholeProgramState> wps) {
-    m_wps = std::move(wps);
-  }
+  /*
+   * Drops the summaries that read a field or method value that differs in the
+   * new WholeProgramState.
+   */
+  void set_whole_program_state(std::unique_ptr<WholeProgramState> wps);
 
   const call_graph::Graph& get_call_graph() { return m_call_graph; }
 
+  struct SummaryStats {
+    size_t analyzed_methods{0};
+    size_t reused_summaries{0};
+    size_t invalidated_summaries{0};
+  };
+
+  SummaryStats get_summary_stats() const {
+    return {m_analyzed_methods, m_reused_summaries, m_invalidated_summaries};
+  }
+
  private:
+  std::shared_ptr<const MethodSummary> get_method_summary(
+      const DexMethod*, const ArgumentDomain& args) const;
+
+  std::shared_ptr<const MethodSummary> summarize(
+      const DexMethod*, const ArgumentDomain& args) const;
+
   std::unique_ptr<const WholeProgramState> m_wps;
   ProcedureAnalysisFactory m_proc_analysis_factory;
   call_graph::Graph m_call_graph;
+  mutable ConcurrentMap<const DexMethod*, std::shared_ptr<const MethodSummary>>
+      m_summaries;
+  mutable std::atomic<size_t> m_analyzed_methods{0};
+  mutable std::atomic<size_t> m_reused_summaries{0};
+  size_t m_invalidated_summaries{0};
 };
 
 } // namespace interprocedural
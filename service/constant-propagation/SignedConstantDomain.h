@@ -7,60 +7,140 @@
 
 #pragma once
 
+#include <boost/optional.hpp>
+#include <ostream>
+
 #include "ConstantAbstractDomain.h"
-#include "ReducedProductAbstractDomain.h"
+#include "Debug.h"
 #include "SignDomain.h"
 
 using ConstantDomain = sparta::ConstantAbstractDomain<int64_t>;
 
-class SignedConstantDomain
-    : public sparta::ReducedProductAbstractDomain<SignedConstantDomain,
-                                                  sign_domain::Domain,
-                                                  ConstantDomain> {
+/*
+ * The reduced product of sign_domain::Domain and ConstantDomain.
+ *
+ * Environments copy and join these values all the time, so rather than a
+ * tuple of the two domains, each value is packed into a 64-bit constant and a
+ * byte of flags. The sign intervals are exactly the subsets of
+ * {negative, zero, positive}, so they are encoded as three bits, and join,
+ * meet and leq are bitwise operations on them. A fourth bit says whether the
+ * value is a single constant. The encoding is kept canonical, so that
+ * equality is a comparison of the fields:
+ *   - Bottom has no bits set;
+ *   - a constant has the constant bit and the bit of its sign set;
+ *   - EQZ is the constant 0;
+ *   - the constant field is 0 for the values that aren't constants.
+ */
+class SignedConstantDomain final
+    : public sparta::AbstractDomain<SignedConstantDomain> {
  public:
-  using ReducedProductAbstractDomain::ReducedProductAbstractDomain;
-
-  // Some older compilers complain that the class is not default constructible.
-  // We intended to use the default constructors of the base class (via the
-  // `using` declaration above), but some compilers fail to catch this. So we
-  // insert a redundant '= default'.
+  // Top.
   SignedConstantDomain() = default;
 
   explicit SignedConstantDomain(int64_t v)
-      : SignedConstantDomain(
-            std::make_tuple(sign_domain::Domain::top(), ConstantDomain(v))) {}
+      : m_constant(v), m_bits(kConstant | sign_bits(v)) {}
 
   explicit SignedConstantDomain(sign_domain::Interval interval)
-      : SignedConstantDomain(std::make_tuple(sign_domain::Domain(interval),
-                                             ConstantDomain::top())) {}
-
-  static void reduce_product(
-      std::tuple<sign_domain::Domain, ConstantDomain>& domains) {
-    auto& sdom = std::get<0>(domains);
-    auto& cdom = std::get<1>(domains);
-    if (sdom.element() == sign_domain::Interval::EQZ) {
-      cdom.meet_with(ConstantDomain(0));
-      return;
-    }
-    auto cst = cdom.get_constant();
-    if (!cst) {
-      return;
-    }
-    if (!sign_domain::contains(sdom.element(), *cst)) {
-      sdom.set_to_bottom();
-      return;
-    }
-    sdom.meet_with(sign_domain::from_int(*cst));
+      : m_bits(interval_bits(interval)) {
+    normalize();
+  }
+
+  static SignedConstantDomain bottom() {
+    SignedConstantDomain result;
+    result.set_to_bottom();
+    return result;
   }
 
-  sign_domain::Domain interval_domain() const { return get<0>(); }
+  static SignedConstantDomain top() { return SignedConstantDomain(); }
+
+  bool is_bottom() const override { return m_bits == 0; }
 
-  sign_domain::Interval interval() const { return interval_domain().element(); }
+  bool is_top() const override { return m_bits == kSigns; }
 
-  ConstantDomain constant_domain() const { return get<1>(); }
+  bool leq(const SignedConstantDomain& other) const override {
+    bool is_subset = (m_bits & ~other.m_bits & kSigns) == 0;
+    bool has_constant =
+        (other.m_bits & kConstant) == 0 ||
+        ((m_bits & kConstant) != 0 && m_constant == other.m_constant) ||
+        m_bits == 0;
+    return is_subset && has_constant;
+  }
+
+  bool equals(const SignedConstantDomain& other) const override {
+    return m_bits == other.m_bits && m_constant == other.m_constant;
+  }
+
+  void set_to_bottom() override {
+    m_constant = 0;
+    m_bits = 0;
+  }
+
+  void set_to_top() override {
+    m_constant = 0;
+    m_bits = kSigns;
+  }
+
+  void join_with(const SignedConstantDomain& other) override {
+    // Bottom is constant as far as the join is concerned.
+    bool is_bottom = m_bits == 0;
+    bool other_is_bottom = other.m_bits == 0;
+    bool is_constant = is_bottom || (m_bits & kConstant) != 0;
+    bool other_is_constant =
+        other_is_bottom || (other.m_bits & kConstant) != 0;
+    bool same_constant =
+        m_constant == other.m_constant || is_bottom || other_is_bottom;
+    bool keep_constant = is_constant && other_is_constant && same_constant;
+    m_constant = is_bottom ? other.m_constant : m_constant;
+    m_bits = (m_bits | other.m_bits) & kSigns;
+    m_bits |= static_cast<uint8_t>(keep_constant) * kConstant;
+    normalize();
+  }
+
+  void widen_with(const SignedConstantDomain& other) override {
+    join_with(other);
+  }
+
+  void meet_with(const SignedConstantDomain& other) override {
+    bool is_constant = (m_bits & kConstant) != 0;
+    bool other_is_constant = (other.m_bits & kConstant) != 0;
+    bool conflict =
+        is_constant && other_is_constant && m_constant != other.m_constant;
+    uint8_t constant_bit = (m_bits | other.m_bits) & kConstant;
+    uint8_t signs = m_bits & other.m_bits & kSigns;
+    m_constant = is_constant ? m_constant : other.m_constant;
+    m_bits = (constant_bit | signs) & static_cast<uint8_t>(!conflict) * kAll;
+    normalize();
+  }
+
+  void narrow_with(const SignedConstantDomain& other) override {
+    meet_with(other);
+  }
+
+  sign_domain::Domain interval_domain() const {
+    return sign_domain::Domain(interval());
+  }
+
+  sign_domain::Interval interval() const {
+    using sign_domain::Interval;
+    static constexpr Interval intervals[] = {
+        Interval::EMPTY, Interval::LTZ, Interval::EQZ, Interval::LEZ,
+        Interval::GTZ,   Interval::NEZ, Interval::GEZ, Interval::ALL};
+    return intervals[m_bits & kSigns];
+  }
+
+  ConstantDomain constant_domain() const {
+    if (is_bottom()) {
+      return ConstantDomain::bottom();
+    }
+    auto cst = get_constant();
+    return cst ? ConstantDomain(*cst) : ConstantDomain::top();
+  }
 
   boost::optional<ConstantDomain::ConstantType> get_constant() const {
-    return constant_domain().get_constant();
+    if ((m_bits & kConstant) == 0) {
+      return boost::none;
+    }
+    return m_constant;
   }
 
   static SignedConstantDomain default_value() {
@@ -72,4 +152,61 @@ class SignedConstantDomain
 
   /* Return the smallest element within the interval. */
   int64_t min_element() const;
+
+  friend std::ostream& operator<<(std::ostream& o,
+                                  const SignedConstantDomain& d) {
+    o << "(" << d.interval_domain() << ", " << d.constant_domain() << ")";
+    return o;
+  }
+
+ private:
+  static constexpr uint8_t kNegative = 1;
+  static constexpr uint8_t kZero = 2;
+  static constexpr uint8_t kPositive = 4;
+  static constexpr uint8_t kSigns = kNegative | kZero | kPositive;
+  static constexpr uint8_t kConstant = 8;
+  static constexpr uint8_t kAll = kSigns | kConstant;
+
+  static uint8_t sign_bits(int64_t v) {
+    return static_cast<uint8_t>(v < 0) * kNegative |
+           static_cast<uint8_t>(v == 0) * kZero |
+           static_cast<uint8_t>(v > 0) * kPositive;
+  }
+
+  static uint8_t interval_bits(sign_domain::Interval interval) {
+    using sign_domain::Interval;
+    switch (interval) {
+    case Interval::EMPTY:
+      return 0;
+    case Interval::LTZ:
+      return kNegative;
+    case Interval::GTZ:
+      return kPositive;
+    case Interval::EQZ:
+      return kZero;
+    case Interval::NEZ:
+      return kNegative | kPositive;
+    case Interval::GEZ:
+      return kZero | kPositive;
+    case Interval::LEZ:
+      return kNegative | kZero;
+    case Interval::ALL:
+      return kSigns;
+    case Interval::SIZE:
+      break;
+    }
+    not_reached();
+  }
+
+  // Restores the canonical encoding: no signs means Bottom, and only zero
+  // means the constant 0.
+  void normalize() {
+    uint8_t signs = m_bits & kSigns;
+    m_bits |= static_cast<uint8_t>(signs == kZero) * kConstant;
+    m_bits &= static_cast<uint8_t>(signs != 0) * kAll;
+    m_constant &= -static_cast<int64_t>((m_bits & kConstant) != 0);
+  }
+
+  int64_t m_constant{0};
+  uint8_t m_bits{kSigns};
 };
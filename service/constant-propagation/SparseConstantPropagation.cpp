@@ -0,0 +1,670 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SparseConstantPropagation.h"
+
+#include <algorithm>
+
+#include "GraphUtil.h"
+#include "Show.h"
+#include "Trace.h"
+
+namespace {
+
+// The register that refine_no_throw refines after `insn`, if any.
+boost::optional<reg_t> get_refined_src(
+    const IRInstruction* insn,
+    const std::unordered_set<DexMethodRef*>& kotlin_null_check_assertions) {
+  auto src_index =
+      constant_propagation::get_dereferenced_object_src_index(insn);
+  if (!src_index) {
+    src_index = constant_propagation::get_null_check_object_index(
+        insn, kotlin_null_check_assertions);
+  }
+  if (!src_index) {
+    return boost::none;
+  }
+  if (insn->has_dest()) {
+    auto dest = insn->dest();
+    if ((dest == *src_index) ||
+        (insn->dest_is_wide() && dest + 1 == *src_index)) {
+      return boost::none;
+    }
+  }
+  return insn->src(*src_index);
+}
+
+template <typename Container>
+void add_unique(Container* regs, reg_t reg) {
+  if (std::find(regs->begin(), regs->end(), reg) == regs->end()) {
+    regs->push_back(reg);
+  }
+}
+
+} // namespace
+
+namespace constant_propagation {
+
+namespace intraprocedural {
+
+SparseFixpointIterator::SparseFixpointIterator(
+    const cfg::ControlFlowGraph& cfg,
+    InstructionAnalyzer<ConstantEnvironment> insn_analyzer)
+    : m_insn_analyzer(std::move(insn_analyzer)),
+      m_kotlin_null_check_assertions(get_kotlin_null_assertions()) {
+  build_ssa(cfg);
+}
+
+SparseFixpointIterator::ValueId SparseFixpointIterator::new_value() {
+  m_values.push_back(ConstantValue::bottom());
+  m_users.emplace_back();
+  return m_values.size() - 1;
+}
+
+/*
+ * Puts the code in SSA form with the usual algorithm of Cytron et al.: phis go
+ * in the iterated dominance frontiers of the blocks that define a register,
+ * and a walk over the dominator tree names the values. The successors of a
+ * block also get phis for the registers that the edges refine.
+ */
+void SparseFixpointIterator::build_ssa(const cfg::ControlFlowGraph& cfg) {
+  auto postorder = graph::postorder_sort<cfg::GraphInterface>(cfg);
+  // Number the blocks in reverse postorder, so the entry comes first.
+  m_blocks.reserve(postorder.size());
+  size_t max_id = 0;
+  for (auto block : postorder) {
+    max_id = std::max(max_id, block->id());
+  }
+  m_block_index.assign(max_id + 1, NONE);
+  for (auto it = postorder.rbegin(); it != postorder.rend(); ++it) {
+    m_block_index[(*it)->id()] = m_blocks.size();
+    m_blocks.emplace_back();
+    m_blocks.back().block = *it;
+  }
+  auto entry = cfg.entry_block();
+  always_assert(m_blocks.front().block == entry);
+
+  // The registers are numbered densely, with RESULT_REGISTER first, so the
+  // per-register tables below are plain vectors.
+  std::vector<reg_t> regs{RESULT_REGISTER};
+  std::vector<uint32_t> reg_slots;
+  auto slot = [&](reg_t reg) -> uint32_t {
+    if (reg == RESULT_REGISTER) {
+      return 0;
+    }
+    if (reg >= reg_slots.size()) {
+      reg_slots.resize(reg + 1, 0);
+    }
+    if (reg_slots[reg] == 0) {
+      reg_slots[reg] = regs.size();
+      regs.push_back(reg);
+    }
+    return reg_slots[reg];
+  };
+
+  // The registers each instruction writes, and the blocks that write them.
+  std::vector<std::vector<reg_t>> insn_def_regs;
+  std::vector<std::vector<uint32_t>> def_blocks;
+  for (uint32_t b = 0; b < m_blocks.size(); ++b) {
+    auto& block = m_blocks[b];
+    block.first_insn = m_insns.size();
+    auto last_insn = block.block->get_last_insn();
+    for (auto& mie : InstructionIterable(block.block)) {
+      auto insn = mie.insn;
+      m_insn_index.emplace(insn, m_insns.size());
+      m_insns.push_back(Instruction{insn, b, block.num_insns++, {}, {}});
+      std::vector<reg_t> def_regs;
+      if (insn->has_dest()) {
+        def_regs.push_back(insn->dest());
+      }
+      if (insn->has_move_result_any()) {
+        def_regs.push_back(RESULT_REGISTER);
+      }
+      if (insn != last_insn->insn) {
+        auto refined = get_refined_src(insn, m_kotlin_null_check_assertions);
+        if (refined) {
+          add_unique(&def_regs, *refined);
+        }
+      }
+      for (auto reg : def_regs) {
+        auto s = slot(reg);
+        if (s >= def_blocks.size()) {
+          def_blocks.resize(regs.size());
+        }
+        // The blocks come in order, so only the last one can be `b`.
+        if (def_blocks[s].empty() || def_blocks[s].back() != b) {
+          def_blocks[s].push_back(b);
+        }
+      }
+      for (auto reg : insn->srcs()) {
+        slot(reg);
+      }
+      insn_def_regs.push_back(std::move(def_regs));
+    }
+  }
+  def_blocks.resize(regs.size());
+
+  // The registers that have a phi in each block.
+  std::vector<std::vector<reg_t>> phi_regs(m_blocks.size());
+  for (uint32_t b = 0; b < m_blocks.size(); ++b) {
+    const auto& block = m_blocks[b];
+    if (block.num_insns == 0) {
+      continue;
+    }
+    for (auto reg : m_insns[block.first_insn + block.num_insns - 1]
+                        .insn->srcs()) {
+      for (auto edge : block.block->succs()) {
+        auto target = block_index(edge->target());
+        if (std::find(phi_regs[target].begin(), phi_regs[target].end(), reg) ==
+            phi_regs[target].end()) {
+          phi_regs[target].push_back(reg);
+          // A duplicate here only costs the walk below a little.
+          def_blocks[slot(reg)].push_back(target);
+        }
+      }
+    }
+  }
+
+  // The immediate dominators, with the algorithm of Cooper, Harvey and
+  // Kennedy, like SimpleFastDominators, but on the block numbers.
+  std::vector<std::vector<uint32_t>> preds(m_blocks.size());
+  for (uint32_t b = 1; b < m_blocks.size(); ++b) {
+    for (auto edge : m_blocks[b].block->preds()) {
+      auto p = block_index(edge->src());
+      if (p != NONE) {
+        add_unique(&preds[b], p);
+      }
+    }
+  }
+  std::vector<uint32_t> idoms(m_blocks.size(), NONE);
+  idoms[0] = 0;
+  auto intersect = [&](uint32_t b1, uint32_t b2) {
+    while (b1 != b2) {
+      while (b1 > b2) {
+        b1 = idoms[b1];
+      }
+      while (b2 > b1) {
+        b2 = idoms[b2];
+      }
+    }
+    return b1;
+  };
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (uint32_t b = 1; b < m_blocks.size(); ++b) {
+      auto idom = NONE;
+      for (auto p : preds[b]) {
+        if (idoms[p] != NONE) {
+          idom = idom == NONE ? p : intersect(p, idom);
+        }
+      }
+      if (idoms[b] != idom) {
+        idoms[b] = idom;
+        changed = true;
+      }
+    }
+  }
+
+  // The entry block also has an edge from the method entry, so when it has
+  // predecessors, it merges every register.
+  std::vector<std::vector<uint32_t>> frontiers(m_blocks.size());
+  std::vector<std::vector<uint32_t>> children(m_blocks.size());
+  for (uint32_t b = 1; b < m_blocks.size(); ++b) {
+    auto idom = idoms[b];
+    m_blocks[b].idom = idom;
+    children[idom].push_back(b);
+    if (preds[b].size() < 2) {
+      continue;
+    }
+    for (auto runner : preds[b]) {
+      while (runner != idom) {
+        add_unique(&frontiers[runner], b);
+        runner = idoms[runner];
+      }
+    }
+  }
+  bool entry_has_preds = false;
+  for (auto edge : entry->preds()) {
+    entry_has_preds |= block_index(edge->src()) != NONE;
+  }
+  // The register whose phis each block got last, to visit blocks once per
+  // register.
+  std::vector<uint32_t> visited(m_blocks.size(), NONE);
+  for (uint32_t s = 0; s < regs.size(); ++s) {
+    auto reg = regs[s];
+    if (entry_has_preds) {
+      add_unique(&phi_regs[0], reg);
+    }
+    auto worklist = def_blocks[s];
+    for (auto b : worklist) {
+      visited[b] = s;
+    }
+    while (!worklist.empty()) {
+      auto b = worklist.back();
+      worklist.pop_back();
+      for (auto f : frontiers[b]) {
+        add_unique(&phi_regs[f], reg);
+        if (visited[f] != s) {
+          visited[f] = s;
+          worklist.push_back(f);
+        }
+      }
+    }
+  }
+  for (uint32_t b = 0; b < m_blocks.size(); ++b) {
+    for (auto reg : phi_regs[b]) {
+      m_blocks[b].phis.push_back(m_phis.size());
+      m_phis.push_back(Phi{reg, new_value(), b, {}});
+    }
+  }
+
+  // Name the values, walking down the dominator tree.
+  std::vector<std::vector<ValueId>> stacks(regs.size());
+  for (uint32_t s = 0; s < regs.size(); ++s) {
+    auto id = new_value();
+    m_entry_values.emplace_back(regs[s], id);
+    stacks[s].push_back(id);
+  }
+  auto current = [&](reg_t reg) { return stacks[slot(reg)].back(); };
+  auto bind_current = [&](Bindings* uses,
+                          reg_t reg) -> boost::optional<ValueId> {
+    for (const auto& pair : *uses) {
+      if (pair.first == reg) {
+        return boost::none;
+      }
+    }
+    auto id = current(reg);
+    uses->emplace_back(reg, id);
+    return id;
+  };
+  auto use = [&](Bindings* uses, reg_t reg, User user) {
+    auto id = bind_current(uses, reg);
+    if (id) {
+      m_users[*id].push_back(user);
+    }
+  };
+  auto add_operands = [&](cfg::Edge* edge, uint32_t target) {
+    for (auto p : m_blocks[target].phis) {
+      auto& phi = m_phis[p];
+      auto id = current(phi.reg);
+      phi.operands.emplace_back(edge, id);
+      m_users[id].push_back(User{true, p});
+    }
+  };
+  add_operands(nullptr, 0);
+
+  // The blocks on the path from the entry, with the register slots whose
+  // values they pushed.
+  std::vector<std::pair<uint32_t, std::vector<uint32_t>>> stack;
+  stack.emplace_back(0, std::vector<uint32_t>());
+  std::vector<size_t> next_children{0};
+  while (!stack.empty()) {
+    auto b = stack.back().first;
+    auto& block = m_blocks[b];
+    if (next_children.back() == 0) {
+      // First visit: push the values that the block defines.
+      auto& pushed = stack.back().second;
+      for (auto p : block.phis) {
+        auto s = slot(m_phis[p].reg);
+        stacks[s].push_back(m_phis[p].value);
+        pushed.push_back(s);
+      }
+      for (uint32_t i = 0; i < block.num_insns; ++i) {
+        auto index = block.first_insn + i;
+        auto& insn = m_insns[index];
+        auto user = User{false, index};
+        for (auto reg : insn.insn->srcs()) {
+          use(&insn.uses, reg, user);
+        }
+        if (opcode::is_move_result_any(insn.insn->opcode())) {
+          use(&insn.uses, RESULT_REGISTER, user);
+        }
+        for (auto reg : insn_def_regs[index]) {
+          use(&insn.uses, reg, user);
+        }
+        for (auto reg : insn_def_regs[index]) {
+          auto id = new_value();
+          insn.defs.emplace_back(reg, id);
+          auto s = slot(reg);
+          stacks[s].push_back(id);
+          pushed.push_back(s);
+        }
+      }
+      if (block.num_insns != 0) {
+        auto last_index = block.first_insn + block.num_insns - 1;
+        const auto& last = m_insns[last_index];
+        for (auto reg : last.insn->srcs()) {
+          auto id = bind_current(&block.exit_values, reg);
+          // The edges are evaluated after the last instruction anyway, so it
+          // needn't hear about the values that it defines itself.
+          if (id && std::none_of(last.defs.begin(), last.defs.end(),
+                                 [&](const std::pair<reg_t, ValueId>& p) {
+                                   return p.second == *id;
+                                 })) {
+            m_users[*id].push_back(User{false, last_index});
+          }
+        }
+      }
+      for (auto edge : block.block->succs()) {
+        add_operands(edge, block_index(edge->target()));
+      }
+    }
+    auto next_child = next_children.back()++;
+    if (next_child < children[b].size()) {
+      stack.emplace_back(children[b][next_child], std::vector<uint32_t>());
+      next_children.push_back(0);
+      continue;
+    }
+    for (auto s : stack.back().second) {
+      stacks[s].pop_back();
+    }
+    stack.pop_back();
+    next_children.pop_back();
+  }
+  TRACE(CONSTP, 5, "SCCP: %zu blocks, %zu registers, %zu phis, %zu values",
+        m_blocks.size(), regs.size(), m_phis.size(), m_values.size());
+}
+
+constexpr uint32_t SparseFixpointIterator::NONE;
+
+uint32_t SparseFixpointIterator::block_index(const cfg::Block* block) const {
+  auto id = block->id();
+  return id < m_block_index.size() ? m_block_index[id] : NONE;
+}
+
+void SparseFixpointIterator::set_value(ValueId id, const ConstantValue& value) {
+  if (m_values[id] == value) {
+    return;
+  }
+  m_values[id] = value;
+  for (const auto& user : m_users[id]) {
+    // The users that haven't been reached yet see the new value when they
+    // are.
+    auto b = user.is_phi ? m_phis[user.index].block
+                         : m_insns[user.index].block;
+    const auto& block = m_blocks[b];
+    if (!block.executable || block.pending ||
+        (!user.is_phi && m_insns[user.index].pos > block.num_live_insns)) {
+      continue;
+    }
+    m_ssa_worklist.push_back(user);
+  }
+}
+
+ConstantEnvironment SparseFixpointIterator::bind(
+    const Bindings& bindings) const {
+  ConstantEnvironment env;
+  env.mutate_register_environment([&](ConstantRegisterEnvironment* regs) {
+    for (const auto& pair : bindings) {
+      regs->set(pair.first, m_values[pair.second]);
+    }
+  });
+  return env;
+}
+
+void SparseFixpointIterator::run(const ConstantEnvironment& init_env) {
+  m_entry_states.clear();
+  m_exit_states.clear();
+  if (init_env.is_bottom()) {
+    return;
+  }
+  for (const auto& pair : m_entry_values) {
+    m_values[pair.second] = init_env.get(pair.first);
+  }
+  mark_executable(0);
+  while (!m_block_worklist.empty() || !m_ssa_worklist.empty()) {
+    while (!m_block_worklist.empty()) {
+      auto b = m_block_worklist.top();
+      m_block_worklist.pop();
+      for (auto p : m_blocks[b].phis) {
+        evaluate_phi(m_phis[p]);
+      }
+      m_blocks[b].pending = false;
+      advance(b);
+    }
+    while (!m_ssa_worklist.empty()) {
+      auto user = m_ssa_worklist.back();
+      m_ssa_worklist.pop_back();
+      if (user.is_phi) {
+        evaluate_phi(m_phis[user.index]);
+        continue;
+      }
+      const auto& insn = m_insns[user.index];
+      const auto& block = m_blocks[insn.block];
+      if (insn.pos == block.num_live_insns) {
+        advance(insn.block);
+      } else if (evaluate_insn(insn) && insn.pos + 1 == block.num_insns) {
+        evaluate_edges(insn.block);
+      }
+    }
+  }
+}
+
+void SparseFixpointIterator::mark_executable(uint32_t b) {
+  auto& block = m_blocks[b];
+  if (!block.executable) {
+    block.executable = true;
+    block.pending = true;
+    m_block_worklist.push(b);
+  }
+}
+
+// Evaluate the instructions that are newly reached, and the outgoing edges
+// once the whole block completes.
+void SparseFixpointIterator::advance(uint32_t b) {
+  auto& block = m_blocks[b];
+  if (block.num_live_insns == block.num_insns && block.num_insns != 0) {
+    return;
+  }
+  while (block.num_live_insns < block.num_insns) {
+    if (!evaluate_insn(m_insns[block.first_insn + block.num_live_insns])) {
+      return;
+    }
+    ++block.num_live_insns;
+  }
+  evaluate_edges(b);
+}
+
+bool SparseFixpointIterator::evaluate_insn(const Instruction& insn) {
+  auto env = bind(insn.uses);
+  if (env.is_bottom()) {
+    return false;
+  }
+  m_insn_analyzer(insn.insn, &env);
+  if (insn.pos + 1 != m_blocks[insn.block].num_insns) {
+    refine_no_throw(insn.insn, &env, m_kotlin_null_check_assertions);
+  }
+  if (env.is_bottom()) {
+    return false;
+  }
+  for (const auto& pair : insn.defs) {
+    set_value(pair.second, env.get(pair.first));
+  }
+  return true;
+}
+
+void SparseFixpointIterator::evaluate_edges(uint32_t b) {
+  const auto& block = m_blocks[b];
+  auto exit_env = bind(block.exit_values);
+  for (auto edge : block.block->succs()) {
+    auto env = refine_edge(edge, exit_env, m_kotlin_null_check_assertions);
+    if (env.is_bottom()) {
+      continue;
+    }
+    auto it = m_edge_envs.find(edge);
+    if (it != m_edge_envs.end() && it->second == env) {
+      continue;
+    }
+    m_edge_envs[edge] = env;
+    auto target = block_index(edge->target());
+    if (!m_blocks[target].executable) {
+      mark_executable(target);
+      continue;
+    }
+    if (m_blocks[target].pending) {
+      // Its phis are evaluated when the block is.
+      continue;
+    }
+    for (auto p : m_blocks[target].phis) {
+      m_ssa_worklist.push_back(User{true, p});
+    }
+  }
+}
+
+void SparseFixpointIterator::evaluate_phi(const Phi& phi) {
+  auto value = ConstantValue::bottom();
+  for (const auto& operand : phi.operands) {
+    auto edge = operand.first;
+    if (edge == nullptr) {
+      value.join_with(m_values[operand.second]);
+      continue;
+    }
+    auto it = m_edge_envs.find(edge);
+    if (it == m_edge_envs.end()) {
+      continue;
+    }
+    auto src = block_index(edge->src());
+    const auto& exit_values = m_blocks[src].exit_values;
+    auto refined = std::find_if(
+        exit_values.begin(), exit_values.end(),
+        [&](const std::pair<reg_t, ValueId>& p) { return p.first == phi.reg; });
+    value.join_with(refined != exit_values.end() ? it->second.get(phi.reg)
+                                                 : m_values[operand.second]);
+  }
+  set_value(phi.value, value);
+}
+
+bool SparseFixpointIterator::is_executable(cfg::Block* block) const {
+  auto b = block_index(block);
+  return b != NONE && m_blocks[b].executable;
+}
+
+ConstantValue SparseFixpointIterator::get_value_before(
+    const IRInstruction* insn, reg_t reg) const {
+  auto it = m_insn_index.find(insn);
+  if (it == m_insn_index.end()) {
+    // The instruction is in an unreachable block.
+    return ConstantValue::bottom();
+  }
+  const auto& instruction = m_insns[it->second];
+  const auto& block = m_blocks[instruction.block];
+  if (!block.executable || instruction.pos > block.num_live_insns) {
+    return ConstantValue::bottom();
+  }
+  for (const auto& pair : instruction.uses) {
+    if (pair.first == reg) {
+      return m_values[pair.second];
+    }
+  }
+  not_reached_log("%s doesn't use v%u", SHOW(insn), reg);
+}
+
+ConstantValue SparseFixpointIterator::get_value_after(const IRInstruction* insn,
+                                                      reg_t reg) const {
+  auto it = m_insn_index.find(insn);
+  if (it == m_insn_index.end()) {
+    return ConstantValue::bottom();
+  }
+  const auto& instruction = m_insns[it->second];
+  const auto& block = m_blocks[instruction.block];
+  if (!block.executable || instruction.pos >= block.num_live_insns) {
+    return ConstantValue::bottom();
+  }
+  for (const auto& pair : instruction.defs) {
+    if (pair.first == reg) {
+      return m_values[pair.second];
+    }
+  }
+  return get_value_before(insn, reg);
+}
+
+/*
+ * The value of a register at the entry of a block is that of its phi there,
+ * or else that of its last definition in the closest dominator that defines
+ * it, or else its value at the method entry. The blocks are numbered in
+ * reverse postorder, so every block comes after its immediate dominator, and
+ * a single pass sees the state at the end of the dominator first.
+ *
+ * The definitions of a block include the refinements after its non-throwing
+ * instructions, so the state at its end is also its exit state, if all its
+ * instructions complete.
+ */
+void SparseFixpointIterator::build_block_states() const {
+  m_entry_states.assign(m_blocks.size(), ConstantEnvironment::bottom());
+  m_exit_states.assign(m_blocks.size(), ConstantEnvironment::bottom());
+  // The states at the end of each block, which its children in the dominator
+  // tree start from.
+  std::vector<ConstantEnvironment> end_states(m_blocks.size());
+  for (uint32_t b = 0; b < m_blocks.size(); ++b) {
+    const auto& block = m_blocks[b];
+    if (!block.executable) {
+      continue;
+    }
+    auto env = b == 0 ? bind(m_entry_values) : end_states[block.idom];
+    env.mutate_register_environment([&](ConstantRegisterEnvironment* regs) {
+      for (auto p : block.phis) {
+        regs->set(m_phis[p].reg, m_values[m_phis[p].value]);
+      }
+    });
+    m_entry_states[b] = env;
+    env.mutate_register_environment([&](ConstantRegisterEnvironment* regs) {
+      for (uint32_t i = 0; i < block.num_insns; ++i) {
+        for (const auto& pair : m_insns[block.first_insn + i].defs) {
+          regs->set(pair.first, m_values[pair.second]);
+        }
+      }
+    });
+    if (block.num_live_insns == block.num_insns) {
+      m_exit_states[b] = env;
+    }
+    end_states[b] = std::move(env);
+  }
+}
+
+ConstantEnvironment SparseFixpointIterator::get_entry_state_at(
+    cfg::Block* block) const {
+  auto b = block_index(block);
+  if (b == NONE) {
+    return ConstantEnvironment::bottom();
+  }
+  if (m_entry_states.empty()) {
+    build_block_states();
+  }
+  return m_entry_states[b];
+}
+
+ConstantEnvironment SparseFixpointIterator::get_exit_state_at(
+    cfg::Block* block) const {
+  auto b = block_index(block);
+  if (b == NONE) {
+    return ConstantEnvironment::bottom();
+  }
+  if (m_exit_states.empty()) {
+    build_block_states();
+  }
+  return m_exit_states[b];
+}
+
+void SparseFixpointIterator::analyze_instruction(
+    const IRInstruction* insn,
+    ConstantEnvironment* current_state,
+    bool is_last) const {
+  m_insn_analyzer(insn, current_state);
+  if (!is_last) {
+    refine_no_throw(insn, current_state, m_kotlin_null_check_assertions);
+  }
+}
+
+ConstantEnvironment SparseFixpointIterator::analyze_edge(
+    cfg::Edge* edge, const ConstantEnvironment& exit_state_at_source) const {
+  return refine_edge(edge, exit_state_at_source,
+                     m_kotlin_null_check_assertions);
+}
+
+} // namespace intraprocedural
+
+} // namespace constant_propagation
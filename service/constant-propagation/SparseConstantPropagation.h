@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <functional>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ConstantPropagationAnalysis.h"
+
+namespace constant_propagation {
+
+namespace intraprocedural {
+
+/*
+ * Sparse conditional constant propagation, after Wegman and Zadeck.
+ *
+ * FixpointIterator keeps a whole ConstantEnvironment at every block, and joins
+ * them at every merge point. In large methods most of that work is spent on
+ * registers that the merge doesn't touch. This iterator instead puts the code
+ * in SSA form on the side, without changing it, and only keeps one value per
+ * SSA definition. A definition is re-evaluated only when one of the values it
+ * uses changes, and only CFG edges that can be taken carry values.
+ *
+ * The transfer functions are those of FixpointIterator: each instruction runs
+ * through the given instruction analyzer, on an environment that only binds
+ * the registers it reads, and the same refinements apply after non-throwing
+ * instructions and on branches. The refined registers get their own
+ * definitions at the start of the successor blocks, so the results are the
+ * same as those of FixpointIterator for analyzers that only look at registers,
+ * like ConstantPrimitiveAnalyzer. Analyzers that track fields or the heap see
+ * those as unknown.
+ *
+ * It also answers the block-level queries of FixpointIterator that Transform
+ * uses, so Transform can run on the results of either iterator. The first
+ * such query builds the entry and exit states of all blocks in one walk down
+ * the dominator tree: a block starts from the state of its immediate
+ * dominator at the end of that block, and only binds its own phis and
+ * definitions. The environments are persistent maps, so that is cheap and
+ * shares most of the structure.
+ */
+class SparseFixpointIterator final {
+ public:
+  SparseFixpointIterator(
+      const cfg::ControlFlowGraph& cfg,
+      InstructionAnalyzer<ConstantEnvironment> insn_analyzer);
+
+  // The registers that are unbound in `init_env` are Top at the method entry.
+  void run(const ConstantEnvironment& init_env);
+
+  bool is_executable(cfg::Block* block) const;
+
+  // The value of `reg` right before `insn`, which has to read or write `reg`.
+  // Bottom if `insn` never executes.
+  ConstantValue get_value_before(const IRInstruction* insn, reg_t reg) const;
+
+  // The value of `reg` right after `insn`, which has to read or write `reg`.
+  // Bottom if `insn` never executes or never completes normally.
+  ConstantValue get_value_after(const IRInstruction* insn, reg_t reg) const;
+
+  // The environment at the entry of the block, as FixpointIterator computes
+  // it. Bottom if the block never executes.
+  ConstantEnvironment get_entry_state_at(cfg::Block* block) const;
+
+  // The environment at the exit of the block, before the refinements on its
+  // outgoing edges. Bottom if the block never executes or never completes.
+  ConstantEnvironment get_exit_state_at(cfg::Block* block) const;
+
+  void analyze_instruction(const IRInstruction* insn,
+                           ConstantEnvironment* current_state,
+                           bool is_last) const;
+
+  ConstantEnvironment analyze_edge(
+      cfg::Edge* edge, const ConstantEnvironment& exit_state_at_source) const;
+
+ private:
+  using ValueId = uint32_t;
+  using Bindings = std::vector<std::pair<reg_t, ValueId>>;
+
+  static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+  struct User {
+    bool is_phi;
+    uint32_t index;
+  };
+
+  struct Instruction {
+    const IRInstruction* insn;
+    uint32_t block;
+    uint32_t pos;
+    // The values of the registers the instruction reads, and of those it
+    // writes, since the analyzer may leave some of them unchanged.
+    Bindings uses;
+    // The values the instruction defines.
+    Bindings defs;
+  };
+
+  struct Phi {
+    reg_t reg;
+    ValueId value;
+    uint32_t block;
+    // A null edge stands for the method entry.
+    std::vector<std::pair<cfg::Edge*, ValueId>> operands;
+  };
+
+  struct Block {
+    cfg::Block* block;
+    // The immediate dominator; the entry block is its own.
+    uint32_t idom{0};
+    uint32_t first_insn{0};
+    uint32_t num_insns{0};
+    std::vector<uint32_t> phis;
+    // The values of the registers the last instruction reads, at the end of
+    // the block; the refinements on the outgoing edges apply to them.
+    Bindings exit_values;
+    bool executable{false};
+    // Executable, but its phis are not evaluated yet.
+    bool pending{false};
+    // The number of leading instructions that complete normally. The others
+    // never execute, just like FixpointIterator sees Bottom after the first
+    // instruction that can't complete.
+    uint32_t num_live_insns{0};
+  };
+
+  void build_ssa(const cfg::ControlFlowGraph& cfg);
+  void build_block_states() const;
+  uint32_t block_index(const cfg::Block* block) const;
+  ValueId new_value();
+  void set_value(ValueId id, const ConstantValue& value);
+  ConstantEnvironment bind(const Bindings& bindings) const;
+
+  void mark_executable(uint32_t block);
+  void advance(uint32_t block);
+  bool evaluate_insn(const Instruction& insn);
+  void evaluate_edges(uint32_t block);
+  void evaluate_phi(const Phi& phi);
+
+  InstructionAnalyzer<ConstantEnvironment> m_insn_analyzer;
+  const std::unordered_set<DexMethodRef*>& m_kotlin_null_check_assertions;
+
+  std::vector<ConstantValue> m_values;
+  std::vector<std::vector<User>> m_users;
+  Bindings m_entry_values;
+  std::vector<Instruction> m_insns;
+  std::vector<Phi> m_phis;
+  std::vector<Block> m_blocks;
+  std::unordered_map<const IRInstruction*, uint32_t> m_insn_index;
+  // The numbers of the blocks by id, NONE for those that are unreachable.
+  std::vector<uint32_t> m_block_index;
+  std::unordered_map<cfg::Edge*, ConstantEnvironment> m_edge_envs;
+  // Built on demand, see build_block_states().
+  mutable std::vector<ConstantEnvironment> m_entry_states;
+  mutable std::vector<ConstantEnvironment> m_exit_states;
+
+  // The executable blocks to evaluate, in reverse postorder, so that the
+  // predecessors of a block are usually evaluated before it, except along
+  // back edges.
+  std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>>
+      m_block_worklist;
+  std::vector<User> m_ssa_worklist;
+};
+
+} // namespace intraprocedural
+
+} // namespace constant_propagation
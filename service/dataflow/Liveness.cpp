@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "Liveness.h"
+
+#include "WorkQueue.h"
+
+void LivenessFixpointIterator::run_summarized(size_t num_threads) {
+  // Create all the entries up front, so that the workers only write to
+  // distinct existing values.
+  for (auto* block : m_cfg.blocks()) {
+    m_block_summaries[block];
+  }
+  auto wq = workqueue_foreach<cfg::Block*>(
+      [&](cfg::Block* block) {
+        auto& summary = m_block_summaries.at(block);
+        for (auto it = block->rbegin(); it != block->rend(); ++it) {
+          if (it->type != MFLOW_OPCODE) {
+            continue;
+          }
+          analyze_instruction(it->insn, &summary.uses);
+          if (it->insn->has_dest()) {
+            summary.defs.add(it->insn->dest());
+          }
+        }
+      },
+      num_threads);
+  for (auto* block : m_cfg.blocks()) {
+    wq.add_item(block);
+  }
+  wq.run_all();
+  run(LivenessDomain());
+  // The summaries would be stale as soon as the code changes.
+  m_block_summaries.clear();
+}
@@ -2292,7 +2292,7 @@ void inline_method_unsafe(const DexMethod* caller_method,
   // find the last position entry before the invoke.
   const auto invoke_position = last_position_before(pos, caller_code);
   if (invoke_position) {
-    TRACE(INL, 3, "Inlining call at %s:%d", invoke_position->file->c_str(),
+    TRACE(INL, 3, "Inlining call at %s:%d", invoke_position->file()->c_str(),
           invoke_position->line);
   }
 
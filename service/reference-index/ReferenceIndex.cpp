@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ReferenceIndex.h"
+
+#include <algorithm>
+
+#include "ControlFlow.h"
+#include "Debug.h"
+#include "IRCode.h"
+#include "IRInstruction.h"
+#include "Walkers.h"
+
+namespace {
+
+template <typename Ref>
+using LocalSites = std::unordered_map<const Ref*, std::vector<IRInstruction*>>;
+
+struct LocalRefs {
+  LocalSites<DexMethodRef> invokes;
+  LocalSites<DexFieldRef> reads;
+  LocalSites<DexFieldRef> writes;
+  LocalSites<DexType> type_uses;
+};
+
+template <typename Iterable>
+void collect(Iterable insns, uint8_t kinds, LocalRefs* refs) {
+  using namespace reference_index;
+  for (const auto& mie : insns) {
+    auto insn = mie.insn;
+    auto op = insn->opcode();
+    if (insn->has_method()) {
+      if (kinds & INVOKES) {
+        refs->invokes[insn->get_method()].push_back(insn);
+      }
+    } else if (opcode::is_an_iget(op) || opcode::is_an_sget(op)) {
+      if (kinds & FIELD_ACCESSES) {
+        refs->reads[insn->get_field()].push_back(insn);
+      }
+    } else if (opcode::is_an_iput(op) || opcode::is_an_sput(op)) {
+      if (kinds & FIELD_ACCESSES) {
+        refs->writes[insn->get_field()].push_back(insn);
+      }
+    } else if (insn->has_type()) {
+      if (kinds & TYPE_USES) {
+        refs->type_uses[insn->get_type()].push_back(insn);
+      }
+    }
+  }
+}
+
+template <typename Ref, typename Index>
+std::vector<const Ref*> add_sites(DexMethod* method,
+                                  LocalSites<Ref>& local,
+                                  Index& index) {
+  std::vector<const Ref*> refs;
+  refs.reserve(local.size());
+  for (auto& p : local) {
+    refs.push_back(p.first);
+    index.update(p.first, [&](const Ref*, auto& sites, bool) {
+      sites[method] = std::move(p.second);
+    });
+  }
+  return refs;
+}
+
+template <typename Ref, typename Index>
+void remove_sites(const DexMethod* method,
+                  const std::vector<const Ref*>& refs,
+                  Index& index) {
+  for (auto ref : refs) {
+    index.update(ref, [&](const Ref*, auto& sites, bool) {
+      sites.erase(const_cast<DexMethod*>(method));
+    });
+  }
+}
+
+template <typename Ref, typename Index>
+std::vector<reference_index::Site> get_sites(const Ref* ref,
+                                             const Index& index) {
+  std::vector<reference_index::Site> result;
+  auto it = index.find(ref);
+  if (it == index.end()) {
+    return result;
+  }
+  std::vector<DexMethod*> methods;
+  methods.reserve(it->second.size());
+  for (const auto& p : it->second) {
+    methods.push_back(p.first);
+  }
+  std::sort(methods.begin(), methods.end(), compare_dexmethods);
+  for (auto method : methods) {
+    for (auto insn : it->second.at(method)) {
+      result.push_back({method, insn});
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+namespace reference_index {
+
+ReferenceIndex::ReferenceIndex(const Scope& scope, uint8_t kinds)
+    : m_kinds(kinds) {
+  walk::parallel::methods(scope, [&](DexMethod* method) {
+    if (method->get_code() != nullptr) {
+      add(method);
+    }
+  });
+}
+
+void ReferenceIndex::add(DexMethod* method) {
+  auto code = method->get_code();
+  LocalRefs local;
+  if (code->editable_cfg_built()) {
+    collect(InstructionIterable(code->cfg()), m_kinds, &local);
+  } else {
+    collect(InstructionIterable(code), m_kinds, &local);
+  }
+
+  MethodRefs refs;
+  refs.methods = add_sites(method, local.invokes, m_invokes);
+  refs.read_fields = add_sites(method, local.reads, m_reads);
+  refs.written_fields = add_sites(method, local.writes, m_writes);
+  refs.types = add_sites(method, local.type_uses, m_type_uses);
+  m_refs_of_method.insert_or_assign(std::make_pair(method, std::move(refs)));
+}
+
+void ReferenceIndex::remove(const DexMethod* method) {
+  auto it = m_refs_of_method.find(method);
+  if (it == m_refs_of_method.end()) {
+    return;
+  }
+  auto refs = std::move(it->second);
+  m_refs_of_method.erase(method);
+  remove_sites(method, refs.methods, m_invokes);
+  remove_sites(method, refs.read_fields, m_reads);
+  remove_sites(method, refs.written_fields, m_writes);
+  remove_sites(method, refs.types, m_type_uses);
+}
+
+void ReferenceIndex::update(DexMethod* method) {
+  remove(method);
+  if (method->get_code() != nullptr) {
+    add(method);
+  }
+}
+
+std::vector<Site> ReferenceIndex::invokes(const DexMethodRef* method) const {
+  always_assert_log(m_kinds & INVOKES, "Invokes are not indexed");
+  return get_sites(method, m_invokes);
+}
+
+std::vector<Site> ReferenceIndex::reads(const DexFieldRef* field) const {
+  always_assert_log(m_kinds & FIELD_ACCESSES, "Field accesses are not indexed");
+  return get_sites(field, m_reads);
+}
+
+std::vector<Site> ReferenceIndex::writes(const DexFieldRef* field) const {
+  always_assert_log(m_kinds & FIELD_ACCESSES, "Field accesses are not indexed");
+  return get_sites(field, m_writes);
+}
+
+std::vector<Site> ReferenceIndex::type_uses(const DexType* type) const {
+  always_assert_log(m_kinds & TYPE_USES, "Type uses are not indexed");
+  return get_sites(type, m_type_uses);
+}
+
+} // namespace reference_index
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ConcurrentContainers.h"
+#include "DexClass.h"
+
+class IRInstruction;
+
+namespace reference_index {
+
+// The kinds of references an index covers.
+enum Kinds : uint8_t {
+  INVOKES = 1 << 0,
+  FIELD_ACCESSES = 1 << 1,
+  TYPE_USES = 1 << 2,
+  ALL = INVOKES | FIELD_ACCESSES | TYPE_USES,
+};
+
+// An instruction and the method it is in.
+struct Site {
+  DexMethod* method;
+  IRInstruction* insn;
+};
+
+/*
+ * Which instructions refer to a method, field, or type, for the whole program:
+ *
+ * - invokes() are the invoke-* instructions of a method ref,
+ * - reads() and writes() are the get and put instructions of a field ref,
+ * - type_uses() are the instructions that take a type, e.g. const-class,
+ *   new-instance, check-cast, instance-of and new-array.
+ *
+ * Instructions are indexed by the ref they name, and not by what it resolves
+ * to. Sites are sorted by method, and by their order within the method.
+ *
+ * Passes that only need some kinds of references can build an index of just
+ * those; querying any other kind is an error.
+ *
+ * The index is built once, in parallel, and is then kept up to date one method
+ * at a time: a pass that changes, adds, or deletes the code of a method calls
+ * update() or remove() for it, which only rescans that method. Both can be
+ * called concurrently for different methods, but not while querying.
+ */
+class ReferenceIndex {
+ public:
+  explicit ReferenceIndex(const Scope& scope, uint8_t kinds = ALL);
+
+  std::vector<Site> invokes(const DexMethodRef* method) const;
+  std::vector<Site> reads(const DexFieldRef* field) const;
+  std::vector<Site> writes(const DexFieldRef* field) const;
+  std::vector<Site> type_uses(const DexType* type) const;
+
+  // Rescans the code of the method. Methods without code are removed.
+  void update(DexMethod* method);
+
+  // Forgets the references of the method, e.g. before it is deleted.
+  void remove(const DexMethod* method);
+
+ private:
+  using Sites = std::unordered_map<DexMethod*, std::vector<IRInstruction*>>;
+
+  template <typename Ref>
+  using Index = ConcurrentMap<const Ref*, Sites>;
+
+  // The refs a method has sites of, so that they can be forgotten again.
+  struct MethodRefs {
+    std::vector<const DexMethodRef*> methods;
+    std::vector<const DexFieldRef*> read_fields;
+    std::vector<const DexFieldRef*> written_fields;
+    std::vector<const DexType*> types;
+  };
+
+  void add(DexMethod* method);
+
+  uint8_t m_kinds;
+  ConcurrentMap<const DexMethod*, MethodRefs> m_refs_of_method;
+  Index<DexMethodRef> m_invokes;
+  Index<DexFieldRef> m_reads;
+  Index<DexFieldRef> m_writes;
+  Index<DexType> m_type_uses;
+};
+
+} // namespace reference_index
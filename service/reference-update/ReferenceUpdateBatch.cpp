@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ReferenceUpdateBatch.h"
+
+#include "IRCode.h"
+#include "Resolver.h"
+#include "Show.h"
+#include "Trace.h"
+#include "TypeReference.h"
+#include "Walkers.h"
+
+namespace {
+
+/**
+ * Point every old element straight at the end of its chain of substitutions.
+ */
+template <typename Map>
+void compose(Map* map) {
+  for (auto& pair : *map) {
+    auto target = pair.second;
+    size_t steps = 0;
+    for (auto it = map->find(target); it != map->end();
+         it = map->find(target)) {
+      always_assert_log(++steps <= map->size(),
+                        "Cyclic substitution of %s\n",
+                        SHOW(pair.first));
+      target = it->second;
+    }
+    pair.second = target;
+  }
+}
+
+template <typename Map, typename Key, typename Value>
+void add_substitution(Map* map, Key old_elem, Value new_elem) {
+  always_assert_log(old_elem != new_elem, "Substituting %s for itself\n",
+                    SHOW(old_elem));
+  auto it = map->emplace(old_elem, new_elem).first;
+  always_assert_log(it->second == new_elem,
+                    "Conflicting substitutions of %s: %s and %s\n",
+                    SHOW(old_elem), SHOW(it->second), SHOW(new_elem));
+}
+
+/**
+ * LOld; => LNew; [[LOld; => [[LNew;
+ * Return nullptr if the type doesn't need to change.
+ */
+DexType* convert_type(
+    const std::unordered_map<const DexType*, DexType*>& old_to_new,
+    const DexType* type) {
+  auto it = old_to_new.find(type::get_element_type_if_array(type));
+  if (it == old_to_new.end()) {
+    return nullptr;
+  }
+  return type::make_array_type(it->second, type::get_array_level(type));
+}
+
+} // namespace
+
+namespace reference_update {
+
+Batch::Stats& Batch::Stats::operator+=(const Stats& that) {
+  updated_fields += that.updated_fields;
+  renamed_fields += that.renamed_fields;
+  updated_type_insns += that.updated_type_insns;
+  updated_method_insns += that.updated_method_insns;
+  updated_field_insns += that.updated_field_insns;
+  return *this;
+}
+
+void Batch::add_type(const DexType* old_type, DexType* new_type) {
+  add_substitution(&m_types, old_type, new_type);
+}
+
+void Batch::add_method(DexMethod* old_callee, DexMethod* new_callee) {
+  add_substitution(&m_methods, old_callee, new_callee);
+}
+
+void Batch::add_field(DexFieldRef* old_field, DexFieldRef* new_field) {
+  add_substitution(&m_fields, old_field, new_field);
+}
+
+Batch::Stats Batch::apply(const Scope& scope,
+                          const ClassHierarchy& ch,
+                          const TypeInsnCheck& check_type_insn) {
+  Stats stats;
+  if (empty()) {
+    return stats;
+  }
+  compose(&m_types);
+  compose(&m_methods);
+  compose(&m_fields);
+
+  UnorderedTypeSet old_types;
+  for (const auto& pair : m_types) {
+    old_types.insert(pair.first);
+  }
+  stats += walk::parallel::methods<Stats>(scope, [&](DexMethod* meth) {
+    Stats insn_stats;
+    auto code = meth->get_code();
+    if (code == nullptr) {
+      return insn_stats;
+    }
+    for (auto& mie : InstructionIterable(code)) {
+      auto insn = mie.insn;
+      if (insn->has_type()) {
+        auto new_type = convert_type(m_types, insn->get_type());
+        if (new_type != nullptr) {
+          if (check_type_insn) {
+            check_type_insn(insn);
+          }
+          insn->set_type(new_type);
+          insn_stats.updated_type_insns++;
+        }
+      } else if (insn->has_field()) {
+        auto field = insn->get_field();
+        auto def = resolve_field(field);
+        auto it = m_fields.find(field);
+        if (it == m_fields.end() && def != nullptr) {
+          it = m_fields.find(def);
+        }
+        if (it != m_fields.end()) {
+          insn->set_field(it->second);
+          insn_stats.updated_field_insns++;
+          continue;
+        }
+        auto new_type = convert_type(m_types, field->get_type());
+        if (!field->is_def() && new_type != nullptr) {
+          // Bind the reference to its definition, which changes below.
+          insn->set_field(def != nullptr
+                              ? def
+                              : DexField::make_field(field->get_class(),
+                                                     field->get_name(),
+                                                     new_type));
+          insn_stats.updated_field_insns++;
+        }
+      } else if (insn->has_method()) {
+        auto method = insn->get_method();
+        auto callee = resolve_method(method, opcode_to_search(insn), meth);
+        auto it = callee == nullptr ? m_methods.end() : m_methods.find(callee);
+        if (it != m_methods.end()) {
+          auto new_callee = it->second;
+          always_assert_log(!is_private(new_callee) || is_static(new_callee),
+                            "%s\n", vshow(new_callee).c_str());
+          always_assert_log(!new_callee->is_virtual() ||
+                                opcode::is_invoke_virtual(insn->opcode()),
+                            "invalid callsite %s\n", SHOW(insn));
+          always_assert_log(!is_static(new_callee) ||
+                                opcode::is_invoke_static(insn->opcode()),
+                            "invalid callsite %s\n", SHOW(insn));
+          insn->set_method(new_callee);
+          insn_stats.updated_method_insns++;
+          continue;
+        }
+        auto proto = method->get_proto();
+        if (!method->is_def() &&
+            type_reference::proto_has_reference_to(proto, old_types)) {
+          // Bind the reference to its definition, which changes below.
+          insn->set_method(
+              callee != nullptr
+                  ? callee
+                  : DexMethod::make_method(
+                        method->get_class(), method->get_name(),
+                        type_reference::get_new_proto(proto, m_types)));
+          insn_stats.updated_method_insns++;
+        }
+      }
+    }
+    return insn_stats;
+  });
+
+  // The code now only refers to the definitions that change below, so it
+  // follows them, even when they get renamed on a clash.
+  if (!m_types.empty()) {
+    type_reference::update_method_signatures(scope, m_types, ch);
+  }
+  walk::fields(scope, [&](DexField* field) {
+    auto new_type = convert_type(m_types, field->get_type());
+    if (new_type == nullptr) {
+      return;
+    }
+    DexFieldSpec spec;
+    spec.type = new_type;
+    if (DexField::get_field(field->get_class(), field->get_name(), new_type)) {
+      always_assert_log(can_rename(field), "Can not rename %s\n", SHOW(field));
+      spec.name = type_reference::new_name(field);
+      stats.renamed_fields++;
+    }
+    TRACE(REFU, 9, "batch: updating field %s", SHOW(field));
+    field->change(spec);
+    stats.updated_fields++;
+  });
+
+  TRACE(REFU, 2,
+        "batch: %zu types, %zu methods, %zu fields; updated %zu fields "
+        "(%zu renamed), %zu type, %zu method and %zu field instructions",
+        m_types.size(), m_methods.size(), m_fields.size(),
+        stats.updated_fields, stats.renamed_fields, stats.updated_type_insns,
+        stats.updated_method_insns, stats.updated_field_insns);
+  m_types.clear();
+  m_methods.clear();
+  m_fields.clear();
+  return stats;
+}
+
+} // namespace reference_update
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+
+#include "ClassHierarchy.h"
+#include "DexClass.h"
+
+class IRInstruction;
+
+namespace reference_update {
+
+/**
+ * Collects the type, method and field substitutions of several
+ * transformations, and applies all of them at once, with a single parallel
+ * walk over the code. Calling update_method_signature_type_references,
+ * update_field_type_references and update_call_refs_simple one after the other
+ * walks the code once per call instead.
+ *
+ * Substitutions compose: after add_type(A, B) and add_type(B, C), references
+ * to A end up as references to C. Adding two different substitutions for the
+ * same type, method or field is an error.
+ *
+ * Applying the batch
+ *   1. updates the instructions: type operands, calls to old methods and
+ *      accesses to old fields. Method and field references that aren't
+ *      definitions and whose signatures refer to an old type are bound to
+ *      their definitions, or get a new signature if they don't resolve.
+ *   2. updates the signatures of the method and field definitions that refer
+ *      to an old type. Methods that would clash with an existing method are
+ *      renamed, or get extra arguments if they are constructors, the same way
+ *      update_method_signature_type_references does it. Fields that would
+ *      clash with an existing field are renamed.
+ */
+class Batch {
+ public:
+  struct Stats {
+    size_t updated_fields{0};
+    size_t renamed_fields{0};
+    size_t updated_type_insns{0};
+    size_t updated_method_insns{0};
+    size_t updated_field_insns{0};
+
+    Stats& operator+=(const Stats& that);
+  };
+
+  void add_type(const DexType* old_type, DexType* new_type);
+
+  // Calls that resolve to `old_callee` will call `new_callee` instead.
+  void add_method(DexMethod* old_callee, DexMethod* new_callee);
+
+  void add_field(DexFieldRef* old_field, DexFieldRef* new_field);
+
+  bool empty() const {
+    return m_types.empty() && m_methods.empty() && m_fields.empty();
+  }
+
+  // Called on every instruction whose type operand is about to change, e.g.
+  // to assert that the instruction is one the transformation expects.
+  using TypeInsnCheck = std::function<void(const IRInstruction*)>;
+
+  // Applies all the substitutions to the scope and clears the batch.
+  Stats apply(const Scope& scope,
+              const ClassHierarchy& ch,
+              const TypeInsnCheck& check_type_insn = nullptr);
+
+ private:
+  std::unordered_map<const DexType*, DexType*> m_types;
+  std::unordered_map<DexMethod*, DexMethod*> m_methods;
+  std::unordered_map<DexFieldRef*, DexFieldRef*> m_fields;
+};
+
+} // namespace reference_update
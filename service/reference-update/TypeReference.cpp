@@ -348,6 +348,18 @@ void TypeRefUpdater::update_methods_fields(const Scope& scope) {
   fix_colliding_dmethods(scope, colliding_inits);
 }
 
+bool TypeRefUpdater::update_type_reference(IRInstruction* insn) {
+  if (!insn->has_type()) {
+    return false;
+  }
+  DexType* new_type = try_convert_to_new_type(insn->get_type());
+  if (new_type == nullptr) {
+    return false;
+  }
+  insn->set_type(new_type);
+  return true;
+}
+
 DexType* TypeRefUpdater::try_convert_to_new_type(DexType* type) {
   uint32_t level = type::get_array_level(type);
   DexType* elem_type = type;
@@ -554,7 +566,7 @@ DexTypeList* drop_and_make(const DexTypeList* list, size_t num_types_to_drop) {
   return DexTypeList::make_type_list(std::move(dropped));
 }
 
-void update_method_signature_type_references(
+void update_method_signatures(
     const Scope& scope,
     const std::unordered_map<const DexType*, DexType*>& old_to_new,
     const ClassHierarchy& ch,
@@ -619,7 +631,20 @@ void update_method_signature_type_references(
     auto& group = key_and_group.second;
     update_vmethods_group_one_type_ref(group, ch);
   }
+}
+
+void update_method_signature_type_references(
+    const Scope& scope,
+    const std::unordered_map<const DexType*, DexType*>& old_to_new,
+    const ClassHierarchy& ch,
+    boost::optional<std::unordered_map<DexMethod*, std::string>&>
+        method_debug_map) {
+  update_method_signatures(scope, old_to_new, ch, method_debug_map);
 
+  UnorderedTypeSet old_types;
+  for (auto& pair : old_to_new) {
+    old_types.insert(pair.first);
+  }
   // Ensure that no method references left that still refer old types.
   walk::parallel::code(scope, [&old_types](DexMethod*, IRCode& code) {
     for (auto& mie : InstructionIterable(code)) {
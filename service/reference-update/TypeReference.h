@@ -13,6 +13,8 @@
 #include "ConcurrentContainers.h"
 #include "DexClass.h"
 
+class IRInstruction;
+
 using TypeSet = std::set<const DexType*, dextypes_comparator>;
 using UnorderedTypeSet = std::unordered_set<const DexType*>;
 
@@ -45,6 +47,14 @@ class TypeRefUpdater final {
 
   void update_methods_fields(const Scope& scope);
 
+  /**
+   * Update the type operand of `insn`, e.g. of a check-cast or a new-array, if
+   * it is a candidate. Return true if the instruction is updated. This is safe
+   * to call from several threads, so one parallel walk over the code can apply
+   * all the substitutions at once.
+   */
+  bool update_type_reference(IRInstruction* insn);
+
  private:
   /**
    * Try to convert "type" to a new type. Return nullptr if it's not found in
@@ -119,6 +129,18 @@ void update_method_signature_type_references(
     boost::optional<std::unordered_map<DexMethod*, std::string>&>
         method_debug_map = boost::none);
 
+/**
+ * The part of update_method_signature_type_references that updates the method
+ * definitions. It leaves the code alone, so the caller has to take care of the
+ * method references that aren't definitions.
+ */
+void update_method_signatures(
+    const Scope& scope,
+    const std::unordered_map<const DexType*, DexType*>& old_to_new,
+    const ClassHierarchy& ch,
+    boost::optional<std::unordered_map<DexMethod*, std::string>&>
+        method_debug_map = boost::none);
+
 void update_field_type_references(
     const Scope& scope,
     const std::unordered_map<const DexType*, DexType*>& old_to_new);
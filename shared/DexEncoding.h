@@ -9,6 +9,11 @@
 
 #include <stdint.h>
 #include <string>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace dex_encoding {
 namespace details {
@@ -17,6 +22,14 @@ namespace details {
 [[noreturn]] void throw_invalid(const char* msg);
 [[noreturn]] void throw_invalid(const char* msg, uint32_t size);
 
+constexpr uint64_t HIGH_BITS = 0x8080808080808080ull;
+
+inline uint64_t load_u64(const void* p) {
+  uint64_t word;
+  memcpy(&word, p, sizeof(word));
+  return word;
+}
+
 } // namespace details
 } // namespace dex_encoding
 
@@ -69,6 +82,68 @@ inline uint32_t read_uleb128p1(const uint8_t** _ptr) {
   return (v - 1);
 }
 
+/*
+ * Decodes `count` consecutive uleb128s into `out` and advances the pointer
+ * past them. `end` is the end of the readable memory; the uleb128s themselves
+ * don't have to extend to it.
+ *
+ * Runs of single-byte values are copied 8 at a time; everything else goes
+ * through read_uleb128(). Branch-free decoding of multi-byte values measured
+ * slower than read_uleb128() on dex class data (see
+ * test/perf/DexEncodingPerfTest.cpp), where the branches predict well.
+ */
+inline void read_uleb128_array(const uint8_t** _ptr,
+                               const uint8_t* end,
+                               uint32_t* out,
+                               size_t count) {
+  const uint8_t* ptr = *_ptr;
+  while (count > 0) {
+    if (count >= 8 && end - ptr >= 8) {
+      uint64_t word = dex_encoding::details::load_u64(ptr);
+      if ((word & dex_encoding::details::HIGH_BITS) == 0) {
+        for (size_t i = 0; i < 8; ++i) {
+          out[i] = (word >> (8 * i)) & 0xff;
+        }
+        ptr += 8;
+        out += 8;
+        count -= 8;
+        continue;
+      }
+    }
+    *out++ = read_uleb128(&ptr);
+    --count;
+  }
+  *_ptr = ptr;
+}
+
+/*
+ * Advances the pointer past `count` consecutive uleb128s, counting the bytes
+ * without a continuation bit 8 bytes at a time. `end` is the end of the
+ * readable memory. Unlike read_uleb128(), this doesn't stop after 5 bytes
+ * on malformed input.
+ */
+inline void skip_uleb128s(const uint8_t** _ptr,
+                          const uint8_t* end,
+                          size_t count) {
+  const uint8_t* ptr = *_ptr;
+  while (end - ptr >= 8) {
+    uint64_t stops = ~dex_encoding::details::load_u64(ptr) &
+                     dex_encoding::details::HIGH_BITS;
+    size_t num_stops = __builtin_popcountll(stops);
+    if (num_stops >= count) {
+      // The last uleb128 ends within these 8 bytes.
+      break;
+    }
+    count -= num_stops;
+    ptr += 8;
+  }
+  for (; count > 0; --count) {
+    while (*ptr++ & 0x80) {
+    }
+  }
+  *_ptr = ptr;
+}
+
 /*
  * Number of bytes it takes to encode a particular integer in a uleb128.
  */
@@ -133,6 +208,24 @@ inline uint8_t* write_uleb128(uint8_t* ptr, uint32_t val) {
   }
 }
 
+/*
+ * Encodes `count` values as consecutive uleb128s. Returns the pointer to the
+ * next location for encoding.
+ */
+inline uint8_t* write_uleb128_array(uint8_t* ptr,
+                                    const uint32_t* vals,
+                                    size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t val = vals[i];
+    if (val < 0x80) {
+      *ptr++ = val;
+    } else {
+      ptr = write_uleb128(ptr, val);
+    }
+  }
+  return ptr;
+}
+
 inline uint8_t* write_uleb128p1(uint8_t* ptr, uint32_t val) {
   return write_uleb128(ptr, val + 1);
 }
@@ -177,7 +270,7 @@ inline uint32_t mutf8_next_code_point(const char*& s) {
   /* Three byte code point */
   if ((v & 0xf0) == 0xe0) {
     uint8_t v3 = *s++;
-    if ((v2 & 0xc0) != 0x80) {
+    if ((v3 & 0xc0) != 0x80) {
       /* Invalid string. */
       dex_encoding::details::throw_invalid("Invalid 3rd byte on mutf8 string");
     }
@@ -187,16 +280,101 @@ inline uint32_t mutf8_next_code_point(const char*& s) {
   dex_encoding::details::throw_invalid("Invalid size encoding mutf8 string");
 }
 
+namespace dex_encoding {
+namespace details {
+
+/*
+ * The number of leading 7-bit bytes of [s, s + size), checking 16 bytes at a
+ * time with SSE2, or else 8 at a time.
+ */
+inline size_t ascii_prefix_length(const char* s, size_t size) {
+  size_t i = 0;
+#ifdef __SSE2__
+  for (; i + 16 <= size; i += 16) {
+    auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    auto non_ascii = _mm_movemask_epi8(chunk);
+    if (non_ascii != 0) {
+      return i + __builtin_ctz(non_ascii);
+    }
+  }
+#endif
+  for (; i + 8 <= size; i += 8) {
+    auto non_ascii = load_u64(s + i) & HIGH_BITS;
+    if (non_ascii != 0) {
+      return i + (__builtin_ctzll(non_ascii) >> 3);
+    }
+  }
+  while (i < size && !(s[i] & 0x80)) {
+    ++i;
+  }
+  return i;
+}
+
+} // namespace details
+} // namespace dex_encoding
+
+/*
+ * The number of code points of the MUTF-8 string of `size` bytes at `s`,
+ * skipping over runs of ASCII in bulk. The string must be NUL-terminated
+ * (as DexStrings and std::strings are), so that a truncated multi-byte
+ * sequence at the end is detected.
+ */
+inline uint32_t length_of_utf8_string(const char* s, size_t size) {
+  const char* end = s + size;
+  uint32_t len = 0;
+  while (s < end) {
+    auto ascii = dex_encoding::details::ascii_prefix_length(s, end - s);
+    len += ascii;
+    s += ascii;
+    if (s < end) {
+      ++len;
+      mutf8_next_code_point(s);
+    }
+  }
+  return len;
+}
+
 inline uint32_t length_of_utf8_string(const char* s) {
   if (s == nullptr) {
     return 0;
   }
-  uint32_t len = 0;
-  while (*s != '\0') {
-    ++len;
-    mutf8_next_code_point(s);
+  return length_of_utf8_string(s, strlen(s));
+}
+
+/*
+ * Whether the `size` bytes at `s` are well-formed MUTF-8: no NUL bytes, and
+ * only complete two- and three-byte sequences besides ASCII.
+ */
+inline bool is_valid_mutf8(const char* s, size_t size) {
+  const char* end = s + size;
+  while (s < end) {
+    auto ascii = dex_encoding::details::ascii_prefix_length(s, end - s);
+    if (memchr(s, '\0', ascii) != nullptr) {
+      return false;
+    }
+    s += ascii;
+    if (s == end) {
+      break;
+    }
+    uint8_t v = *s++;
+    size_t continuations;
+    if ((v & 0xe0) == 0xc0) {
+      continuations = 1;
+    } else if ((v & 0xf0) == 0xe0) {
+      continuations = 2;
+    } else {
+      return false;
+    }
+    if (size_t(end - s) < continuations) {
+      return false;
+    }
+    for (; continuations > 0; --continuations) {
+      if ((*s++ & 0xc0) != 0x80) {
+        return false;
+      }
+    }
   }
-  return len;
+  return true;
 }
 
 // https://docs.oracle.com/javase/8/docs/api/java/lang/String.html#hashCode--
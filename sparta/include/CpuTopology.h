@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace sparta {
+
+namespace parallel {
+
+/**
+ * The NUMA nodes of the machine and the CPUs that belong to each of them, as
+ * reported by Linux in /sys/devices/system/node. Only the CPUs in the affinity
+ * mask of the process (e.g. as set by taskset) count, as of when the topology
+ * is first read. On other platforms, or when the information is not
+ * available, the machine is modeled as a single node with all CPUs.
+ */
+class CpuTopology {
+ public:
+  static const CpuTopology& get() {
+    static const CpuTopology topology;
+    return topology;
+  }
+
+  size_t num_nodes() const { return m_node_cpus.size(); }
+
+  const std::vector<int>& cpus_of_node(size_t node) const {
+    return m_node_cpus[node];
+  }
+
+  // The node of the given CPU, or 0 if unknown.
+  size_t node_of_cpu(int cpu) const {
+    return cpu >= 0 && size_t(cpu) < m_cpu_node.size() ? m_cpu_node[cpu] : 0;
+  }
+
+  // The node the calling thread is currently running on.
+  size_t current_node() const {
+#ifdef __linux__
+    return node_of_cpu(sched_getcpu());
+#else
+    return 0;
+#endif
+  }
+
+  /*
+   * Restrict the calling thread to the given CPU, which has to be one of the
+   * CPUs of a node. Returns whether that succeeded.
+   */
+  static bool pin_current_thread(int cpu) {
+#ifdef __linux__
+    const auto& topology = get();
+    if (cpu < 0 || cpu >= CPU_SETSIZE ||
+        (topology.m_has_affinity && !CPU_ISSET(cpu, &topology.m_affinity))) {
+      return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+  }
+
+  /*
+   * Allow the calling thread to run on all the CPUs of the process' affinity
+   * mask again.
+   */
+  static bool unpin_current_thread() {
+#ifdef __linux__
+    const auto& topology = get();
+    cpu_set_t set = topology.m_affinity;
+    if (!topology.m_has_affinity) {
+      CPU_ZERO(&set);
+      for (const auto& cpus : topology.m_node_cpus) {
+        for (auto cpu : cpus) {
+          CPU_SET(cpu, &set);
+        }
+      }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+  }
+
+ private:
+  CpuTopology() {
+#ifdef __linux__
+    CPU_ZERO(&m_affinity);
+    m_has_affinity =
+        sched_getaffinity(0, sizeof(m_affinity), &m_affinity) == 0;
+    auto is_allowed = [this](int cpu) {
+      return !m_has_affinity ||
+             (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &m_affinity));
+    };
+    for (size_t node = 0;; ++node) {
+      std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) +
+                       "/cpulist");
+      if (!in) {
+        break;
+      }
+      std::string cpulist;
+      std::getline(in, cpulist);
+      auto cpus = parse_cpulist(cpulist);
+      cpus.erase(std::remove_if(cpus.begin(), cpus.end(),
+                                [&](int cpu) { return !is_allowed(cpu); }),
+                 cpus.end());
+      if (cpus.empty()) {
+        // A memory-only node, or one whose CPUs the process may not use.
+        continue;
+      }
+      for (auto cpu : cpus) {
+        if (size_t(cpu) >= m_cpu_node.size()) {
+          m_cpu_node.resize(cpu + 1, 0);
+        }
+        m_cpu_node[cpu] = m_node_cpus.size();
+      }
+      m_node_cpus.push_back(std::move(cpus));
+    }
+#endif
+    if (m_node_cpus.empty()) {
+      std::vector<int> cpus;
+#ifdef __linux__
+      if (m_has_affinity) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+          if (CPU_ISSET(cpu, &m_affinity)) {
+            cpus.push_back(cpu);
+          }
+        }
+      }
+#endif
+      if (cpus.empty()) {
+        for (unsigned int cpu = 0; cpu < std::thread::hardware_concurrency();
+             ++cpu) {
+          cpus.push_back(cpu);
+        }
+      }
+      if (cpus.empty()) {
+        cpus.push_back(0);
+      }
+      m_cpu_node.assign(cpus.back() + 1, 0);
+      m_node_cpus.push_back(std::move(cpus));
+    }
+  }
+
+  // Parses lists like "0-3,8-11,16".
+  static std::vector<int> parse_cpulist(const std::string& cpulist) {
+    std::vector<int> cpus;
+    std::istringstream ranges(cpulist);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+      if (range.empty()) {
+        continue;
+      }
+      auto dash = range.find('-');
+      int first = std::stoi(range.substr(0, dash));
+      int last =
+          dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      for (int cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    }
+    return cpus;
+  }
+
+  std::vector<std::vector<int>> m_node_cpus;
+  std::vector<size_t> m_cpu_node;
+#ifdef __linux__
+  // The affinity mask of the process when the topology was read.
+  cpu_set_t m_affinity;
+  bool m_has_affinity{false};
+#endif
+};
+
+} // namespace parallel
+
+} // namespace sparta
@@ -13,14 +13,19 @@
 #include <cassert>
 #include <chrono>
 #include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <numeric>
 #include <queue>
 #include <random>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include "Arity.h"
+#include "CpuTopology.h"
 
 namespace sparta {
 
@@ -90,6 +95,294 @@ class Semaphore {
   size_t m_count;
 };
 
+/**
+ * Counts down the outstanding jobs of a run; wait() returns once all of them
+ * are done.
+ */
+class Latch {
+ public:
+  explicit Latch(size_t count = 0) : m_count(count) {}
+
+  void add(size_t n) {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_count += n;
+  }
+
+  void count_down() {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    assert(m_count > 0);
+    if (--m_count == 0) {
+      m_cv.notify_all();
+    }
+  }
+
+  void wait() {
+    std::unique_lock<std::mutex> lock(m_mtx);
+    m_cv.wait(lock, [this] { return m_count == 0; });
+  }
+
+ private:
+  std::mutex m_mtx;
+  std::condition_variable m_cv;
+  size_t m_count;
+};
+
+/**
+ * A process-wide pool of persistent threads that all SpartaWorkQueues borrow
+ * from, so that run_all() doesn't have to create and join its threads every
+ * time. Threads are created on demand and stay around, idle, once their job
+ * is done.
+ *
+ * A run_all() issued from a thread that is itself working for a work queue
+ * (nested parallelism) only borrows the threads that are idle at that moment
+ * and never creates new ones, so that forking subtasks doesn't oversubscribe
+ * the machine. The caller always participates in the work, so a nested queue
+ * makes progress even if no thread is available.
+ */
+class ThreadPool {
+ public:
+  static ThreadPool& get() {
+    // Intentionally leaked: work queues may still be used during static
+    // destruction, and the idle threads just die with the process.
+    static ThreadPool* pool = new ThreadPool();
+    return *pool;
+  }
+
+  /*
+   * Whether the calling thread is currently working for a work queue.
+   */
+  static bool& in_worker() {
+    static thread_local bool in_worker = false;
+    return in_worker;
+  }
+
+  /*
+   * Marks the calling thread as working for a work queue for its scope.
+   */
+  class WorkerScope {
+   public:
+    WorkerScope() : m_previous(in_worker()) { in_worker() = true; }
+    ~WorkerScope() { in_worker() = m_previous; }
+
+   private:
+    bool m_previous;
+  };
+
+  /*
+   * Hands `job(0)`, ..., `job(n - 1)` to pool threads, where n is `count`
+   * if `may_grow` is true, or the number of idle threads (at most `count`)
+   * otherwise. `latch` is counted down as each job finishes. Returns n.
+   *
+   * With pinning enabled, `nodes[i]` is the NUMA node job i should preferably
+   * run on; see set_pinning().
+   */
+  size_t start(size_t count,
+               bool may_grow,
+               Latch& latch,
+               const std::function<void(size_t)>& job,
+               const std::vector<size_t>& nodes = {}) {
+    std::vector<Worker*> workers;
+    {
+      std::lock_guard<std::mutex> lock(m_mtx);
+      bool pinning = m_pinning.load();
+      while (workers.size() < count) {
+        Worker* worker;
+        if (pinning && workers.size() < nodes.size()) {
+          worker = take_worker_on_node(nodes[workers.size()], may_grow);
+        } else if (!m_idle.empty()) {
+          worker = m_idle.back();
+          m_idle.pop_back();
+        } else if (may_grow) {
+          worker = create_worker();
+        } else {
+          break;
+        }
+        if (worker == nullptr) {
+          break;
+        }
+        if (pinning && worker->cpu < 0) {
+          assign_cpu(worker,
+                     m_next_node++ % parallel::CpuTopology::get().num_nodes());
+        }
+        workers.push_back(worker);
+      }
+    }
+    latch.add(workers.size());
+    for (size_t i = 0; i < workers.size(); ++i) {
+      auto worker = workers[i];
+      std::lock_guard<std::mutex> lock(worker->mtx);
+      worker->job = [job, i] { job(i); };
+      worker->latch = &latch;
+      worker->cv.notify_one();
+    }
+    return workers.size();
+  }
+
+  size_t num_threads() {
+    std::lock_guard<std::mutex> lock(m_mtx);
+    return m_workers.size();
+  }
+
+  /*
+   * When pinning is enabled, every pool thread is bound to a single CPU,
+   * spread round-robin over the NUMA nodes, and work queues assign each of
+   * their worker states to a node (see SpartaWorkQueue::node_of_state).
+   * Since work queues distribute their items over the states in insertion
+   * order, walking the same items twice runs each item on the same node both
+   * times, so that memory first touched by the first walk (e.g. IRCode
+   * ballooned in parallel) is local to the threads of the later ones.
+   *
+   * Threads that are already running get pinned when they pick up their next
+   * job, and unpinned again when pinning is disabled.
+   */
+  void set_pinning(bool pinning) { m_pinning = pinning; }
+
+  bool pinning() const { return m_pinning.load(); }
+
+  /*
+   * The NUMA node of the calling thread: the node it is pinned to, if any,
+   * otherwise the one it happens to be running on.
+   */
+  static size_t current_node() {
+    auto node = pinned_node();
+    return node >= 0 ? node : parallel::CpuTopology::get().current_node();
+  }
+
+  /*
+   * How many work queue items ran on a thread of the node of the worker
+   * state they were queued on (local) or were stolen by a thread of another
+   * node (remote), while pinning was enabled.
+   */
+  struct PlacementStats {
+    uint64_t local_tasks{0};
+    uint64_t remote_tasks{0};
+  };
+
+  PlacementStats placement_stats() const {
+    PlacementStats stats;
+    stats.local_tasks = m_local_tasks.load(std::memory_order_relaxed);
+    stats.remote_tasks = m_remote_tasks.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  void record_placement(uint64_t local_tasks, uint64_t remote_tasks) {
+    m_local_tasks.fetch_add(local_tasks, std::memory_order_relaxed);
+    m_remote_tasks.fetch_add(remote_tasks, std::memory_order_relaxed);
+  }
+
+ private:
+  struct Worker {
+    std::thread thread;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::function<void()> job;
+    Latch* latch{nullptr};
+    // The CPU the thread should be pinned to, and its node. Only written
+    // while the thread is idle, under m_mtx.
+    int cpu{-1};
+    size_t node{0};
+  };
+
+  static int& pinned_node() {
+    static thread_local int node = -1;
+    return node;
+  }
+
+  ThreadPool() = default;
+
+  Worker* create_worker() {
+    m_workers.emplace_back(new Worker());
+    auto worker = m_workers.back().get();
+    worker->thread = std::thread([this, worker] { loop(worker); });
+    return worker;
+  }
+
+  void assign_cpu(Worker* worker, size_t node) {
+    const auto& cpus = parallel::CpuTopology::get().cpus_of_node(node);
+    if (m_next_cpu.size() <= node) {
+      m_next_cpu.resize(node + 1, 0);
+    }
+    worker->cpu = cpus[m_next_cpu[node]++ % cpus.size()];
+    worker->node = node;
+  }
+
+  /*
+   * An idle thread on the given node, or else a fresh one (if allowed), or
+   * else any idle thread. Returns nullptr if there is none.
+   */
+  Worker* take_worker_on_node(size_t node, bool may_grow) {
+    auto take = [this](std::vector<Worker*>::iterator it) {
+      auto worker = *it;
+      m_idle.erase(it);
+      return worker;
+    };
+    auto local = std::find_if(m_idle.begin(), m_idle.end(), [&](Worker* w) {
+      return w->cpu >= 0 && w->node == node;
+    });
+    if (local != m_idle.end()) {
+      return take(local);
+    }
+    auto unassigned = std::find_if(m_idle.begin(), m_idle.end(),
+                                   [](Worker* w) { return w->cpu < 0; });
+    if (unassigned != m_idle.end()) {
+      auto worker = take(unassigned);
+      assign_cpu(worker, node);
+      return worker;
+    }
+    if (may_grow) {
+      auto worker = create_worker();
+      assign_cpu(worker, node);
+      return worker;
+    }
+    return m_idle.empty() ? nullptr : take(m_idle.end() - 1);
+  }
+
+  void loop(Worker* worker) {
+    in_worker() = true;
+    int pinned_cpu = -1;
+    while (true) {
+      std::function<void()> job;
+      Latch* latch;
+      int cpu;
+      {
+        std::unique_lock<std::mutex> lock(worker->mtx);
+        worker->cv.wait(lock, [worker] { return bool(worker->job); });
+        job = std::move(worker->job);
+        worker->job = nullptr;
+        latch = worker->latch;
+        cpu = m_pinning.load() ? worker->cpu : -1;
+      }
+      if (cpu != pinned_cpu) {
+        const auto& topology = parallel::CpuTopology::get();
+        bool pinned = cpu >= 0 ? parallel::CpuTopology::pin_current_thread(cpu)
+                               : parallel::CpuTopology::unpin_current_thread();
+        if (pinned) {
+          pinned_cpu = cpu;
+          pinned_node() = cpu >= 0 ? int(topology.node_of_cpu(cpu)) : -1;
+        }
+      }
+      job();
+      // Become available again before reporting completion, so that a
+      // subsequent run finds this thread idle.
+      {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_idle.push_back(worker);
+      }
+      latch->count_down();
+    }
+  }
+
+  std::mutex m_mtx;
+  std::vector<std::unique_ptr<Worker>> m_workers;
+  std::vector<Worker*> m_idle;
+  std::atomic<bool> m_pinning{false};
+  // Round-robin cursors for placing new threads, guarded by m_mtx.
+  size_t m_next_node{0};
+  std::vector<size_t> m_next_cpu;
+  std::atomic<uint64_t> m_local_tasks{0};
+  std::atomic<uint64_t> m_remote_tasks{0};
+};
+
 struct StateCounters {
   std::atomic_uint num_non_empty;
   std::atomic_uint num_running;
@@ -215,10 +508,19 @@ class SpartaWorkQueue {
   void add_item(Input task, size_t worker_id);
 
   /**
-   * Spawn threads and evaluate function.  This method blocks.
+   * Evaluate the function on all items, using the calling thread and threads
+   * borrowed from the process-wide ThreadPool.  This method blocks.
    */
   void run_all();
 
+  /*
+   * The NUMA node whose threads process the queue of the given worker state
+   * when ThreadPool pinning is enabled.
+   */
+  static size_t node_of_state(size_t worker_id) {
+    return worker_id % parallel::CpuTopology::get().num_nodes();
+  }
+
   template <class>
   friend class SpartaWorkerState;
 };
@@ -257,13 +559,27 @@ void SpartaWorkQueue<Input, Executor>::add_item(Input task, size_t worker_id) {
  */
 template <class Input, typename Executor>
 void SpartaWorkQueue<Input, Executor>::run_all() {
-  std::vector<std::thread> all_threads;
   m_state_counters.num_non_empty = 0;
   m_state_counters.num_running = 0;
   m_state_counters.waiter->take_all();
-  auto worker = [&](SpartaWorkerState<Input>* state, size_t state_idx) {
+  std::mutex exception_mtx;
+  std::exception_ptr exception;
+  auto& pool = workqueue_impl::ThreadPool::get();
+  const bool pinning = pool.pinning();
+  auto worker = [&](SpartaWorkerState<Input>* state,
+                    size_t state_idx,
+                    uint64_t& local_tasks,
+                    uint64_t& remote_tasks) {
     auto attempts =
         workqueue_impl::create_permutation(m_num_threads, state_idx);
+    size_t node = 0;
+    if (pinning) {
+      // Steal from the states of our own node first.
+      node = workqueue_impl::ThreadPool::current_node();
+      std::stable_partition(
+          attempts.begin() + 1, attempts.end(),
+          [node](unsigned int idx) { return node_of_state(idx) == node; });
+    }
     while (true) {
       auto have_task = false;
       for (auto idx : attempts) {
@@ -271,6 +587,9 @@ void SpartaWorkQueue<Input, Executor>::run_all() {
         auto task = other_state->pop_task(state);
         if (task) {
           have_task = true;
+          if (pinning) {
+            ++(node_of_state(idx) == node ? local_tasks : remote_tasks);
+          }
           consume(state, *task);
           break;
         }
@@ -298,18 +617,67 @@ void SpartaWorkQueue<Input, Executor>::run_all() {
       m_state_counters.waiter->take(); // Wait for work.
     }
   };
+  auto guarded_worker = [&](size_t state_idx) {
+    auto state = m_states[state_idx].get();
+    uint64_t local_tasks = 0;
+    uint64_t remote_tasks = 0;
+    try {
+      worker(state, state_idx, local_tasks, remote_tasks);
+    } catch (...) {
+      {
+        std::lock_guard<std::mutex> lock(exception_mtx);
+        if (!exception) {
+          exception = std::current_exception();
+        }
+      }
+      // Don't leave the other workers waiting for this one.
+      state->set_running(false);
+      m_state_counters.waiter->give(m_state_counters.num_all);
+    }
+    if (pinning) {
+      pool.record_placement(local_tasks, remote_tasks);
+    }
+  };
 
   for (size_t i = 0; i < m_num_threads; ++i) {
     if (!m_states[i]->m_queue.empty()) {
       ++m_state_counters.num_non_empty;
     }
   }
-  for (size_t i = 0; i < m_num_threads; ++i) {
-    all_threads.emplace_back(std::bind<void>(worker, m_states[i].get(), i));
+
+  workqueue_impl::Latch latch;
+  const bool nested = workqueue_impl::ThreadPool::in_worker();
+  if (pinning && !nested) {
+    // Run every state on a pool thread of its node; the (unpinned) calling
+    // thread just waits.
+    std::vector<size_t> nodes(m_num_threads);
+    for (size_t i = 0; i < m_num_threads; ++i) {
+      nodes[i] = node_of_state(i);
+    }
+    pool.start(m_num_threads, /* may_grow */ true, latch, guarded_worker,
+               nodes);
+  } else {
+    // The calling thread works on the first state, pool threads on the
+    // others. Workers steal from all queues, so all the work gets done even
+    // if a nested run gets fewer threads than it asked for.
+    std::vector<size_t> nodes;
+    if (pinning) {
+      for (size_t i = 1; i < m_num_threads; ++i) {
+        nodes.push_back(node_of_state(i));
+      }
+    }
+    pool.start(m_num_threads - 1,
+               /* may_grow */ !nested,
+               latch,
+               [&](size_t i) { guarded_worker(i + 1); },
+               nodes);
+    workqueue_impl::ThreadPool::WorkerScope scope;
+    guarded_worker(0);
   }
+  latch.wait();
 
-  for (auto& thread : all_threads) {
-    thread.join();
+  if (exception) {
+    std::rethrow_exception(exception);
   }
 
   for (size_t i = 0; i < m_num_threads; ++i) {
@@ -7,10 +7,16 @@
 
 #include "SpartaWorkQueue.h"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <gtest/gtest.h>
+#include <mutex>
 #include <random>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
 
 constexpr unsigned int NUM_INTS = 1000;
 
@@ -99,3 +105,129 @@ TEST(SpartaWorkQueueTest, preciseScheduling) {
     ASSERT_EQ(1, array[idx]);
   }
 }
+
+TEST(SpartaWorkQueueTest, reusesThreads) {
+  auto& pool = sparta::workqueue_impl::ThreadPool::get();
+  std::atomic<int> result{0};
+  std::mutex thread_ids_lock;
+  std::unordered_set<std::thread::id> thread_ids;
+  size_t threads_after_first_run = 0;
+  for (int run = 0; run < 100; ++run) {
+    auto wq = sparta::work_queue<int>(
+        [&](int a) {
+          result += a;
+          std::lock_guard<std::mutex> lock(thread_ids_lock);
+          thread_ids.insert(std::this_thread::get_id());
+        },
+        4);
+    for (int idx = 0; idx < 10; ++idx) {
+      wq.add_item(1);
+    }
+    wq.run_all();
+    if (run == 0) {
+      threads_after_first_run = pool.num_threads();
+    } else {
+      // Later runs find the threads of the first one idle.
+      EXPECT_EQ(pool.num_threads(), threads_after_first_run);
+    }
+  }
+  EXPECT_EQ(1000, result);
+  // The caller does a share of the work, so 3 pool threads suffice for all
+  // runs.
+  EXPECT_GE(threads_after_first_run, 3);
+  // All the work ran on the caller and the pool threads, not on new threads
+  // per run.
+  EXPECT_LE(thread_ids.size(), threads_after_first_run + 1);
+}
+
+TEST(SpartaWorkQueueTest, nestedQueues) {
+  constexpr size_t num_threads{4};
+  std::atomic<int> result{0};
+  auto& pool = sparta::workqueue_impl::ThreadPool::get();
+  auto outer = sparta::work_queue<int>(
+      [&](int a) {
+        auto inner = sparta::work_queue<int>([&](int b) { result += b; },
+                                             num_threads);
+        for (int idx = 0; idx < a; ++idx) {
+          inner.add_item(1);
+        }
+        inner.run_all();
+      },
+      num_threads);
+  for (int idx = 0; idx < 20; ++idx) {
+    outer.add_item(idx);
+  }
+  auto threads_before = pool.num_threads();
+  outer.run_all();
+
+  // 0 + 1 + ... + 19 = 190
+  EXPECT_EQ(190, result);
+  // Nested queues only borrow idle threads.
+  EXPECT_LE(pool.num_threads(), std::max<size_t>(threads_before, 3));
+}
+
+TEST(SpartaWorkQueueTest, propagatesExceptions) {
+  auto wq = sparta::work_queue<int>(
+      [](int a) {
+        if (a == 42) {
+          throw std::runtime_error("42");
+        }
+      },
+      4);
+  for (int idx = 0; idx < 100; ++idx) {
+    wq.add_item(idx);
+  }
+  EXPECT_THROW(wq.run_all(), std::runtime_error);
+}
+
+TEST(SpartaWorkQueueTest, pinnedThreads) {
+  auto& pool = sparta::workqueue_impl::ThreadPool::get();
+  pool.set_pinning(true);
+  auto stats_before = pool.placement_stats();
+
+  constexpr size_t num_threads{4};
+  std::atomic<int> result{0};
+  auto wq = sparta::work_queue<int>([&](int a) { result += a; }, num_threads);
+  for (int idx = 0; idx < 1000; ++idx) {
+    wq.add_item(idx);
+  }
+  wq.run_all();
+  pool.set_pinning(false);
+
+  // 0 + 1 + ... + 999 = 499500
+  EXPECT_EQ(499500, result);
+  auto stats = pool.placement_stats();
+  EXPECT_EQ(1000,
+            (stats.local_tasks - stats_before.local_tasks) +
+                (stats.remote_tasks - stats_before.remote_tasks));
+
+  // Unpinned runs don't count.
+  auto wq2 = sparta::work_queue<int>([&](int a) { result += a; }, num_threads);
+  wq2.add_item(1);
+  wq2.run_all();
+  auto stats_after = pool.placement_stats();
+  EXPECT_EQ(stats.local_tasks, stats_after.local_tasks);
+  EXPECT_EQ(stats.remote_tasks, stats_after.remote_tasks);
+}
+
+#ifdef __linux__
+TEST(SpartaWorkQueueTest, pinningStaysWithinAffinityMask) {
+  cpu_set_t allowed;
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(allowed), &allowed));
+  const auto& topology = sparta::parallel::CpuTopology::get();
+  for (size_t node = 0; node < topology.num_nodes(); ++node) {
+    for (auto cpu : topology.cpus_of_node(node)) {
+      EXPECT_TRUE(CPU_ISSET(cpu, &allowed)) << "CPU " << cpu;
+    }
+  }
+
+  std::thread([&] {
+    EXPECT_TRUE(sparta::parallel::CpuTopology::pin_current_thread(
+        topology.cpus_of_node(0).front()));
+    EXPECT_TRUE(sparta::parallel::CpuTopology::unpin_current_thread());
+    cpu_set_t after;
+    ASSERT_EQ(0, sched_getaffinity(0, sizeof(after), &after));
+    EXPECT_TRUE(CPU_EQUAL(&allowed, &after));
+  }).join();
+}
+#endif
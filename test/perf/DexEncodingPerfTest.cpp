@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "DexDefs.h"
+#include "DexEncoding.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <vector>
+
+//==========
+// Compares the bulk uleb128 and MUTF-8 codecs with their byte-at-a-time
+// counterparts, over the string tables and class data of the given dex files
+// (or of a synthetic one):
+//
+//   dex_encoding_perf_test classes.dex classes2.dex ...
+//==========
+
+namespace {
+
+constexpr int NUM_ITERATIONS = 50;
+
+struct DexData {
+  std::vector<char> bytes;
+  // The MUTF-8 data of all strings.
+  std::vector<const char*> strings;
+  // The class_data_items.
+  std::vector<const uint8_t*> class_data;
+
+  const uint8_t* begin() const {
+    return reinterpret_cast<const uint8_t*>(bytes.data());
+  }
+  const uint8_t* end() const { return begin() + bytes.size(); }
+};
+
+DexData load_dex(const char* path) {
+  DexData data;
+  std::ifstream in(path, std::ios::binary);
+  data.bytes.assign(std::istreambuf_iterator<char>(in),
+                    std::istreambuf_iterator<char>());
+  auto dh = reinterpret_cast<const dex_header*>(data.bytes.data());
+  auto string_ids = reinterpret_cast<const dex_string_id*>(
+      data.begin() + dh->string_ids_off);
+  for (uint32_t i = 0; i < dh->string_ids_size; ++i) {
+    const uint8_t* ptr = data.begin() + string_ids[i].offset;
+    read_uleb128(&ptr); // utf16_size
+    data.strings.push_back(reinterpret_cast<const char*>(ptr));
+  }
+  auto map_list =
+      reinterpret_cast<const dex_map_list*>(data.begin() + dh->map_off);
+  for (uint32_t i = 0; i < map_list->size; ++i) {
+    const auto& item = map_list->items[i];
+    if (item.type != TYPE_CLASS_DATA_ITEM) {
+      continue;
+    }
+    const uint8_t* ptr = data.begin() + item.offset;
+    for (uint32_t j = 0; j < item.size; ++j) {
+      data.class_data.push_back(ptr);
+      uint32_t counts[4];
+      read_uleb128_array(&ptr, data.end(), counts, 4);
+      skip_uleb128s(&ptr, data.end(),
+                    2 * (counts[0] + counts[1]) + 3 * (counts[2] + counts[3]));
+    }
+  }
+  return data;
+}
+
+// Mostly class and member names, with the odd non-ASCII string, and class
+// data for small classes.
+DexData synthetic_dex() {
+  DexData data;
+  std::vector<size_t> string_offsets;
+  for (int i = 0; i < 100000; ++i) {
+    string_offsets.push_back(data.bytes.size());
+    std::string str = "Lcom/facebook/redex/generated/Class" + std::to_string(i);
+    if (i % 50 == 0) {
+      str += "\xc3\xa9t\xc3\xa9";
+    }
+    str += ";";
+    data.bytes.insert(data.bytes.end(), str.c_str(),
+                      str.c_str() + str.size() + 1);
+  }
+  std::vector<size_t> class_data_offsets;
+  for (uint32_t i = 0; i < 20000; ++i) {
+    class_data_offsets.push_back(data.bytes.size());
+    std::vector<uint32_t> values = {2, 3, 4, 6};
+    for (uint32_t f = 0; f < 5; ++f) {
+      values.push_back(f == 0 ? i * 5 : 1);
+      values.push_back(f < 2 ? 0x19 : 0x2);
+    }
+    for (uint32_t m = 0; m < 10; ++m) {
+      values.push_back(m == 0 || m == 4 ? i * 10 : 1);
+      values.push_back(m % 3 == 0 ? 0x10001 : 0x1);
+      values.push_back(0x10000 + 64 * (i * 10 + m));
+    }
+    uint8_t buf[5 * 64];
+    auto end = write_uleb128_array(buf, values.data(), values.size());
+    data.bytes.insert(data.bytes.end(), buf, end);
+  }
+  for (auto offset : string_offsets) {
+    data.strings.push_back(data.bytes.data() + offset);
+  }
+  for (auto offset : class_data_offsets) {
+    data.class_data.push_back(data.begin() + offset);
+  }
+  return data;
+}
+
+// What length_of_utf8_string() used to do.
+uint32_t scalar_length_of_utf8_string(const char* s) {
+  uint32_t len = 0;
+  while (*s != '\0') {
+    ++len;
+    mutf8_next_code_point(s);
+  }
+  return len;
+}
+
+// The fastest of NUM_ITERATIONS runs, to filter out noise.
+template <typename Fn>
+double time_ns_per_iteration(const Fn& fn) {
+  double best = std::numeric_limits<double>::max();
+  for (int i = 0; i < NUM_ITERATIONS; ++i) {
+    auto start = std::chrono::high_resolution_clock::now();
+    fn();
+    auto end = std::chrono::high_resolution_clock::now();
+    best = std::min<double>(
+        best,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count());
+  }
+  return best;
+}
+
+void report(const char* what, double baseline_ns, double bulk_ns) {
+  printf("%-28s %12.0f us %12.0f us %8.2fx\n", what, baseline_ns / 1000,
+         bulk_ns / 1000, baseline_ns / bulk_ns);
+}
+
+void run(const DexData& data) {
+  printf("%zu strings, %zu class_data_items\n", data.strings.size(),
+         data.class_data.size());
+  printf("%-28s %15s %15s %9s\n", "", "byte-at-a-time", "bulk", "speedup");
+  volatile uint64_t sink = 0;
+
+  auto scalar_length = time_ns_per_iteration([&] {
+    uint64_t total = 0;
+    for (auto s : data.strings) {
+      total += scalar_length_of_utf8_string(s);
+    }
+    sink = sink + total;
+  });
+  auto bulk_length = time_ns_per_iteration([&] {
+    uint64_t total = 0;
+    for (auto s : data.strings) {
+      total += length_of_utf8_string(s, strlen(s));
+    }
+    sink = sink + total;
+  });
+  report("MUTF-8 length", scalar_length, bulk_length);
+
+  auto scalar_validate = time_ns_per_iteration([&] {
+    uint64_t total = 0;
+    for (auto s : data.strings) {
+      // Decoding throws on invalid strings, so this validates them, too.
+      total += scalar_length_of_utf8_string(s);
+    }
+    sink = sink + total;
+  });
+  auto bulk_validate = time_ns_per_iteration([&] {
+    uint64_t total = 0;
+    for (auto s : data.strings) {
+      total += is_valid_mutf8(s, strlen(s));
+    }
+    sink = sink + total;
+  });
+  report("MUTF-8 validation", scalar_validate, bulk_validate);
+
+  std::vector<uint32_t> values;
+  auto scalar_decode = time_ns_per_iteration([&] {
+    for (auto ptr : data.class_data) {
+      uint32_t counts[4];
+      for (auto& count : counts) {
+        count = read_uleb128(&ptr);
+      }
+      values.resize(2 * (counts[0] + counts[1]) + 3 * (counts[2] + counts[3]));
+      for (auto& value : values) {
+        value = read_uleb128(&ptr);
+      }
+      sink = sink + values.size();
+    }
+  });
+  auto bulk_decode = time_ns_per_iteration([&] {
+    for (auto ptr : data.class_data) {
+      uint32_t counts[4];
+      read_uleb128_array(&ptr, data.end(), counts, 4);
+      values.resize(2 * (counts[0] + counts[1]) + 3 * (counts[2] + counts[3]));
+      read_uleb128_array(&ptr, data.end(), values.data(), values.size());
+      sink = sink + values.size();
+    }
+  });
+  report("class_data decode", scalar_decode, bulk_decode);
+
+  auto scalar_skip = time_ns_per_iteration([&] {
+    for (auto ptr : data.class_data) {
+      uint32_t counts[4];
+      for (auto& count : counts) {
+        count = read_uleb128(&ptr);
+      }
+      auto num = 2 * (counts[0] + counts[1]) + 3 * (counts[2] + counts[3]);
+      for (uint32_t i = 0; i < num; ++i) {
+        read_uleb128(&ptr);
+      }
+      sink = sink + (ptr - data.begin());
+    }
+  });
+  auto bulk_skip = time_ns_per_iteration([&] {
+    for (auto ptr : data.class_data) {
+      uint32_t counts[4];
+      read_uleb128_array(&ptr, data.end(), counts, 4);
+      skip_uleb128s(&ptr, data.end(),
+                    2 * (counts[0] + counts[1]) + 3 * (counts[2] + counts[3]));
+      sink = sink + (ptr - data.begin());
+    }
+  });
+  report("class_data skip", scalar_skip, bulk_skip);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    printf("synthetic dex: ");
+    run(synthetic_dex());
+  }
+  for (int i = 1; i < argc; ++i) {
+    printf("%s: ", argv[i]);
+    run(load_dex(argv[i]));
+  }
+}
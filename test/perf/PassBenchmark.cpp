@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <json/json.h>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CommonSubexpressionEliminationPass.h"
+#include "ConfigFiles.h"
+#include "ConstantPropagationPass.h"
+#include "Debug.h"
+#include "DexOutput.h"
+#include "DexPosition.h"
+#include "DexStore.h"
+#include "InstructionLowering.h"
+#include "InterDexPass.h"
+#include "MethodInlinePass.h"
+#include "PassManager.h"
+#include "RedexContext.h"
+#include "RedexTestUtils.h"
+#include "RegAlloc.h"
+#include "SyntheticApp.h"
+#include "Timer.h"
+
+//==========
+// Runs passes end-to-end on a generated app (see SyntheticApp.h), and reports
+// the time and peak memory of each, to track how they scale without needing
+// a real app:
+//
+//   pass_benchmark --classes 20000 --passes inline,cse,constprop,output
+//
+// The output stage allocates registers, lowers the code and writes the dex
+// files, like redex-all does after the last pass. With --stats-output, the
+// timings and pass metrics are also written in the format of the redex-all
+// stats, for tools/perf-gate.
+//==========
+
+namespace {
+
+const std::map<std::string, std::function<Pass*()>> PASSES = {
+    {"inline", [] { return new MethodInlinePass(); }},
+    {"cse", [] { return new CommonSubexpressionEliminationPass(); }},
+    {"constprop", [] { return new ConstantPropagationPass(); }},
+    {"interdex",
+     [] { return new interdex::InterDexPass(/* register_plugins */ false); }},
+};
+
+void usage(const char* argv0) {
+  fprintf(stderr,
+          "usage: %s [--classes N] [--methods-per-class N]\n"
+          "    [--calls-per-method X] [--hierarchy-depth N] [--strings N]\n"
+          "    [--method-size N] [--max-method-size N] [--seed N]\n"
+          "    [--passes inline,cse,constprop,interdex,output]\n"
+          "    [--stats-output FILE]\n",
+          argv0);
+  exit(EXIT_FAILURE);
+}
+
+std::vector<std::string> split(const std::string& list) {
+  std::vector<std::string> names;
+  std::istringstream ss(list);
+  std::string name;
+  while (std::getline(ss, name, ',')) {
+    names.push_back(name);
+  }
+  return names;
+}
+
+void report(const std::string& what, double seconds, uint64_t vm_hwm) {
+  printf("%-36s %10.3f s %10.1f MB\n", what.c_str(), seconds,
+         vm_hwm / 1024.0 / 1024.0);
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  synthetic_app::Config config;
+  std::vector<std::string> pass_names = {"inline", "cse", "constprop",
+                                         "interdex", "output"};
+  std::string stats_output;
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 == argc) {
+      usage(argv[0]);
+    }
+    std::string arg = argv[i];
+    const char* value = argv[++i];
+    if (arg == "--classes") {
+      config.num_classes = std::stoul(value);
+    } else if (arg == "--methods-per-class") {
+      config.methods_per_class = std::stoul(value);
+    } else if (arg == "--calls-per-method") {
+      config.calls_per_method = std::stod(value);
+    } else if (arg == "--hierarchy-depth") {
+      config.hierarchy_depth = std::stoul(value);
+    } else if (arg == "--strings") {
+      config.num_strings = std::stoul(value);
+    } else if (arg == "--method-size") {
+      config.mean_method_size = std::stoul(value);
+    } else if (arg == "--max-method-size") {
+      config.max_method_size = std::stoul(value);
+    } else if (arg == "--seed") {
+      config.seed = std::stoul(value);
+    } else if (arg == "--passes") {
+      pass_names = split(value);
+    } else if (arg == "--stats-output") {
+      stats_output = value;
+    } else {
+      usage(argv[0]);
+    }
+  }
+
+  std::vector<Pass*> passes;
+  bool run_output = false;
+  for (const auto& name : pass_names) {
+    if (name == "output") {
+      run_output = true;
+    } else if (PASSES.count(name)) {
+      passes.push_back(PASSES.at(name)());
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (run_output) {
+    passes.push_back(new regalloc::RegAllocPass());
+  }
+
+  g_redex = new RedexContext();
+  auto tmpdir = redex::make_tmp_dir("pass_benchmark_%%%%%%%%");
+
+  Json::Value time_stats(Json::arrayValue);
+  Json::Value pass_stats(Json::objectValue);
+  auto add_time = [&](const std::string& name, double seconds) {
+    Json::Value element;
+    element[name] = seconds;
+    time_stats.append(element);
+  };
+
+  try_reset_hwm_mem_stat();
+  auto start = std::chrono::steady_clock::now();
+  auto classes = synthetic_app::generate(config);
+  add_time("Generate synthetic app", seconds_since(start));
+  report("generate (" + std::to_string(classes.size()) + " classes)",
+         seconds_since(start), get_mem_stats().vm_hwm);
+
+  DexMetadata dm;
+  dm.set_id("classes");
+  DexStore root_store(dm);
+  root_store.add_classes(std::move(classes));
+  DexStoresVector stores;
+  stores.emplace_back(std::move(root_store));
+
+  Json::Value conf_obj(Json::objectValue);
+  conf_obj["mem_stats"] = true;
+  conf_obj["mem_stats_per_pass"] = true;
+  ConfigFiles conf(conf_obj, tmpdir.path);
+  if (!passes.empty()) {
+    PassManager manager(passes, conf_obj);
+    manager.set_testing_mode();
+    manager.run_passes(stores, conf);
+
+    // The Timer of each pass run is named "<pass> <run> (run)".
+    std::map<std::string, double> times;
+    for (const auto& time : Timer::get_times()) {
+      times[time.first] = time.second;
+      add_time(time.first, time.second);
+    }
+    for (const auto& info : manager.get_pass_info()) {
+      for (const auto& metric : info.metrics) {
+        pass_stats[info.name][metric.first] = (Json::Int64)metric.second;
+      }
+      auto key = info.pass->name() + " " + std::to_string(info.repeat + 1) +
+                 " (run)";
+      auto hwm = info.metrics.find("vm_hwm_after");
+      report(info.name, times[key],
+             hwm == info.metrics.end() ? 0 : hwm->second);
+    }
+  }
+
+  if (run_output) {
+    try_reset_hwm_mem_stat();
+    start = std::chrono::steady_clock::now();
+    instruction_lowering::run(stores, /* lower_with_cfg */ true);
+    RedexOptions redex_options;
+    std::unique_ptr<PositionMapper> pos_mapper(PositionMapper::make(""));
+    auto& dexen = stores[0].get_dexen();
+    for (size_t i = 0; i < dexen.size(); ++i) {
+      write_classes_to_dex(redex_options,
+                           tmpdir.path + "/classes" + std::to_string(i) +
+                               ".dex",
+                           &dexen[i],
+                           nullptr /* LocatorIndex* */,
+                           0,
+                           i,
+                           conf,
+                           pos_mapper.get(),
+                           nullptr,
+                           nullptr,
+                           nullptr /* IODIMetadata* */,
+                           stores[0].get_dex_magic());
+    }
+    add_time("Output", seconds_since(start));
+    report("output (" + std::to_string(dexen.size()) + " dexes)",
+           seconds_since(start), get_mem_stats().vm_hwm);
+  }
+
+  if (!stats_output.empty()) {
+    Json::Value stats;
+    stats["output_stats"]["time_stats"] = time_stats;
+    stats["output_stats"]["pass_stats"] = pass_stats;
+    stats["output_stats"]["mem_stats"]["vm_hwm"] =
+        (Json::UInt64)get_mem_stats().vm_hwm;
+    std::ofstream out(stats_output);
+    out << stats;
+  }
+
+  for (auto pass : passes) {
+    delete pass;
+  }
+  delete g_redex;
+  return 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SyntheticApp.h"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Creators.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+
+namespace synthetic_app {
+
+namespace {
+
+std::string class_name(size_t cls) {
+  return "Lcom/facebook/redex/synthetic/C" + std::to_string(cls) + ";";
+}
+
+std::string static_method_name(const Config& config, size_t idx) {
+  return class_name(idx / config.methods_per_class) + ".m" +
+         std::to_string(idx % config.methods_per_class) + ":(I)I";
+}
+
+/*
+ * Only draws raw numbers from the engine, whose output is fully specified,
+ * unlike that of the std distributions.
+ */
+class Random {
+ public:
+  explicit Random(uint32_t seed) : m_engine(seed) {}
+
+  // Uniform in [0, n).
+  size_t below(size_t n) { return m_engine() % n; }
+
+  // Geometric with the given mean, up to max.
+  size_t geometric(double mean, size_t max) {
+    double keep_going = mean / (mean + 1);
+    size_t n = 0;
+    while (n < max && double(m_engine()) / m_engine.max() < keep_going) {
+      ++n;
+    }
+    return n;
+  }
+
+ private:
+  std::mt19937 m_engine;
+};
+
+/*
+ * The body of a method taking and returning an int. v0 holds the running
+ * result, v1 and v2 are temporaries, and the parameters start at v3.
+ */
+std::string method_body(const Config& config,
+                        Random& rand,
+                        size_t method_idx,
+                        bool is_static) {
+  size_t num_methods = config.num_classes * config.methods_per_class;
+  size_t num_blocks =
+      std::max<size_t>(1, rand.geometric(config.mean_method_size,
+                                         config.max_method_size));
+  size_t num_calls = rand.geometric(config.calls_per_method, num_blocks);
+  std::ostringstream ss;
+  ss << "(";
+  if (is_static) {
+    ss << "(load-param v3)(move v0 v3)";
+  } else {
+    ss << "(load-param-object v3)(load-param v4)(move v0 v4)";
+  }
+  for (size_t block = 0; block < num_blocks; ++block) {
+    if (num_calls > 0 && rand.below(num_blocks - block) < num_calls) {
+      --num_calls;
+      if (method_idx + 1 < num_methods) {
+        auto callee =
+            method_idx + 1 + rand.below(num_methods - method_idx - 1);
+        ss << "(invoke-static (v0) \"" << static_method_name(config, callee)
+           << "\")(move-result v0)";
+        continue;
+      }
+    }
+    auto k = 1 + rand.below(100);
+    switch (rand.below(5)) {
+    case 0:
+      ss << "(add-int/lit8 v0 v0 " << k << ")";
+      break;
+    case 1:
+      ss << "(const v1 " << k << ")(if-ne v0 v1 :L" << block
+         << ")(mul-int v0 v0 v1)(:L" << block << ")";
+      break;
+    case 2:
+      // Redundant, for CSE.
+      ss << "(mul-int v1 v0 v0)(mul-int v2 v0 v0)(add-int v0 v1 v2)";
+      break;
+    case 3:
+      // Foldable, for constant propagation.
+      ss << "(const v1 " << k << ")(const v2 " << 2 * k
+         << ")(add-int v1 v1 v2)(add-int v0 v0 v1)";
+      break;
+    case 4:
+      if (config.num_strings > 0) {
+        ss << "(const-string \"synthetic string "
+           << rand.below(config.num_strings)
+           << "\")(move-result-pseudo-object v1)"
+           << "(invoke-virtual (v1) \"Ljava/lang/String;.length:()I\")"
+           << "(move-result v1)(add-int v0 v0 v1)";
+      }
+      break;
+    }
+  }
+  ss << "(return v0))";
+  return ss.str();
+}
+
+} // namespace
+
+DexClasses generate(const Config& config) {
+  Random rand(config.seed);
+  DexClasses classes;
+  classes.reserve(config.num_classes);
+  for (size_t cls = 0; cls < config.num_classes; ++cls) {
+    auto type = DexType::make_type(class_name(cls).c_str());
+    ClassCreator creator(type);
+    creator.set_access(ACC_PUBLIC);
+    if (config.hierarchy_depth > 1 && cls % config.hierarchy_depth != 0) {
+      creator.set_super(DexType::make_type(class_name(cls - 1).c_str()));
+    } else {
+      creator.set_super(type::java_lang_Object());
+    }
+
+    for (size_t m = 0; m < config.methods_per_class; ++m) {
+      auto method_idx = cls * config.methods_per_class + m;
+      auto method =
+          DexMethod::make_method(static_method_name(config, method_idx))
+              ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+      method->set_code(assembler::ircode_from_string(
+          method_body(config, rand, method_idx, /* is_static */ true)));
+      creator.add_method(method);
+    }
+
+    auto method = DexMethod::make_method(class_name(cls) + ".v:(I)I")
+                      ->make_concrete(ACC_PUBLIC, true);
+    method->set_code(assembler::ircode_from_string(
+        method_body(config, rand, (cls + 1) * config.methods_per_class - 1,
+                    /* is_static */ false)));
+    creator.add_method(method);
+
+    classes.push_back(creator.create());
+  }
+  return classes;
+}
+
+} // namespace synthetic_app
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "DexClass.h"
+
+namespace synthetic_app {
+
+/*
+ * The shape of a generated app. The same config always generates the same
+ * classes and code.
+ */
+struct Config {
+  size_t num_classes{1000};
+  // Static methods per class. Every class also has one virtual method, which
+  // overrides that of its superclass.
+  size_t methods_per_class{10};
+  // The mean number of calls each method makes to other methods. Calls only
+  // go to methods that were generated later, so the call graph is acyclic.
+  double calls_per_method{2};
+  // Classes come in inheritance chains of this length.
+  size_t hierarchy_depth{3};
+  // The number of distinct string constants used across all methods.
+  size_t num_strings{10000};
+  // Method sizes, in blocks of 1-5 instructions each, are geometrically
+  // distributed with this mean, up to the max.
+  size_t mean_method_size{8};
+  size_t max_method_size{200};
+  uint32_t seed{0};
+};
+
+/*
+ * Creates the classes of the app in the current RedexContext. The code mixes
+ * arithmetic, branches, redundant and constant-foldable computations, string
+ * constants and calls, so that the usual optimizations all have work to do.
+ */
+DexClasses generate(const Config& config);
+
+} // namespace synthetic_app
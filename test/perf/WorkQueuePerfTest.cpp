@@ -7,9 +7,11 @@
 
 #include "WorkQueue.h"
 
+#include <atomic>
 #include <chrono>
 #include <random>
 #include <thread>
+#include <vector>
 
 //==========
 // Test for performance
@@ -73,9 +75,56 @@ void smallLengthTasks() {
   printf("speedup small length tasks: %f\n", speedup);
 }
 
+// Many tiny work queues, as issued by walk::parallel over small scopes. This
+// compares run_all, which borrows persistent threads from the process-wide
+// pool, with creating and joining the threads for every run.
+void manySmallQueues() {
+  constexpr int num_runs = 2000;
+  constexpr int num_items = 64;
+  const unsigned int num_threads = std::thread::hardware_concurrency();
+  std::atomic<int> sink{0};
+  auto work = [&](int a) { sink += a; };
+
+  auto pool_start = std::chrono::high_resolution_clock::now();
+  for (int run = 0; run < num_runs; ++run) {
+    auto wq = workqueue_foreach<int>(work, num_threads);
+    for (int i = 0; i < num_items; ++i) {
+      wq.add_item(i);
+    }
+    wq.run_all();
+  }
+  auto pool_end = std::chrono::high_resolution_clock::now();
+
+  auto spawn_start = std::chrono::high_resolution_clock::now();
+  for (int run = 0; run < num_runs; ++run) {
+    std::atomic<int> next{0};
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&] {
+        for (int i = next++; i < num_items; i = next++) {
+          work(i);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  auto spawn_end = std::chrono::high_resolution_clock::now();
+
+  using us = std::chrono::microseconds;
+  double pool_us =
+      std::chrono::duration_cast<us>(pool_end - pool_start).count();
+  double spawn_us =
+      std::chrono::duration_cast<us>(spawn_end - spawn_start).count();
+  printf("small queues, per run: %f us pooled, %f us spawning threads\n",
+         pool_us / num_runs, spawn_us / num_runs);
+}
+
 int main() {
   printf("Begin!\n");
   profileBusyLoop();
   variableLengthTasks();
   smallLengthTasks();
+  manySmallQueues();
 }
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "BlockProbes.h"
+
+#include "DexClass.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "Instrument.h"
+#include "RedexTest.h"
+
+class BlockProbesTest : public RedexTest {};
+
+namespace {
+
+instrument::BlockProbes place(IRCode* code,
+                              std::function<bool(cfg::Block*)> can_probe =
+                                  [](cfg::Block*) { return true; }) {
+  code->build_cfg(/* editable */ false);
+  auto& cfg = code->cfg();
+  auto probes = instrument::place_block_probes(cfg, cfg.blocks(), can_probe);
+  code->clear_cfg();
+  return probes;
+}
+
+} // namespace
+
+TEST_F(BlockProbesTest, joinSharesProbeOfEntry) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :else)
+      (const v1 1)
+      (goto :join)
+      (:else)
+      (const v1 2)
+      (:join)
+      (return v1)
+    )
+  )");
+  auto probes = place(code.get());
+  ASSERT_EQ(probes.probe_of_block.size(), 4);
+  EXPECT_EQ(probes.probe_blocks.size(), 3);
+  EXPECT_EQ(probes.probe_of_block[3], probes.probe_of_block[0]);
+  EXPECT_NE(probes.probe_of_block[1], probes.probe_of_block[0]);
+  EXPECT_NE(probes.probe_of_block[2], probes.probe_of_block[0]);
+  EXPECT_NE(probes.probe_of_block[1], probes.probe_of_block[2]);
+}
+
+TEST_F(BlockProbesTest, blockThatMayBeSkippedGetsItsOwnProbe) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :join)
+      (const v0 1)
+      (:join)
+      (return v0)
+    )
+  )");
+  auto probes = place(code.get());
+  ASSERT_EQ(probes.probe_of_block.size(), 3);
+  EXPECT_EQ(probes.probe_blocks.size(), 2);
+  EXPECT_EQ(probes.probe_of_block[2], probes.probe_of_block[0]);
+  EXPECT_NE(probes.probe_of_block[1], probes.probe_of_block[0]);
+}
+
+TEST_F(BlockProbesTest, headWithoutProbeIsNotCoveredByBlocksBelowIt) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :join)
+      (const v0 1)
+      (:join)
+      (return v0)
+    )
+  )");
+  auto probes =
+      place(code.get(), [](cfg::Block* block) { return block->id() != 0; });
+  ASSERT_EQ(probes.probe_of_block.size(), 3);
+  EXPECT_EQ(probes.probe_blocks.size(), 2);
+  EXPECT_EQ(probes.probe_of_block[0], -1);
+  EXPECT_NE(probes.probe_of_block[1], -1);
+  EXPECT_NE(probes.probe_of_block[2], -1);
+  EXPECT_NE(probes.probe_of_block[1], probes.probe_of_block[2]);
+}
+
+TEST_F(BlockProbesTest, blockWithoutProbeUsesProbeOfItsDominator) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :else)
+      (const v1 1)
+      (goto :join)
+      (:else)
+      (const v1 2)
+      (:join)
+      (return v1)
+    )
+  )");
+  auto probes =
+      place(code.get(), [](cfg::Block* block) { return block->id() != 1; });
+  ASSERT_EQ(probes.probe_of_block.size(), 4);
+  EXPECT_EQ(probes.probe_blocks.size(), 2);
+  EXPECT_EQ(probes.probe_of_block[1], probes.probe_of_block[0]);
+  EXPECT_EQ(probes.probe_of_block[3], probes.probe_of_block[0]);
+  EXPECT_NE(probes.probe_of_block[2], probes.probe_of_block[0]);
+}
+
+TEST_F(BlockProbesTest, loopBodyGetsItsOwnProbe) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (:loop)
+      (if-eqz v0 :exit)
+      (add-int/lit8 v0 v0 -1)
+      (goto :loop)
+      (:exit)
+      (return v0)
+    )
+  )");
+  auto probes = place(code.get());
+  ASSERT_EQ(probes.probe_of_block.size(), 4);
+  EXPECT_EQ(probes.probe_blocks.size(), 2);
+  EXPECT_EQ(probes.probe_of_block[1], probes.probe_of_block[0]);
+  EXPECT_EQ(probes.probe_of_block[3], probes.probe_of_block[0]);
+  EXPECT_NE(probes.probe_of_block[2], probes.probe_of_block[0]);
+}
+
+TEST_F(BlockProbesTest, bitmapProbesRunOnEveryPathIntoTheirBlock) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (.try_start a)
+      (invoke-static () "LFoo;.bar:()V")
+      (.try_end a)
+      (if-eqz v0 :target)
+      (const v1 1)
+      (return v1)
+      (:target)
+      (const v1 2)
+      (return v1)
+      (.catch (a))
+      (move-exception v2)
+      (throw v2)
+    )
+  )");
+  auto bitmap = DexField::make_field("LFoo;.bitmap:[I");
+  auto probe_of_block =
+      InstrumentPass::insert_bitmap_probes(code.get(), bitmap, 0);
+  // The block of the try end can't hold a probe, and uses the one of the
+  // entry.
+  EXPECT_EQ(probe_of_block, (std::vector<int>{0, 0, 0, 1, 2, 3, 4}));
+
+  auto expected = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (sget-object "LFoo;.bitmap:[I")
+      (move-result-pseudo-object v3)
+      (const v4 0)
+      (aget v3 v4)
+      (move-result-pseudo v5)
+      (or-int/lit16 v5 v5 1)
+      (aput v5 v3 v4)
+      (.try_start a)
+      (invoke-static () "LFoo;.bar:()V")
+      (.try_end a)
+      (const v4 0)
+      (aget v3 v4)
+      (move-result-pseudo v5)
+      (or-int/lit16 v5 v5 2)
+      (aput v5 v3 v4)
+      (if-eqz v0 :target)
+      (const v4 0)
+      (aget v3 v4)
+      (move-result-pseudo v5)
+      (or-int/lit16 v5 v5 4)
+      (aput v5 v3 v4)
+      (const v1 1)
+      (return v1)
+      (:target)
+      (const v4 0)
+      (aget v3 v4)
+      (move-result-pseudo v5)
+      (or-int/lit16 v5 v5 8)
+      (aput v5 v3 v4)
+      (const v1 2)
+      (return v1)
+      (.catch (a))
+      (move-exception v2)
+      (const v4 0)
+      (aget v3 v4)
+      (move-result-pseudo v5)
+      (or-int/lit16 v5 v5 16)
+      (aput v5 v3 v4)
+      (throw v2)
+    )
+  )");
+  EXPECT_CODE_EQ(code.get(), expected.get());
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "CostSampling.h"
+
+#include <algorithm>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DexClass.h"
+#include "RedexTest.h"
+#include "WorkQueue.h"
+
+class CostSamplingTest : public RedexTest {
+ protected:
+  std::vector<DexMethod*> make_methods(size_t count) {
+    std::vector<DexMethod*> methods;
+    for (size_t i = 0; i < count; ++i) {
+      auto name = "m" + std::to_string(i);
+      methods.push_back(
+          DexMethod::make_method("LFoo;", name.c_str(), "V", {})
+              ->make_concrete(ACC_PUBLIC | ACC_STATIC, false));
+    }
+    return methods;
+  }
+
+  ~CostSamplingTest() { cost_sampling::enable(0); }
+};
+
+TEST_F(CostSamplingTest, disabledByDefault) {
+  auto methods = make_methods(4);
+  auto wq = workqueue_foreach<DexMethod*>([](DexMethod*) {});
+  for (auto method : methods) {
+    wq.add_item(method);
+  }
+  wq.run_all();
+  EXPECT_FALSE(cost_sampling::is_enabled());
+  EXPECT_TRUE(cost_sampling::take_slowest().empty());
+}
+
+TEST_F(CostSamplingTest, keepsSlowestMethods) {
+  constexpr size_t NUM_METHODS = 20;
+  auto methods = make_methods(NUM_METHODS);
+  cost_sampling::enable(3);
+
+  auto wq = workqueue_foreach<DexMethod*>(
+      [&](DexMethod* method) {
+        auto idx = std::find(methods.begin(), methods.end(), method) -
+                   methods.begin();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2 * idx));
+      },
+      4);
+  for (auto method : methods) {
+    wq.add_item(method);
+  }
+  wq.run_all();
+
+  auto slowest = cost_sampling::take_slowest();
+  ASSERT_EQ(slowest.size(), 3);
+  EXPECT_EQ(slowest[0].method, methods[NUM_METHODS - 1]);
+  EXPECT_EQ(slowest[1].method, methods[NUM_METHODS - 2]);
+  EXPECT_EQ(slowest[2].method, methods[NUM_METHODS - 3]);
+  EXPECT_GE(slowest[0].wall_ns, slowest[1].wall_ns);
+  EXPECT_GE(slowest[1].wall_ns, slowest[2].wall_ns);
+
+  // Taking the samples resets them.
+  EXPECT_TRUE(cost_sampling::take_slowest().empty());
+}
+
+TEST_F(CostSamplingTest, resetDropsSamples) {
+  auto methods = make_methods(2);
+  cost_sampling::enable(3);
+  auto wq = workqueue_foreach<DexMethod*>([](DexMethod*) {});
+  for (auto method : methods) {
+    wq.add_item(method);
+  }
+  wq.run_all();
+  cost_sampling::reset();
+  EXPECT_TRUE(cost_sampling::take_slowest().empty());
+}
@@ -7,6 +7,7 @@
 
 #include <gtest/gtest.h>
 
+#include "DexPosition.h"
 #include "IRAssembler.h"
 #include "IRCode.h"
 #include "InstructionLowering.h"
@@ -75,3 +76,25 @@ TEST_F(DexPositionTest, consecutiveIdenticalPositions) {
 
   EXPECT_CODE_EQ(method->get_code(), expected_code.get());
 }
+
+TEST_F(DexPositionTest, positionsShareTheirFrame) {
+  auto method = DexString::make_string("LFoo;.bar:()V");
+  auto file = DexString::make_string("Foo.java");
+  DexPosition pos1(method, file, 123);
+  DexPosition pos2(method, file, 124);
+  EXPECT_EQ(pos1.frame(), pos2.frame());
+  EXPECT_EQ(pos1.method(), method);
+  EXPECT_EQ(pos1.file(), file);
+
+  DexPosition unbound(125);
+  EXPECT_EQ(unbound.frame(), nullptr);
+  EXPECT_EQ(unbound.method(), nullptr);
+  unbound.bind(method, file);
+  EXPECT_EQ(unbound.frame(), pos1.frame());
+
+  auto other_file = DexString::make_string("Bar.java");
+  pos2.bind(method, other_file);
+  EXPECT_NE(pos1.frame(), pos2.frame());
+  EXPECT_EQ(pos2.file(), other_file);
+  EXPECT_EQ(pos1.file(), file);
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "DexEncoding.h"
+
+namespace {
+
+std::vector<uint32_t> some_values() {
+  std::vector<uint32_t> values = {0,         1,          0x7f,      0x80,
+                                  0x3fff,    0x4000,     0x1fffff,  0x200000,
+                                  0xfffffff, 0x10000000, 0xffffffff};
+  std::mt19937 gen(42);
+  for (int i = 0; i < 1000; ++i) {
+    // Mostly small values, like in real dex files.
+    values.push_back(gen() >> (gen() % 32));
+  }
+  return values;
+}
+
+std::vector<uint8_t> encode(const std::vector<uint32_t>& values) {
+  std::vector<uint8_t> bytes(5 * values.size());
+  auto end = write_uleb128_array(bytes.data(), values.data(), values.size());
+  bytes.resize(end - bytes.data());
+  return bytes;
+}
+
+} // namespace
+
+TEST(DexEncodingTest, writeUleb128Array) {
+  auto values = some_values();
+  auto bytes = encode(values);
+  std::vector<uint8_t> expected(5 * values.size());
+  uint8_t* ptr = expected.data();
+  for (auto value : values) {
+    ptr = write_uleb128(ptr, value);
+  }
+  expected.resize(ptr - expected.data());
+  EXPECT_EQ(bytes, expected);
+}
+
+TEST(DexEncodingTest, readUleb128Array) {
+  auto values = some_values();
+  auto bytes = encode(values);
+  // Decode from every offset, so that values straddle the 8-byte windows in
+  // every possible way, and up to the very end of the buffer.
+  const uint8_t* start = bytes.data();
+  for (size_t skip = 0; skip < 16; ++skip) {
+    const uint8_t* ptr = start;
+    for (size_t i = 0; i < skip; ++i) {
+      read_uleb128(&ptr);
+    }
+    std::vector<uint32_t> decoded(values.size() - skip);
+    read_uleb128_array(&ptr, start + bytes.size(), decoded.data(),
+                       decoded.size());
+    EXPECT_EQ(ptr, start + bytes.size());
+    EXPECT_TRUE(std::equal(decoded.begin(), decoded.end(),
+                           values.begin() + skip));
+  }
+}
+
+TEST(DexEncodingTest, skipUleb128s) {
+  auto values = some_values();
+  auto bytes = encode(values);
+  const uint8_t* start = bytes.data();
+  for (size_t count = 0; count < values.size(); count += 37) {
+    const uint8_t* expected = start;
+    for (size_t i = 0; i < count; ++i) {
+      read_uleb128(&expected);
+    }
+    const uint8_t* ptr = start;
+    skip_uleb128s(&ptr, start + bytes.size(), count);
+    EXPECT_EQ(ptr, expected);
+  }
+}
+
+TEST(DexEncodingTest, lengthOfUtf8String) {
+  std::vector<std::string> strings = {
+      "",
+      "a",
+      "Lcom/facebook/redex/SomeVeryLongClassNameThatIsLongerThan32Bytes;",
+      "caf\xc3\xa9",
+      "\xc0\x80",
+      "\xe2\x82\xac in the middle of a longer ASCII string \xe2\x82\xac",
+      "0123456789abcdef\xc3\xa9"};
+  for (const auto& str : strings) {
+    uint32_t expected = 0;
+    const char* s = str.c_str();
+    while (*s != '\0') {
+      mutf8_next_code_point(s);
+      ++expected;
+    }
+    EXPECT_EQ(length_of_utf8_string(str.c_str()), expected) << str;
+    EXPECT_EQ(length_of_utf8_string(str.c_str(), str.size()), expected)
+        << str;
+    EXPECT_TRUE(is_valid_mutf8(str.c_str(), str.size())) << str;
+  }
+}
+
+TEST(DexEncodingTest, invalidMutf8) {
+  std::string nul("0123456789abcdef0123456789\0abcdef", 33);
+  EXPECT_FALSE(is_valid_mutf8(nul.c_str(), nul.size()));
+  std::string truncated = "0123456789abcdef\xe2\x82";
+  EXPECT_FALSE(is_valid_mutf8(truncated.c_str(), truncated.size()));
+  std::string bad_continuation = "abc\xe2\x82x";
+  EXPECT_FALSE(
+      is_valid_mutf8(bad_continuation.c_str(), bad_continuation.size()));
+  EXPECT_ANY_THROW(length_of_utf8_string(bad_continuation.c_str()));
+  std::string four_bytes = "\xf0\x9f\x98\x80";
+  EXPECT_FALSE(is_valid_mutf8(four_bytes.c_str(), four_bytes.size()));
+}
@@ -7,7 +7,9 @@
 
 #include <gtest/gtest.h>
 
+#include "DexClass.h"
 #include "DexInstruction.h"
+#include "DexOutput.h"
 #include "RedexTest.h"
 
 class DexInstructionTest : public RedexTest {};
@@ -63,3 +65,83 @@ TEST_F(DexInstructionTest, test_encode_fill_array_data_payload_32) {
   EXPECT_EQ(data32[4], 4);
   EXPECT_EQ(data32[5], 5);
 }
+
+class DexCodeCompactionTest : public RedexTest {
+ protected:
+  DexString* str = DexString::make_string("hello");
+  DexString* jumbo_str = DexString::make_string("world");
+  DexType* type = DexType::make_type("LFoo;");
+  DexFieldRef* field = DexField::make_field("LFoo;.bar:I");
+  DexMethodRef* method = DexMethod::make_method("LFoo;.baz:(I)V");
+  DexCode code;
+
+  DexCodeCompactionTest() {
+    code.set_registers_size(2);
+    code.set_ins_size(0);
+    code.set_outs_size(1);
+    auto& insns = code.get_instructions();
+    insns.push_back(
+        (new DexOpcodeString(DOPCODE_CONST_STRING, str))->set_dest(0));
+    insns.push_back(
+        (new DexOpcodeString(DOPCODE_CONST_STRING_JUMBO, jumbo_str))
+            ->set_dest(1));
+    insns.push_back(
+        (new DexOpcodeType(DOPCODE_CONST_CLASS, type))->set_dest(0));
+    insns.push_back((new DexOpcodeField(DOPCODE_SGET, field))->set_dest(1));
+    insns.push_back((new DexOpcodeMethod(DOPCODE_INVOKE_STATIC, method, 1))
+                        ->set_src(0, 1));
+    insns.push_back(new DexInstruction(DOPCODE_RETURN_VOID));
+    insns.push_back(
+        encode_fill_array_data_payload(std::vector<int32_t>{1, 2}));
+  }
+};
+
+TEST_F(DexCodeCompactionTest, test_compacted_code_encodes_identically) {
+  DexOutputIdx dodx(new dexstring_to_idx{{str, 3}, {jumbo_str, 0x12345}},
+                    new dextype_to_idx{{type, 7}},
+                    new dexproto_to_idx,
+                    new dexfield_to_idx{{field, 11}},
+                    new dexmethod_to_idx{{method, 13}},
+                    new std::vector<DexTypeList*>,
+                    new dexcallsite_to_idx,
+                    new dexmethodhandle_to_idx,
+                    nullptr);
+
+  DexCode compacted(code);
+  compacted.compact();
+  EXPECT_TRUE(compacted.is_compact());
+  EXPECT_EQ(compacted.num_instructions(), code.num_instructions());
+  EXPECT_EQ(compacted.size(), code.size());
+
+  std::vector<uint32_t> expected(64);
+  std::vector<uint32_t> actual(64);
+  auto expected_size = code.encode(&dodx, expected.data());
+  auto actual_size = compacted.encode(&dodx, actual.data());
+  EXPECT_EQ(actual_size, expected_size);
+  EXPECT_EQ(actual, expected);
+}
+
+TEST_F(DexCodeCompactionTest, test_compacted_code_decodes_on_demand) {
+  DexCode compacted(code);
+  compacted.compact();
+
+  // Readers after the output get the instructions back.
+  const auto& decoded =
+      static_cast<const DexCode&>(compacted).get_instructions();
+  EXPECT_FALSE(compacted.is_compact());
+  const auto& insns = code.get_instructions();
+  ASSERT_EQ(decoded.size(), insns.size());
+  for (size_t i = 0; i < insns.size(); ++i) {
+    EXPECT_TRUE(*decoded[i] == *insns[i]) << i;
+  }
+  EXPECT_EQ(compacted.size(), code.size());
+
+  DexCode released(code);
+  released.compact();
+  auto released_insns = released.release_instructions();
+  ASSERT_EQ(released_insns->size(), insns.size());
+  EXPECT_FALSE(released.is_compact());
+  for (auto insn : *released_insns) {
+    delete insn;
+  }
+}
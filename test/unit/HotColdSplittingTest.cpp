@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include "HotColdSplittingPass.h"
+
+#include "Creators.h"
+#include "DexClass.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+
+class HotColdSplittingTest : public RedexTest {
+ public:
+  static DexMethod* create(const std::string& sig,
+                           const std::string& code_str) {
+    ClassCreator cc{DexType::make_type("LFoo;")};
+    cc.set_super(type::java_lang_Object());
+    auto m = DexMethod::make_method("LFoo;.bar:" + sig)
+                 ->make_concrete(ACC_PUBLIC | ACC_STATIC,
+                                 assembler::ircode_from_string(code_str),
+                                 false);
+    cc.add_method(m);
+    cc.create();
+    return m;
+  }
+
+  static HotColdSplittingPass::BlockCoverage coverage(
+      DexMethod* m, std::unordered_set<cfg::BlockId> executed_blocks) {
+    HotColdSplittingPass::BlockCoverage coverage;
+    auto code = m->get_code();
+    code->build_cfg(/* editable */ false);
+    coverage.num_blocks = code->cfg().blocks().size();
+    code->clear_cfg();
+    coverage.executed_blocks = std::move(executed_blocks);
+    return coverage;
+  }
+
+  static DexMethod* cold_method(DexMethod* m, const std::string& proto) {
+    auto ref = DexMethod::get_method("LFoo;.bar$cold:" + proto);
+    return ref == nullptr ? nullptr : ref->as_def();
+  }
+};
+
+TEST_F(HotColdSplittingTest, splitsColdTail) {
+  auto m = create("(I)I", R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :cold)
+      (return v0)
+      (:cold)
+      (const v1 42)
+      (add-int v1 v1 v0)
+      (mul-int v1 v1 v0)
+      (invoke-static (v1) "LFoo;.log:(I)V")
+      (return v1)
+    )
+  )");
+  auto stats = HotColdSplittingPass::run(m, coverage(m, {0, 1}), 4);
+  EXPECT_EQ(stats.hot_methods, 1);
+  EXPECT_EQ(stats.split_methods, 1);
+  EXPECT_EQ(stats.cold_methods, 1);
+  EXPECT_LT(stats.hot_code_units_after, stats.hot_code_units_before);
+
+  auto cold = cold_method(m, "(I)I");
+  ASSERT_NE(cold, nullptr);
+  EXPECT_TRUE(is_static(cold));
+  EXPECT_EQ(type_class(m->get_class())->get_dmethods().size(), 2);
+
+  auto expected_hot = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :cold)
+      (return v0)
+      (:cold)
+      (invoke-static (v0) "LFoo;.bar$cold:(I)I")
+      (move-result v2)
+      (return v2)
+    )
+  )");
+  EXPECT_CODE_EQ(m->get_code(), expected_hot.get());
+
+  auto expected_cold = assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (const v1 42)
+      (add-int v1 v1 v0)
+      (mul-int v1 v1 v0)
+      (invoke-static (v1) "LFoo;.log:(I)V")
+      (return v1)
+    )
+  )");
+  EXPECT_CODE_EQ(cold->get_code(), expected_cold.get());
+}
+
+TEST_F(HotColdSplittingTest, typesArgumentsByTheirUses) {
+  auto m = create("(Ljava/lang/String;)V", R"(
+    (
+      (load-param-object v0)
+      (if-nez v0 :cold)
+      (return-void)
+      (:cold)
+      (invoke-virtual (v0) "Ljava/lang/String;.length:()I")
+      (move-result v1)
+      (invoke-static (v1) "LFoo;.log:(I)V")
+      (return-void)
+    )
+  )");
+  auto stats = HotColdSplittingPass::run(m, coverage(m, {0, 1}), 4);
+  EXPECT_EQ(stats.cold_methods, 1);
+  EXPECT_NE(cold_method(m, "(Ljava/lang/String;)V"), nullptr);
+
+  auto expected_hot = assembler::ircode_from_string(R"(
+    (
+      (load-param-object v0)
+      (if-nez v0 :cold)
+      (return-void)
+      (:cold)
+      (invoke-static (v0) "LFoo;.bar$cold:(Ljava/lang/String;)V")
+      (return-void)
+    )
+  )");
+  EXPECT_CODE_EQ(m->get_code(), expected_hot.get());
+}
+
+TEST_F(HotColdSplittingTest, keepsRegionsThatFlowBackIntoHotCode) {
+  auto m = create("(I)I", R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :cold)
+      (:join)
+      (return v0)
+      (:cold)
+      (const v0 1)
+      (mul-int v0 v0 v0)
+      (goto :join)
+    )
+  )");
+  auto stats = HotColdSplittingPass::run(m, coverage(m, {0, 1}), 0);
+  EXPECT_EQ(stats.hot_methods, 1);
+  EXPECT_EQ(stats.cold_methods, 0);
+  EXPECT_EQ(type_class(m->get_class())->get_dmethods().size(), 1);
+}
+
+TEST_F(HotColdSplittingTest, keepsConstructionOfLiveInObjects) {
+  auto m = create("(I)V", R"(
+    (
+      (load-param v0)
+      (new-instance "LFoo;")
+      (move-result-pseudo-object v1)
+      (if-eqz v0 :cold)
+      (invoke-direct (v1) "LFoo;.<init>:()V")
+      (return-void)
+      (:cold)
+      (invoke-direct (v1) "LFoo;.<init>:()V")
+      (invoke-static (v1) "LFoo;.use:(LFoo;)V")
+      (return-void)
+    )
+  )");
+  auto stats = HotColdSplittingPass::run(m, coverage(m, {0, 1}), 0);
+  EXPECT_EQ(stats.cold_methods, 0);
+}
+
+TEST_F(HotColdSplittingTest, skipsMethodsThatChanged) {
+  auto m = create("(I)I", R"(
+    (
+      (load-param v0)
+      (if-eqz v0 :cold)
+      (return v0)
+      (:cold)
+      (const v1 42)
+      (return v1)
+    )
+  )");
+  auto cov = coverage(m, {0, 1});
+  ++cov.num_blocks;
+  auto stats = HotColdSplittingPass::run(m, cov, 0);
+  EXPECT_EQ(stats.block_count_mismatch, 1);
+  EXPECT_EQ(stats.cold_methods, 0);
+}
+
+TEST_F(HotColdSplittingTest, readBlockCoverage) {
+  auto m = create("(I)I", R"(
+    (
+      (load-param v0)
+      (return v0)
+    )
+  )");
+  std::istringstream in(
+      "LFoo;.bar:(I)I,3,0 2\n"
+      "LFoo;.missing:()V,1,0\n");
+  size_t unknown_methods = 0;
+  auto coverage =
+      HotColdSplittingPass::read_block_coverage(in, &unknown_methods);
+  EXPECT_EQ(unknown_methods, 1);
+  ASSERT_EQ(coverage.size(), 1);
+  const auto& method_coverage = coverage.at(m);
+  EXPECT_EQ(method_coverage.num_blocks, 3);
+  EXPECT_EQ(method_coverage.executed_blocks,
+            (std::unordered_set<cfg::BlockId>{0, 2}));
+}
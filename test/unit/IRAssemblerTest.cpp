@@ -373,8 +373,8 @@ TEST_F(IRAssemblerTest, pos) {
   auto positions = get_positions(code);
   ASSERT_EQ(positions.size(), 1);
   auto pos = positions[0];
-  EXPECT_EQ(show(pos->method), std::string("LFoo;.bar:()V"));
-  EXPECT_EQ(pos->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos->method()), std::string("LFoo;.bar:()V"));
+  EXPECT_EQ(pos->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos->line, 420);
   EXPECT_EQ(pos->parent, nullptr);
 }
@@ -404,14 +404,14 @@ TEST_F(IRAssemblerTest, posWithParent_DbgLabel) {
   ASSERT_EQ(positions.size(), 2);
 
   auto pos0 = positions[0];
-  EXPECT_EQ(show(pos0->method), std::string("LFoo;.bar:()V"));
-  EXPECT_EQ(pos0->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos0->method()), std::string("LFoo;.bar:()V"));
+  EXPECT_EQ(pos0->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos0->line, 420);
   EXPECT_EQ(pos0->parent, nullptr);
 
   auto pos1 = positions[1];
-  EXPECT_EQ(show(pos1->method), std::string("LFoo;.baz:()I"));
-  EXPECT_EQ(pos1->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos1->method()), std::string("LFoo;.baz:()I"));
+  EXPECT_EQ(pos1->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos1->line, 440);
   EXPECT_EQ(*pos1->parent, *pos0);
 }
@@ -441,14 +441,14 @@ TEST_F(IRAssemblerTest, posWithParent_UserLabel) {
   ASSERT_EQ(positions.size(), 2);
 
   auto pos0 = positions[0];
-  EXPECT_EQ(show(pos0->method), std::string("LFoo;.bar:()V"));
-  EXPECT_EQ(pos0->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos0->method()), std::string("LFoo;.bar:()V"));
+  EXPECT_EQ(pos0->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos0->line, 420);
   EXPECT_EQ(pos0->parent, nullptr);
 
   auto pos1 = positions[1];
-  EXPECT_EQ(show(pos1->method), std::string("LFoo;.baz:()I"));
-  EXPECT_EQ(pos1->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos1->method()), std::string("LFoo;.baz:()I"));
+  EXPECT_EQ(pos1->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos1->line, 440);
   EXPECT_EQ(*pos1->parent, *pos0);
 }
@@ -478,14 +478,14 @@ TEST_F(IRAssemblerTest, posWithParent_BadParent) {
   ASSERT_EQ(positions.size(), 2);
 
   auto pos0 = positions[0];
-  EXPECT_EQ(show(pos0->method), std::string("LFoo;.bar:()V"));
-  EXPECT_EQ(pos0->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos0->method()), std::string("LFoo;.bar:()V"));
+  EXPECT_EQ(pos0->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos0->line, 420);
   EXPECT_EQ(pos0->parent, nullptr);
 
   auto pos1 = positions[1];
-  EXPECT_EQ(show(pos1->method), std::string("LFoo;.baz:()I"));
-  EXPECT_EQ(pos1->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos1->method()), std::string("LFoo;.baz:()I"));
+  EXPECT_EQ(pos1->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos1->line, 440);
   EXPECT_EQ(pos1->parent, nullptr);
 }
@@ -518,14 +518,14 @@ TEST_F(IRAssemblerTest, posWithGrandparent) {
   ASSERT_EQ(positions.size(), 3);
 
   auto pos0 = positions[0];
-  EXPECT_EQ(show(pos0->method), std::string("LFoo;.bar:()V"));
-  EXPECT_EQ(pos0->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos0->method()), std::string("LFoo;.bar:()V"));
+  EXPECT_EQ(pos0->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos0->line, 420);
   EXPECT_EQ(pos0->parent, nullptr);
 
   auto pos2 = positions[2];
-  EXPECT_EQ(show(pos2->method), std::string("LFoo;.baz:()Z"));
-  EXPECT_EQ(pos2->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos2->method()), std::string("LFoo;.baz:()Z"));
+  EXPECT_EQ(pos2->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos2->line, 441);
   EXPECT_EQ(*pos2->parent->parent, *pos0);
 }
@@ -559,14 +559,14 @@ TEST_F(IRAssemblerTest, posWithGreatGrandparent) {
   ASSERT_EQ(positions.size(), 4);
 
   auto pos0 = positions[0];
-  EXPECT_EQ(show(pos0->method), std::string("LFoo;.bar:()V"));
-  EXPECT_EQ(pos0->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos0->method()), std::string("LFoo;.bar:()V"));
+  EXPECT_EQ(pos0->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos0->line, 420);
   EXPECT_EQ(pos0->parent, nullptr);
 
   auto pos3 = positions[3];
-  EXPECT_EQ(show(pos3->method), std::string("LFoo;.baz:()Z"));
-  EXPECT_EQ(pos3->file->c_str(), std::string("Foo.java"));
+  EXPECT_EQ(show(pos3->method()), std::string("LFoo;.baz:()Z"));
+  EXPECT_EQ(pos3->file()->c_str(), std::string("Foo.java"));
   EXPECT_EQ(pos3->line, 442);
   EXPECT_EQ(*pos3->parent->parent->parent, *pos0);
 }
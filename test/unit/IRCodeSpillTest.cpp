@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "IRCodeSpill.h"
+
+#include <gtest/gtest.h>
+
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+#include "RedexTestUtils.h"
+
+struct IRCodeSpillTest : public RedexTest {
+  DexMethod* make_method(const std::string& name, const std::string& code) {
+    auto method = DexMethod::make_method("LFoo;." + name + ":(I)V")
+                      ->make_concrete(ACC_PUBLIC | ACC_STATIC, false);
+    method->set_code(assembler::ircode_from_string(code));
+    return method;
+  }
+};
+
+TEST_F(IRCodeSpillTest, roundtrip) {
+  auto method = make_method("bar", R"(
+    (
+      (load-param v0)
+      (.pos:dbg_0 "LFoo;.bar:(I)V" "Foo.java" 10)
+      (.dbg DBG_SET_PROLOGUE_END)
+      (.dbg DBG_START_LOCAL 1 "x" "I")
+      (.pos "LBar;.baz:()V" "Bar.java" 20 dbg_0)
+      (.try_start a)
+      (const-string "hello")
+      (move-result-pseudo-object v1)
+      (invoke-static (v1) "LFoo;.qux:(Ljava/lang/String;)V")
+      (.try_end a)
+      (switch v0 (:b :c))
+      (const-wide v2 1234567890123)
+      (:b 0)
+      (sget "LFoo;.f:I")
+      (move-result-pseudo v1)
+      (if-eqz v1 :d)
+      (return-void)
+      (:c 1)
+      (return-void)
+      (:d)
+      (return-void)
+      (.catch (a) "Ljava/lang/Exception;")
+      (return-void)
+    )
+  )");
+  auto expected = assembler::to_string(method->get_code());
+
+  auto tmp_dir = redex::make_tmp_dir("ir_code_spill_test_%%%%%%%%");
+  ir_code_spill::Store store(tmp_dir.path);
+  EXPECT_EQ(store.spill({method}, 0), 1);
+  EXPECT_TRUE(method->is_code_spilled());
+  EXPECT_EQ(store.num_spilled(), 1);
+  EXPECT_GT(store.file_size(), 0);
+
+  EXPECT_EQ(assembler::to_string(method->get_code()), expected);
+  EXPECT_FALSE(method->is_code_spilled());
+  EXPECT_EQ(store.num_spilled(), 0);
+  EXPECT_EQ(store.num_faults(), 1);
+}
+
+TEST_F(IRCodeSpillTest, small_code_stays) {
+  auto method = make_method("small", R"(
+    (
+      (load-param v0)
+      (return-void)
+    )
+  )");
+  auto tmp_dir = redex::make_tmp_dir("ir_code_spill_test_%%%%%%%%");
+  ir_code_spill::Store store(tmp_dir.path);
+  EXPECT_EQ(store.spill({method}, 16), 0);
+  EXPECT_FALSE(method->is_code_spilled());
+}
+
+TEST_F(IRCodeSpillTest, code_with_cfg_stays) {
+  auto method = make_method("cfg", R"(
+    (
+      (load-param v0)
+      (return-void)
+    )
+  )");
+  method->get_code()->build_cfg(/* editable */ true);
+  auto tmp_dir = redex::make_tmp_dir("ir_code_spill_test_%%%%%%%%");
+  ir_code_spill::Store store(tmp_dir.path);
+  EXPECT_EQ(store.spill({method}, 0), 0);
+  EXPECT_FALSE(method->is_code_spilled());
+  method->get_code()->clear_cfg();
+}
+
+TEST_F(IRCodeSpillTest, set_code_drops_spilled_code) {
+  auto method = make_method("replaced", R"(
+    (
+      (load-param v0)
+      (const v1 1)
+      (return-void)
+    )
+  )");
+  auto tmp_dir = redex::make_tmp_dir("ir_code_spill_test_%%%%%%%%");
+  ir_code_spill::Store store(tmp_dir.path);
+  EXPECT_EQ(store.spill({method}, 0), 1);
+
+  method->set_code(assembler::ircode_from_string(R"(
+    (
+      (load-param v0)
+      (return-void)
+    )
+  )"));
+  EXPECT_FALSE(method->is_code_spilled());
+  EXPECT_EQ(store.num_spilled(), 0);
+  EXPECT_EQ(method->get_code()->count_opcodes(), 1);
+  EXPECT_EQ(store.num_faults(), 0);
+}
+
+TEST_F(IRCodeSpillTest, make_concrete_drops_spilled_code) {
+  auto method = make_method("remade", R"(
+    (
+      (load-param v0)
+      (const v1 1)
+      (return-void)
+    )
+  )");
+  auto tmp_dir = redex::make_tmp_dir("ir_code_spill_test_%%%%%%%%");
+  ir_code_spill::Store store(tmp_dir.path);
+  EXPECT_EQ(store.spill({method}, 0), 1);
+
+  method->make_concrete(ACC_PUBLIC | ACC_STATIC,
+                        assembler::ircode_from_string(R"(
+                          (
+                            (load-param v0)
+                            (return-void)
+                          )
+                        )"),
+                        false);
+  EXPECT_FALSE(method->is_code_spilled());
+  EXPECT_EQ(store.num_spilled(), 0);
+  EXPECT_EQ(method->get_code()->count_opcodes(), 1);
+  EXPECT_EQ(store.num_faults(), 0);
+}
+
+TEST_F(IRCodeSpillTest, destroying_the_store_faults_in_all) {
+  auto method = make_method("kept", R"(
+    (
+      (load-param v0)
+      (const v1 1)
+      (return-void)
+    )
+  )");
+  auto expected = assembler::to_string(method->get_code());
+  auto tmp_dir = redex::make_tmp_dir("ir_code_spill_test_%%%%%%%%");
+  {
+    ir_code_spill::Store store(tmp_dir.path);
+    EXPECT_EQ(store.spill({method}, 0), 1);
+  }
+  EXPECT_FALSE(method->is_code_spilled());
+  EXPECT_EQ(ir_code_spill::Store::get(), nullptr);
+  EXPECT_EQ(assembler::to_string(method->get_code()), expected);
+}
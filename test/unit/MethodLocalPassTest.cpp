@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+
+#include <gtest/gtest.h>
+#include <json/value.h>
+
+#include "ConfigFiles.h"
+#include "Creators.h"
+#include "DexClass.h"
+#include "IRAssembler.h"
+#include "Pass.h"
+#include "PassManager.h"
+#include "RedexTest.h"
+#include "Timer.h"
+
+namespace {
+
+std::mutex s_events_mutex;
+std::vector<std::string> s_events;
+
+void log(const std::string& event) {
+  std::lock_guard<std::mutex> lock(s_events_mutex);
+  s_events.push_back(event);
+}
+
+class ExampleMethodLocalPass : public MethodLocalPass {
+ public:
+  explicit ExampleMethodLocalPass(const std::string& name)
+      : MethodLocalPass(name) {}
+
+  void begin_walk(DexStoresVector&, ConfigFiles&, PassManager&) override {
+    log(name() + ".begin");
+    m_methods = 0;
+  }
+
+  void run_on_method(DexMethod* method, IRCode&, size_t worker_id) override {
+    EXPECT_LT(worker_id, num_workers());
+    log(name() + ":" + method->get_name()->str());
+    ++m_methods;
+  }
+
+  void end_walk(DexStoresVector&, ConfigFiles&, PassManager& mgr) override {
+    log(name() + ".end");
+    mgr.set_metric("methods", m_methods);
+  }
+
+ private:
+  std::atomic<size_t> m_methods{0};
+};
+
+} // namespace
+
+class MethodLocalPassTest : public RedexTest {
+ protected:
+  DexStoresVector stores;
+  ExampleMethodLocalPass pass_a{"MethodLocalA"};
+  ExampleMethodLocalPass pass_b{"MethodLocalB"};
+
+  void SetUp() override {
+    ClassCreator cc(DexType::make_type("LFoo;"));
+    cc.set_super(type::java_lang_Object());
+    auto method =
+        DexMethod::make_method("LFoo;.bar:()V")
+            ->make_concrete(ACC_PUBLIC | ACC_STATIC,
+                            assembler::ircode_from_string("((return-void))"),
+                            false);
+    cc.add_method(method);
+    DexStore store("classes");
+    store.add_classes({cc.create()});
+    stores = {store};
+    s_events.clear();
+  }
+
+  // Runs the passes, and returns their metrics.
+  std::vector<std::unordered_map<std::string, int64_t>> run_passes(
+      bool fuse, size_t cost_sampling_top_k = 0) {
+    Json::Value config(Json::objectValue);
+    config["redex"] = Json::objectValue;
+    config["redex"]["passes"] = Json::arrayValue;
+    config["redex"]["passes"].append("MethodLocalA");
+    config["redex"]["passes"].append("MethodLocalB");
+    config["fuse_method_local_passes"] = fuse;
+    config["method_cost_sampling_top_k"] = Json::UInt64(cost_sampling_top_k);
+    // Checking or hashing the code after each pass turns fusion off.
+    config["hasher"] = Json::objectValue;
+    config["hasher"]["run_after_each_pass"] = false;
+    config["ir_type_checker"] = Json::objectValue;
+    config["ir_type_checker"]["run_after_each_pass"] = false;
+    ConfigFiles conf(config);
+    std::vector<Pass*> passes{&pass_a, &pass_b};
+    PassManager manager(passes, config);
+    manager.set_testing_mode();
+    manager.run_passes(stores, conf);
+    std::vector<std::unordered_map<std::string, int64_t>> metrics;
+    for (const auto& info : manager.get_pass_info()) {
+      metrics.push_back(info.metrics);
+    }
+    return metrics;
+  }
+};
+
+TEST_F(MethodLocalPassTest, runsPassesOneAfterTheOther) {
+  auto metrics = run_passes(/* fuse */ false);
+  EXPECT_EQ(s_events,
+            (std::vector<std::string>{"MethodLocalA.begin", "MethodLocalA:bar",
+                                      "MethodLocalA.end", "MethodLocalB.begin",
+                                      "MethodLocalB:bar", "MethodLocalB.end"}));
+  ASSERT_EQ(metrics.size(), 2);
+  EXPECT_EQ(metrics[0].at("methods"), 1);
+  EXPECT_EQ(metrics[0].count("~fused~passes"), 0);
+}
+
+TEST_F(MethodLocalPassTest, fusesAdjacentPasses) {
+  const auto& times = Timer::get_times();
+  size_t num_times_before = times.size();
+  auto metrics = run_passes(/* fuse */ true);
+  EXPECT_EQ(s_events,
+            (std::vector<std::string>{
+                "MethodLocalA.begin", "MethodLocalB.begin", "MethodLocalA:bar",
+                "MethodLocalB:bar", "MethodLocalA.end", "MethodLocalB.end"}));
+  ASSERT_EQ(metrics.size(), 2);
+  for (const auto& pass_metrics : metrics) {
+    EXPECT_EQ(pass_metrics.at("methods"), 1);
+    EXPECT_EQ(pass_metrics.at("~fused~passes"), 2);
+  }
+  // Every fused pass is still timed on its own.
+  std::unordered_set<std::string> timers;
+  for (size_t t = num_times_before; t < times.size(); ++t) {
+    timers.insert(times[t].first);
+  }
+  EXPECT_EQ(timers.count("MethodLocalA 1 (run)"), 1);
+  EXPECT_EQ(timers.count("MethodLocalB 1 (run)"), 1);
+}
+
+TEST_F(MethodLocalPassTest, exportsTimePerMethod) {
+  for (bool fuse : {false, true}) {
+    auto metrics = run_passes(fuse, /* cost_sampling_top_k */ 1);
+    ASSERT_EQ(metrics.size(), 2);
+    for (const auto& pass_metrics : metrics) {
+      EXPECT_EQ(pass_metrics.at("~method~us.count"), 1);
+      EXPECT_EQ(pass_metrics.count("~method~us.p50"), 1);
+      EXPECT_EQ(pass_metrics.count("~method~us.p99"), 1);
+      EXPECT_EQ(pass_metrics.count("~slowest~us~LFoo;.bar:()V"), 1);
+    }
+  }
+  cost_sampling::enable(0);
+}
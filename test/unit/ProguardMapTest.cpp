@@ -341,3 +341,37 @@ TEST_F(ProguardMapTest, DeobfuscateFramesWithoutLineRange) {
 
   EXPECT_CODE_EQ(code.get(), expected_code.get());
 }
+
+TEST_F(ProguardMapTest, ManyClasses) {
+  // Enough classes that the members are parsed in several chunks.
+  std::ostringstream map;
+  map << "# compiler: R8\n";
+  for (int i = 0; i < 1000; ++i) {
+    map << "com.foo.C" << i << " -> X.C" << i << ":\n"
+        << "    com.foo.C" << (i + 1) % 1000 << " next -> a\n"
+        << "    1:2:void run(com.foo.C" << (999 - i) << ") -> b\n";
+  }
+  // A class that shows up again; its later members win.
+  map << "com.foo.C0 -> X.C0:\n"
+      << "    com.foo.C1 next -> c\n";
+  std::stringstream ss(map.str());
+  ProguardMap pm(ss);
+
+  for (int i = 0; i < 1000; ++i) {
+    auto cls = "Lcom/foo/C" + std::to_string(i) + ";";
+    auto new_cls = "LX/C" + std::to_string(i) + ";";
+    auto next = std::to_string((i + 1) % 1000);
+    auto arg = std::to_string(999 - i);
+    EXPECT_EQ(new_cls, pm.translate_class(cls));
+    if (i != 0) {
+      EXPECT_EQ(new_cls + ".a:LX/C" + next + ";",
+                pm.translate_field(cls + ".next:Lcom/foo/C" + next + ";"));
+    }
+    EXPECT_EQ(new_cls + ".b:(LX/C" + arg + ";)V",
+              pm.translate_method(cls + ".run:(Lcom/foo/C" + arg + ";)V"));
+    EXPECT_EQ(cls + ".run:(Lcom/foo/C" + arg + ";)V",
+              pm.deobfuscate_method(new_cls + ".b:(LX/C" + arg + ";)V"));
+  }
+  EXPECT_EQ("LX/C0;.c:LX/C1;",
+            pm.translate_field("Lcom/foo/C0;.next:Lcom/foo/C1;"));
+}
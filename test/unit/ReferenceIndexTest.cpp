@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "ReferenceIndex.h"
+
+#include "Creators.h"
+#include "DexClass.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+
+using namespace reference_index;
+
+class ReferenceIndexTest : public RedexTest {
+ public:
+  ReferenceIndexTest() {
+    ClassCreator cc{DexType::make_type("LFoo;")};
+    cc.set_super(type::java_lang_Object());
+    m_field = static_cast<DexField*>(DexField::make_field("LFoo;.f:I"));
+    m_field->make_concrete(ACC_PUBLIC | ACC_STATIC);
+    cc.add_field(m_field);
+    m_callee = make_method("callee", R"(
+      (
+        (sget "LFoo;.f:I")
+        (move-result-pseudo v0)
+        (return-void)
+      )
+    )");
+    m_caller = make_method("caller", R"(
+      (
+        (const v0 1)
+        (sput v0 "LFoo;.f:I")
+        (invoke-static () "LFoo;.callee:()V")
+        (new-instance "LBar;")
+        (move-result-pseudo-object v1)
+        (invoke-static () "LFoo;.callee:()V")
+        (return-void)
+      )
+    )");
+    cc.add_method(m_callee);
+    cc.add_method(m_caller);
+    m_scope.push_back(cc.create());
+  }
+
+  static DexMethod* make_method(const std::string& name,
+                                const std::string& code) {
+    return DexMethod::make_method("LFoo;." + name + ":()V")
+        ->make_concrete(ACC_PUBLIC | ACC_STATIC,
+                        assembler::ircode_from_string(code),
+                        false);
+  }
+
+  static std::vector<DexMethod*> methods(const std::vector<Site>& sites) {
+    std::vector<DexMethod*> result;
+    for (const auto& site : sites) {
+      result.push_back(site.method);
+    }
+    return result;
+  }
+
+  Scope m_scope;
+  DexField* m_field;
+  DexMethod* m_callee;
+  DexMethod* m_caller;
+};
+
+TEST_F(ReferenceIndexTest, indexesAllKindsOfReferences) {
+  ReferenceIndex index(m_scope);
+
+  auto invokes = index.invokes(m_callee);
+  ASSERT_EQ(invokes.size(), 2);
+  EXPECT_EQ(invokes[0].method, m_caller);
+  EXPECT_EQ(invokes[0].insn->opcode(), OPCODE_INVOKE_STATIC);
+  EXPECT_NE(invokes[0].insn, invokes[1].insn);
+
+  EXPECT_EQ(methods(index.reads(m_field)), std::vector<DexMethod*>{m_callee});
+  EXPECT_EQ(methods(index.writes(m_field)), std::vector<DexMethod*>{m_caller});
+
+  auto type_uses = index.type_uses(DexType::make_type("LBar;"));
+  ASSERT_EQ(type_uses.size(), 1);
+  EXPECT_EQ(type_uses[0].insn->opcode(), OPCODE_NEW_INSTANCE);
+
+  EXPECT_TRUE(index.invokes(m_caller).empty());
+}
+
+TEST_F(ReferenceIndexTest, updatesOneMethod) {
+  ReferenceIndex index(m_scope);
+
+  m_caller->set_code(assembler::ircode_from_string(R"(
+    (
+      (sget "LFoo;.f:I")
+      (move-result-pseudo v0)
+      (return-void)
+    )
+  )"));
+  index.update(m_caller);
+  EXPECT_TRUE(index.invokes(m_callee).empty());
+  EXPECT_TRUE(index.writes(m_field).empty());
+  EXPECT_TRUE(index.type_uses(DexType::make_type("LBar;")).empty());
+  EXPECT_EQ(methods(index.reads(m_field)),
+            (std::vector<DexMethod*>{m_callee, m_caller}));
+
+  index.remove(m_callee);
+  EXPECT_EQ(methods(index.reads(m_field)), std::vector<DexMethod*>{m_caller});
+}
+
+TEST_F(ReferenceIndexTest, indexesEditableCfgs) {
+  m_caller->get_code()->build_cfg(/* editable */ true);
+  ReferenceIndex index(m_scope);
+  EXPECT_EQ(index.invokes(m_callee).size(), 2);
+  m_caller->get_code()->clear_cfg();
+}
+
+TEST_F(ReferenceIndexTest, indexesOnlyRequestedKinds) {
+  ReferenceIndex index(m_scope, INVOKES);
+  EXPECT_EQ(index.invokes(m_callee).size(), 2);
+  EXPECT_ANY_THROW(index.reads(m_field));
+  EXPECT_ANY_THROW(index.type_uses(DexType::make_type("LBar;")));
+
+  index.update(m_caller);
+  EXPECT_EQ(index.invokes(m_callee).size(), 2);
+}
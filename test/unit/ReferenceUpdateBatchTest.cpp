@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <gtest/gtest.h>
+
+#include "ReferenceUpdateBatch.h"
+
+#include "ClassHierarchy.h"
+#include "Creators.h"
+#include "DexClass.h"
+#include "IRAssembler.h"
+#include "IRCode.h"
+#include "RedexTest.h"
+#include "Show.h"
+
+using namespace reference_update;
+
+class ReferenceUpdateBatchTest : public RedexTest {
+ public:
+  ReferenceUpdateBatchTest()
+      : m_creator(DexType::make_type("LFoo;")),
+        m_a(DexType::make_type("LA;")),
+        m_b(DexType::make_type("LB;")),
+        m_c(DexType::make_type("LC;")) {
+    m_creator.set_super(type::java_lang_Object());
+  }
+
+  DexField* add_field(const std::string& sig) {
+    auto field = static_cast<DexField*>(DexField::make_field("LFoo;." + sig));
+    field->make_concrete(ACC_PUBLIC | ACC_STATIC);
+    m_creator.add_field(field);
+    return field;
+  }
+
+  DexMethod* add_method(const std::string& sig, const std::string& code) {
+    auto method = DexMethod::make_method("LFoo;." + sig)
+                      ->make_concrete(ACC_PUBLIC | ACC_STATIC,
+                                      assembler::ircode_from_string(code),
+                                      false);
+    m_creator.add_method(method);
+    return method;
+  }
+
+  Batch::Stats apply(Batch* batch,
+                     const Batch::TypeInsnCheck& check_type_insn = nullptr) {
+    Scope scope{m_creator.create()};
+    return batch->apply(scope, build_type_hierarchy(scope), check_type_insn);
+  }
+
+  ClassCreator m_creator;
+  DexType* m_a;
+  DexType* m_b;
+  DexType* m_c;
+};
+
+TEST_F(ReferenceUpdateBatchTest, appliesAllSubstitutionsAtOnce) {
+  auto f_old = add_field("f_old:I");
+  auto f_new = add_field("f_new:I");
+  auto m_old = add_method("old:()V", "((return-void))");
+  auto m_new = add_method("new:()V", "((return-void))");
+  auto user = add_method("user:(LA;)V", R"(
+    (
+      (load-param-object v0)
+      (const v1 1)
+      (new-array v1 "[[LA;")
+      (move-result-pseudo-object v2)
+      (sget "LFoo;.f_old:I")
+      (move-result-pseudo v1)
+      (invoke-static () "LFoo;.old:()V")
+      (return-void)
+    )
+  )");
+
+  Batch batch;
+  batch.add_type(m_a, m_b);
+  batch.add_method(m_old, m_new);
+  batch.add_field(f_old, f_new);
+  auto stats = apply(&batch);
+  EXPECT_TRUE(batch.empty());
+  EXPECT_EQ(stats.updated_type_insns, 1);
+  EXPECT_EQ(stats.updated_field_insns, 1);
+  EXPECT_EQ(stats.updated_method_insns, 1);
+
+  EXPECT_EQ(show(user), "LFoo;.user:(LB;)V");
+  auto expected = assembler::ircode_from_string(R"(
+    (
+      (load-param-object v0)
+      (const v1 1)
+      (new-array v1 "[[LB;")
+      (move-result-pseudo-object v2)
+      (sget "LFoo;.f_new:I")
+      (move-result-pseudo v1)
+      (invoke-static () "LFoo;.new:()V")
+      (return-void)
+    )
+  )");
+  EXPECT_CODE_EQ(user->get_code(), expected.get());
+}
+
+TEST_F(ReferenceUpdateBatchTest, composesSubstitutions) {
+  auto field = add_field("f:[LA;");
+
+  Batch batch;
+  batch.add_type(m_b, m_c);
+  batch.add_type(m_a, m_b);
+  auto stats = apply(&batch);
+  EXPECT_EQ(stats.updated_fields, 1);
+  EXPECT_EQ(field->get_type(), type::make_array_type(m_c));
+}
+
+TEST_F(ReferenceUpdateBatchTest, renamesClashingFields) {
+  auto f_a = add_field("f:LA;");
+  auto f_b = add_field("f:LB;");
+
+  Batch batch;
+  batch.add_type(m_a, m_b);
+  auto stats = apply(&batch);
+  EXPECT_EQ(stats.updated_fields, 1);
+  EXPECT_EQ(stats.renamed_fields, 1);
+  EXPECT_EQ(f_b->get_name()->str(), "f");
+  EXPECT_EQ(f_a->get_type(), m_b);
+  EXPECT_NE(f_a->get_name()->str(), "f");
+}
+
+TEST_F(ReferenceUpdateBatchTest, followsRenamedMethods) {
+  const auto code = "((load-param-object v0) (return-void))";
+  auto foo_a = add_method("foo:(LA;)V", code);
+  auto foo_b = add_method("foo:(LB;)V", code);
+  auto user = add_method("user:()V", R"(
+    (
+      (const v0 0)
+      (invoke-static (v0) "LFoo;.foo:(LA;)V")
+      (invoke-static (v0) "LFoo;.foo:(LB;)V")
+      (return-void)
+    )
+  )");
+
+  Batch batch;
+  batch.add_type(m_a, m_b);
+  apply(&batch);
+  EXPECT_EQ(show(foo_b), "LFoo;.foo:(LB;)V");
+  EXPECT_EQ(foo_a->get_proto(), foo_b->get_proto());
+  EXPECT_NE(foo_a->get_name(), foo_b->get_name());
+
+  std::vector<DexMethodRef*> callees;
+  for (auto& mie : InstructionIterable(user->get_code())) {
+    if (mie.insn->has_method()) {
+      callees.push_back(mie.insn->get_method());
+    }
+  }
+  EXPECT_EQ(callees, (std::vector<DexMethodRef*>{foo_a, foo_b}));
+}
+
+TEST_F(ReferenceUpdateBatchTest, checksUpdatedTypeInstructions) {
+  add_method("user:()V", R"(
+    (
+      (const v0 1)
+      (new-array v0 "[LA;")
+      (move-result-pseudo-object v1)
+      (new-instance "LC;")
+      (move-result-pseudo-object v2)
+      (return-void)
+    )
+  )");
+
+  Batch batch;
+  batch.add_type(m_a, m_b);
+  std::vector<IROpcode> checked;
+  auto stats = apply(&batch, [&](const IRInstruction* insn) {
+    checked.push_back(insn->opcode());
+  });
+  EXPECT_EQ(stats.updated_type_insns, 1);
+  EXPECT_EQ(checked, (std::vector<IROpcode>{OPCODE_NEW_ARRAY}));
+}
@@ -794,6 +794,215 @@ TEST_F(RegAllocTest, NoSpillSingleArgInvokes) {
   EXPECT_CODE_EQ(code.get(), expected_code.get());
 }
 
+namespace {
+
+const char* const loop_code_str = R"(
+    (
+     (load-param-object v0)
+     (load-param v1)
+     (const v2 0)
+     (:loop)
+     (if-ge v2 v1 :end)
+     (check-cast v0 "LFoo;")
+     (move-result-pseudo-object v3)
+     (iget v3 "LFoo;.a:I")
+     (move-result-pseudo v4)
+     (add-int v2 v2 v4)
+     (const-wide v5 1)
+     (add-long v7 v5 v5)
+     (goto :loop)
+     (:end)
+     (return v2)
+    )
+)";
+
+void expect_same_graph(const interference::Graph& actual,
+                       const interference::Graph& expected) {
+  ASSERT_EQ(actual.nodes().size(), expected.nodes().size());
+  for (const auto& pair : expected.nodes()) {
+    auto reg = pair.first;
+    const auto& node = pair.second;
+    const auto& actual_node = actual.get_node(reg);
+    EXPECT_EQ(actual_node.weight(), node.weight()) << "v" << reg;
+    EXPECT_EQ(actual_node.spill_cost(), node.spill_cost()) << "v" << reg;
+    EXPECT_EQ(actual_node.max_vreg(), node.max_vreg()) << "v" << reg;
+    EXPECT_EQ(actual_node.width(), node.width()) << "v" << reg;
+    EXPECT_EQ(actual_node.type(), node.type()) << "v" << reg;
+    EXPECT_EQ(actual_node.is_param(), node.is_param()) << "v" << reg;
+    EXPECT_EQ(actual_node.is_range(), node.is_range()) << "v" << reg;
+    EXPECT_EQ(actual_node.is_spilt(), node.is_spilt()) << "v" << reg;
+    EXPECT_TRUE(actual_node.is_active()) << "v" << reg;
+    EXPECT_THAT(actual_node.adjacent(),
+                ::testing::UnorderedElementsAreArray(node.adjacent()))
+        << "v" << reg;
+    for (auto adj : node.adjacent()) {
+      EXPECT_EQ(actual.is_coalesceable(reg, adj),
+                expected.is_coalesceable(reg, adj))
+          << "v" << reg << " -- v" << adj;
+    }
+    for (const auto& other : expected.nodes()) {
+      EXPECT_EQ(actual.has_containment_edge(reg, other.first),
+                expected.has_containment_edge(reg, other.first))
+          << "v" << reg << " -> v" << other.first;
+    }
+  }
+}
+
+} // namespace
+
+TEST_F(RegAllocTest, ParallelLivenessAndInterference) {
+  auto code = assembler::ircode_from_string(loop_code_str);
+  code->set_registers_size(9);
+  code->build_cfg(/* editable */ false);
+  auto& cfg = code->cfg();
+  cfg.calculate_exit_block();
+  LivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(LivenessDomain());
+  LivenessFixpointIterator summarized_fixpoint_iter(cfg);
+  summarized_fixpoint_iter.run_summarized(/* num_threads */ 4);
+  for (auto* block : cfg.blocks()) {
+    EXPECT_EQ(summarized_fixpoint_iter.get_live_in_vars_at(block),
+              fixpoint_iter.get_live_in_vars_at(block));
+    EXPECT_EQ(summarized_fixpoint_iter.get_live_out_vars_at(block),
+              fixpoint_iter.get_live_out_vars_at(block));
+  }
+
+  RangeSet range_set;
+  auto ig = interference::build_graph(fixpoint_iter, code.get(),
+                                      code->get_registers_size(), range_set);
+  auto parallel_ig = interference::build_graph(
+      summarized_fixpoint_iter, code.get(), code->get_registers_size(),
+      range_set, /* num_threads */ 4);
+  expect_same_graph(parallel_ig, ig);
+  // The edges are added in the same order too.
+  for (const auto& pair : ig.nodes()) {
+    EXPECT_EQ(parallel_ig.get_node(pair.first).adjacent(),
+              pair.second.adjacent());
+  }
+}
+
+TEST_F(RegAllocTest, UpdateInterferenceGraphAfterSpill) {
+  auto code = assembler::ircode_from_string(loop_code_str);
+  code->set_registers_size(9);
+  code->build_cfg(/* editable */ false);
+  code->cfg().calculate_exit_block();
+  auto initial_regs = code->get_registers_size();
+  RangeSet range_set;
+  interference::Graph ig;
+  {
+    LivenessFixpointIterator fixpoint_iter(code->cfg());
+    fixpoint_iter.run(LivenessDomain());
+    ig = interference::build_graph(fixpoint_iter, code.get(), initial_regs,
+                                   range_set);
+  }
+
+  graph_coloring::Allocator allocator;
+  std::stack<reg_t> select_stack;
+  std::stack<reg_t> spilled_select_stack;
+  allocator.simplify(&ig, &select_stack, &spilled_select_stack);
+  graph_coloring::SpillPlan spill_plan;
+  spill_plan.global_spills = std::unordered_map<reg_t, vreg_t>{
+      {2, 256},
+      {4, 16},
+  };
+  allocator.spill(ig, spill_plan, range_set, code.get());
+  code->build_cfg(/* editable */ false);
+  auto& cfg = code->cfg();
+  cfg.calculate_exit_block();
+  LivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(LivenessDomain());
+
+  // Only the spilled registers and the new temporaries have changed, and the
+  // latter are past the end of `touched`.
+  std::vector<bool> touched(initial_regs);
+  touched[2] = true;
+  touched[4] = true;
+  interference::update_graph(fixpoint_iter, code.get(), initial_regs,
+                             range_set, touched, &ig);
+  expect_same_graph(ig,
+                    interference::build_graph(fixpoint_iter, code.get(),
+                                              initial_regs, range_set));
+}
+
+TEST_F(RegAllocTest, UpdateInterferenceGraphAfterCoalesceSpillAndSplit) {
+  auto code = assembler::ircode_from_string(R"(
+    (
+     (load-param-object v0)
+     (load-param v1)
+     (const v2 0)
+     (:loop)
+     (if-ge v2 v1 :end)
+     (check-cast v0 "LFoo;")
+     (move-result-pseudo-object v3)
+     (iget v3 "LFoo;.a:I")
+     (move-result-pseudo v4)
+     (move v8 v4)
+     (add-int v2 v2 v8)
+     (const-wide v5 1)
+     (add-long v7 v5 v5)
+     (goto :loop)
+     (:end)
+     (return v2)
+    )
+)");
+  code->set_registers_size(9);
+  code->build_cfg(/* editable */ false);
+  code->cfg().calculate_exit_block();
+  auto initial_regs = code->get_registers_size();
+  RangeSet range_set;
+  interference::Graph ig;
+  graph_coloring::Allocator allocator;
+  std::vector<bool> touched;
+  {
+    LivenessFixpointIterator fixpoint_iter(code->cfg());
+    fixpoint_iter.run(LivenessDomain());
+    ig = interference::build_graph(fixpoint_iter, code.get(), initial_regs,
+                                   range_set);
+    allocator.coalesce(&ig, code.get(), &touched);
+  }
+  // v8 and v7 were coalesced into v4 and v5.
+  EXPECT_TRUE(touched[4]);
+  EXPECT_TRUE(touched[8]);
+
+  // Spill and split the way allocate() does after coalescing, with the
+  // liveness of the coalesced code.
+  size_t split_moves;
+  {
+    LivenessFixpointIterator fixpoint_iter(code->cfg());
+    fixpoint_iter.run(LivenessDomain());
+    std::stack<reg_t> select_stack;
+    std::stack<reg_t> spilled_select_stack;
+    allocator.simplify(&ig, &select_stack, &spilled_select_stack);
+    graph_coloring::CodeSnapshot snapshot(code.get());
+    graph_coloring::SpillPlan spill_plan;
+    spill_plan.global_spills = std::unordered_map<reg_t, vreg_t>{{2, 256}};
+    SplitCosts split_costs;
+    SplitPlan split_plan;
+    // split 0 around 5
+    split_plan.split_around =
+        std::unordered_map<vreg_t, std::unordered_set<vreg_t>>{
+            {5, std::unordered_set<vreg_t>{0}}};
+    allocator.spill(ig, spill_plan, range_set, code.get());
+    split_moves =
+        split(fixpoint_iter, split_plan, split_costs, ig, code.get());
+    code->build_cfg(/* editable */ false);
+    touched.resize(
+        std::max<size_t>(touched.size(), code->get_registers_size()));
+    snapshot.mark_touched_registers(code.get(), &touched);
+  }
+  EXPECT_GT(split_moves, 0);
+  auto& cfg = code->cfg();
+  cfg.calculate_exit_block();
+  LivenessFixpointIterator fixpoint_iter(cfg);
+  fixpoint_iter.run(LivenessDomain());
+
+  interference::update_graph(fixpoint_iter, code.get(), initial_regs,
+                             range_set, touched, &ig);
+  expect_same_graph(ig,
+                    interference::build_graph(fixpoint_iter, code.get(),
+                                              initial_regs, range_set));
+}
+
 TEST_F(RegAllocTest, ContainmentGraph) {
   auto code = assembler::ircode_from_string(R"(
     (
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "ShardedMetrics.h"
+
+#include <gtest/gtest.h>
+
+#include "WorkQueue.h"
+
+using namespace sharded_metrics;
+
+constexpr size_t NUM_ITEMS = 10000;
+
+TEST(ShardedMetricsTest, counterSumsAllThreads) {
+  Counter counter;
+  auto wq = workqueue_foreach<size_t>([&](size_t item) { counter.incr(item); },
+                                      8);
+  for (size_t i = 0; i < NUM_ITEMS; ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+  EXPECT_EQ(counter.sum(), NUM_ITEMS * (NUM_ITEMS - 1) / 2);
+
+  counter.reset();
+  EXPECT_EQ(counter.sum(), 0);
+}
+
+TEST(ShardedMetricsTest, bucketsRoundTrip) {
+  for (size_t bucket = 0; bucket < Histogram::NUM_BUCKETS; ++bucket) {
+    EXPECT_EQ(Histogram::bucket_of(Histogram::bucket_lower_bound(bucket)),
+              bucket);
+  }
+  EXPECT_EQ(Histogram::bucket_of(std::numeric_limits<uint64_t>::max()),
+            Histogram::NUM_BUCKETS - 1);
+  // Small values are exact.
+  for (uint64_t value = 0; value < 2 * Histogram::SUB_BUCKETS; ++value) {
+    EXPECT_EQ(Histogram::bucket_lower_bound(Histogram::bucket_of(value)),
+              value);
+  }
+  // Larger values are approximated from below, within 12.5%.
+  for (uint64_t value : {17, 100, 1000, 123456, 1 << 30}) {
+    auto lower = Histogram::bucket_lower_bound(Histogram::bucket_of(value));
+    EXPECT_LE(lower, value);
+    EXPECT_GE(lower, value - value / Histogram::SUB_BUCKETS);
+  }
+}
+
+TEST(ShardedMetricsTest, histogramSummary) {
+  Histogram histogram;
+  auto wq = workqueue_foreach<uint64_t>(
+      [&](uint64_t item) { histogram.record(item); }, 8);
+  for (uint64_t i = 1; i <= 100; ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  auto summary = histogram.summarize();
+  EXPECT_EQ(summary.count, 100);
+  EXPECT_EQ(summary.sum, 5050);
+  EXPECT_EQ(summary.min, 1);
+  EXPECT_EQ(summary.max, 100);
+  // 50 lies in the bucket [48, 52), 90 in [88, 96), 99 in [96, 104).
+  EXPECT_EQ(summary.p50, 48);
+  EXPECT_EQ(summary.p90, 88);
+  EXPECT_EQ(summary.p99, 96);
+
+  histogram.reset();
+  summary = histogram.summarize();
+  EXPECT_EQ(summary.count, 0);
+  EXPECT_EQ(summary.min, 0);
+  EXPECT_EQ(summary.max, 0);
+}
+
+TEST(ShardedMetricsTest, histogramAdd) {
+  Histogram a;
+  Histogram b;
+  for (uint64_t i = 1; i <= 50; ++i) {
+    a.record(i);
+  }
+  for (uint64_t i = 51; i <= 100; ++i) {
+    b.record(i);
+  }
+  a.add(b);
+
+  auto summary = a.summarize();
+  EXPECT_EQ(summary.count, 100);
+  EXPECT_EQ(summary.sum, 5050);
+  EXPECT_EQ(summary.min, 1);
+  EXPECT_EQ(summary.max, 100);
+  EXPECT_EQ(summary.p50, 48);
+  EXPECT_EQ(b.summarize().count, 50);
+}
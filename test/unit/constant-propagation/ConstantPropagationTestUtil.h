@@ -14,7 +14,9 @@ namespace cp = constant_propagation;
 
 struct ConstantPropagationTest : public RedexTest {};
 
-inline void do_const_prop(
+// The Iterator is intraprocedural::FixpointIterator or SparseFixpointIterator.
+template <class Iterator = cp::intraprocedural::FixpointIterator>
+void do_const_prop(
     IRCode* code,
     const std::function<void(const IRInstruction*, ConstantEnvironment*)>&
         insn_analyzer = cp::ConstantPrimitiveAnalyzer(),
@@ -22,7 +24,7 @@ inline void do_const_prop(
     bool editable_cfg = false) {
   code->build_cfg(editable_cfg);
   code->cfg().calculate_exit_block();
-  cp::intraprocedural::FixpointIterator intra_cp(code->cfg(), insn_analyzer);
+  Iterator intra_cp(code->cfg(), insn_analyzer);
   intra_cp.run(ConstantEnvironment());
   cp::Transform tf(transform_config);
   if (editable_cfg) {
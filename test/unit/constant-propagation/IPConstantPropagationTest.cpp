@@ -1093,6 +1093,62 @@ TEST_F(InterproceduralConstantPropagationTest, constantFieldAfterClinit) {
   EXPECT_CODE_EQ(m->get_code(), expected_code.get());
 }
 
+TEST_F(InterproceduralConstantPropagationTest,
+       reuseSummariesAcrossIterations) {
+  auto cls_ty = DexType::make_type("LFoo;");
+  ClassCreator creator(cls_ty);
+  creator.set_super(type::java_lang_Object());
+
+  auto field = DexField::make_field("LFoo;.qux:I")
+                   ->make_concrete(ACC_PUBLIC | ACC_STATIC);
+  creator.add_field(field);
+
+  auto writer = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.writer:()V"
+     (
+      (const v0 1)
+      (sput v0 "LFoo;.qux:I")
+      (return-void)
+     )
+    )
+  )");
+  writer->rstate.set_root();
+  creator.add_method(writer);
+
+  auto reader = assembler::method_from_string(R"(
+    (method (public static) "LFoo;.reader:()I"
+     (
+      (sget "LFoo;.qux:I")
+      (move-result-pseudo v0)
+      (return v0)
+     )
+    )
+  )");
+  reader->rstate.set_root();
+  creator.add_method(reader);
+
+  Scope scope{creator.create()};
+  walk::code(scope, [](DexMethod*, IRCode& code) {
+    code.build_cfg(/* editable */ false);
+    code.cfg().calculate_exit_block();
+  });
+
+  InterproceduralConstantPropagationPass::Config config;
+  config.max_heap_analysis_iterations = 2;
+  auto fp_iter = InterproceduralConstantPropagationPass(config).analyze(
+      scope, &m_immut_analyzer_state);
+
+  // Foo.qux is either its initial value 0 or 1. Only the reader depends on
+  // it, so the summary of the writer is reused after the first iteration.
+  auto stats = fp_iter->get_summary_stats();
+  EXPECT_EQ(stats.invalidated_summaries, 1);
+  EXPECT_GT(stats.reused_summaries, 0);
+  EXPECT_EQ(fp_iter->get_method_summary(reader)->return_value,
+            SignedConstantDomain(sign_domain::Interval::GEZ));
+  EXPECT_EQ(fp_iter->get_method_summary(writer)->field_values.at(field),
+            SignedConstantDomain(1));
+}
+
 TEST_F(InterproceduralConstantPropagationTest,
        nonConstantFieldDueToInvokeInClinit) {
   auto cls_ty = DexType::make_type("LFoo;");
@@ -13,6 +13,7 @@
 #include "ConstantPropagationTestUtil.h"
 #include "IRAssembler.h"
 #include "RedexTest.h"
+#include "ReducedProductAbstractDomain.h"
 
 struct Constants {
   SignedConstantDomain one{SignedConstantDomain(1)};
@@ -97,6 +98,82 @@ TEST_F(SignedConstantDomainOperationsTest, binaryOperations) {
   EXPECT_EQ(not_zero.meet(min_val), min_val);
 }
 
+/*
+ * The reduced product that SignedConstantDomain packs into a few bits.
+ */
+class SignedConstantProduct final
+    : public sparta::ReducedProductAbstractDomain<SignedConstantProduct,
+                                                  sign_domain::Domain,
+                                                  ConstantDomain> {
+ public:
+  using ReducedProductAbstractDomain::ReducedProductAbstractDomain;
+
+  SignedConstantProduct() = default;
+
+  explicit SignedConstantProduct(const SignedConstantDomain& d)
+      : SignedConstantProduct(
+            std::make_tuple(d.interval_domain(), d.constant_domain())) {}
+
+  static void reduce_product(
+      std::tuple<sign_domain::Domain, ConstantDomain>& domains) {
+    auto& sdom = std::get<0>(domains);
+    auto& cdom = std::get<1>(domains);
+    if (sdom.element() == sign_domain::Interval::EQZ) {
+      cdom.meet_with(ConstantDomain(0));
+      return;
+    }
+    auto cst = cdom.get_constant();
+    if (!cst) {
+      return;
+    }
+    if (!sign_domain::contains(sdom.element(), *cst)) {
+      sdom.set_to_bottom();
+      return;
+    }
+    sdom.meet_with(sign_domain::from_int(*cst));
+  }
+
+  // Meets don't reduce the product, so the constant 0 may show up as
+  // (EQZ, Top); reduce before comparing.
+  bool same_as(const SignedConstantDomain& d) const {
+    SignedConstantProduct reduced(std::make_tuple(get<0>(), get<1>()));
+    if (reduced.is_bottom()) {
+      return d.is_bottom();
+    }
+    return reduced.get<0>().element() == d.interval() &&
+           reduced.get<1>().get_constant() == d.get_constant();
+  }
+};
+
+TEST_F(SignedConstantDomainOperationsTest, matchesReducedProduct) {
+  using namespace sign_domain;
+
+  std::vector<SignedConstantDomain> values{
+      SignedConstantDomain::bottom(), SignedConstantDomain::top()};
+  for (auto interval : {Interval::EMPTY, Interval::LTZ, Interval::GTZ,
+                        Interval::EQZ, Interval::NEZ, Interval::GEZ,
+                        Interval::LEZ, Interval::ALL}) {
+    values.emplace_back(interval);
+  }
+  for (int64_t v : {std::numeric_limits<int64_t>::min(), int64_t(-2),
+                    int64_t(-1), int64_t(0), int64_t(1), int64_t(2),
+                    std::numeric_limits<int64_t>::max()}) {
+    values.emplace_back(v);
+  }
+  for (const auto& x : values) {
+    SignedConstantProduct px(x);
+    EXPECT_TRUE(px.same_as(x)) << x;
+    EXPECT_EQ(px.is_top(), x.is_top()) << x;
+    for (const auto& y : values) {
+      SignedConstantProduct py(y);
+      EXPECT_TRUE(px.join(py).same_as(x.join(y))) << x << " " << y;
+      EXPECT_TRUE(px.meet(py).same_as(x.meet(y))) << x << " " << y;
+      EXPECT_EQ(px.leq(py), x.leq(y)) << x << " " << y;
+      EXPECT_EQ(px.equals(py), x.equals(y)) << x << " " << y;
+    }
+  }
+}
+
 class ConstantNezTest : public RedexTest {};
 
 TEST_F(ConstantNezTest, DeterminableNezTrue) {
@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include "SparseConstantPropagation.h"
+
+#include <ctime>
+#include <gtest/gtest.h>
+#include <limits>
+#include <sstream>
+
+#include "ConstantPropagationTestUtil.h"
+#include "IRAssembler.h"
+#include "Show.h"
+
+using namespace constant_propagation::intraprocedural;
+
+/*
+ * Runs both iterators on the code, and checks that the sparse one finds the
+ * same executable blocks, and the same values for every register that an
+ * instruction reads or writes.
+ */
+struct SparseConstantPropagationTest : public ConstantPropagationTest {
+  void run(const std::string& code_str, bool editable_cfg = false) {
+    m_code = assembler::ircode_from_string(code_str);
+    m_code->build_cfg(editable_cfg);
+    auto& cfg = m_code->cfg();
+    cfg.calculate_exit_block();
+    FixpointIterator dense(cfg, cp::ConstantPrimitiveAnalyzer());
+    dense.run(ConstantEnvironment());
+    m_sparse = std::make_unique<SparseFixpointIterator>(
+        cfg, cp::ConstantPrimitiveAnalyzer());
+    m_sparse->run(ConstantEnvironment());
+
+    for (auto block : cfg.blocks()) {
+      auto env = dense.get_entry_state_at(block);
+      EXPECT_EQ(!env.is_bottom(), m_sparse->is_executable(block))
+          << "B" << block->id();
+      EXPECT_EQ(env, m_sparse->get_entry_state_at(block))
+          << "B" << block->id();
+      EXPECT_EQ(dense.get_exit_state_at(block),
+                m_sparse->get_exit_state_at(block))
+          << "B" << block->id();
+      auto last_insn = block->get_last_insn();
+      for (auto& mie : InstructionIterable(block)) {
+        auto insn = mie.insn;
+        for (auto reg : insn->srcs()) {
+          EXPECT_EQ(env.get(reg), m_sparse->get_value_before(insn, reg))
+              << "v" << reg << " before " << show(insn);
+        }
+        if (opcode::is_move_result_any(insn->opcode())) {
+          EXPECT_EQ(env.get(RESULT_REGISTER),
+                    m_sparse->get_value_before(insn, RESULT_REGISTER))
+              << "result before " << show(insn);
+        }
+        dense.analyze_instruction(insn, &env, insn == last_insn->insn);
+        if (insn->has_dest()) {
+          EXPECT_EQ(env.get(insn->dest()),
+                    m_sparse->get_value_after(insn, insn->dest()))
+              << "v" << insn->dest() << " after " << show(insn);
+        }
+        if (insn->has_move_result_any()) {
+          EXPECT_EQ(env.get(RESULT_REGISTER),
+                    m_sparse->get_value_after(insn, RESULT_REGISTER))
+              << "result after " << show(insn);
+        }
+      }
+    }
+  }
+
+  // The join of the values that the method returns.
+  ConstantValue returned_value() {
+    ConstantValue value = ConstantValue::bottom();
+    for (auto block : m_code->cfg().blocks()) {
+      for (auto& mie : InstructionIterable(block)) {
+        if (opcode::is_a_return_value(mie.insn->opcode())) {
+          value.join_with(
+              m_sparse->get_value_before(mie.insn, mie.insn->src(0)));
+        }
+      }
+    }
+    return value;
+  }
+
+  std::unique_ptr<IRCode> m_code;
+  std::unique_ptr<SparseFixpointIterator> m_sparse;
+};
+
+TEST_F(SparseConstantPropagationTest, Arithmetic) {
+  run(R"(
+    (
+      (const v0 1)
+      (const v1 2)
+      (add-int v2 v0 v1)
+      (mul-int/lit8 v2 v2 3)
+      (return v2)
+    )
+  )");
+  EXPECT_EQ(returned_value(), SignedConstantDomain(9));
+}
+
+TEST_F(SparseConstantPropagationTest, DeadBranch) {
+  run(R"(
+    (
+      (const v0 0)
+      (if-eqz v0 :true)
+      (const v1 1)
+      (goto :end)
+      (:true)
+      (const v1 2)
+      (:end)
+      (return v1)
+    )
+  )");
+  EXPECT_EQ(returned_value(), SignedConstantDomain(2));
+}
+
+TEST_F(SparseConstantPropagationTest, Loop) {
+  run(R"(
+    (
+      (load-param v1)
+      (const v0 0)
+      (const v2 5)
+      (:loop)
+      (add-int/lit8 v0 v0 1)
+      (if-lt v0 v1 :loop)
+      (return v2)
+    )
+  )");
+  EXPECT_EQ(returned_value(), SignedConstantDomain(5));
+}
+
+TEST_F(SparseConstantPropagationTest, BranchRefinement) {
+  run(R"(
+    (
+      (load-param v0)
+      (const v1 1)
+      (if-nez v0 :nonzero)
+      (if-eqz v0 :zero)
+      (const v1 2)
+      (:zero)
+      (return v0)
+      (:nonzero)
+      (if-nez v0 :end)
+      (const v1 3)
+      (:end)
+      (return v1)
+    )
+  )");
+  EXPECT_EQ(returned_value(),
+            SignedConstantDomain(0).join(SignedConstantDomain(1)));
+}
+
+TEST_F(SparseConstantPropagationTest, Switch) {
+  run(R"(
+    (
+      (const v0 1)
+      (switch v0 (:b :c))
+      (const v1 100)
+      (return v1)
+
+      (:b 1)
+      (const v1 200)
+      (return v1)
+
+      (:c 3)
+      (const v1 300)
+      (return v1)
+    )
+  )",
+      /* editable_cfg */ true);
+  EXPECT_EQ(returned_value(), SignedConstantDomain(200));
+}
+
+TEST_F(SparseConstantPropagationTest, DereferenceRefinement) {
+  run(R"(
+    (
+      (load-param-object v0)
+      (.try_start a)
+      (array-length v0)
+      (move-result-pseudo v1)
+      (.try_end a)
+      (if-eqz v0 :null)
+      (const v2 1)
+      (return v2)
+      (:null)
+      (const v2 2)
+      (return v2)
+      (.catch (a))
+      (const v2 3)
+      (return v2)
+    )
+  )");
+  EXPECT_EQ(returned_value(),
+            SignedConstantDomain(1).join(SignedConstantDomain(3)));
+}
+
+/*
+ * Transform gives the same code with the results of either iterator, on both
+ * the uneditable and the editable CFG.
+ */
+TEST_F(SparseConstantPropagationTest, TransformWithSparseResults) {
+  const std::string code_str = R"(
+    (
+      (load-param v0)
+      (const v1 0)
+      (if-eqz v1 :zero)
+      (const v2 1)
+      (goto :join)
+      (:zero)
+      (const v2 2)
+      (:join)
+      (move v3 v2)
+      (if-nez v0 :nonzero)
+      (add-int/lit8 v4 v0 1)
+      (return v4)
+      (:nonzero)
+      (const v5 3)
+      (if-eqz v5 :dead)
+      (return v3)
+      (:dead)
+      (return v5)
+    )
+  )";
+  for (auto editable_cfg : {false, true}) {
+    auto dense_code = assembler::ircode_from_string(code_str);
+    do_const_prop(dense_code.get(), cp::ConstantPrimitiveAnalyzer(),
+                  cp::Transform::Config(), editable_cfg);
+    auto sparse_code = assembler::ircode_from_string(code_str);
+    do_const_prop<SparseFixpointIterator>(
+        sparse_code.get(), cp::ConstantPrimitiveAnalyzer(),
+        cp::Transform::Config(), editable_cfg);
+    EXPECT_CODE_EQ(sparse_code.get(), dense_code.get());
+  }
+}
+
+/*
+ * On a large CFG, where each merge only touches one of many registers, and
+ * nested loops make FixpointIterator go over the whole body several times,
+ * the sparse iterator computes the same states, and computing all the states
+ * that Transform needs takes it no longer than the dense iterator.
+ */
+TEST_F(SparseConstantPropagationTest, LargeCfgIsNotSlower) {
+  constexpr size_t NUM_REGS = 64;
+  constexpr size_t NUM_DIAMONDS = 1000;
+  std::ostringstream code_str;
+  code_str << "((load-param v" << NUM_REGS << ")\n"
+           << "(load-param v" << NUM_REGS + 1 << ")\n";
+  for (size_t r = 0; r < NUM_REGS; ++r) {
+    code_str << "(const v" << r << " " << r << ")\n";
+  }
+  code_str << "(:outer)\n"
+           << "(add-int/lit8 v" << NUM_REGS << " v" << NUM_REGS << " 1)\n"
+           << "(:inner)\n";
+  for (size_t d = 0; d < NUM_DIAMONDS; ++d) {
+    auto reg = d % NUM_REGS;
+    code_str << "(if-eqz v" << NUM_REGS << " :else" << d << ")\n"
+             << "(add-int/lit8 v" << reg << " v" << reg << " 1)\n"
+             << "(goto :join" << d << ")\n"
+             << "(:else" << d << ")\n"
+             << "(add-int/lit8 v" << reg << " v" << reg << " 2)\n"
+             << "(:join" << d << ")\n";
+  }
+  code_str << "(if-nez v" << NUM_REGS + 1 << " :inner)\n"
+           << "(if-gtz v" << NUM_REGS + 1 << " :outer)\n"
+           << "(return v0))";
+  run(code_str.str());
+
+  auto& cfg = m_code->cfg();
+  // The processor time, which other processes don't add to.
+  auto time = [&](auto make_iterator) {
+    auto start = std::clock();
+    auto iterator = make_iterator();
+    iterator->run(ConstantEnvironment());
+    for (auto block : cfg.blocks()) {
+      iterator->get_entry_state_at(block);
+      iterator->get_exit_state_at(block);
+    }
+    return std::clock() - start;
+  };
+  // The best of a few alternating runs, to keep noise out.
+  auto dense = std::numeric_limits<std::clock_t>::max();
+  auto sparse = std::numeric_limits<std::clock_t>::max();
+  for (int i = 0; i < 5; ++i) {
+    dense = std::min(dense, time([&] {
+                       return std::make_unique<FixpointIterator>(
+                           cfg, cp::ConstantPrimitiveAnalyzer());
+                     }));
+    sparse = std::min(sparse, time([&] {
+                        return std::make_unique<SparseFixpointIterator>(
+                            cfg, cp::ConstantPrimitiveAnalyzer());
+                      }));
+  }
+  EXPECT_LE(sparse, dense) << "sparse " << sparse << ", dense " << dense
+                           << " clock ticks";
+}
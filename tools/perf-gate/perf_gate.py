@@ -0,0 +1,202 @@
+#!/usr/bin/env python3
+# Copyright (c) Facebook, Inc. and its affiliates.
+#
+# This source code is licensed under the MIT license found in the
+# LICENSE file in the root directory of this source tree.
+
+# Compares the per-pass timings and memory of two sets of runs, from the stats
+# JSON files that redex-all (or test/perf/PassBenchmark.cpp) writes, and fails
+# if the candidate runs regressed beyond the budgets.
+#
+# Every metric is reduced to its median over the runs of each set, and the
+# spread of the baseline runs is treated as noise that doesn't count against
+# the budget. Example usage:
+#
+#   perf_gate.py --baseline base1.json base2.json base3.json \
+#       --candidate new1.json new2.json new3.json --budgets budgets.json
+#
+# where budgets.json looks like
+#
+#   {
+#     "time": 0.1,
+#     "memory": 0.05,
+#     "min_time_s": 1.0,
+#     "min_memory_bytes": 52428800,
+#     "passes": {"MethodInlinePass": {"time": 0.2}}
+#   }
+#
+# "time" and "memory" are the allowed relative increases; regressions smaller
+# than "min_time_s" or "min_memory_bytes" are ignored.
+
+import argparse
+import json
+import re
+import statistics
+import sys
+from collections import defaultdict
+
+
+DEFAULT_BUDGETS = {
+    "time": 0.1,
+    "memory": 0.05,
+    "min_time_s": 1.0,
+    "min_memory_bytes": 50 * 1024 * 1024,
+    "passes": {},
+}
+
+# The Timer of the n-th run of a pass, see PassManager::run_passes.
+PASS_RUN_TIMER = re.compile(r"^(.*) (\d+) \(run\)$")
+# The pass_stats key of the n-th run of a pass, see PassManager::init.
+PASS_INFO_NAME = re.compile(r"^(.*)#(\d+)$")
+
+
+def normalize(name, merge_runs):
+    """
+    Maps pass timers and pass info names to "<pass>#<run>", or just "<pass>"
+    when merging the runs of a pass.
+    """
+    for pattern in (PASS_RUN_TIMER, PASS_INFO_NAME):
+        match = pattern.match(name)
+        if match:
+            return match.group(1) if merge_runs else "%s#%s" % match.groups()
+    return name
+
+
+def load_run(path, merge_runs):
+    """
+    Returns the times (in seconds) and peak memory increases (in bytes) of a
+    run, keyed by normalized name. Timers that ran more than once, and merged
+    pass runs, are added up.
+    """
+    with open(path) as f:
+        stats = json.load(f)
+    output_stats = stats.get("output_stats", stats)
+    times = defaultdict(float)
+    for element in output_stats.get("time_stats", []):
+        for name, seconds in element.items():
+            times[normalize(name, merge_runs)] += seconds
+    memory = defaultdict(int)
+    for name, metrics in output_stats.get("pass_stats", {}).items():
+        if "vm_hwm_delta" in metrics:
+            memory[normalize(name, merge_runs)] += metrics["vm_hwm_delta"]
+    vm_hwm = output_stats.get("mem_stats", {}).get("vm_hwm")
+    if vm_hwm is not None:
+        memory["(total vm_hwm)"] = vm_hwm
+    return times, memory
+
+
+def medians(runs):
+    """
+    Returns, for every name, the median over the runs, and the largest
+    distance of a run from it.
+    """
+    values = defaultdict(list)
+    for run in runs:
+        for name, value in run.items():
+            values[name].append(value)
+    result = {}
+    for name, vals in values.items():
+        # Runs that lack the metric, e.g. because a pass did nothing, count as
+        # zero.
+        vals += [0] * (len(runs) - len(vals))
+        median = statistics.median(vals)
+        result[name] = (median, max(abs(v - median) for v in vals))
+    return result
+
+
+def budget_for(budgets, name, kind):
+    pass_name = normalize(name, merge_runs=True)
+    per_pass = budgets["passes"].get(pass_name, {})
+    return per_pass.get(kind, budgets[kind])
+
+
+def compare(baseline, candidate, budgets, kind, min_delta, unit, scale):
+    """
+    Prints the comparison of every metric of the given kind, and returns the
+    names of those that regressed.
+    """
+    regressions = []
+    print(
+        "%-50s %12s %12s %12s %8s"
+        % (kind, "base " + unit, "new " + unit, "noise " + unit, "change")
+    )
+    for name in sorted(set(baseline) | set(candidate)):
+        base, noise = baseline.get(name, (0, 0))
+        new, _ = candidate.get(name, (0, 0))
+        delta = new - base
+        allowed = base * budget_for(budgets, name, kind) + noise
+        regressed = delta > max(allowed, min_delta)
+        relative = "%+7.1f%%" % (100.0 * delta / base) if base else "    new"
+        print(
+            "%-50s %12.2f %12.2f %12.2f %8s%s"
+            % (
+                name,
+                base / scale,
+                new / scale,
+                noise / scale,
+                relative,
+                "  REGRESSION" if regressed else "",
+            )
+        )
+        if regressed:
+            regressions.append(name)
+    print()
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Fails if the per-pass timings or memory of the candidate "
+        "runs regressed compared to the baseline runs."
+    )
+    parser.add_argument(
+        "--baseline", nargs="+", required=True, help="stats files of the baseline"
+    )
+    parser.add_argument(
+        "--candidate", nargs="+", required=True, help="stats files of the candidate"
+    )
+    parser.add_argument("--budgets", help="JSON file with the budgets")
+    parser.add_argument(
+        "--per-run",
+        action="store_true",
+        help="compare every run of a pass separately, instead of their sum",
+    )
+    args = parser.parse_args()
+
+    budgets = dict(DEFAULT_BUDGETS)
+    if args.budgets:
+        with open(args.budgets) as f:
+            budgets.update(json.load(f))
+
+    merge_runs = not args.per_run
+    base_runs = [load_run(path, merge_runs) for path in args.baseline]
+    new_runs = [load_run(path, merge_runs) for path in args.candidate]
+
+    regressions = compare(
+        medians([times for times, _ in base_runs]),
+        medians([times for times, _ in new_runs]),
+        budgets,
+        "time",
+        budgets["min_time_s"],
+        "s",
+        1.0,
+    )
+    regressions += compare(
+        medians([memory for _, memory in base_runs]),
+        medians([memory for _, memory in new_runs]),
+        budgets,
+        "memory",
+        budgets["min_memory_bytes"],
+        "MB",
+        1024.0 * 1024.0,
+    )
+
+    if regressions:
+        print("Regressions beyond the budgets:", ", ".join(regressions))
+        return 1
+    print("No regressions beyond the budgets.")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "Debug.h"
+
+/*
+ * The app index written by `redex-tool dex-index-dump` and queried by
+ * `redex-tool dex-index-query`. It holds the same tables as the dex-sql-dump
+ * SQL script, but as columns of fixed-width integers, so that it can be
+ * mapped and scanned without any parsing or importing.
+ *
+ * All names and string constants are ids into a single string dictionary.
+ * Rows are identified by their position: the class of a method is the
+ * position of its row in the class columns, etc.
+ *
+ * The file starts with a Header, followed by one ColumnEntry per Column.
+ * Each column is aligned to 8 bytes. Everything is little-endian.
+ */
+namespace dex_index {
+
+constexpr char MAGIC[8] = {'R', 'D', 'X', 'I', 'N', 'D', 'E', 'X'};
+constexpr uint32_t VERSION = 1;
+
+// Marks a missing reference, e.g. a class without a superclass in the app.
+constexpr uint32_t NONE = 0xffffffff;
+
+enum Column : uint32_t {
+  // STRING_OFFSETS has one more entry than there are strings; string i is
+  // the NUL-terminated string at STRING_DATA[STRING_OFFSETS[i]].
+  STRING_OFFSETS, // uint64_t
+  STRING_DATA, // char
+
+  // Per class.
+  CLASS_DEX, // string id, as "<store>/<dex index>"
+  CLASS_NAME, // string id
+  CLASS_OBFUSCATED_NAME, // string id
+  CLASS_ACCESS, // uint32_t
+  CLASS_SUPER, // class id or NONE
+
+  // Per method.
+  METHOD_CLASS, // class id
+  METHOD_NAME, // string id, of the full deobfuscated name
+  METHOD_OBFUSCATED_NAME, // string id
+  METHOD_ACCESS, // uint32_t
+  METHOD_CODE_SIZE, // uint32_t
+
+  // Per field.
+  FIELD_CLASS, // class id
+  FIELD_NAME, // string id, of the full deobfuscated name
+  FIELD_OBFUSCATED_NAME, // string id
+  FIELD_ACCESS, // uint32_t
+
+  // Per subclass or implementor relation, including indirect ones.
+  IS_A_CLASS, // class id
+  IS_A_SUPER, // class id
+
+  // Per reference from the code of a method; the opcode is an IROpcode.
+  METHOD_METHOD_REF_FROM, // method id
+  METHOD_METHOD_REF_TO, // method id
+  METHOD_METHOD_REF_OPCODE, // uint16_t
+  METHOD_FIELD_REF_FROM, // method id
+  METHOD_FIELD_REF_TO, // field id
+  METHOD_FIELD_REF_OPCODE, // uint16_t
+  METHOD_CLASS_REF_FROM, // method id
+  METHOD_CLASS_REF_TO, // class id
+  METHOD_CLASS_REF_OPCODE, // uint16_t
+  METHOD_STRING_REF_FROM, // method id
+  METHOD_STRING_REF_TO, // string id
+  METHOD_STRING_REF_OPCODE, // uint16_t
+
+  // Per static field with a string value.
+  FIELD_STRING_REF_FROM, // field id
+  FIELD_STRING_REF_TO, // string id
+
+  NUM_COLUMNS
+};
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_columns;
+};
+
+struct ColumnEntry {
+  uint32_t width; // in bytes
+  uint32_t unused;
+  uint64_t offset; // from the start of the file
+  uint64_t count;
+};
+
+/*
+ * Maps an index file, and gives access to its columns.
+ */
+class Reader {
+ public:
+  explicit Reader(const std::string& path) : m_file(path) {
+    always_assert_log(m_file.is_open(), "Could not open %s", path.c_str());
+    auto data = m_file.data();
+    always_assert_log(m_file.size() >= sizeof(Header) &&
+                          memcmp(data, MAGIC, sizeof(MAGIC)) == 0,
+                      "%s is not an app index", path.c_str());
+    m_header = reinterpret_cast<const Header*>(data);
+    always_assert_log(m_header->version == VERSION &&
+                          m_header->num_columns == NUM_COLUMNS,
+                      "%s has an unsupported version", path.c_str());
+    m_columns = reinterpret_cast<const ColumnEntry*>(m_header + 1);
+    for (uint32_t i = 0; i < NUM_COLUMNS; ++i) {
+      always_assert_log(m_columns[i].offset +
+                                m_columns[i].width * m_columns[i].count <=
+                            m_file.size(),
+                        "%s is truncated", path.c_str());
+    }
+  }
+
+  template <typename T>
+  const T* column(Column c) const {
+    always_assert(m_columns[c].width == sizeof(T));
+    return reinterpret_cast<const T*>(m_file.data() + m_columns[c].offset);
+  }
+
+  size_t size(Column c) const { return m_columns[c].count; }
+
+  size_t num_strings() const { return size(STRING_OFFSETS) - 1; }
+
+  const char* string(uint32_t id) const {
+    return column<char>(STRING_DATA) + column<uint64_t>(STRING_OFFSETS)[id];
+  }
+
+ private:
+  boost::iostreams::mapped_file_source m_file;
+  const Header* m_header;
+  const ColumnEntry* m_columns;
+};
+
+} // namespace dex_index
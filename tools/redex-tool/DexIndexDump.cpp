@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+/*
+
+Workflow:
+
+$ ./native/redex/redex.py -u <APK>
+$ buck run //native/redex:redex-tool -- dex-index-dump \
+     --apkdir <APKDIR> --dexendir <DEXEN_DIR> \
+     --jars <ANDROID_JAR> --proguard-map <RENAME_MAP> \
+     --output app.idx
+$ buck run //native/redex:redex-tool -- dex-index-query \
+     --index app.idx --query who-calls 'Lcom/foo/Bar;.baz:()V'
+
+See DexIndex.h for the format.
+
+*/
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "ClassHierarchy.h"
+#include "DexIndex.h"
+#include "DexUtil.h"
+#include "IRCode.h"
+#include "ProguardMap.h"
+#include "Resolver.h"
+#include "Tool.h"
+#include "WorkQueue.h"
+
+namespace {
+
+using namespace dex_index;
+
+// Runs fn(0), ..., fn(count - 1) in a work queue.
+template <typename Fn>
+void run_in_parallel(size_t count, const Fn& fn) {
+  auto wq = workqueue_foreach<size_t>(fn);
+  for (size_t i = 0; i < count; ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+}
+
+/*
+ * Numbers the names and string constants. Strings are added from the workers
+ * gathering the references; each one goes to the shard its hash picks, which
+ * has its own lock. finish() then sorts the shards in parallel and numbers
+ * them one after the other, so the ids only depend on the set of strings, and
+ * not on the order in which they were added.
+ */
+class StringPool {
+ public:
+  void add(const std::string& str) {
+    auto& shard = m_shards[shard_of(str)];
+    std::lock_guard<std::mutex> lock(shard.lock);
+    shard.added.insert(str);
+  }
+
+  void finish() {
+    run_in_parallel(NUM_SHARDS, [&](size_t i) {
+      auto& shard = m_shards[i];
+      shard.sorted.assign(shard.added.begin(), shard.added.end());
+      shard.added.clear();
+      std::sort(shard.sorted.begin(), shard.sorted.end());
+    });
+    for (auto& shard : m_shards) {
+      shard.first_id = m_offsets.size();
+      for (const auto& str : shard.sorted) {
+        m_offsets.push_back(m_data.size());
+        m_data.insert(m_data.end(), str.c_str(), str.c_str() + str.size() + 1);
+      }
+    }
+    // The end offset of the last string.
+    m_offsets.push_back(m_data.size());
+  }
+
+  // The id of a string that was added. Only valid after finish(), and safe to
+  // call from several threads.
+  uint32_t id(const std::string& str) const {
+    const auto& shard = m_shards[shard_of(str)];
+    auto it = std::lower_bound(shard.sorted.begin(), shard.sorted.end(), str);
+    always_assert(it != shard.sorted.end() && *it == str);
+    return shard.first_id + (it - shard.sorted.begin());
+  }
+
+  const std::vector<uint64_t>& offsets() const { return m_offsets; }
+  const std::vector<char>& data() const { return m_data; }
+
+ private:
+  static constexpr size_t NUM_SHARDS = 64;
+
+  struct Shard {
+    std::mutex lock;
+    std::unordered_set<std::string> added;
+    std::vector<std::string> sorted;
+    uint32_t first_id{0};
+  };
+
+  static size_t shard_of(const std::string& str) {
+    return std::hash<std::string>()(str) % NUM_SHARDS;
+  }
+
+  std::array<Shard, NUM_SHARDS> m_shards;
+  std::vector<uint64_t> m_offsets;
+  std::vector<char> m_data;
+};
+
+template <typename To>
+struct Refs {
+  std::vector<uint32_t> from;
+  std::vector<To> to;
+  std::vector<uint16_t> opcode;
+
+  void add(uint32_t from_id, To to_id, uint16_t op) {
+    from.push_back(from_id);
+    to.push_back(to_id);
+    opcode.push_back(op);
+  }
+};
+
+// What the code of the methods of a class refers to; gathered in parallel.
+struct ClassRefs {
+  Refs<uint32_t> methods;
+  Refs<uint32_t> fields;
+  Refs<uint32_t> classes;
+  Refs<const DexString*> strings;
+  // The ids of strings.to, once the strings are numbered.
+  std::vector<uint32_t> string_ids;
+};
+
+class IndexWriter {
+ public:
+  template <typename T>
+  void set(Column c, const std::vector<T>& column) {
+    m_entries[c].width = sizeof(T);
+    m_entries[c].count = column.size();
+    m_data[c] = column.data();
+  }
+
+  void write(FILE* out) {
+    Header header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.num_columns = NUM_COLUMNS;
+    uint64_t offset = sizeof(header) + sizeof(m_entries);
+    for (auto& entry : m_entries) {
+      offset = (offset + 7) & ~uint64_t(7);
+      entry.offset = offset;
+      offset += entry.width * entry.count;
+    }
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(m_entries, sizeof(m_entries), 1, out);
+    offset = sizeof(header) + sizeof(m_entries);
+    for (uint32_t c = 0; c < NUM_COLUMNS; ++c) {
+      static const char padding[8] = {};
+      fwrite(padding, 1, m_entries[c].offset - offset, out);
+      fwrite(m_data[c], m_entries[c].width, m_entries[c].count, out);
+      offset = m_entries[c].offset + m_entries[c].width * m_entries[c].count;
+    }
+  }
+
+ private:
+  ColumnEntry m_entries[NUM_COLUMNS] = {};
+  const void* m_data[NUM_COLUMNS] = {};
+};
+
+template <typename T>
+void append(std::vector<T>& to, const std::vector<T>& from) {
+  to.insert(to.end(), from.begin(), from.end());
+}
+
+void dump_index(FILE* out, DexStoresVector& stores, ProguardMap& pg_map) {
+  StringPool strings;
+
+  // Number the classes, methods and fields in the same order as the SQL dump.
+  std::vector<DexClass*> classes;
+  std::vector<std::string> dex_names;
+  std::vector<uint32_t> class_dex_names;
+  std::vector<DexMethod*> methods;
+  std::vector<DexField*> fields;
+  for (auto& store : stores) {
+    auto& dexen = store.get_dexen();
+    apply_deobfuscated_names(dexen, pg_map);
+    for (size_t dex_idx = 0; dex_idx < dexen.size(); ++dex_idx) {
+      dex_names.push_back(store.get_name() + "/" + std::to_string(dex_idx));
+      strings.add(dex_names.back());
+      for (auto cls : dexen[dex_idx]) {
+        classes.push_back(cls);
+        class_dex_names.push_back(dex_names.size() - 1);
+        append(fields, cls->get_ifields());
+        append(fields, cls->get_sfields());
+        append(methods, cls->get_dmethods());
+        append(methods, cls->get_vmethods());
+      }
+    }
+  }
+  std::unordered_map<const DexClass*, uint32_t> class_ids;
+  for (uint32_t i = 0; i < classes.size(); ++i) {
+    class_ids.emplace(classes[i], i);
+  }
+  std::unordered_map<const DexMethod*, uint32_t> method_ids;
+  for (uint32_t i = 0; i < methods.size(); ++i) {
+    method_ids.emplace(methods[i], i);
+  }
+  std::unordered_map<const DexField*, uint32_t> field_ids;
+  for (uint32_t i = 0; i < fields.size(); ++i) {
+    field_ids.emplace(fields[i], i);
+  }
+  auto class_id_of = [&](const DexType* type) {
+    auto cls = type ? type_class(type) : nullptr;
+    auto it = cls ? class_ids.find(cls) : class_ids.end();
+    return it == class_ids.end() ? NONE : it->second;
+  };
+
+  // Gather the references from the code of each class, and the strings to
+  // number, in parallel. The id maps are only read from here on.
+  std::vector<ClassRefs> class_refs(classes.size());
+  run_in_parallel(classes.size(), [&](size_t class_id) {
+    auto& refs = class_refs[class_id];
+    auto cls = classes[class_id];
+    strings.add(cls->get_deobfuscated_name());
+    strings.add(cls->get_name()->str());
+    for (auto field : cls->get_all_fields()) {
+      strings.add(field->get_deobfuscated_name());
+      strings.add(field->get_name()->str());
+      auto value = field->get_static_value();
+      if (value && value->evtype() == DEVT_STRING) {
+        strings.add(
+            static_cast<DexEncodedValueString*>(value)->string()->str());
+      }
+    }
+    for (auto method : cls->get_all_methods()) {
+      strings.add(method->get_deobfuscated_name());
+      strings.add(method->get_name()->str());
+      auto code = method->get_code();
+      if (!code) {
+        continue;
+      }
+      auto method_id = method_ids.at(method);
+      for (auto& mie : InstructionIterable(code)) {
+        auto insn = mie.insn;
+        auto op = insn->opcode();
+        if (insn->has_string()) {
+          refs.strings.add(method_id, insn->get_string(), op);
+          strings.add(insn->get_string()->str());
+        }
+        if (insn->has_type()) {
+          auto id = class_id_of(insn->get_type());
+          if (id != NONE) {
+            refs.classes.add(method_id, id, op);
+          }
+        }
+        if (insn->has_field()) {
+          auto field = resolve_field(insn->get_field());
+          auto it = field ? field_ids.find(field) : field_ids.end();
+          if (it != field_ids.end()) {
+            refs.fields.add(method_id, it->second, op);
+          }
+        }
+        if (insn->has_method()) {
+          auto callee = resolve_method(insn->get_method(),
+                                       opcode_to_search(insn), method);
+          auto it = callee ? method_ids.find(callee) : method_ids.end();
+          if (it != method_ids.end()) {
+            refs.methods.add(method_id, it->second, op);
+          }
+        }
+      }
+    }
+  });
+  strings.finish();
+  run_in_parallel(classes.size(), [&](size_t class_id) {
+    auto& refs = class_refs[class_id];
+    refs.string_ids.reserve(refs.strings.to.size());
+    for (auto str : refs.strings.to) {
+      refs.string_ids.push_back(strings.id(str->str()));
+    }
+  });
+
+  // Build the columns.
+  std::vector<uint32_t> class_dex, class_name, class_obfuscated_name,
+      class_access, class_super;
+  for (size_t i = 0; i < classes.size(); ++i) {
+    auto cls = classes[i];
+    class_dex.push_back(strings.id(dex_names[class_dex_names[i]]));
+    class_name.push_back(strings.id(cls->get_deobfuscated_name()));
+    class_obfuscated_name.push_back(strings.id(cls->get_name()->str()));
+    class_access.push_back(cls->get_access());
+    class_super.push_back(class_id_of(cls->get_super_class()));
+  }
+
+  std::vector<uint32_t> method_class, method_name, method_obfuscated_name,
+      method_access, method_code_size;
+  for (auto method : methods) {
+    method_class.push_back(class_id_of(method->get_class()));
+    method_name.push_back(strings.id(method->get_deobfuscated_name()));
+    method_obfuscated_name.push_back(strings.id(method->get_name()->str()));
+    method_access.push_back(method->get_access());
+    method_code_size.push_back(
+        method->get_code() ? method->get_code()->sum_opcode_sizes() : 0);
+  }
+
+  std::vector<uint32_t> field_class, field_name, field_obfuscated_name,
+      field_access;
+  Refs<uint32_t> field_string_refs;
+  for (auto field : fields) {
+    auto field_id = field_class.size();
+    field_class.push_back(class_id_of(field->get_class()));
+    field_name.push_back(strings.id(field->get_deobfuscated_name()));
+    field_obfuscated_name.push_back(strings.id(field->get_name()->str()));
+    field_access.push_back(field->get_access());
+    auto value = field->get_static_value();
+    if (value && value->evtype() == DEVT_STRING) {
+      field_string_refs.add(
+          field_id,
+          strings.id(
+              static_cast<DexEncodedValueString*>(value)->string()->str()),
+          0);
+    }
+  }
+
+  Refs<uint32_t> method_refs, field_refs, class_refs_to, string_refs;
+  for (const auto& refs : class_refs) {
+    append(method_refs.from, refs.methods.from);
+    append(method_refs.to, refs.methods.to);
+    append(method_refs.opcode, refs.methods.opcode);
+    append(field_refs.from, refs.fields.from);
+    append(field_refs.to, refs.fields.to);
+    append(field_refs.opcode, refs.fields.opcode);
+    append(class_refs_to.from, refs.classes.from);
+    append(class_refs_to.to, refs.classes.to);
+    append(class_refs_to.opcode, refs.classes.opcode);
+    append(string_refs.from, refs.strings.from);
+    append(string_refs.to, refs.string_ids);
+    append(string_refs.opcode, refs.strings.opcode);
+  }
+  class_refs.clear();
+
+  // The subclasses and implementors of each class are independent of those
+  // of the others, so they are found in parallel, and then concatenated in
+  // scope order.
+  auto scope = build_class_scope(stores);
+  ClassHierarchy ch = build_type_hierarchy(scope);
+  std::vector<std::vector<uint32_t>> children(scope.size());
+  run_in_parallel(scope.size(), [&](size_t i) {
+    TypeSet results;
+    get_all_children_or_implementors(ch, scope, scope[i], results);
+    for (auto type : results) {
+      auto id = class_id_of(type);
+      if (id != NONE) {
+        children[i].push_back(id);
+      }
+    }
+  });
+  std::vector<uint32_t> is_a_class, is_a_super;
+  for (size_t i = 0; i < scope.size(); ++i) {
+    append(is_a_class, children[i]);
+    is_a_super.insert(is_a_super.end(), children[i].size(),
+                      class_ids.at(scope[i]));
+  }
+
+  IndexWriter writer;
+  writer.set(STRING_OFFSETS, strings.offsets());
+  writer.set(STRING_DATA, strings.data());
+  writer.set(CLASS_DEX, class_dex);
+  writer.set(CLASS_NAME, class_name);
+  writer.set(CLASS_OBFUSCATED_NAME, class_obfuscated_name);
+  writer.set(CLASS_ACCESS, class_access);
+  writer.set(CLASS_SUPER, class_super);
+  writer.set(METHOD_CLASS, method_class);
+  writer.set(METHOD_NAME, method_name);
+  writer.set(METHOD_OBFUSCATED_NAME, method_obfuscated_name);
+  writer.set(METHOD_ACCESS, method_access);
+  writer.set(METHOD_CODE_SIZE, method_code_size);
+  writer.set(FIELD_CLASS, field_class);
+  writer.set(FIELD_NAME, field_name);
+  writer.set(FIELD_OBFUSCATED_NAME, field_obfuscated_name);
+  writer.set(FIELD_ACCESS, field_access);
+  writer.set(IS_A_CLASS, is_a_class);
+  writer.set(IS_A_SUPER, is_a_super);
+  writer.set(METHOD_METHOD_REF_FROM, method_refs.from);
+  writer.set(METHOD_METHOD_REF_TO, method_refs.to);
+  writer.set(METHOD_METHOD_REF_OPCODE, method_refs.opcode);
+  writer.set(METHOD_FIELD_REF_FROM, field_refs.from);
+  writer.set(METHOD_FIELD_REF_TO, field_refs.to);
+  writer.set(METHOD_FIELD_REF_OPCODE, field_refs.opcode);
+  writer.set(METHOD_CLASS_REF_FROM, class_refs_to.from);
+  writer.set(METHOD_CLASS_REF_TO, class_refs_to.to);
+  writer.set(METHOD_CLASS_REF_OPCODE, class_refs_to.opcode);
+  writer.set(METHOD_STRING_REF_FROM, string_refs.from);
+  writer.set(METHOD_STRING_REF_TO, string_refs.to);
+  writer.set(METHOD_STRING_REF_OPCODE, string_refs.opcode);
+  writer.set(FIELD_STRING_REF_FROM, field_string_refs.from);
+  writer.set(FIELD_STRING_REF_TO, field_string_refs.to);
+  writer.write(out);
+}
+
+class DexIndexDump : public Tool {
+ public:
+  DexIndexDump()
+      : Tool("dex-index-dump",
+             "dump an apk to a columnar index for dex-index-query") {}
+
+  void add_options(po::options_description& options) const override {
+    add_standard_options(options);
+    options.add_options()(
+        "proguard-map,p",
+        po::value<std::string>()->value_name("redex-rename-map.txt"),
+        "path to a rename map")(
+        "output,o",
+        po::value<std::string>()->value_name("app.idx")->required(),
+        "path to the output index file");
+  }
+
+  void run(const po::variables_map& options) override {
+    auto stores = init(options["jars"].as<std::string>(),
+                       options["apkdir"].as<std::string>(),
+                       options["dexendir"].as<std::string>());
+    ProguardMap pgmap(options.count("proguard-map")
+                          ? options["proguard-map"].as<std::string>()
+                          : "/dev/null");
+    const std::string& filename = options["output"].as<std::string>();
+    FILE* fdout = fopen(filename.c_str(), "wb");
+    if (!fdout) {
+      fprintf(stderr,
+              "Could not open %s for writing; terminating\n",
+              filename.c_str());
+      exit(EXIT_FAILURE);
+    }
+    dump_index(fdout, stores, pgmap);
+    fclose(fdout);
+  }
+};
+
+static DexIndexDump s_tool;
+
+} // namespace
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "DexIndex.h"
+#include "Tool.h"
+
+/*
+ * Answers the common DexSqlQuery.py questions directly from an index written
+ * by dex-index-dump, by scanning its columns:
+ *
+ *   who-calls <method>       the methods that call <method>
+ *   callees <method>         the methods that <method> calls
+ *   who-uses-string <str>    the methods that load the string <str>
+ *   size-by-package [depth]  code size per package, up to <depth> levels
+ *   subclasses <class>       the subclasses and implementors of <class>
+ *
+ * Method and class names are deobfuscated; a name matches if it contains the
+ * given text, e.g. "Lcom/foo/Bar;.baz:" matches all overloads of baz.
+ */
+
+namespace {
+
+using namespace dex_index;
+
+// The rows whose string column contains the text.
+std::unordered_set<uint32_t> find_rows(const Reader& index,
+                                       Column name_column,
+                                       const std::string& text) {
+  auto names = index.column<uint32_t>(name_column);
+  std::unordered_set<uint32_t> rows;
+  for (uint32_t row = 0; row < index.size(name_column); ++row) {
+    if (strstr(index.string(names[row]), text.c_str())) {
+      rows.insert(row);
+    }
+  }
+  return rows;
+}
+
+void print_methods(const Reader& index, const std::vector<uint32_t>& ids) {
+  auto names = index.column<uint32_t>(METHOD_NAME);
+  std::vector<std::string> lines;
+  for (auto id : ids) {
+    lines.emplace_back(index.string(names[id]));
+  }
+  std::sort(lines.begin(), lines.end());
+  lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+  for (const auto& line : lines) {
+    printf("%s\n", line.c_str());
+  }
+  printf("%zu methods\n", lines.size());
+}
+
+// The `from` of every row whose `to` is in `targets`, or vice versa.
+std::vector<uint32_t> scan_refs(const Reader& index,
+                                Column match_column,
+                                Column result_column,
+                                const std::unordered_set<uint32_t>& targets) {
+  auto match = index.column<uint32_t>(match_column);
+  auto result = index.column<uint32_t>(result_column);
+  std::vector<uint32_t> ids;
+  for (size_t row = 0; row < index.size(match_column); ++row) {
+    if (targets.count(match[row])) {
+      ids.push_back(result[row]);
+    }
+  }
+  return ids;
+}
+
+// Like PKG() in DexSqlQuery.py: the first `depth` levels of the package of
+// the class, e.g. "com/foo" for "Lcom/foo/bar/Baz;" and depth 2.
+std::string package_of(const char* class_name, size_t depth) {
+  std::string name(class_name);
+  if (name.size() < 2) {
+    return "";
+  }
+  name = name.substr(1, name.size() - 2);
+  auto end = name.rfind('/');
+  if (end == std::string::npos) {
+    return "";
+  }
+  size_t pos = 0;
+  for (size_t level = 0; level < depth; ++level) {
+    auto slash = name.find('/', pos);
+    if (slash == std::string::npos || slash >= end) {
+      return name.substr(0, end);
+    }
+    pos = slash + 1;
+  }
+  return name.substr(0, pos - 1);
+}
+
+void size_by_package(const Reader& index, size_t depth) {
+  auto class_names = index.column<uint32_t>(CLASS_NAME);
+  auto method_class = index.column<uint32_t>(METHOD_CLASS);
+  auto code_size = index.column<uint32_t>(METHOD_CODE_SIZE);
+  std::vector<uint64_t> class_sizes(index.size(CLASS_NAME));
+  for (size_t m = 0; m < index.size(METHOD_CLASS); ++m) {
+    if (method_class[m] != NONE) {
+      class_sizes[method_class[m]] += code_size[m];
+    }
+  }
+  std::map<std::string, uint64_t> package_sizes;
+  for (size_t c = 0; c < class_sizes.size(); ++c) {
+    package_sizes[package_of(index.string(class_names[c]), depth)] +=
+        class_sizes[c];
+  }
+  std::vector<std::pair<std::string, uint64_t>> sorted(package_sizes.begin(),
+                                                       package_sizes.end());
+  std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+    return a.second > b.second;
+  });
+  for (const auto& package : sorted) {
+    printf("%12lu  %s\n", (unsigned long)package.second,
+           package.first.c_str());
+  }
+}
+
+class DexIndexQuery : public Tool {
+ public:
+  DexIndexQuery()
+      : Tool("dex-index-query", "query an index written by dex-index-dump") {}
+
+  void add_options(po::options_description& options) const override {
+    options.add_options()(
+        "index,i",
+        po::value<std::string>()->value_name("app.idx")->required(),
+        "path to the index file")(
+        "query,q",
+        po::value<std::vector<std::string>>()->multitoken()->required(),
+        "who-calls <method> | callees <method> | who-uses-string <string> | "
+        "size-by-package [depth] | subclasses <class>");
+  }
+
+  void run(const po::variables_map& options) override {
+    Reader index(options["index"].as<std::string>());
+    auto query = options["query"].as<std::vector<std::string>>();
+    const auto& command = query[0];
+    auto arg = query.size() > 1 ? query[1] : std::string();
+    if (command == "who-calls") {
+      print_methods(index,
+                    scan_refs(index, METHOD_METHOD_REF_TO,
+                              METHOD_METHOD_REF_FROM,
+                              find_rows(index, METHOD_NAME, arg)));
+    } else if (command == "callees") {
+      print_methods(index,
+                    scan_refs(index, METHOD_METHOD_REF_FROM,
+                              METHOD_METHOD_REF_TO,
+                              find_rows(index, METHOD_NAME, arg)));
+    } else if (command == "who-uses-string") {
+      std::unordered_set<uint32_t> string_ids;
+      for (uint32_t id = 0; id < index.num_strings(); ++id) {
+        if (arg == index.string(id)) {
+          string_ids.insert(id);
+        }
+      }
+      print_methods(index,
+                    scan_refs(index, METHOD_STRING_REF_TO,
+                              METHOD_STRING_REF_FROM, string_ids));
+    } else if (command == "size-by-package") {
+      size_by_package(index, arg.empty() ? 9999 : std::stoul(arg));
+    } else if (command == "subclasses") {
+      auto ids = scan_refs(index, IS_A_SUPER, IS_A_CLASS,
+                           find_rows(index, CLASS_NAME, arg));
+      auto names = index.column<uint32_t>(CLASS_NAME);
+      for (auto id : ids) {
+        printf("%s\n", index.string(names[id]));
+      }
+      printf("%zu classes\n", ids.size());
+    } else {
+      fprintf(stderr, "Unknown query: %s\n", command.c_str());
+      exit(EXIT_FAILURE);
+    }
+  }
+};
+
+static DexIndexQuery s_tool;
+
+} // namespace
@@ -9,14 +9,17 @@
 #include "DexInstruction.h"
 #include "DexUtil.h"
 #include "JarLoader.h"
+#include "MappedDex.h"
 #include "ProguardConfiguration.h"
 #include "ProguardParser.h"
 #include "ReachableClasses.h"
 #include "Show.h"
 #include "Tool.h"
 #include "Walkers.h"
+#include "WorkQueue.h"
 
 #include <algorithm>
+#include <boost/iostreams/device/mapped_file.hpp>
 #include <iostream>
 #include <map>
 #include <string>
@@ -266,6 +269,139 @@ void diff_from_two_dexen_dirs(const std::string& dexen_dir_A,
   g_redex = A_context;
 }
 
+/*
+ * The streaming mode reads the sizes straight from the code items of the
+ * mapped dex files, and builds the method names from the id tables, without
+ * loading anything into a RedexContext.
+ */
+using DexMethodInfoList =
+    std::vector<std::pair<std::string, std::tuple<int, int>>>;
+
+// Like DexCode::size() and DexCode::get_registers_size().
+std::tuple<int, int> dex_code_sizes(const uint8_t* base, uint32_t code_off) {
+  if (code_off == 0) {
+    return std::make_tuple(0, 0);
+  }
+  auto code = reinterpret_cast<const dex_code_item*>(base + code_off);
+  auto insns = reinterpret_cast<const uint16_t*>(code + 1);
+  uint32_t size = 0;
+  for (uint32_t pos = 0; pos < code->insns_size;) {
+    auto insn_size = mapped_dex::insn_size(insns + pos);
+    if (!dex_opcode::is_fopcode(static_cast<DexOpcode>(insns[pos]))) {
+      size += insn_size;
+    }
+    pos += insn_size;
+  }
+  return std::make_tuple(size, code->registers_size);
+}
+
+void stream_dex_file(const std::string& path, DexMethodInfoList& result) {
+  boost::iostreams::mapped_file_source file(path);
+  always_assert_log(file.is_open(), "Could not open %s", path.c_str());
+  auto base = reinterpret_cast<const uint8_t*>(file.data());
+  auto dh = reinterpret_cast<const dex_header*>(base);
+  auto class_defs =
+      reinterpret_cast<const dex_class_def*>(base + dh->class_defs_off);
+  for (uint32_t i = 0; i < dh->class_defs_size; ++i) {
+    if (class_defs[i].class_data_offset == 0) {
+      continue;
+    }
+    const uint8_t* ptr = base + class_defs[i].class_data_offset;
+    uint32_t sfields_size = read_uleb128(&ptr);
+    uint32_t ifields_size = read_uleb128(&ptr);
+    uint32_t dmethods_size = read_uleb128(&ptr);
+    uint32_t vmethods_size = read_uleb128(&ptr);
+    skip_uleb128s(&ptr, base + file.size(), 2 * (sfields_size + ifields_size));
+    for (auto methods_size : {dmethods_size, vmethods_size}) {
+      uint32_t method_idx = 0;
+      for (uint32_t j = 0; j < methods_size; ++j) {
+        method_idx += read_uleb128(&ptr);
+        read_uleb128(&ptr); // access_flags
+        uint32_t code_off = read_uleb128(&ptr);
+        result.emplace_back(mapped_dex::method_name(base, method_idx),
+                            dex_code_sizes(base, code_off));
+      }
+    }
+  }
+}
+
+/*
+ * The method infos of every directory, sorted by method name. All dex files
+ * of all directories are read in parallel.
+ */
+std::vector<DexMethodInfoList> stream_dex_method_info(
+    const std::vector<std::string>& dirs) {
+  std::vector<std::pair<size_t, std::string>> files;
+  for (size_t i = 0; i < dirs.size(); ++i) {
+    for (const auto& file : mapped_dex::find_dex_files(dirs[i])) {
+      files.emplace_back(i, file);
+    }
+  }
+  std::vector<DexMethodInfoList> per_file(files.size());
+  auto wq = workqueue_foreach<size_t>(
+      [&](size_t i) { stream_dex_file(files[i].second, per_file[i]); });
+  for (size_t i = 0; i < files.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  std::vector<DexMethodInfoList> result(dirs.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    auto& list = result[files[i].first];
+    std::move(per_file[i].begin(), per_file[i].end(),
+              std::back_inserter(list));
+  }
+  auto wq_sort = workqueue_foreach<DexMethodInfoList*>(
+      [](DexMethodInfoList* list) { std::sort(list->begin(), list->end()); });
+  for (auto& list : result) {
+    wq_sort.add_item(&list);
+  }
+  wq_sort.run_all();
+  return result;
+}
+
+void stream_method_sizes(const std::vector<std::string>& dexen_dirs) {
+  std::cout << "INFO: "
+            << "Streaming " << dexen_dirs.size() << " directories ... "
+            << std::endl;
+  auto infos = stream_dex_method_info(dexen_dirs);
+  for (size_t i = 0; i < infos.size(); ++i) {
+    std::cout << "INFO: " << infos[i].size()
+              << " method information loaded from " << dexen_dirs[i]
+              << std::endl;
+  }
+  if (infos.size() == 1) {
+    for (const auto& pair : infos[0]) {
+      std::cout << "SIZE: " << pair.first << " " << std::get<0>(pair.second)
+                << " " << std::get<1>(pair.second) << std::endl;
+    }
+    return;
+  }
+
+  // Merge-join the sorted lists.
+  std::cout << "Diffing A and B... " << std::endl;
+  const auto& A_info = infos[0];
+  const auto& B_info = infos[1];
+  auto a = A_info.begin();
+  auto b = B_info.begin();
+  while (a != A_info.end() && b != B_info.end()) {
+    if (a->first < b->first) {
+      ++a;
+    } else if (b->first < a->first) {
+      ++b;
+    } else {
+      if (a->second != b->second) {
+        std::cout << "DIFF: " << a->first << " "
+                  << std::get<0>(b->second) - std::get<0>(a->second) << " "
+                  << std::get<1>(b->second) - std::get<1>(a->second)
+                  << std::endl;
+      }
+      ++a;
+      ++b;
+    }
+  }
+}
+
 void dump_method_move_info_from_dex_dir(const std::string& dex_dir) {
   std::cout << "INFO: "
             << "Loading directory " << dex_dir << " ... " << std::endl;
@@ -292,6 +428,9 @@ class DiffMethodSizes : public Tool {
         po::value<std::vector<std::string>>()->multitoken(),
         "dump all method sizes in the given dexen directory; if two dexen "
         "directories are given, compare the method sizes")(
+        "streaming",
+        "with --dexendir, read the method sizes straight from the dex "
+        "files instead of loading them, which is much faster")(
         "show-moves,s",
         po::value<std::vector<std::string>>()->multitoken(),
         "show number of move code and their size for each methods");
@@ -304,6 +443,11 @@ class DiffMethodSizes : public Tool {
     } else if (!options["dexendir"].empty()) {
       const auto& dexen_dirs =
           options["dexendir"].as<std::vector<std::string>>();
+      if (options.count("streaming") &&
+          (dexen_dirs.size() == 1 || dexen_dirs.size() == 2)) {
+        stream_method_sizes(dexen_dirs);
+        return;
+      }
       switch (dexen_dirs.size()) {
       case 1:
         dump_method_sizes_from_dexen_dir(dexen_dirs[0]);
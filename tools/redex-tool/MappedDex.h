@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <boost/filesystem.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DexDefs.h"
+#include "DexEncoding.h"
+#include "DexInstruction.h"
+
+/*
+ * Helpers for the tools that read dex files directly, from memory, instead of
+ * loading them into a RedexContext. `base` is the start of the mapped dex.
+ */
+namespace mapped_dex {
+
+inline const dex_header* header(const uint8_t* base) {
+  return reinterpret_cast<const dex_header*>(base);
+}
+
+inline const char* string(const uint8_t* base, uint32_t string_idx) {
+  auto string_ids = reinterpret_cast<const dex_string_id*>(
+      base + header(base)->string_ids_off);
+  const uint8_t* ptr = base + string_ids[string_idx].offset;
+  read_uleb128(&ptr); // utf16_size
+  return reinterpret_cast<const char*>(ptr);
+}
+
+inline const char* type_name(const uint8_t* base, uint32_t type_idx) {
+  auto type_ids =
+      reinterpret_cast<const dex_type_id*>(base + header(base)->type_ids_off);
+  return string(base, type_ids[type_idx].string_idx);
+}
+
+// The same as show(DexMethod*).
+inline std::string method_name(const uint8_t* base, uint32_t method_idx) {
+  auto dh = header(base);
+  auto method_ids =
+      reinterpret_cast<const dex_method_id*>(base + dh->method_ids_off);
+  auto proto_ids =
+      reinterpret_cast<const dex_proto_id*>(base + dh->proto_ids_off);
+  const auto& method_id = method_ids[method_idx];
+  const auto& proto_id = proto_ids[method_id.protoidx];
+  std::string name = type_name(base, method_id.classidx);
+  name += ".";
+  name += string(base, method_id.nameidx);
+  name += ":(";
+  if (proto_id.param_off != 0) {
+    auto size = *reinterpret_cast<const uint32_t*>(base + proto_id.param_off);
+    auto params = reinterpret_cast<const dex_type_item*>(
+        base + proto_id.param_off + sizeof(uint32_t));
+    for (uint32_t i = 0; i < size; ++i) {
+      name += type_name(base, params[i].type_idx);
+    }
+  }
+  name += ")";
+  name += type_name(base, proto_id.rtypeidx);
+  return name;
+}
+
+// The code units of the instruction that starts with the given one, as in
+// DexInstruction::size().
+inline uint32_t insn_size(const uint16_t* insn) {
+  switch (*insn) {
+  case FOPCODE_PACKED_SWITCH:
+    return insn[1] * 2 + 4;
+  case FOPCODE_SPARSE_SWITCH:
+    return insn[1] * 4 + 2;
+  case FOPCODE_FILLED_ARRAY: {
+    uint16_t ewidth = insn[1];
+    uint32_t size = insn[2] | (uint32_t(insn[3]) << 16);
+    return (ewidth * size + 1) / 2 + 4;
+  }
+  default: {
+    // Creating the instruction is the simplest way to get its size, so
+    // remember it.
+    thread_local std::array<uint16_t, 256> sizes{};
+    auto op = static_cast<DexOpcode>(*insn & 0xff);
+    if (sizes[op] == 0) {
+      std::unique_ptr<DexInstruction> dex_insn(
+          DexInstruction::make_instruction(op));
+      sizes[op] = dex_insn->size();
+    }
+    return sizes[op];
+  }
+  }
+}
+
+// The *.dex files in the directory, like load_root_dexen finds them.
+inline std::vector<std::string> find_dex_files(const std::string& dir) {
+  namespace fs = boost::filesystem;
+  std::vector<std::string> files;
+  for (fs::directory_iterator it(dir), end; it != end; ++it) {
+    const auto& file = it->path();
+    if (fs::is_regular_file(file) && file.extension() == ".dex") {
+      files.push_back(file.string());
+    }
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+} // namespace mapped_dex
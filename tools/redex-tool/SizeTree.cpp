@@ -0,0 +1,723 @@
+/*
+ * Copyright (c) Facebook, Inc. and its affiliates.
+ *
+ * This source code is licensed under the MIT license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Debug.h"
+#include "DexAnnotation.h"
+#include "MappedDex.h"
+#include "ProguardMap.h"
+#include "Tool.h"
+#include "WorkQueue.h"
+
+/*
+ * Attributes every byte of the dex files of an app to the class, method and
+ * dex section that it belongs to, and shows or diffs the resulting size
+ * trees:
+ *
+ *   redex-tool size-tree --dexendir out/ --rename-map map.txt -o new.tree
+ *   redex-tool size-tree --show new.tree --depth 3
+ *   redex-tool size-tree --diff old.tree new.tree --depth 4
+ *
+ * A tree is stored as its sorted leaves, one "<bytes>\t<key>" per line, where
+ * the key is "<class>[.<method>] [<section>]", or just "[<section>]" for the
+ * bytes that belong to no single class. The inner nodes (packages, classes,
+ * methods) are the sums of their leaves. --show and --diff also accept a
+ * dexen directory instead of a tree file.
+ *
+ * The dex files are mapped and attributed in parallel, without loading them.
+ * With --cache, the leaves of every dex are kept under its signature, so that
+ * only the dexes that changed are attributed again.
+ */
+
+namespace {
+
+using Leaves = std::vector<std::pair<std::string, uint64_t>>;
+
+void sort_and_sum(Leaves& leaves) {
+  std::sort(leaves.begin(), leaves.end());
+  size_t out = 0;
+  for (size_t i = 0; i < leaves.size(); ++i) {
+    if (out > 0 && leaves[out - 1].first == leaves[i].first) {
+      leaves[out - 1].second += leaves[i].second;
+    } else {
+      leaves[out++] = std::move(leaves[i]);
+    }
+  }
+  leaves.resize(out);
+}
+
+/*
+ * Attributes the bytes of a single dex. Strings and data items can be
+ * referenced from several classes; those that are referenced from more than
+ * one go to "[shared <section>]". Whatever is left, like the padding and the
+ * type lists of the protos, goes to "[other]", so that the leaves always add
+ * up to the size of the file.
+ */
+class DexAttribution {
+ public:
+  DexAttribution(const uint8_t* base, size_t size, const ProguardMap& pgmap)
+      : m_base(base),
+        m_end(base + size),
+        m_pgmap(pgmap),
+        m_string_owners(mapped_dex::header(base)->string_ids_size, UNOWNED) {}
+
+  Leaves run() {
+    auto dh = mapped_dex::header(m_base);
+    auto class_defs =
+        reinterpret_cast<const dex_class_def*>(m_base + dh->class_defs_off);
+    for (uint32_t i = 0; i < dh->class_defs_size; ++i) {
+      attribute_class(class_defs[i]);
+    }
+
+    Leaves leaves;
+    uint64_t attributed = 0;
+    auto add = [&](std::string key, uint64_t size) {
+      leaves.emplace_back(std::move(key), size);
+      attributed += size;
+    };
+    add("[header]", dh->header_size);
+    add("[ids]",
+        dh->type_ids_size * sizeof(dex_type_id) +
+            dh->proto_ids_size * sizeof(dex_proto_id) +
+            dh->field_ids_size * sizeof(dex_field_id) +
+            dh->method_ids_size * sizeof(dex_method_id));
+    if (dh->map_off != 0) {
+      auto map = reinterpret_cast<const dex_map_list*>(m_base + dh->map_off);
+      add("[map]", sizeof(uint32_t) + map->size * sizeof(dex_map_item));
+    }
+    for (size_t i = 0; i < m_owners.size(); ++i) {
+      if (m_class_bytes[i] != 0) {
+        add(m_owners[i] + " [class]", m_class_bytes[i]);
+      }
+    }
+    auto string_ids =
+        reinterpret_cast<const dex_string_id*>(m_base + dh->string_ids_off);
+    for (uint32_t i = 0; i < m_string_owners.size(); ++i) {
+      auto start = m_base + string_ids[i].offset;
+      auto ptr = start;
+      read_uleb128(&ptr);
+      auto size = sizeof(dex_string_id) + (ptr - start) +
+                  strlen(reinterpret_cast<const char*>(ptr)) + 1;
+      add(leaf_key(m_string_owners[i], "strings"), size);
+    }
+    for (const auto& pair : m_items) {
+      const auto& item = pair.second;
+      add(leaf_key(item.owner, item.section), item.size);
+    }
+    auto file_size = m_end - m_base;
+    always_assert(attributed <= uint64_t(file_size));
+    add("[other]", file_size - attributed);
+    sort_and_sum(leaves);
+    return leaves;
+  }
+
+ private:
+  static constexpr uint32_t SHARED = 0xffffffff;
+  static constexpr uint32_t UNOWNED = 0xfffffffe;
+
+  struct Item {
+    uint32_t size;
+    uint32_t owner;
+    const char* section;
+  };
+
+  std::string leaf_key(uint32_t owner, const char* section) const {
+    if (owner == SHARED || owner == UNOWNED) {
+      return std::string("[shared ") + section + "]";
+    }
+    return m_owners[owner] + " [" + section + "]";
+  }
+
+  // An owner is a class or a method, identified by its key.
+  uint32_t add_owner(std::string key) {
+    m_owners.push_back(std::move(key));
+    m_class_bytes.push_back(0);
+    return m_owners.size() - 1;
+  }
+
+  void own(uint32_t* current, uint32_t owner) {
+    if (*current == UNOWNED) {
+      *current = owner;
+    } else if (*current != owner) {
+      *current = SHARED;
+    }
+  }
+
+  // Strings are always attributed to classes, not to methods.
+  void own_string(uint32_t string_idx) {
+    own(&m_string_owners.at(string_idx), m_class_owner);
+  }
+
+  // Data items are identified by their offset.
+  void own_item(uint32_t off,
+                uint32_t size,
+                uint32_t owner,
+                const char* section) {
+    auto it = m_items.emplace(off, Item{size, UNOWNED, section}).first;
+    own(&it->second.owner, owner);
+  }
+
+  void attribute_class(const dex_class_def& def) {
+    auto type_ids =
+        reinterpret_cast<const dex_type_id*>(m_base +
+                                             mapped_dex::header(m_base)
+                                                 ->type_ids_off);
+    std::string cls =
+        m_pgmap.deobfuscate_class(mapped_dex::type_name(m_base, def.typeidx));
+    m_class_owner = add_owner(cls);
+    m_class_bytes[m_class_owner] = sizeof(dex_class_def);
+    own_string(type_ids[def.typeidx].string_idx);
+    if (def.source_file_idx != DEX_NO_INDEX) {
+      own_string(def.source_file_idx);
+    }
+    if (def.interfaces_off != 0) {
+      auto size =
+          *reinterpret_cast<const uint32_t*>(m_base + def.interfaces_off);
+      own_item(def.interfaces_off,
+               sizeof(uint32_t) + size * sizeof(dex_type_item),
+               m_class_owner,
+               "class");
+    }
+    std::unordered_map<uint32_t, uint32_t> method_owners;
+    if (def.class_data_offset != 0) {
+      attribute_class_data(def.class_data_offset, cls, &method_owners);
+    }
+    if (def.annotations_off != 0) {
+      attribute_annotations_directory(def.annotations_off, method_owners);
+    }
+    if (def.static_values_off != 0) {
+      const uint8_t* ptr = m_base + def.static_values_off;
+      skip_encoded_array(&ptr);
+      own_item(def.static_values_off,
+               ptr - (m_base + def.static_values_off),
+               m_class_owner,
+               "static values");
+    }
+  }
+
+  void attribute_class_data(
+      uint32_t class_data_off,
+      const std::string& cls,
+      std::unordered_map<uint32_t, uint32_t>* method_owners) {
+    auto dh = mapped_dex::header(m_base);
+    auto field_ids =
+        reinterpret_cast<const dex_field_id*>(m_base + dh->field_ids_off);
+    auto method_ids =
+        reinterpret_cast<const dex_method_id*>(m_base + dh->method_ids_off);
+    const uint8_t* ptr = m_base + class_data_off;
+    uint32_t sfields_size = read_uleb128(&ptr);
+    uint32_t ifields_size = read_uleb128(&ptr);
+    uint32_t dmethods_size = read_uleb128(&ptr);
+    uint32_t vmethods_size = read_uleb128(&ptr);
+    for (auto fields_size : {sfields_size, ifields_size}) {
+      uint32_t field_idx = 0;
+      for (uint32_t i = 0; i < fields_size; ++i) {
+        field_idx += read_uleb128(&ptr);
+        read_uleb128(&ptr); // access_flags
+        own_string(field_ids[field_idx].nameidx);
+      }
+    }
+    for (auto methods_size : {dmethods_size, vmethods_size}) {
+      uint32_t method_idx = 0;
+      for (uint32_t i = 0; i < methods_size; ++i) {
+        method_idx += read_uleb128(&ptr);
+        read_uleb128(&ptr); // access_flags
+        uint32_t code_off = read_uleb128(&ptr);
+        // Keep the class of the deobfuscated method name in line with the
+        // one of the class, even if the map lacks the method.
+        auto name = m_pgmap.deobfuscate_method(
+            mapped_dex::method_name(m_base, method_idx));
+        auto owner = add_owner(cls + name.substr(name.find(';') + 1));
+        (*method_owners)[method_idx] = owner;
+        own_string(method_ids[method_idx].nameidx);
+        if (code_off != 0) {
+          attribute_code(code_off, owner);
+        }
+      }
+    }
+    m_class_bytes[m_class_owner] += ptr - (m_base + class_data_off);
+  }
+
+  void attribute_code(uint32_t code_off, uint32_t owner) {
+    auto code = reinterpret_cast<const dex_code_item*>(m_base + code_off);
+    auto insns = reinterpret_cast<const uint16_t*>(code + 1);
+    for (uint32_t pos = 0; pos < code->insns_size;
+         pos += mapped_dex::insn_size(insns + pos)) {
+      auto op = insns[pos] & 0xff;
+      if (op == DOPCODE_CONST_STRING) {
+        own_string(insns[pos + 1]);
+      } else if (op == DOPCODE_CONST_STRING_JUMBO) {
+        own_string(insns[pos + 1] | (uint32_t(insns[pos + 2]) << 16));
+      }
+    }
+    auto end = reinterpret_cast<const uint8_t*>(insns + code->insns_size);
+    if (code->tries_size != 0) {
+      if (code->insns_size & 1) {
+        end += sizeof(uint16_t);
+      }
+      end += code->tries_size * sizeof(dex_tries_item);
+      uint32_t handlers_size = read_uleb128(&end);
+      for (uint32_t i = 0; i < handlers_size; ++i) {
+        int32_t size = read_sleb128(&end);
+        // Pairs of type and address, then the catch-all address.
+        skip_uleb128s(&end, m_end, 2 * std::abs(size) + (size <= 0 ? 1 : 0));
+      }
+    }
+    own_item(code_off, end - (m_base + code_off), owner, "code");
+    if (code->debug_info_off != 0) {
+      attribute_debug_info(code->debug_info_off, owner);
+    }
+  }
+
+  void attribute_debug_info(uint32_t debug_info_off, uint32_t owner) {
+    const uint8_t* ptr = m_base + debug_info_off;
+    read_uleb128(&ptr); // line_start
+    uint32_t parameters_size = read_uleb128(&ptr);
+    skip_uleb128s(&ptr, m_end, parameters_size);
+    for (bool done = false; !done;) {
+      switch (*ptr++) {
+      case DBG_END_SEQUENCE:
+        done = true;
+        break;
+      case DBG_ADVANCE_PC:
+      case DBG_ADVANCE_LINE:
+      case DBG_END_LOCAL:
+      case DBG_RESTART_LOCAL:
+      case DBG_SET_FILE:
+        skip_uleb128s(&ptr, m_end, 1);
+        break;
+      case DBG_START_LOCAL:
+        skip_uleb128s(&ptr, m_end, 3);
+        break;
+      case DBG_START_LOCAL_EXTENDED:
+        skip_uleb128s(&ptr, m_end, 4);
+        break;
+      default:
+        break;
+      }
+    }
+    own_item(debug_info_off,
+             ptr - (m_base + debug_info_off),
+             owner,
+             "debug info");
+  }
+
+  void attribute_annotations_directory(
+      uint32_t off, const std::unordered_map<uint32_t, uint32_t>& methods) {
+    auto dir =
+        reinterpret_cast<const dex_annotations_directory_item*>(m_base + off);
+    auto fields = reinterpret_cast<const dex_field_annotation*>(dir + 1);
+    auto method_annos = reinterpret_cast<const dex_method_annotation*>(
+        fields + dir->fields_size);
+    auto parameter_annos = reinterpret_cast<const dex_parameter_annotation*>(
+        method_annos + dir->methods_size);
+    own_item(off,
+             reinterpret_cast<const uint8_t*>(parameter_annos +
+                                              dir->parameters_size) -
+                 (m_base + off),
+             m_class_owner,
+             "annotations");
+    auto method_owner = [&](uint32_t method_idx) {
+      auto it = methods.find(method_idx);
+      return it == methods.end() ? m_class_owner : it->second;
+    };
+    if (dir->class_annotations_off != 0) {
+      attribute_annotation_set(dir->class_annotations_off, m_class_owner);
+    }
+    for (uint32_t i = 0; i < dir->fields_size; ++i) {
+      attribute_annotation_set(fields[i].annotations_off, m_class_owner);
+    }
+    for (uint32_t i = 0; i < dir->methods_size; ++i) {
+      attribute_annotation_set(method_annos[i].annotations_off,
+                               method_owner(method_annos[i].method_idx));
+    }
+    for (uint32_t i = 0; i < dir->parameters_size; ++i) {
+      auto owner = method_owner(parameter_annos[i].method_idx);
+      auto list_off = parameter_annos[i].annotations_off;
+      auto size = *reinterpret_cast<const uint32_t*>(m_base + list_off);
+      own_item(list_off,
+               sizeof(uint32_t) + size * sizeof(dex_annotation_set_ref_item),
+               owner,
+               "annotations");
+      auto refs = reinterpret_cast<const dex_annotation_set_ref_item*>(
+          m_base + list_off + sizeof(uint32_t));
+      for (uint32_t j = 0; j < size; ++j) {
+        if (refs[j].annotations_off != 0) {
+          attribute_annotation_set(refs[j].annotations_off, owner);
+        }
+      }
+    }
+  }
+
+  void attribute_annotation_set(uint32_t off, uint32_t owner) {
+    auto size = *reinterpret_cast<const uint32_t*>(m_base + off);
+    own_item(off,
+             sizeof(uint32_t) + size * sizeof(dex_annotation_off_item),
+             owner,
+             "annotations");
+    auto items = reinterpret_cast<const dex_annotation_off_item*>(
+        m_base + off + sizeof(uint32_t));
+    for (uint32_t i = 0; i < size; ++i) {
+      auto item_off = items[i].annotation_off;
+      const uint8_t* ptr = m_base + item_off + 1; // visibility
+      skip_encoded_annotation(&ptr);
+      own_item(item_off, ptr - (m_base + item_off), owner, "annotations");
+    }
+  }
+
+  void skip_encoded_value(const uint8_t** ptr) {
+    uint8_t header = *(*ptr)++;
+    uint8_t arg = DEVT_HDR_ARG(header);
+    switch (DEVT_HDR_TYPE(header)) {
+    case DEVT_ARRAY:
+      skip_encoded_array(ptr);
+      break;
+    case DEVT_ANNOTATION:
+      skip_encoded_annotation(ptr);
+      break;
+    case DEVT_NULL:
+    case DEVT_BOOLEAN:
+      break;
+    case DEVT_STRING: {
+      uint32_t string_idx = 0;
+      for (uint8_t i = 0; i <= arg; ++i) {
+        string_idx |= uint32_t((*ptr)[i]) << (8 * i);
+      }
+      own_string(string_idx);
+      *ptr += arg + 1;
+      break;
+    }
+    default:
+      *ptr += arg + 1;
+      break;
+    }
+  }
+
+  void skip_encoded_array(const uint8_t** ptr) {
+    uint32_t size = read_uleb128(ptr);
+    for (uint32_t i = 0; i < size; ++i) {
+      skip_encoded_value(ptr);
+    }
+  }
+
+  void skip_encoded_annotation(const uint8_t** ptr) {
+    read_uleb128(ptr); // type_idx
+    uint32_t size = read_uleb128(ptr);
+    for (uint32_t i = 0; i < size; ++i) {
+      own_string(read_uleb128(ptr));
+      skip_encoded_value(ptr);
+    }
+  }
+
+  const uint8_t* m_base;
+  const uint8_t* m_end;
+  const ProguardMap& m_pgmap;
+  std::vector<std::string> m_owners;
+  // The class_def and class_data bytes of the class owners.
+  std::vector<uint64_t> m_class_bytes;
+  std::vector<uint32_t> m_string_owners;
+  std::unordered_map<uint32_t, Item> m_items;
+  uint32_t m_class_owner{UNOWNED};
+};
+
+constexpr uint32_t DexAttribution::SHARED;
+constexpr uint32_t DexAttribution::UNOWNED;
+
+Leaves read_tree(const std::string& path) {
+  std::ifstream in(path);
+  always_assert_log(in, "Could not open %s", path.c_str());
+  Leaves leaves;
+  std::string line;
+  while (std::getline(in, line)) {
+    auto tab = line.find('\t');
+    always_assert_log(tab != std::string::npos, "Malformed size tree %s",
+                      path.c_str());
+    leaves.emplace_back(line.substr(tab + 1),
+                        std::stoull(line.substr(0, tab)));
+  }
+  return leaves;
+}
+
+void write_tree(const Leaves& leaves, std::ostream& out) {
+  for (const auto& leaf : leaves) {
+    out << leaf.second << '\t' << leaf.first << '\n';
+  }
+}
+
+struct Options {
+  ProguardMap pgmap;
+  // Distinguishes the cached trees of different rename maps.
+  std::string cache_tag;
+  std::string cache_dir;
+};
+
+Leaves attribute_dex_file(const std::string& path, const Options& options) {
+  boost::iostreams::mapped_file_source file(path);
+  always_assert_log(file.is_open(), "Could not open %s", path.c_str());
+  auto base = reinterpret_cast<const uint8_t*>(file.data());
+
+  std::string cache_path;
+  if (!options.cache_dir.empty()) {
+    std::ostringstream name;
+    name << options.cache_dir << "/";
+    char hex[3];
+    for (auto byte : mapped_dex::header(base)->signature) {
+      snprintf(hex, sizeof(hex), "%02x", byte);
+      name << hex;
+    }
+    name << "-" << options.cache_tag << ".tree";
+    cache_path = name.str();
+    if (boost::filesystem::exists(cache_path)) {
+      return read_tree(cache_path);
+    }
+  }
+
+  auto leaves = DexAttribution(base, file.size(), options.pgmap).run();
+  if (!cache_path.empty()) {
+    // Write and rename, so that concurrent runs never see a partial tree.
+    auto tmp_path = cache_path + ".tmp";
+    {
+      std::ofstream out(tmp_path);
+      write_tree(leaves, out);
+    }
+    boost::filesystem::rename(tmp_path, cache_path);
+  }
+  return leaves;
+}
+
+Leaves attribute_dexen_dir(const std::string& dir, const Options& options) {
+  auto files = mapped_dex::find_dex_files(dir);
+  std::vector<Leaves> per_dex(files.size());
+  auto wq = workqueue_foreach<size_t>(
+      [&](size_t i) { per_dex[i] = attribute_dex_file(files[i], options); });
+  for (size_t i = 0; i < files.size(); ++i) {
+    wq.add_item(i);
+  }
+  wq.run_all();
+
+  Leaves leaves;
+  for (auto& dex_leaves : per_dex) {
+    std::move(dex_leaves.begin(), dex_leaves.end(),
+              std::back_inserter(leaves));
+  }
+  sort_and_sum(leaves);
+  return leaves;
+}
+
+Leaves load_tree(const std::string& path, const Options& options) {
+  if (boost::filesystem::is_directory(path)) {
+    return attribute_dexen_dir(path, options);
+  }
+  auto leaves = read_tree(path);
+  sort_and_sum(leaves);
+  return leaves;
+}
+
+/*
+ * The nodes from the root to the leaf, e.g. "com", "com/foo", "Lcom/foo/Bar;",
+ * "Lcom/foo/Bar;.baz:()V" and "[code]".
+ */
+std::vector<std::string> leaf_path(const std::string& key) {
+  std::vector<std::string> path;
+  auto section = key.rfind(" [");
+  if (section == std::string::npos) {
+    path.push_back(key);
+    return path;
+  }
+  auto semicolon = key.find(';');
+  if (key[0] == 'L' && semicolon != std::string::npos && semicolon < section) {
+    auto cls = key.substr(0, semicolon + 1);
+    for (auto slash = cls.find('/'); slash != std::string::npos;
+         slash = cls.find('/', slash + 1)) {
+      path.push_back(cls.substr(1, slash - 1));
+    }
+    path.push_back(cls);
+    if (semicolon + 1 < section) {
+      path.push_back(key.substr(0, section));
+    }
+  }
+  path.push_back(key.substr(section + 1));
+  return path;
+}
+
+struct Node {
+  int64_t size{0};
+  std::map<std::string, std::unique_ptr<Node>> children;
+
+  void add(const std::string& key, int64_t leaf_size) {
+    Node* node = this;
+    node->size += leaf_size;
+    for (const auto& name : leaf_path(key)) {
+      auto& child = node->children[name];
+      if (!child) {
+        child = std::make_unique<Node>();
+      }
+      node = child.get();
+      node->size += leaf_size;
+    }
+  }
+
+  void print(const std::string& name,
+             size_t indent,
+             size_t depth,
+             bool signed_sizes) const {
+    printf(signed_sizes ? "%+12lld  %*s%s\n" : "%12lld  %*s%s\n",
+           (long long)size, int(2 * indent), "", name.c_str());
+    if (depth == 0) {
+      return;
+    }
+    std::vector<std::pair<const std::string*, const Node*>> sorted;
+    for (const auto& child : children) {
+      sorted.emplace_back(&child.first, child.second.get());
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+      return std::abs(a.second->size) > std::abs(b.second->size);
+    });
+    for (const auto& child : sorted) {
+      child.second->print(*child.first, indent + 1, depth - 1, signed_sizes);
+    }
+  }
+};
+
+void show_tree(const Leaves& leaves, size_t depth) {
+  Node root;
+  for (const auto& leaf : leaves) {
+    root.add(leaf.first, leaf.second);
+  }
+  root.print("(total)", 0, depth, false);
+}
+
+/*
+ * Merge-joins the sorted leaves of the two trees, and only builds the nodes
+ * of the leaves that changed.
+ */
+void diff_trees(const Leaves& before, const Leaves& after, size_t depth) {
+  Node root;
+  uint64_t total_before = 0;
+  uint64_t total_after = 0;
+  auto a = before.begin();
+  auto b = after.begin();
+  while (a != before.end() || b != after.end()) {
+    if (b == after.end() || (a != before.end() && a->first < b->first)) {
+      total_before += a->second;
+      root.add(a->first, -int64_t(a->second));
+      ++a;
+    } else if (a == before.end() || b->first < a->first) {
+      total_after += b->second;
+      root.add(b->first, b->second);
+      ++b;
+    } else {
+      total_before += a->second;
+      total_after += b->second;
+      if (a->second != b->second) {
+        root.add(a->first, int64_t(b->second) - int64_t(a->second));
+      }
+      ++a;
+      ++b;
+    }
+  }
+  printf("%12llu  before\n%12llu  after\n", (unsigned long long)total_before,
+         (unsigned long long)total_after);
+  root.print("(total)", 0, depth, true);
+}
+
+class SizeTree : public Tool {
+ public:
+  SizeTree()
+      : Tool("size-tree",
+             "attribute, show and diff the sizes of dex files by package, "
+             "class, method and section") {}
+
+  void add_options(po::options_description& options) const override {
+    options.add_options()(
+        "dexendir,d",
+        po::value<std::string>()->value_name("dir"),
+        "attribute the dex files of this directory")(
+        "output,o",
+        po::value<std::string>()->value_name("app.tree"),
+        "where to write the tree of --dexendir (defaults to stdout)")(
+        "show,s",
+        po::value<std::string>()->value_name("app.tree"),
+        "print a tree, or the tree of a dexen directory")(
+        "diff",
+        po::value<std::vector<std::string>>()->multitoken(),
+        "print the differences between two trees, or dexen directories")(
+        "depth",
+        po::value<size_t>()->default_value(3),
+        "how many levels of the tree to print")(
+        "rename-map,r",
+        po::value<std::string>()->value_name("redex-rename-map.txt"),
+        "path to a rename map, to attribute to deobfuscated names")(
+        "cache",
+        po::value<std::string>()->value_name("dir"),
+        "keep the tree of every dex in this directory, to only attribute "
+        "the dexes that changed");
+  }
+
+  void run(const po::variables_map& options) override {
+    Options tree_options;
+    tree_options.cache_tag = "0";
+    if (options.count("rename-map")) {
+      auto path = options["rename-map"].as<std::string>();
+      std::ifstream in(path);
+      std::stringstream contents;
+      contents << in.rdbuf();
+      tree_options.pgmap = ProguardMap(contents);
+      std::ostringstream tag;
+      tag << std::hex << std::hash<std::string>()(contents.str());
+      tree_options.cache_tag = tag.str();
+    }
+    if (options.count("cache")) {
+      tree_options.cache_dir = options["cache"].as<std::string>();
+      boost::filesystem::create_directories(tree_options.cache_dir);
+    }
+    auto depth = options["depth"].as<size_t>();
+
+    if (options.count("diff")) {
+      const auto& trees = options["diff"].as<std::vector<std::string>>();
+      if (trees.size() != 2) {
+        fprintf(stderr, "--diff expects two trees\n");
+        exit(EXIT_FAILURE);
+      }
+      diff_trees(load_tree(trees[0], tree_options),
+                 load_tree(trees[1], tree_options), depth);
+    } else if (options.count("show")) {
+      show_tree(load_tree(options["show"].as<std::string>(), tree_options),
+                depth);
+    } else if (options.count("dexendir")) {
+      auto leaves = attribute_dexen_dir(options["dexendir"].as<std::string>(),
+                                        tree_options);
+      if (options.count("output")) {
+        std::ofstream out(options["output"].as<std::string>());
+        write_tree(leaves, out);
+      } else {
+        write_tree(leaves, std::cout);
+      }
+    } else {
+      fprintf(stderr, "One of --dexendir, --show or --diff is required\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+};
+
+static SizeTree s_tool;
+
+} // namespace
@@ -9,6 +9,8 @@
 #include <dlfcn.h>
 #endif
 
+#include "JemallocUtil.h"
+
 #include "Debug.h"
 
 extern "C" {
@@ -35,6 +37,18 @@ void set_profile_active(bool active) {
   always_assert_log(err == 0, "mallctl failed with: %d", err);
 }
 
+uint64_t* get_thread_allocated_counter() {
+  if (mallctl == nullptr) {
+    return nullptr;
+  }
+  uint64_t* counter = nullptr;
+  size_t size = sizeof(counter);
+  if (mallctl("thread.allocatedp", (void*)&counter, &size, nullptr, 0) != 0) {
+    return nullptr;
+  }
+  return counter;
+}
+
 } // namespace
 
 namespace jemalloc_util {
@@ -43,4 +57,11 @@ void enable_profiling() { set_profile_active(true); }
 
 void disable_profiling() { set_profile_active(false); }
 
+uint64_t thread_allocated_bytes() {
+  // The counter lives in jemalloc's thread-specific data, so it only needs to
+  // be looked up once per thread.
+  static thread_local uint64_t* counter = get_thread_allocated_counter();
+  return counter == nullptr ? 0 : *counter;
+}
+
 } // namespace jemalloc_util
@@ -5,6 +5,9 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#pragma once
+
+#include <cstdint>
 #include <cstdio>
 
 namespace jemalloc_util {
@@ -13,6 +16,10 @@ void enable_profiling();
 
 void disable_profiling();
 
+// Total bytes allocated so far by the calling thread, or zero when not running
+// with jemalloc.
+uint64_t thread_allocated_bytes();
+
 class ScopedProfiling final {
  public:
   explicit ScopedProfiling(bool enable) {